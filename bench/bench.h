@@ -0,0 +1,81 @@
+// Host benchmark runner (pio run -e native_bench -t exec). Each benchmark
+// repeats one operation, doubling the batch until it runs for BENCH_MIN_MS
+// (default 200 ms), and prints one JSON line for tools/bench_compare.py:
+//
+//   {"bench":"sensor_json","iters":262144,"ns_per_op":812.4,"allocs_per_op":1.00,"bytes_per_op":64.0}
+//
+// Allocations are seen through the malloc hooks in bench_main.cpp (linked
+// with -Wl,--wrap=malloc,...), so Arduino String, ArduinoJson and operator
+// new all count, as in /debug/heap on the device.
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// 64-bit: a batch can allocate more than 4 GB in total
+template <int = 0>
+struct BenchAllocs {
+  static uint64_t count;
+  static uint64_t bytes;
+};
+template <int N> uint64_t BenchAllocs<N>::count = 0;
+template <int N> uint64_t BenchAllocs<N>::bytes = 0;
+
+inline void benchCountAlloc(size_t n) {
+  BenchAllocs<>::count++;
+  BenchAllocs<>::bytes += n;
+}
+
+struct BenchResult {
+  const char *name;
+  uint64_t iters;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+struct BenchOptions {
+  const char *filter;   // substring of the names to run, nullptr = all
+  uint32_t minMs;
+};
+
+inline BenchOptions benchOptions(int argc, char **argv) {
+  BenchOptions o = { argc > 1 ? argv[1] : nullptr, 200 };
+  const char *env = getenv("BENCH_MIN_MS");
+  if (env && atoi(env) > 0) o.minMs = (uint32_t)atoi(env);
+  return o;
+}
+
+inline void benchPrint(const BenchResult &r) {
+  printf("{\"bench\":\"%s\",\"iters\":%llu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+         r.name, (unsigned long long)r.iters, r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+  fflush(stdout);
+}
+
+// Op: void(); called once untimed first so one-time setup (static buffers,
+// first file creation) is not charged to every op
+template <typename Op>
+bool benchRun(const BenchOptions &o, const char *name, Op op) {
+  if (o.filter && !strstr(name, o.filter)) return false;
+  op();
+  typedef std::chrono::steady_clock Clock;
+  const uint64_t minNs = (uint64_t)o.minMs * 1000000ULL;
+  for (uint64_t iters = 1;; iters *= 2) {
+    uint64_t allocs = BenchAllocs<>::count, bytes = BenchAllocs<>::bytes;
+    Clock::time_point t0 = Clock::now();
+    for (uint64_t i = 0; i < iters; ++i) op();
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    if (ns < minNs && iters < (1ULL << 32)) continue;
+    BenchResult r = { name, iters, (double)ns / iters,
+                      (double)(BenchAllocs<>::count - allocs) / iters,
+                      (double)(BenchAllocs<>::bytes - bytes) / iters };
+    benchPrint(r);
+    return true;
+  }
+}
+
+#endif // BENCH_H
@@ -0,0 +1,162 @@
+// Host benchmarks of the firmware hot paths, built from the real sources in
+// src/ against the mocks in bench/shim (pio run -e native_bench -t exec).
+// Output: one JSON line per benchmark, see bench.h. Optional argument: run
+// only the benchmarks whose name contains it.
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <DHTesp.h>
+#include <new>
+#include "bench.h"
+#include "http_request.h"
+#include "logging.h"
+#include "relays.h"
+#include "relay_journal.h"
+#include "sensor.h"
+#include "scheduler.h"
+#include "automation.h"
+#include "storage.h"
+#include "time_service.h"
+
+// Same hooks as src/heap_debug.cpp: every malloc of the benched code
+// (String, ArduinoJson, and operator new below) goes through them
+extern "C" {
+void *__real_malloc(size_t n);
+void __real_free(void *p);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n) {
+  benchCountAlloc(n);
+  return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  benchCountAlloc(n * size);
+  return __real_calloc(n, size);
+}
+
+// String growth: counted as a new block, as on the device
+void *__wrap_realloc(void *p, size_t n) {
+  if (n) benchCountAlloc(n);
+  return __real_realloc(p, n);
+}
+
+void __wrap_free(void *p) {
+  __real_free(p);
+}
+}
+
+// libstdc++'s operator new calls malloc from inside the shared library,
+// where --wrap does not reach
+void *operator new(size_t n) {
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+
+static volatile size_t benchSink;
+
+// WiFiClient stand-in replaying one request
+class RequestStream : public Stream {
+public:
+  explicit RequestStream(const char *req) : text(req), len(strlen(req)), pos(0) {}
+  void rewind() { pos = 0; }
+  size_t write(uint8_t) { return 1; }
+  int available() { return (int)(len - pos); }
+  int read() { return pos < len ? (unsigned char)text[pos++] : -1; }
+  int peek() { return pos < len ? (unsigned char)text[pos] : -1; }
+
+private:
+  const char *text;
+  size_t len;
+  size_t pos;
+};
+
+static const char REQUEST[] =
+  "GET /cmd?name=relay&ch=3&state=on HTTP/1.1\r\n"
+  "Host: 192.168.1.50\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+  "Accept: application/json, text/plain, */*\r\n"
+  "Accept-Language: es-ES,es;q=0.9\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n";
+
+// Boot the benched modules on an empty filesystem, with a wall clock and a
+// typical configuration: 16 schedules (lights channel left out so its
+// minimum-on logic stays idle), 3 irrigation times on 2 zones
+static void benchBoot() {
+  SPIFFS.format();
+  benchSetEpoch(1718000000);   // 2024-06-10 06:13:20 UTC, a Monday
+  benchSetDht(21.5f, 55.0f);
+  relaysBegin();
+  storageBegin();
+  initLogging();
+  timeBegin();
+  relaysRestore();
+  sensorBegin();
+  sensorTick();
+  schedulerBegin();
+  automationBegin();
+  static const uint8_t channels[] = { 1, 3, 4, 5 };
+  for (uint8_t i = 0; i < 16; ++i) addSchedule(channels[i % 4], (uint8_t)(i * 3 % 24), (uint8_t)(i * 7 % 60), i % 2 == 0);
+  setIrrigationTimesCSV("06:00,12:00,18:00", 60);
+  setIrrigationZonesCSV("3:60,4:120", 1);
+  relayJournalFlush();
+  logFlush();
+}
+
+int main(int argc, char **argv) {
+  BenchOptions o = benchOptions(argc, argv);
+  benchBoot();
+
+  RequestStream client(REQUEST);
+  benchRun(o, "http_parse_request", [&]() {
+    client.rewind();
+    HttpRequest req;
+    httpReadRequest(client, req);
+    bool cbor = wantsCbor(req.path, req.accept);
+    int q = req.path.indexOf('?');
+    String query = q >= 0 ? req.path.substring(q + 1) : String();
+    benchSink = queryParam(query, "name").length() + queryParam(query, "ch").length() + cbor;
+  });
+
+  benchRun(o, "sensor_json", []() { benchSink = sensorJson().length(); });
+  benchRun(o, "schedule_list_json", []() { benchSink = scheduleListJson().length(); });
+  benchRun(o, "automation_json", []() { benchSink = automationJson().length(); });
+
+  // a new minute every call, so every schedule is evaluated (both clocks
+  // move together: no clock step)
+  benchRun(o, "scheduler_loop", []() {
+    benchAdvanceMs(60000);
+    benchAdvanceEpoch(60);
+    timeTick();
+    schedulerLoop();
+  });
+
+  // a log line per loop, flushed to flash in batches as on the device
+  benchRun(o, "log_append", []() {
+    LOG_I(LOGM_SCHEDULER, "Schedule trigger ch%d -> %s", 3, "ON");
+    benchAdvanceMs(10);
+    logTick();
+  });
+
+  static const String line("Schedule trigger ch3 -> ON");
+  benchRun(o, "log_flush_16_lines", []() {
+    for (int i = 0; i < 16; ++i) appendLog(line);
+    logFlush();
+  });
+
+  benchRun(o, "relay_journal_flush_16", []() {
+    for (uint8_t i = 0; i < 16; ++i) relayJournalRecord(3, i % 2, RELAY_SRC_SCHEDULER, RELAY_REASON_SCHEDULE);
+    relayJournalFlush();
+  });
+
+  // setScheduleEnabled rewrites /schedules.json, loadSchedules reads it back
+  // (schedulerBegin would also register its clock hook again every call)
+  benchRun(o, "schedule_save", []() { setScheduleEnabled(0, true); });
+  benchRun(o, "schedule_load", []() { loadSchedules(); });
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Host stand-in for the Arduino core, enough to build the modules run by
+// bench/bench_main.cpp. Time is simulated: millis() only moves when the
+// benchmark advances it or calls delay(), and the wall clock seen by
+// getLocalTime() and gettimeofday() is set with benchSetEpoch().
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "WString.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Simulated clocks and pins, shared by every translation unit
+template <int = 0>
+struct BenchHost {
+  static unsigned long ms;
+  static time_t epoch;
+  static uint8_t pins[64];
+};
+template <int N> unsigned long BenchHost<N>::ms = 0;
+template <int N> time_t BenchHost<N>::epoch = 0;
+template <int N> uint8_t BenchHost<N>::pins[64];
+
+inline void benchAdvanceMs(unsigned long ms) { BenchHost<>::ms += ms; }
+// 0 leaves the wall clock unset, as before the first NTP sync
+inline void benchSetEpoch(time_t t) { BenchHost<>::epoch = t; }
+inline void benchAdvanceEpoch(long sec) { BenchHost<>::epoch += sec; }
+
+inline unsigned long millis() { return BenchHost<>::ms; }
+inline unsigned long micros() { return BenchHost<>::ms * 1000UL; }
+inline void delay(unsigned long ms) { BenchHost<>::ms += ms; }
+inline void yield() {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t v) { BenchHost<>::pins[pin & 63] = v; }
+inline int digitalRead(uint8_t pin) { return BenchHost<>::pins[pin & 63]; }
+inline uint16_t analogRead(uint8_t) { return 0; }
+
+// esp32-hal-time: the simulated wall clock, in UTC (gettimeofday() is
+// wrapped onto it in globals.cpp)
+inline void configTime(long, int, const char *, const char * = nullptr, const char * = nullptr) {}
+inline void configTzTime(const char *, const char *, const char * = nullptr, const char * = nullptr) {}
+inline bool getLocalTime(struct tm *info, uint32_t = 5000) {
+  time_t t = BenchHost<>::epoch;
+  if (!t) return false;
+  gmtime_r(&t, info);
+  return true;
+}
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *p, size_t n) {
+    size_t i = 0;
+    while (i < n && write(p[i])) i++;
+    return i;
+  }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t println() { return print("\r\n"); }
+  size_t println(const char *s) { return print(s) + println(); }
+  size_t println(const String &s) { return print(s) + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  size_t readBytes(char *buf, size_t n) {
+    size_t i = 0;
+    for (; i < n; ++i) {
+      int c = read();
+      if (c < 0) break;
+      buf[i] = (char)c;
+    }
+    return i;
+  }
+  size_t readBytes(uint8_t *buf, size_t n) { return readBytes((char *)buf, n); }
+
+  // Char by char like the core's, which is what the firmware pays for
+  String readStringUntil(char terminator) {
+    String ret;
+    int c = read();
+    while (c >= 0 && c != terminator) {
+      ret += (char)c;
+      c = read();
+    }
+    return ret;
+  }
+};
+
+// No host console: the log sinks see a closed port and skip the write
+class HardwareSerial : public Stream {
+public:
+  operator bool() const { return false; }
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t *, size_t n) { return n; }
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  void begin(unsigned long) {}
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // ARDUINO_H
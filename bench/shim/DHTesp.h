@@ -0,0 +1,31 @@
+// Host stand-in for the DHT22 driver: every sensor reads the values set with
+// benchSetDht() (NAN = not responding)
+#ifndef DHTESP_H
+#define DHTESP_H
+
+#include <Arduino.h>
+
+struct TempAndHumidity {
+  float temperature;
+  float humidity;
+};
+
+template <int = 0>
+struct DhtMock {
+  static TempAndHumidity value;
+};
+template <int N> TempAndHumidity DhtMock<N>::value = { 21.5f, 55.0f };
+
+inline void benchSetDht(float temperature, float humidity) {
+  DhtMock<>::value.temperature = temperature;
+  DhtMock<>::value.humidity = humidity;
+}
+
+class DHTesp {
+public:
+  enum DHT_MODEL_t { AUTO_DETECT, DHT11, DHT22, AM2302, RHT03 };
+  void setup(uint8_t, DHT_MODEL_t) {}
+  TempAndHumidity getTempAndHumidity() { return DhtMock<>::value; }
+};
+
+#endif // DHTESP_H
@@ -0,0 +1,132 @@
+// In-memory filesystem for the host benchmarks: a fixed table of files with
+// fixed-size storage, so the mock itself never touches the heap and the
+// allocation counts are the firmware's own.
+#ifndef FS_H
+#define FS_H
+
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+static const size_t MOCK_FS_FILES = 16;
+static const size_t MOCK_FS_FILE_BYTES = 96 * 1024;
+
+struct MockFile {
+  char path[32];
+  bool used;
+  size_t size;
+  uint8_t data[MOCK_FS_FILE_BYTES];
+};
+
+template <int = 0>
+struct MockFsState {
+  static MockFile files[MOCK_FS_FILES];
+};
+template <int N> MockFile MockFsState<N>::files[MOCK_FS_FILES];
+
+class File : public Stream {
+public:
+  File() : f(nullptr), pos(0), writable(false) {}
+  File(MockFile *file, size_t at, bool canWrite) : f(file), pos(at), writable(canWrite) {}
+
+  operator bool() const { return f != nullptr; }
+  size_t size() const { return f ? f->size : 0; }
+  size_t position() const { return pos; }
+  void close() { f = nullptr; }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *p, size_t n) {
+    if (!f || !writable) return 0;
+    if (pos + n > MOCK_FS_FILE_BYTES) n = MOCK_FS_FILE_BYTES - pos;   // "disk full"
+    memcpy(f->data + pos, p, n);
+    pos += n;
+    if (pos > f->size) f->size = pos;
+    return n;
+  }
+
+  int available() { return f ? (int)(f->size - pos) : 0; }
+  int read() { return f && pos < f->size ? f->data[pos++] : -1; }
+  int peek() { return f && pos < f->size ? f->data[pos] : -1; }
+  size_t read(uint8_t *p, size_t n) {
+    if (!f) return 0;
+    if (n > f->size - pos) n = f->size - pos;
+    memcpy(p, f->data + pos, n);
+    pos += n;
+    return n;
+  }
+
+private:
+  MockFile *f;
+  size_t pos;
+  bool writable;
+};
+
+class FS {
+public:
+  bool begin(bool = false) { return true; }
+  void end() {}
+
+  bool exists(const char *path) { return find(path) != nullptr; }
+
+  File open(const char *path, const char *mode = FILE_READ) {
+    MockFile *f = find(path);
+    if (mode[0] == 'r') return f ? File(f, 0, false) : File();
+    if (!f) f = create(path);
+    if (!f) return File();
+    if (mode[0] == 'w') f->size = 0;
+    return File(f, mode[0] == 'a' ? f->size : 0, true);
+  }
+
+  bool remove(const char *path) {
+    MockFile *f = find(path);
+    if (!f) return false;
+    f->used = false;
+    return true;
+  }
+
+  bool rename(const char *from, const char *to) {
+    MockFile *f = find(from);
+    if (!f || strlen(to) >= sizeof(f->path)) return false;
+    remove(to);
+    strcpy(f->path, to);
+    return true;
+  }
+
+  // Bench helper: drop every file
+  void format() {
+    for (size_t i = 0; i < MOCK_FS_FILES; ++i) MockFsState<>::files[i].used = false;
+  }
+
+private:
+  MockFile *find(const char *path) {
+    for (size_t i = 0; i < MOCK_FS_FILES; ++i) {
+      MockFile &f = MockFsState<>::files[i];
+      if (f.used && !strcmp(f.path, path)) return &f;
+    }
+    return nullptr;
+  }
+
+  MockFile *create(const char *path) {
+    if (strlen(path) >= sizeof(MockFile().path)) return nullptr;
+    for (size_t i = 0; i < MOCK_FS_FILES; ++i) {
+      MockFile &f = MockFsState<>::files[i];
+      if (f.used) continue;
+      f.used = true;
+      f.size = 0;
+      strcpy(f.path, path);
+      return &f;
+    }
+    return nullptr;
+  }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif // FS_H
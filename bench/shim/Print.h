@@ -0,0 +1,2 @@
+// Host stand-in: the core declares Print in Arduino.h
+#include <Arduino.h>
@@ -0,0 +1,9 @@
+// Host stand-in for the SPIFFS mount, backed by the in-memory FS.h
+#ifndef SPIFFS_H
+#define SPIFFS_H
+
+#include "FS.h"
+
+extern fs::FS SPIFFS;
+
+#endif // SPIFFS_H
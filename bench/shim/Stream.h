@@ -0,0 +1,2 @@
+// Host stand-in: the core declares Stream in Arduino.h
+#include <Arduino.h>
@@ -0,0 +1,164 @@
+// Host stand-in for the Arduino core String with the ESP32 core's memory
+// behaviour: up to 11 chars inline, longer ones realloc'ed to the exact
+// length + 1, so allocation counts match the firmware's. Only what the
+// benched modules use.
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
+
+class String {
+public:
+  String(const char *s = "") : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; if (s) copy(s, strlen(s)); }
+  String(const String &s) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; copy(s.data(), s.len); }
+  explicit String(char c) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; copy(&c, 1); }
+  explicit String(int v) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%d", v); }
+  explicit String(unsigned int v) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%u", v); }
+  explicit String(long v) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%ld", v); }
+  explicit String(unsigned long v) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%lu", v); }
+  explicit String(float v, unsigned char decimals = 2) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%.*f", decimals, (double)v); }
+  explicit String(double v, unsigned char decimals = 2) : buf(nullptr), cap(SSO_CHARS), len(0) { sso[0] = 0; fmt("%.*f", decimals, v); }
+  ~String() { free(buf); }
+
+  String &operator=(const String &s) {
+    if (this != &s) copy(s.data(), s.len);
+    return *this;
+  }
+  String &operator=(const char *s) {
+    if (s) copy(s, strlen(s));
+    else invalidate();
+    return *this;
+  }
+
+  bool reserve(unsigned int size) {
+    if (cap >= size) return true;
+    char *p = (char *)realloc(buf, size + 1);
+    if (!p) return false;
+    if (!buf) memcpy(p, sso, len + 1);
+    buf = p;
+    cap = size;
+    return true;
+  }
+
+  unsigned int length() const { return len; }
+  const char *c_str() const { return data(); }
+
+  bool concat(const char *s, unsigned int n) {
+    if (!n) return true;
+    if (n > UINT_MAX - len || !reserve(len + n)) return false;
+    memcpy(data() + len, s, n);
+    len += n;
+    data()[len] = 0;
+    return true;
+  }
+  bool concat(const char *s) { return s ? concat(s, strlen(s)) : false; }
+  bool concat(const String &s) { return concat(s.c_str(), s.len); }
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(int v) { return concat(String(v)); }
+  bool concat(unsigned long v) { return concat(String(v)); }
+
+  String &operator+=(const String &s) { concat(s); return *this; }
+  String &operator+=(const char *s) { concat(s); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+
+  bool operator==(const String &s) const { return len == s.len && !memcmp(c_str(), s.c_str(), len); }
+  bool operator==(const char *s) const { return !strcmp(c_str(), s ? s : ""); }
+  bool operator!=(const String &s) const { return !(*this == s); }
+  bool operator!=(const char *s) const { return !(*this == s); }
+  char operator[](unsigned int i) const { return i < len ? data()[i] : 0; }
+  char &operator[](unsigned int i) {
+    static char dummy;
+    return i < len ? data()[i] : dummy;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    if (from >= len) return -1;
+    const char *p = strchr(data() + from, c);
+    return p ? (int)(p - data()) : -1;
+  }
+  int indexOf(const char *s, unsigned int from = 0) const {
+    if (from >= len) return -1;
+    const char *p = strstr(data() + from, s);
+    return p ? (int)(p - data()) : -1;
+  }
+  String substring(unsigned int from) const { return substring(from, len); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    String out;
+    if (from >= len) return out;
+    if (to > len) to = len;
+    out.copy(data() + from, to - from);
+    return out;
+  }
+  bool startsWith(const char *s) const { return !strncmp(c_str(), s, strlen(s)); }
+  bool equalsIgnoreCase(const char *s) const {
+    size_t n = strlen(s);
+    if (n != len) return false;
+    const char *p = data();
+    for (size_t i = 0; i < n; ++i) {
+      if (tolower((unsigned char)p[i]) != tolower((unsigned char)s[i])) return false;
+    }
+    return true;
+  }
+  void trim() {
+    char *p = data();
+    unsigned int a = 0, b = len;
+    while (a < b && isspace((unsigned char)p[a])) a++;
+    while (b > a && isspace((unsigned char)p[b - 1])) b--;
+    len = b - a;
+    if (a) memmove(p, p + a, len);
+    p[len] = 0;
+  }
+  long toInt() const { return atol(data()); }
+  float toFloat() const { return (float)atof(data()); }
+
+private:
+  void copy(const char *s, unsigned int n) {
+    if (!reserve(n)) { invalidate(); return; }
+    memmove(data(), s, n);
+    len = n;
+    data()[len] = 0;
+  }
+  void fmt(const char *f, ...) __attribute__((format(printf, 2, 3))) {
+    char tmp[48];
+    va_list ap;
+    va_start(ap, f);
+    int n = vsnprintf(tmp, sizeof(tmp), f, ap);
+    va_end(ap);
+    copy(tmp, n < 0 ? 0 : (unsigned int)n);
+  }
+  void invalidate() {
+    free(buf);
+    buf = nullptr;
+    cap = SSO_CHARS;
+    len = 0;
+    sso[0] = 0;
+  }
+  char *data() { return buf ? buf : sso; }
+  const char *data() const { return buf ? buf : sso; }
+
+  static const unsigned int SSO_CHARS = 11;
+  char *buf;           // heap storage, nullptr while the inline one fits
+  char sso[SSO_CHARS + 1];
+  unsigned int cap;
+  unsigned int len;
+};
+
+// Named by ArduinoJson's String detection; operator+ returns plain String here
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *p) : String(p) {}
+};
+
+inline String operator+(const String &a, const String &b) { String s(a); s += b; return s; }
+inline String operator+(const String &a, const char *b) { String s(a); s += b; return s; }
+inline String operator+(const char *a, const String &b) { String s(a); s += b; return s; }
+inline bool operator==(const char *a, const String &b) { return b == a; }
+
+#endif // WSTRING_H
@@ -0,0 +1,10 @@
+// ESP-IDF SNTP client: never syncs on the host
+#ifndef ESP_SNTP_H
+#define ESP_SNTP_H
+
+#include <sys/time.h>
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t) {}
+
+#endif // ESP_SNTP_H
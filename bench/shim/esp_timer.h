@@ -0,0 +1,9 @@
+// ESP-IDF high resolution timer: the simulated millis(), in microseconds
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return (int64_t)millis() * 1000; }
+
+#endif // ESP_TIMER_H
@@ -0,0 +1,15 @@
+// Objects the Arduino core and its libraries define on the device
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <sys/time.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+fs::FS SPIFFS;
+
+// The simulated wall clock for src/time_service.cpp (-Wl,--wrap=gettimeofday)
+extern "C" int __wrap_gettimeofday(struct timeval *tv, void *) {
+  tv->tv_sec = BenchHost<>::epoch;
+  tv->tv_usec = 0;
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Fixed-capacity binary min-heap (no heap allocation).
+// Hardware independent so it can be unit tested on the host (env:native).
+#ifndef BOUNDED_HEAP_H
+#define BOUNDED_HEAP_H
+
+#include <stddef.h>
+
+// Less must provide `bool operator()(const T &a, const T &b) const`
+template <typename T, size_t N, typename Less>
+class BoundedHeap {
+public:
+  BoundedHeap() : count(0) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == N; }
+  void clear() { count = 0; }
+  const T &top() const { return items[0]; }
+  // Unordered access, e.g. for status reporting
+  const T &at(size_t i) const { return items[i]; }
+
+  bool push(const T &v) {
+    if (count == N) return false;
+    size_t i = count++;
+    items[i] = v;
+    while (i > 0) {
+      size_t parent = (i - 1) / 2;
+      if (!less(items[i], items[parent])) break;
+      swap(i, parent);
+      i = parent;
+    }
+    return true;
+  }
+
+  bool pop(T &out) {
+    if (count == 0) return false;
+    out = items[0];
+    items[0] = items[--count];
+    size_t i = 0;
+    for (;;) {
+      size_t l = 2 * i + 1, r = l + 1, m = i;
+      if (l < count && less(items[l], items[m])) m = l;
+      if (r < count && less(items[r], items[m])) m = r;
+      if (m == i) break;
+      swap(i, m);
+      i = m;
+    }
+    return true;
+  }
+
+private:
+  void swap(size_t a, size_t b) {
+    T t = items[a];
+    items[a] = items[b];
+    items[b] = t;
+  }
+
+  T items[N];
+  size_t count;
+  Less less;
+};
+
+#endif // BOUNDED_HEAP_H
@@ -0,0 +1,252 @@
+// One-to-many message fan-out for stream subscribers (SSE, telnet) that
+// never blocks the publisher. Messages are copied once into a shared byte
+// ring; every subscriber keeps its own read cursor and is drained with a
+// non-blocking writer that may accept only part of a frame. A subscriber that
+// falls more than the ring behind loses frames according to its policy,
+// never the others. Hardware independent.
+//
+// Writer: size_t write(const uint8_t *p, size_t n) returns the bytes accepted
+// right now (0 = would block).
+#ifndef BROADCAST_HUB_H
+#define BROADCAST_HUB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum HubPolicy : uint8_t {
+  HUB_DROP_OLDEST = 0,  // skip only the frames that were overwritten (logs)
+  HUB_SKIP_TO_LATEST,   // skip the whole backlog (state streams that resync)
+  HUB_DISCONNECT,       // ask the owner to close the subscriber
+};
+
+struct HubPart {
+  const void *data;
+  size_t len;
+};
+
+template <size_t RingBytes, size_t MaxSubs, size_t MaxFrame>
+class BroadcastHub {
+  static_assert(MaxFrame < 65536, "frame length is stored in 16 bits");
+  static_assert(MaxFrame + 2 <= RingBytes, "ring must hold at least one frame");
+  // positions are free-running uint32_t: `% RingBytes` stays continuous
+  // across their wrap only for a power of two
+  static_assert((RingBytes & (RingBytes - 1)) == 0, "RingBytes must be a power of two");
+public:
+  struct SubStats {
+    uint32_t frames;       // frames delivered completely
+    uint32_t bytes;
+    uint32_t dropped;      // frames skipped because of lag
+    uint32_t gaps;         // times the policy had to skip
+    uint32_t stalls;       // pumps that stopped on a partial write
+    uint32_t maxLagBytes;  // worst backlog seen at the start of a pump
+  };
+
+  BroadcastHub() : head(0), tail(0), headSeq(0), tailSeq(0), publishedCount(0), evictedCount(0) {
+    for (size_t i = 0; i < MaxSubs; ++i) subs[i].active = false;
+  }
+
+  static size_t capacity() { return MaxSubs; }
+
+  // New subscriber; `replay` starts it at the oldest retained frame instead of
+  // the next published one. -1 when every slot is taken.
+  int subscribe(HubPolicy policy, bool replay = false) {
+    for (size_t i = 0; i < MaxSubs; ++i) {
+      Sub &s = subs[i];
+      if (s.active) continue;
+      memset(&s, 0, sizeof(s));
+      s.active = true;
+      s.policy = policy;
+      s.cursor = replay ? tail : head;
+      s.seq = replay ? tailSeq : headSeq;
+      return (int)i;
+    }
+    return -1;
+  }
+
+  void unsubscribe(int id) { subs[id].active = false; }
+  bool active(int id) const { return subs[id].active; }
+
+  size_t subscribers() const {
+    size_t n = 0;
+    for (size_t i = 0; i < MaxSubs; ++i) n += subs[i].active ? 1 : 0;
+    return n;
+  }
+
+  bool publish(const void *data, size_t len) {
+    HubPart p = { data, len };
+    return publish(&p, 1);
+  }
+
+  // Frame assembled from parts (e.g. "event: ", name, "\ndata: ", json, "\n\n")
+  // without a temporary copy. False if it is larger than MaxFrame.
+  bool publish(const HubPart *parts, size_t n) {
+    size_t len = totalLen(parts, n);
+    if (len > MaxFrame) return false;
+    while (RingBytes - (head - tail) < len + 2) evictOldest();
+    putByte(head, (uint8_t)(len & 0xFF));
+    putByte(head + 1, (uint8_t)(len >> 8));
+    uint32_t at = head + 2;
+    for (size_t k = 0; k < n; ++k) {
+      const uint8_t *p = (const uint8_t *)parts[k].data;
+      for (size_t b = 0; b < parts[k].len; ++b) putByte(at++, p[b]);
+    }
+    head = at;
+    headSeq++;
+    publishedCount++;
+    return true;
+  }
+
+  // Frame for one subscriber only (welcome text, snapshot after a gap). It is
+  // sent before that subscriber's next ring frame. False while a previous
+  // private frame or a partially written ring frame is still pending.
+  bool unicast(int id, const void *data, size_t len) {
+    HubPart p = { data, len };
+    return unicast(id, &p, 1);
+  }
+
+  bool unicast(int id, const HubPart *parts, size_t n) {
+    Sub &s = subs[id];
+    size_t len = totalLen(parts, n);
+    if (!s.active || len > MaxFrame || s.carryLen || s.partial) return false;
+    for (size_t k = 0; k < n; ++k) {
+      memcpy(s.carry + s.carryLen, parts[k].data, parts[k].len);
+      s.carryLen += (uint16_t)parts[k].len;
+    }
+    s.carryPos = 0;
+    return true;
+  }
+
+  // Send as much as `w` accepts. Returns the bytes written.
+  template <typename Writer>
+  size_t pump(int id, Writer &w) {
+    Sub &s = subs[id];
+    if (!s.active || s.closing) return 0;
+    size_t total = 0;
+    while (s.carryPos < s.carryLen) {
+      size_t n = w.write(s.carry + s.carryPos, s.carryLen - s.carryPos);
+      s.carryPos += (uint16_t)n;
+      total += n;
+      if (n == 0) {
+        s.stats.stalls++;
+        s.stats.bytes += total;
+        return total;
+      }
+    }
+    s.carryLen = s.carryPos = 0;
+    if ((int32_t)(tailSeq - s.seq) > 0) {
+      // frames this subscriber never got were overwritten
+      s.stats.gaps++;
+      s.gap = true;
+      if (s.policy == HUB_DISCONNECT) {
+        s.closing = true;
+        s.stats.bytes += total;
+        return total;
+      }
+      bool latest = s.policy == HUB_SKIP_TO_LATEST;
+      s.stats.dropped += (latest ? headSeq : tailSeq) - s.seq;
+      s.cursor = latest ? head : tail;
+      s.seq = latest ? headSeq : tailSeq;
+    }
+    uint32_t lag = head - s.cursor;
+    if (lag > s.stats.maxLagBytes) s.stats.maxLagBytes = lag;
+    while (s.cursor != head) {
+      size_t len = frameLen(s.cursor);
+      size_t off = (s.cursor + 2 + s.partial) % RingBytes;
+      size_t chunk = len - s.partial;
+      if (chunk > RingBytes - off) chunk = RingBytes - off;
+      size_t n = chunk ? w.write(ring + off, chunk) : 0;
+      s.partial += (uint16_t)n;
+      total += n;
+      if (s.partial == len) {
+        s.cursor += 2 + len;
+        s.seq++;
+        s.partial = 0;
+        s.stats.frames++;
+      } else if (n < chunk) {
+        s.stats.stalls++;
+        break;
+      }
+    }
+    s.stats.bytes += total;
+    return total;
+  }
+
+  // True once after frames were skipped for this subscriber, so the owner can
+  // unicast a snapshot or a "lines dropped" note
+  bool takeGap(int id) {
+    bool g = subs[id].gap;
+    subs[id].gap = false;
+    return g;
+  }
+
+  // HUB_DISCONNECT subscriber fell behind; the owner should close and unsubscribe
+  bool closing(int id) const { return subs[id].closing; }
+
+  // Bytes published but not yet sent to this subscriber
+  uint32_t lagBytes(int id) const { return head - subs[id].cursor - subs[id].partial; }
+  uint32_t lagFrames(int id) const { return headSeq - subs[id].seq; }
+  bool idle(int id) const { return subs[id].cursor == head && !subs[id].carryLen; }
+  const SubStats &stats(int id) const { return subs[id].stats; }
+
+  uint32_t published() const { return publishedCount; }
+  uint32_t evicted() const { return evictedCount; }
+  size_t usedBytes() const { return head - tail; }
+
+private:
+  struct Sub {
+    bool active;
+    bool gap;
+    bool closing;
+    HubPolicy policy;
+    uint32_t cursor;    // absolute ring offset of the next frame
+    uint32_t seq;       // sequence number of that frame
+    uint16_t partial;   // bytes of that frame already written
+    uint16_t carryLen;  // private frame (unicast or rescued partial frame)
+    uint16_t carryPos;
+    uint8_t carry[MaxFrame];
+    SubStats stats;
+  };
+
+  static size_t totalLen(const HubPart *parts, size_t n) {
+    size_t len = 0;
+    for (size_t k = 0; k < n; ++k) len += parts[k].len;
+    return len;
+  }
+
+  void putByte(uint32_t at, uint8_t b) { ring[at % RingBytes] = b; }
+  uint8_t getByte(uint32_t at) const { return ring[at % RingBytes]; }
+  size_t frameLen(uint32_t at) const { return getByte(at) | (size_t)getByte(at + 1) << 8; }
+
+  void evictOldest() {
+    size_t len = frameLen(tail);
+    // a subscriber in the middle of this frame keeps the rest in its carry
+    // buffer so its byte stream stays intact
+    for (size_t i = 0; i < MaxSubs; ++i) {
+      Sub &s = subs[i];
+      if (!s.active || s.cursor != tail || !s.partial) continue;
+      size_t rest = len - s.partial;
+      for (size_t b = 0; b < rest; ++b) s.carry[b] = getByte(tail + 2 + s.partial + b);
+      s.carryLen = (uint16_t)rest;
+      s.carryPos = 0;
+      s.cursor += 2 + len;
+      s.seq++;
+      s.partial = 0;
+      s.stats.frames++;
+    }
+    tail += 2 + len;
+    tailSeq++;
+    evictedCount++;
+  }
+
+  uint8_t ring[RingBytes];
+  uint32_t head;        // absolute byte offsets; wrap-around safe
+  uint32_t tail;
+  uint32_t headSeq;
+  uint32_t tailSeq;
+  uint32_t publishedCount;
+  uint32_t evictedCount;
+  Sub subs[MaxSubs];
+};
+
+#endif // BROADCAST_HUB_H
@@ -0,0 +1,117 @@
+// CBOR (RFC 8949) encoder behind the StructWriter interface. Maps and arrays
+// use the indefinite-length form so nothing has to be counted up front, and
+// the encoding goes through a fixed buffer straight into the output (a
+// WiFiClient on the device): memory use is BufBytes whatever the document
+// size. Floats are single precision, NAN becomes null. Hardware independent.
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "struct_writer.h"
+
+// Out: size_t write(const uint8_t *p, size_t n)
+template <typename Out, size_t BufBytes = 256>
+class CborWriter : public StructWriter {
+  static_assert(BufBytes >= 16, "room for the largest head plus a float");
+public:
+  explicit CborWriter(Out &o) : out(o), len(0), total(0), failed(false) {}
+
+  void beginMap() { put(0xBF); }
+  void endMap() { put(0xFF); }
+  void beginArray() { put(0x9F); }
+  void endArray() { put(0xFF); }
+  void key(const char *k) { StructWriter::strValue(k); }
+
+  void intValue(int64_t v) {
+    if (v >= 0) head(0, (uint64_t)v);
+    else head(1, (uint64_t)(-(v + 1)));
+  }
+
+  void floatValue(float v) {
+    if (isnan(v)) {
+      nullValue();
+      return;
+    }
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    room(5);
+    buf[len++] = 0xFA;
+    for (int shift = 24; shift >= 0; shift -= 8) buf[len++] = (uint8_t)(bits >> shift);
+  }
+
+  void boolValue(bool v) { put(v ? 0xF5 : 0xF4); }
+  void nullValue() { put(0xF6); }
+
+  void strValue(const char *s, size_t n) {
+    head(3, n);
+    while (n) {
+      if (len == BufBytes) flush();
+      size_t chunk = BufBytes - len;
+      if (chunk > n) chunk = n;
+      memcpy(buf + len, s, chunk);
+      len += chunk;
+      s += chunk;
+      n -= chunk;
+    }
+  }
+
+  using StructWriter::strValue;
+
+  // Hand the buffered tail to the output; call once the document is done
+  bool flush() {
+    if (len && !failed) failed = out.write(buf, len) != len;
+    total += len;
+    len = 0;
+    return !failed;
+  }
+
+  // Bytes encoded so far (flushed or not)
+  size_t size() const { return total + len; }
+  // The output took less than it was given; later writes are dropped
+  bool ok() const { return !failed; }
+
+private:
+  void put(uint8_t b) {
+    room(1);
+    buf[len++] = b;
+  }
+
+  void room(size_t n) {
+    if (len + n > BufBytes) flush();
+  }
+
+  // Major type plus argument in the shortest form
+  void head(uint8_t major, uint64_t v) {
+    room(9);
+    uint8_t m = (uint8_t)(major << 5);
+    int bytes;
+    if (v < 24) {
+      buf[len++] = m | (uint8_t)v;
+      return;
+    } else if (v <= 0xFF) {
+      buf[len++] = m | 24;
+      bytes = 1;
+    } else if (v <= 0xFFFF) {
+      buf[len++] = m | 25;
+      bytes = 2;
+    } else if (v <= 0xFFFFFFFFull) {
+      buf[len++] = m | 26;
+      bytes = 4;
+    } else {
+      buf[len++] = m | 27;
+      bytes = 8;
+    }
+    for (int i = bytes - 1; i >= 0; --i) buf[len++] = (uint8_t)(v >> (i * 8));
+  }
+
+  Out &out;
+  uint8_t buf[BufBytes];
+  size_t len;
+  size_t total;
+  bool failed;
+};
+
+#endif // CBOR_WRITER_H
@@ -0,0 +1,47 @@
+// HTTP/1.1 chunked transfer coding over a byte sink: every write() becomes
+// one chunk, so a JsonWriter/CborWriter in front of it sends one chunk per
+// buffer flush and the response length never has to be known up front.
+// Hardware independent.
+#ifndef CHUNKED_SINK_H
+#define CHUNKED_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Out: size_t write(const uint8_t *p, size_t n)
+template <typename Out>
+class ChunkedSink {
+public:
+  explicit ChunkedSink(Out &o) : out(o), failed(false), chunks(0) {}
+
+  size_t write(const uint8_t *p, size_t n) {
+    // a zero-length chunk would end the body
+    if (!n || failed) return failed ? 0 : n;
+    char head[12];
+    int h = snprintf(head, sizeof(head), "%x\r\n", (unsigned)n);
+    if (!send((const uint8_t *)head, h) || !send(p, n) || !send((const uint8_t *)"\r\n", 2)) return 0;
+    chunks++;
+    return n;
+  }
+
+  // Last chunk; the response is complete after this
+  bool finish() {
+    return send((const uint8_t *)"0\r\n\r\n", 5);
+  }
+
+  bool ok() const { return !failed; }
+  uint32_t chunkCount() const { return chunks; }
+
+private:
+  bool send(const uint8_t *p, size_t n) {
+    if (!failed && out.write(p, n) != n) failed = true;
+    return !failed;
+  }
+
+  Out &out;
+  bool failed;
+  uint32_t chunks;
+};
+
+#endif // CHUNKED_SINK_H
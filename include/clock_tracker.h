@@ -0,0 +1,91 @@
+// Wall clock bookkeeping for the time service (src/time_service.cpp). It is
+// fed readings of the monotonic clock (ms since boot, 64-bit, never jumps)
+// and of the system wall clock, and keeps the offset between the two, so
+// the wall time can be derived from the monotonic clock without another
+// system call. It notices when the wall clock becomes valid and when it
+// jumps: an NTP step, a manual set, or an RTC that was far off. Each of
+// those is reported once, as an event, so modules that count minutes can
+// re-anchor instead of firing twice or skipping. Hardware independent.
+#ifndef CLOCK_TRACKER_H
+#define CLOCK_TRACKER_H
+
+#include <stdint.h>
+
+enum ClockSource : uint8_t {
+  CLOCK_NONE = 0,   // not set yet
+  CLOCK_RTC,        // kept across the reset by the RTC timer, not synced yet
+  CLOCK_NTP,        // set by NTP since boot
+};
+
+enum ClockEvent : uint8_t {
+  CLOCK_EV_NONE = 0,
+  CLOCK_EV_SET,     // became valid
+  CLOCK_EV_JUMP,    // stepped by more than the threshold: see lastJumpMs()
+  CLOCK_EV_SYNC,    // NTP answered (reported by the time service, after synced())
+  CLOCK_EV_ZONE,    // time zone rule changed (reported by the time service)
+};
+
+class ClockTracker {
+public:
+  // 2001-09-09: any epoch past this was set, not the 1970 the clock starts at
+  static const int64_t VALID_AFTER_MS = 1000000000LL * 1000;
+
+  explicit ClockTracker(uint32_t jumpThresholdMs = 2000)
+    : threshold(jumpThresholdMs), src(CLOCK_NONE), offsetMs(0), jumpMs(0), jumpCount(0),
+      syncCount(0), syncMono(0), everSynced(false) {}
+
+  // First reading, at boot: a clock already valid survived the reset
+  void begin(uint64_t monoMs, int64_t wallMs) {
+    if (wallMs < VALID_AFTER_MS) return;
+    src = CLOCK_RTC;
+    offsetMs = wallMs - (int64_t)monoMs;
+  }
+
+  // One reading of both clocks, every loop; what happened since the last
+  ClockEvent observe(uint64_t monoMs, int64_t wallMs) {
+    if (wallMs < VALID_AFTER_MS) return CLOCK_EV_NONE;
+    int64_t offset = wallMs - (int64_t)monoMs;
+    if (src == CLOCK_NONE) {
+      src = CLOCK_NTP;
+      offsetMs = offset;
+      return CLOCK_EV_SET;
+    }
+    int64_t d = offset - offsetMs;
+    offsetMs = offset;
+    if (d <= (int64_t)threshold && d >= -(int64_t)threshold) return CLOCK_EV_NONE;
+    jumpMs = d;
+    jumpCount++;
+    return CLOCK_EV_JUMP;
+  }
+
+  // NTP reported a sync (its step, if any, shows up in the next observe())
+  void synced(uint64_t monoMs) {
+    syncCount++;
+    syncMono = monoMs;
+    everSynced = true;
+    if (src != CLOCK_NONE) src = CLOCK_NTP;
+  }
+
+  bool valid() const { return src != CLOCK_NONE; }
+  ClockSource source() const { return src; }
+  // Wall time for a monotonic reading, as of the last observe(); 0 if unset
+  int64_t wallMs(uint64_t monoMs) const { return src != CLOCK_NONE ? (int64_t)monoMs + offsetMs : 0; }
+  // Last step, positive forward
+  int64_t lastJumpMs() const { return jumpMs; }
+  uint32_t jumps() const { return jumpCount; }
+  uint32_t syncs() const { return syncCount; }
+  // Since the last NTP sync, UINT64_MAX if never
+  uint64_t sinceSyncMs(uint64_t monoMs) const { return everSynced ? monoMs - syncMono : UINT64_MAX; }
+
+private:
+  uint32_t threshold;
+  ClockSource src;
+  int64_t offsetMs;      // wall - monotonic
+  int64_t jumpMs;
+  uint32_t jumpCount;
+  uint32_t syncCount;
+  uint64_t syncMono;
+  bool everSynced;
+};
+
+#endif // CLOCK_TRACKER_H
@@ -0,0 +1,294 @@
+// Table-driven command dispatcher shared by all transports (serial, HTTP,
+// MQTT). Each command declares a typed argument schema; transports only turn
+// their input into key/value pairs and the dispatcher validates, converts and
+// times the call. Hardware independent.
+//
+// Arguments may be given by name ("ch=2") or by position ("relay 2 on"); a
+// positional string as the last argument takes the rest of a line.
+//
+// Commands named in the constructor's `localOnly` list are refused to a
+// remote transport (dispatch(..., remote = true)), e.g. a shared MQTT
+// broker, and run from the others only.
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+enum CmdArgType : uint8_t {
+  CMD_ARG_INT = 0,
+  CMD_ARG_FLOAT,
+  CMD_ARG_BOOL,   // 1/0, true/false, on/off, yes/no
+  CMD_ARG_STR,
+  CMD_ARG_ENUM,   // one of `choices` ("on|off|toggle"), read as its index
+};
+
+struct CmdArgSpec {
+  const char *name;
+  CmdArgType type;
+  bool required;
+  float min;        // range check for numbers when min < max
+  float max;
+  const char *choices;
+};
+
+// key == 0 or "" means positional
+struct CmdPair {
+  const char *key;
+  const char *value;
+};
+
+enum CmdStatus : uint8_t {
+  CMD_OK = 0,
+  CMD_UNKNOWN,    // no such command
+  CMD_BAD_ARGS,   // schema validation failed
+  CMD_FAILED,     // handler returned false
+  CMD_DENIED,     // local-only command from a remote transport
+};
+
+static const size_t CMD_MAX_ARGS = 6;
+static const size_t CMD_MAX_PAIRS = 8;
+
+class CmdArgs {
+public:
+  CmdArgs() { for (size_t i = 0; i < CMD_MAX_ARGS; ++i) present[i] = false; }
+  bool has(size_t i) const { return present[i]; }
+  long asInt(size_t i, long def = 0) const { return present[i] ? v[i].i : def; }
+  float asFloat(size_t i, float def = 0) const { return present[i] ? v[i].f : def; }
+  bool asBool(size_t i, bool def = false) const { return present[i] ? v[i].i != 0 : def; }
+  const char *asStr(size_t i, const char *def = "") const { return present[i] ? v[i].s : def; }
+
+private:
+  template <typename Ctx, size_t N> friend class CommandDispatcher;
+  union Value { long i; float f; const char *s; };
+  Value v[CMD_MAX_ARGS];
+  bool present[CMD_MAX_ARGS];
+};
+
+template <typename Ctx>
+struct CmdDef {
+  const char *name;
+  const char *alias;          // optional second name (e.g. legacy serial verb)
+  const CmdArgSpec *args;
+  uint8_t argCount;
+  bool (*run)(const CmdArgs &args, Ctx &ctx);
+  const char *help;
+};
+
+template <typename Ctx, size_t N>
+class CommandDispatcher {
+public:
+  struct Stats {
+    uint32_t calls;
+    uint32_t errors;     // validation failures and handler failures
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+  };
+
+  // localOnly: command names, nullptr-terminated
+  explicit CommandDispatcher(const CmdDef<Ctx> (&table)[N], const char *const *localOnly = 0) : defs(table) {
+    resetStats();
+    for (size_t i = 0; i < N; ++i) local[i] = false;
+    for (; localOnly && *localOnly; ++localOnly) {
+      int idx = find(*localOnly);
+      if (idx >= 0) local[idx] = true;
+    }
+  }
+
+  static size_t size() { return N; }
+  const CmdDef<Ctx> &def(size_t i) const { return defs[i]; }
+  const Stats &stats(size_t i) const { return stat[i]; }
+  bool localOnly(size_t i) const { return local[i]; }
+  void resetStats() { memset(stat, 0, sizeof(stat)); }
+
+  int find(const char *name) const {
+    for (size_t i = 0; i < N; ++i) {
+      if (strcmp(defs[i].name, name) == 0) return (int)i;
+      if (defs[i].alias && strcmp(defs[i].alias, name) == 0) return (int)i;
+    }
+    return -1;
+  }
+
+  // Validate `pairs` against the command's schema and run it. nowUs() is
+  // any microsecond clock; the elapsed time is recorded per command.
+  template <typename Clock>
+  CmdStatus dispatch(const char *name, const CmdPair *pairs, size_t n, Ctx &ctx,
+                     char *err, size_t errLen, Clock nowUs, bool remote = false) {
+    int idx = find(name);
+    if (idx < 0) {
+      setErr(err, errLen, "unknown command '%s'", name);
+      return CMD_UNKNOWN;
+    }
+    if (remote && local[idx]) {
+      setErr(err, errLen, "%s is not allowed from here", defs[idx].name);
+      return CMD_DENIED;
+    }
+    uint32_t t0 = (uint32_t)nowUs();
+    const CmdDef<Ctx> &d = defs[idx];
+    CmdArgs args;
+    CmdStatus st = bind(d, pairs, n, args, err, errLen) ? CMD_OK : CMD_BAD_ARGS;
+    if (st == CMD_OK && !d.run(args, ctx)) {
+      st = CMD_FAILED;
+      setErr(err, errLen, "%s failed", d.name);
+    }
+    uint32_t dt = (uint32_t)nowUs() - t0;
+    Stats &s = stat[idx];
+    s.calls++;
+    if (st != CMD_OK) s.errors++;
+    s.lastUs = dt;
+    if (dt > s.maxUs) s.maxUs = dt;
+    s.totalUs += dt;
+    return st;
+  }
+
+  // Split "name arg arg key=value ..." in place and dispatch it.
+  template <typename Clock>
+  CmdStatus dispatchLine(char *line, Ctx &ctx, char *err, size_t errLen, Clock nowUs, bool remote = false) {
+    char *p = skip(line);
+    char *name = p;
+    while (*p && *p != ' ') ++p;
+    if (*p) *p++ = 0;
+    int idx = find(name);
+    if (idx < 0) return dispatch(name, 0, 0, ctx, err, errLen, nowUs, remote);
+    const CmdDef<Ctx> &d = defs[idx];
+    CmdPair pairs[CMD_MAX_PAIRS];
+    size_t n = 0;
+    size_t positional = 0;
+    for (p = skip(p); *p && n < CMD_MAX_PAIRS; p = skip(p)) {
+      // a trailing string argument swallows the rest of the line (rule text, CSV)
+      if (d.argCount && positional == (size_t)d.argCount - 1 &&
+          d.args[d.argCount - 1].type == CMD_ARG_STR && !isKeyed(d, p)) {
+        char *end = p + strlen(p);
+        while (end > p && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n')) *--end = 0;
+        pairs[n].key = 0;
+        pairs[n++].value = p;
+        break;
+      }
+      char *tok = p;
+      while (*p && *p != ' ') ++p;
+      if (*p) *p++ = 0;
+      char *eq = isKeyed(d, tok) ? strchr(tok, '=') : 0;
+      if (eq) {
+        *eq = 0;
+        pairs[n].key = tok;
+        pairs[n++].value = eq + 1;
+      } else {
+        pairs[n].key = 0;
+        pairs[n++].value = tok;
+        positional++;
+      }
+    }
+    return dispatch(name, pairs, n, ctx, err, errLen, nowUs, remote);
+  }
+
+private:
+  static char *skip(char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+    return p;
+  }
+
+  // "name=value" where name is one of the command's arguments
+  static bool isKeyed(const CmdDef<Ctx> &d, const char *tok) {
+    const char *eq = strchr(tok, '=');
+    const char *sp = strchr(tok, ' ');
+    if (!eq || (sp && sp < eq)) return false;
+    for (size_t a = 0; a < d.argCount; ++a) {
+      size_t n = strlen(d.args[a].name);
+      if (n == (size_t)(eq - tok) && strncmp(d.args[a].name, tok, n) == 0) return true;
+    }
+    return false;
+  }
+
+  static void setErr(char *err, size_t len, const char *fmt, const char *what) {
+    if (err && len) snprintf(err, len, fmt, what);
+  }
+
+  static bool parseBool(const char *s, long &out) {
+    static const char *yes[] = { "1", "true", "on", "yes" };
+    static const char *no[] = { "0", "false", "off", "no" };
+    for (size_t i = 0; i < 4; ++i) {
+      if (strcmp(s, yes[i]) == 0) { out = 1; return true; }
+      if (strcmp(s, no[i]) == 0) { out = 0; return true; }
+    }
+    return false;
+  }
+
+  static bool parseEnum(const char *s, const char *choices, long &out) {
+    size_t len = strlen(s);
+    long i = 0;
+    for (const char *c = choices; c && *c; ++i) {
+      const char *bar = strchr(c, '|');
+      size_t n = bar ? (size_t)(bar - c) : strlen(c);
+      if (n == len && strncmp(c, s, n) == 0) { out = i; return true; }
+      c = bar ? bar + 1 : 0;
+    }
+    return false;
+  }
+
+  static bool convert(const CmdArgSpec &a, const char *s, CmdArgs::Value &v) {
+    char *end;
+    switch (a.type) {
+      case CMD_ARG_INT:
+        v.i = strtol(s, &end, 10);
+        if (end == s || *end) return false;
+        return a.min >= a.max || (v.i >= a.min && v.i <= a.max);
+      case CMD_ARG_FLOAT:
+        v.f = strtof(s, &end);
+        if (end == s || *end) return false;
+        return a.min >= a.max || (v.f >= a.min && v.f <= a.max);
+      case CMD_ARG_BOOL:
+        return parseBool(s, v.i);
+      case CMD_ARG_ENUM:
+        return parseEnum(s, a.choices, v.i);
+      default:
+        v.s = s;
+        return true;
+    }
+  }
+
+  static bool bind(const CmdDef<Ctx> &d, const CmdPair *pairs, size_t n, CmdArgs &args,
+                   char *err, size_t errLen) {
+    size_t nextPos = 0;
+    for (size_t k = 0; k < n; ++k) {
+      size_t slot = d.argCount;
+      if (pairs[k].key && pairs[k].key[0]) {
+        for (size_t a = 0; a < d.argCount; ++a) {
+          if (strcmp(d.args[a].name, pairs[k].key) == 0) { slot = a; break; }
+        }
+        if (slot == d.argCount) {
+          setErr(err, errLen, "unknown argument '%s'", pairs[k].key);
+          return false;
+        }
+      } else {
+        while (nextPos < d.argCount && args.present[nextPos]) ++nextPos;
+        if (nextPos == d.argCount) {
+          setErr(err, errLen, "too many arguments for %s", d.name);
+          return false;
+        }
+        slot = nextPos;
+      }
+      if (!convert(d.args[slot], pairs[k].value, args.v[slot])) {
+        setErr(err, errLen, "bad value for '%s'", d.args[slot].name);
+        return false;
+      }
+      args.present[slot] = true;
+    }
+    for (size_t a = 0; a < d.argCount; ++a) {
+      if (d.args[a].required && !args.present[a]) {
+        setErr(err, errLen, "missing '%s'", d.args[a].name);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const CmdDef<Ctx> (&defs)[N];
+  Stats stat[N];
+  bool local[N];
+};
+
+#endif // COMMAND_DISPATCHER_H
@@ -0,0 +1,180 @@
+// Writing an image into a flash partition as it streams in (OTA, see
+// src/ota.cpp). Bytes are gathered into one flash page and programmed a page
+// at a time; each sector is erased just before its first page, so the image
+// is never held in RAM and an upload that stops halfway has only erased what
+// it wrote. The stream is hashed on the way in (SHA-256) and the flash is
+// read back and hashed again before the image is trusted.
+//
+// Flash is the partition, offsets relative to its start:
+//   uint32_t size() const
+//   bool erase(uint32_t offset, uint32_t len)   // whole sectors
+//   bool write(uint32_t offset, const uint8_t *p, size_t n)
+//   bool read(uint32_t offset, uint8_t *p, size_t n)
+// Hardware independent: the host tests use a simulated partition.
+#ifndef FLASH_WRITER_H
+#define FLASH_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "sha256.h"
+
+enum FlashWriteError : uint8_t {
+  FLASH_OK = 0,
+  FLASH_ERR_SIZE,       // larger than the partition, or not the size announced
+  FLASH_ERR_ERASE,
+  FLASH_ERR_WRITE,
+  FLASH_ERR_DIGEST,     // the stream does not hash to the expected SHA-256
+  FLASH_ERR_READBACK,   // the flash does not hold what was written
+  FLASH_ERR_ABORTED,
+};
+
+inline const char *flashWriteErrorName(FlashWriteError e) {
+  switch (e) {
+    case FLASH_OK: return "ok";
+    case FLASH_ERR_SIZE: return "size";
+    case FLASH_ERR_ERASE: return "erase";
+    case FLASH_ERR_WRITE: return "write";
+    case FLASH_ERR_DIGEST: return "sha256 mismatch";
+    case FLASH_ERR_READBACK: return "readback mismatch";
+    case FLASH_ERR_ABORTED: return "aborted";
+  }
+  return "?";
+}
+
+template <typename Flash, size_t PAGE = 256, uint32_t SECTOR = 4096>
+class FlashStreamWriter {
+  static_assert(SECTOR % PAGE == 0, "pages must tile a sector");
+
+public:
+  explicit FlashStreamWriter(Flash &f) : flash(f), total(0), received(0), flushed(0), verified(0), fill(0), err(FLASH_OK) {}
+
+  // A stream of `size` bytes hashing to `digest` follows
+  bool begin(uint32_t size, const uint8_t digest[Sha256::DIGEST_SIZE]) {
+    total = size;
+    received = flushed = verified = 0;
+    fill = 0;
+    err = FLASH_OK;
+    memcpy(expected, digest, sizeof(expected));
+    sha.reset();
+    if (size == 0 || size > flash.size()) return fail(FLASH_ERR_SIZE);
+    return true;
+  }
+
+  // Any split of the stream; false from the first failure on
+  bool write(const uint8_t *p, size_t n) {
+    if (err) return false;
+    if (n > total - received) return fail(FLASH_ERR_SIZE);
+    sha.update(p, n);
+    received += n;
+    while (n) {
+      size_t k = PAGE - fill < n ? PAGE - fill : n;
+      memcpy(page + fill, p, k);
+      fill += k;
+      p += k;
+      n -= k;
+      if (fill == PAGE && !flushPage()) return false;
+    }
+    return true;
+  }
+
+  // After the last byte: programs the partial page, checks size and digest
+  bool finish() {
+    if (err) return false;
+    if (received != total) return fail(FLASH_ERR_SIZE);
+    if (fill) {
+      memset(page + fill, 0xFF, PAGE - fill);   // erased state: programs nothing
+      if (!flushPage()) return false;
+    }
+    uint8_t d[Sha256::DIGEST_SIZE];
+    sha.finish(d);
+    if (memcmp(d, expected, sizeof(d)) != 0) return fail(FLASH_ERR_DIGEST);
+    sha.reset();
+    return true;
+  }
+
+  // After finish(): reads back up to `budget` bytes and hashes them, so a
+  // long verification can be spread over several loops. true when the whole
+  // image is verified; false while in progress or failed (see error())
+  bool verifyStep(size_t budget) {
+    if (err) return false;
+    while (verified < total && budget) {
+      size_t n = total - verified < PAGE ? total - verified : PAGE;
+      if (!flash.read(verified, page, n)) return fail(FLASH_ERR_READBACK);
+      sha.update(page, n);
+      verified += n;
+      budget = budget > n ? budget - n : 0;
+    }
+    if (verified < total) return false;
+    uint8_t d[Sha256::DIGEST_SIZE];
+    sha.finish(d);
+    sha.reset();
+    verified = total + 1;   // checked once
+    if (memcmp(d, expected, sizeof(d)) != 0) return fail(FLASH_ERR_READBACK);
+    return true;
+  }
+
+  void abort() { if (!err) err = FLASH_ERR_ABORTED; }
+
+  FlashWriteError error() const { return err; }
+  uint32_t size() const { return total; }
+  uint32_t bytesReceived() const { return received; }
+  uint32_t bytesVerified() const { return verified > total ? total : verified; }
+
+private:
+  bool fail(FlashWriteError e) {
+    err = e;
+    return false;
+  }
+
+  bool flushPage() {
+    if (flushed % SECTOR == 0 && !flash.erase(flushed, SECTOR)) return fail(FLASH_ERR_ERASE);
+    if (!flash.write(flushed, page, PAGE)) return fail(FLASH_ERR_WRITE);
+    flushed += PAGE;
+    fill = 0;
+    return true;
+  }
+
+  Flash &flash;
+  uint32_t total;
+  uint32_t received;
+  uint32_t flushed;       // bytes programmed, whole pages
+  uint32_t verified;      // read back so far; total + 1 once checked
+  size_t fill;
+  FlashWriteError err;
+  uint8_t expected[Sha256::DIGEST_SIZE];
+  Sha256 sha;
+  uint8_t page[PAGE];
+};
+
+// Copies the sector of `src` at `from` over the one of `dst` at `to`
+template <uint32_t SECTOR, size_t PAGE, typename D, typename S>
+bool flashCopySector(D &dst, uint32_t to, S &src, uint32_t from) {
+  uint8_t page[PAGE];
+  if (!dst.erase(to, SECTOR)) return false;
+  for (uint32_t p = 0; p < SECTOR; p += PAGE) {
+    if (!src.read(from + p, page, PAGE) || !dst.write(to + p, page, PAGE)) return false;
+  }
+  return true;
+}
+
+static const uint8_t FLASH_SWAP_STEPS = 3;
+
+// Step `step` (0..FLASH_SWAP_STEPS-1) of exchanging one sector of two
+// partitions: afterwards `a` holds what `b` had and `b` what `a` had.
+// Swapping every sector of an image in place of the live one keeps the old
+// image in the other partition, so swapping again rolls back. `scratch` is
+// a spare sector of `b` outside the swapped range: step 0 parks the sector
+// of `a` there, 1 copies the one of `b` into `a`, 2 the parked one into `b`.
+// No step touches the copy the next one reads, so after a power cut the
+// step that was running can simply be run again.
+template <uint32_t SECTOR, size_t PAGE, typename A, typename B>
+bool flashSwapStep(A &a, B &b, uint32_t offset, uint32_t scratch, uint8_t step) {
+  switch (step) {
+    case 0: return flashCopySector<SECTOR, PAGE>(b, scratch, a, offset);
+    case 1: return flashCopySector<SECTOR, PAGE>(a, offset, b, offset);
+    default: return flashCopySector<SECTOR, PAGE>(b, offset, b, scratch);
+  }
+}
+
+#endif // FLASH_WRITER_H
@@ -0,0 +1,102 @@
+// Allocation accounting by module. The allocator hooks (src/heap_debug.cpp,
+// linked with -Wl,--wrap=malloc,...) call heapCountAlloc/heapCountFree for
+// every malloc/free; the count goes to the module currently running on the
+// loop task, set with a HeapScope around each subsystem's loop call:
+//
+//   { HeapScope s(LOGM_SENSOR); sensorTick(); }
+//
+// Allocations from other tasks (WiFi, lwIP, timers) land in the last slot.
+// Counters are updated with relaxed atomics since the hooks run on every
+// task. Hardware independent.
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "log_macros.h"
+
+// Slot for allocations outside any scope or from another task
+static const uint8_t HEAP_TAG_OTHER = LOGM_COUNT;
+static const uint8_t HEAP_TAG_COUNT = LOGM_COUNT + 1;
+
+inline const char *heapTagName(uint8_t tag) {
+  return tag < LOGM_COUNT ? logModuleName((LogModule)tag) : "other";
+}
+
+struct HeapCounters {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t bytes;     // requested by allocs (cumulative, wraps)
+  uint32_t failed;    // allocs that returned NULL
+};
+
+// Header-only storage, one copy per program
+template <int = 0>
+struct HeapTagState {
+  static HeapCounters tags[HEAP_TAG_COUNT];
+  static uint8_t current;
+};
+template <int N>
+HeapCounters HeapTagState<N>::tags[HEAP_TAG_COUNT];
+template <int N>
+uint8_t HeapTagState<N>::current = HEAP_TAG_OTHER;
+
+inline uint8_t heapCurrentTag() { return HeapTagState<>::current; }
+
+inline void heapCountAlloc(uint8_t tag, size_t n, bool ok) {
+  HeapCounters &c = HeapTagState<>::tags[tag < HEAP_TAG_COUNT ? tag : HEAP_TAG_OTHER];
+  __atomic_fetch_add(&c.allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&c.bytes, (uint32_t)n, __ATOMIC_RELAXED);
+  if (!ok) __atomic_fetch_add(&c.failed, 1, __ATOMIC_RELAXED);
+}
+
+inline void heapCountFree(uint8_t tag) {
+  HeapCounters &c = HeapTagState<>::tags[tag < HEAP_TAG_COUNT ? tag : HEAP_TAG_OTHER];
+  __atomic_fetch_add(&c.frees, 1, __ATOMIC_RELAXED);
+}
+
+inline const HeapCounters &heapCounters(uint8_t tag) { return HeapTagState<>::tags[tag]; }
+
+inline void heapCountersReset() {
+  for (uint8_t i = 0; i < HEAP_TAG_COUNT; ++i) HeapTagState<>::tags[i] = HeapCounters();
+}
+
+// Attributes the loop task's allocations to `module` until it goes out of
+// scope; scopes nest
+class HeapScope {
+public:
+  explicit HeapScope(LogModule module) : prev(HeapTagState<>::current) { HeapTagState<>::current = module; }
+  ~HeapScope() { HeapTagState<>::current = prev; }
+
+private:
+  HeapScope(const HeapScope &);
+  HeapScope &operator=(const HeapScope &);
+  uint8_t prev;
+};
+
+// Counters of one tag (or the sum of all with HEAP_TAG_COUNT), for
+// before/after deltas around a request
+struct HeapSnapshot {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t bytes;
+
+  static HeapSnapshot take(uint8_t tag = HEAP_TAG_COUNT) {
+    HeapSnapshot s = { 0, 0, 0 };
+    for (uint8_t i = 0; i < HEAP_TAG_COUNT; ++i) {
+      if (tag < HEAP_TAG_COUNT && i != tag) continue;
+      const HeapCounters &c = HeapTagState<>::tags[i];
+      s.allocs += c.allocs;
+      s.frees += c.frees;
+      s.bytes += c.bytes;
+    }
+    return s;
+  }
+
+  HeapSnapshot since(const HeapSnapshot &before) const {
+    HeapSnapshot d = { allocs - before.allocs, frees - before.frees, bytes - before.bytes };
+    return d;
+  }
+};
+
+#endif // HEAP_STATS_H
@@ -0,0 +1,154 @@
+// Irrigation job scheduler: multiple zones (valves), at most N running at once
+// (pump capacity), excess jobs wait in a bounded FIFO instead of overlapping.
+// Running jobs are kept in a min-heap by end time so the next stop event is
+// found in O(log n). Hardware independent: relays are driven via a callback.
+#ifndef IRRIGATION_ENGINE_H
+#define IRRIGATION_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bounded_heap.h"
+
+template <size_t MaxZones, size_t QueueCap>
+class IrrigationEngine {
+public:
+  struct Zone {
+    uint8_t channel;      // relay channel, 0 = zone unused
+    uint16_t durationSec; // default run time for jobs on this zone
+  };
+
+  IrrigationEngine() : zoneCount(0), maxConcurrent(1), qHead(0), qCount(0), dropped(0) {
+    for (size_t i = 0; i < MaxZones; ++i) { zones[i].channel = 0; zones[i].durationSec = 0; running[i] = false; }
+  }
+
+  // Replace the zone table. Only allowed while idle so no valve is orphaned.
+  bool setZones(const Zone *z, size_t n) {
+    if (n > MaxZones || !idle()) return false;
+    for (size_t i = 0; i < MaxZones; ++i) {
+      zones[i].channel = i < n ? z[i].channel : 0;
+      zones[i].durationSec = i < n ? z[i].durationSec : 0;
+    }
+    zoneCount = (uint8_t)n;
+    return true;
+  }
+  // Default run time of one zone, allowed while running: jobs already
+  // queued or running keep the duration they were given
+  bool setZoneDuration(size_t i, uint16_t durationSec) {
+    if (i >= zoneCount) return false;
+    zones[i].durationSec = durationSec;
+    return true;
+  }
+  void setMaxConcurrent(uint8_t n) { maxConcurrent = n == 0 ? 1 : n; }
+  uint8_t getMaxConcurrent() const { return maxConcurrent; }
+  size_t getZoneCount() const { return zoneCount; }
+  const Zone &zone(size_t i) const { return zones[i]; }
+  bool isRunning(size_t zoneIdx) const { return zoneIdx < MaxZones && running[zoneIdx]; }
+  size_t runningCount() const { return active.size(); }
+  size_t queuedCount() const { return qCount; }
+  uint32_t droppedCount() const { return dropped; }
+  bool idle() const { return active.empty() && qCount == 0; }
+
+  // Queue a run of `zoneIdx`; durationSec 0 uses the zone default.
+  // Returns false when the zone is invalid or the queue is full.
+  bool enqueue(uint8_t zoneIdx, uint16_t durationSec = 0) {
+    if (zoneIdx >= zoneCount || zones[zoneIdx].channel == 0) return false;
+    if (qCount == QueueCap) { dropped++; return false; }
+    Job &j = queue[(qHead + qCount) % QueueCap];
+    j.zone = zoneIdx;
+    j.durationSec = durationSec ? durationSec : zones[zoneIdx].durationSec;
+    qCount++;
+    return true;
+  }
+
+  // Queue every configured zone once, in table order
+  size_t enqueueAll() {
+    size_t n = 0;
+    for (uint8_t i = 0; i < zoneCount; ++i) if (enqueue(i)) n++;
+    return n;
+  }
+
+  // Stop finished runs and start queued ones. `actuate(channel, on)` is
+  // called for every valve change. nowMs is a wrapping millisecond clock.
+  template <typename F>
+  void tick(uint32_t nowMs, F actuate) {
+    Run r;
+    while (!active.empty() && (int32_t)(nowMs - active.top().endMs) >= 0) {
+      active.pop(r);
+      running[r.zone] = false;
+      actuate(zones[r.zone].channel, false);
+    }
+    while (active.size() < maxConcurrent && qCount > 0) {
+      // first queued job whose zone is free (a zone never runs twice at once)
+      size_t k = 0;
+      while (k < qCount && running[queue[(qHead + k) % QueueCap].zone]) ++k;
+      if (k == qCount) break;
+      Job j = removeQueued(k);
+      if (j.durationSec == 0) continue;
+      r.zone = j.zone;
+      r.endMs = nowMs + (uint32_t)j.durationSec * 1000UL;
+      active.push(r);
+      running[j.zone] = true;
+      actuate(zones[j.zone].channel, true);
+    }
+  }
+
+  // Milliseconds until the next scheduled stop, or -1 when nothing runs
+  int32_t msUntilNextStop(uint32_t nowMs) const {
+    if (active.empty()) return -1;
+    int32_t d = (int32_t)(active.top().endMs - nowMs);
+    return d < 0 ? 0 : d;
+  }
+
+  // Remaining seconds of a running zone (0 if not running)
+  uint32_t remainingSec(uint8_t zoneIdx, uint32_t nowMs) const {
+    for (size_t i = 0; i < active.size(); ++i) {
+      const Run &r = active.at(i);
+      if (r.zone != zoneIdx) continue;
+      int32_t d = (int32_t)(r.endMs - nowMs);
+      return d > 0 ? (uint32_t)(d + 999) / 1000 : 0;
+    }
+    return 0;
+  }
+
+  // Close every valve and drop all queued jobs
+  template <typename F>
+  void cancelAll(F actuate) {
+    Run r;
+    while (active.pop(r)) {
+      running[r.zone] = false;
+      actuate(zones[r.zone].channel, false);
+    }
+    qHead = 0;
+    qCount = 0;
+  }
+
+private:
+  struct Job { uint8_t zone; uint16_t durationSec; };
+  struct Run { uint32_t endMs; uint8_t zone; };
+  struct RunLess {
+    bool operator()(const Run &a, const Run &b) const { return (int32_t)(a.endMs - b.endMs) < 0; }
+  };
+
+  // Remove the k-th queued job keeping FIFO order (k is bounded by QueueCap)
+  Job removeQueued(size_t k) {
+    Job j = queue[(qHead + k) % QueueCap];
+    for (size_t i = k; i > 0; --i) {
+      queue[(qHead + i) % QueueCap] = queue[(qHead + i - 1) % QueueCap];
+    }
+    qHead = (qHead + 1) % QueueCap;
+    qCount--;
+    return j;
+  }
+
+  Zone zones[MaxZones];
+  bool running[MaxZones];
+  uint8_t zoneCount;
+  uint8_t maxConcurrent;
+  Job queue[QueueCap];
+  size_t qHead;
+  size_t qCount;
+  uint32_t dropped;
+  BoundedHeap<Run, MaxZones, RunLess> active;
+};
+
+#endif // IRRIGATION_ENGINE_H
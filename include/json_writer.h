@@ -0,0 +1,192 @@
+// JSON encoder behind the StructWriter interface. Output goes through a fixed
+// buffer into any byte sink (a ChunkedSink on a socket, a String for MQTT and
+// command replies), so writing a document never allocates: peak memory is
+// BufBytes plus one bit per nesting level (up to 32 levels). Floats are
+// printed with up to three decimals, NAN/INF become null. Hardware
+// independent.
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "struct_writer.h"
+
+// Out: size_t write(const uint8_t *p, size_t n)
+template <typename Out, size_t BufBytes = 256>
+class JsonWriter : public StructWriter {
+  static_assert(BufBytes >= 32, "room for the longest number");
+public:
+  explicit JsonWriter(Out &o) : out(o), len(0), total(0), failed(false), depth(0), fresh(0), afterKey(false) {}
+
+  void beginMap() { open('{'); }
+  void endMap() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+
+  void key(const char *k) {
+    separate();
+    quoted(k, strlen(k));
+    put(':');
+    afterKey = true;
+  }
+
+  void intValue(int64_t v) {
+    separate();
+    char tmp[21];
+    size_t n = 0;
+    // magnitude as unsigned so INT64_MIN works
+    uint64_t u = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+    do {
+      tmp[n++] = (char)('0' + u % 10);
+      u /= 10;
+    } while (u);
+    room(n + 1);
+    if (v < 0) buf[len++] = '-';
+    while (n) buf[len++] = (uint8_t)tmp[--n];
+  }
+
+  void floatValue(float v) {
+    if (isnan(v) || isinf(v)) {
+      nullValue();
+      return;
+    }
+    separate();
+    char tmp[32];
+    int n = snprintf(tmp, sizeof(tmp), "%.3f", (double)v);
+    if (n <= 0 || n >= (int)sizeof(tmp)) n = snprintf(tmp, sizeof(tmp), "%g", (double)v);
+    // 21.500 -> 21.5, 200.000 -> 200; %g exponents (1e+30) are left alone
+    if (memchr(tmp, '.', n) && !memchr(tmp, 'e', n)) {
+      while (tmp[n - 1] == '0') n--;
+      if (tmp[n - 1] == '.') n--;
+    }
+    raw(tmp, n);
+  }
+
+  void boolValue(bool v) {
+    separate();
+    if (v) raw("true", 4);
+    else raw("false", 5);
+  }
+
+  void nullValue() {
+    separate();
+    raw("null", 4);
+  }
+
+  void strValue(const char *s, size_t n) {
+    separate();
+    quoted(s, n);
+  }
+
+  using StructWriter::strValue;
+
+  // Hand the buffered tail to the output; call once the document is done
+  bool flush() {
+    if (len && !failed) failed = out.write(buf, len) != len;
+    total += len;
+    len = 0;
+    return !failed;
+  }
+
+  size_t size() const { return total + len; }
+  bool ok() const { return !failed; }
+
+private:
+  // Comma before every element but the first of its container
+  void separate() {
+    if (afterKey) {
+      afterKey = false;
+      return;
+    }
+    if (!depth) return;
+    uint32_t bit = 1u << ((depth - 1) & 31);
+    if (fresh & bit) fresh &= ~bit;
+    else put(',');
+  }
+
+  void open(char c) {
+    separate();
+    put((uint8_t)c);
+    depth++;
+    fresh |= 1u << ((depth - 1) & 31);
+  }
+
+  void close(char c) {
+    put((uint8_t)c);
+    if (depth) depth--;
+  }
+
+  void quoted(const char *s, size_t n) {
+    put('"');
+    for (size_t i = 0; i < n; ++i) {
+      uint8_t c = (uint8_t)s[i];
+      if (c == '"' || c == '\\') {
+        room(2);
+        buf[len++] = '\\';
+        buf[len++] = c;
+      } else if (c < 0x20) {
+        char esc[7];
+        int e;
+        if (c == '\n') e = snprintf(esc, sizeof(esc), "\\n");
+        else if (c == '\r') e = snprintf(esc, sizeof(esc), "\\r");
+        else if (c == '\t') e = snprintf(esc, sizeof(esc), "\\t");
+        else e = snprintf(esc, sizeof(esc), "\\u%04x", c);
+        raw(esc, e);
+      } else {
+        put(c);
+      }
+    }
+    put('"');
+  }
+
+  void raw(const char *s, size_t n) {
+    room(n);
+    memcpy(buf + len, s, n);
+    len += n;
+  }
+
+  void put(uint8_t c) {
+    room(1);
+    buf[len++] = c;
+  }
+
+  void room(size_t n) {
+    if (len + n > BufBytes) flush();
+  }
+
+  Out &out;
+  uint8_t buf[BufBytes];
+  size_t len;
+  size_t total;
+  bool failed;
+  uint8_t depth;
+  uint32_t fresh;     // bit per level: container has no element yet
+  bool afterKey;
+};
+
+// Byte sink appending to a string. Str: Arduino String (concat(p, n))
+template <typename Str>
+struct StringOut {
+  Str &s;
+  size_t write(const uint8_t *p, size_t n) {
+    s.concat((const char *)p, n);
+    return n;
+  }
+};
+
+// For callers that need the document as one string (MQTT payloads, command
+// replies); HTTP responses should stream instead
+template <typename Str>
+Str structToJson(StructProducer produce) {
+  Str s;
+  StringOut<Str> o = { s };
+  JsonWriter<StringOut<Str> > w(o);
+  produce(w);
+  w.flush();
+  return s;
+}
+
+#endif // JSON_WRITER_H
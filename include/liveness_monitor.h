@@ -0,0 +1,95 @@
+// Loop liveness supervision. The loop task checks in when each subsystem
+// starts and returns (two relaxed stores, no clock read); a supervisor on
+// another task polls check() and, when no check-in happened for longer than
+// the running subsystem's deadline, reports it as stalled:
+//
+//   loop task:        mon.enter(LOGM_WEB); webHandle(); mon.leave();
+//   supervisor task:  if (mon.check(millis(), stall)) { ...safe state... }
+//
+// Between subsystems the idle deadline applies (a hang outside any of them).
+// Stall time is measured by the supervisor from the last change it saw, so
+// it is accurate to one poll period. Hardware independent.
+#ifndef LIVENESS_MONITOR_H
+#define LIVENESS_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct LivenessStall {
+  uint8_t slot;        // subsystem in progress, or IDLE
+  uint32_t stalledMs;  // since its last check-in
+};
+
+template <uint8_t Slots>
+class LivenessMonitor {
+public:
+  static const uint8_t IDLE = 0xFF;
+
+  LivenessMonitor() : seq(0), current(IDLE), idleDeadline(0), seenSeq(0), seenAt(0), polled(false) {
+    for (uint8_t i = 0; i < Slots; ++i) deadline[i] = 0;
+  }
+
+  // 0 = not supervised
+  void setDeadline(uint8_t slot, uint32_t ms) {
+    if (slot < Slots) deadline[slot] = ms;
+  }
+  void setIdleDeadline(uint32_t ms) { idleDeadline = ms; }
+  uint32_t deadlineOf(uint8_t slot) const { return slot < Slots ? deadline[slot] : idleDeadline; }
+
+  // ---- loop task ----
+  void enter(uint8_t slot) {
+    __atomic_store_n(&current, slot, __ATOMIC_RELAXED);
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+  }
+  void leave() {
+    __atomic_store_n(&current, IDLE, __ATOMIC_RELAXED);
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+  }
+
+  // ---- supervisor task ----
+  // True while the loop has made no progress for longer than the deadline
+  // of what it is running; `out` names it
+  bool check(uint32_t now, LivenessStall &out) {
+    uint32_t s = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+    uint8_t slot = __atomic_load_n(&current, __ATOMIC_RELAXED);
+    if (!polled || s != seenSeq) {
+      seenSeq = s;
+      seenAt = now;
+      polled = true;
+    }
+    out.slot = slot;
+    out.stalledMs = now - seenAt;
+    uint32_t limit = deadlineOf(slot);
+    return limit && out.stalledMs > limit;
+  }
+
+  // Subsystem in progress right now (IDLE between them)
+  uint8_t running() const { return __atomic_load_n(&current, __ATOMIC_RELAXED); }
+  // Check-ins so far (two per supervised call)
+  uint32_t checkIns() const { return __atomic_load_n(&seq, __ATOMIC_RELAXED); }
+
+private:
+  uint32_t seq;
+  uint8_t current;
+  uint32_t deadline[Slots];
+  uint32_t idleDeadline;
+  // supervisor's view
+  uint32_t seenSeq;
+  uint32_t seenAt;
+  bool polled;
+};
+
+// Scoped check-in around one subsystem call
+template <typename Monitor>
+class LivenessScope {
+public:
+  LivenessScope(Monitor &m, uint8_t slot) : mon(m) { mon.enter(slot); }
+  ~LivenessScope() { mon.leave(); }
+
+private:
+  LivenessScope(const LivenessScope &);
+  LivenessScope &operator=(const LivenessScope &);
+  Monitor &mon;
+};
+
+#endif // LIVENESS_MONITOR_H
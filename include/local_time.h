@@ -0,0 +1,240 @@
+// POSIX TZ rules ("CET-1CEST,M3.5.0,M10.5.0/3", "<-03>3", "UTC0") and the
+// map from a local day's wall-clock minutes to UTC, which the scheduler and
+// automation build once per day so the per-minute check only compares UTC
+// minutes. On the day the clocks change:
+//   - a skipped local minute (spring forward) maps to the change itself, so
+//     an event set in the missing hour fires once, when the hour is skipped
+//   - a repeated local minute (fall back) maps to its first occurrence only,
+//     so an event in the repeated hour fires once
+// Offsets are seconds east of UTC (the opposite sign of the TZ string).
+// Hardware independent.
+#ifndef LOCAL_TIME_H
+#define LOCAL_TIME_H
+
+#include <stdint.h>
+
+// A change date of the rule: Mm.w.d (day d of week w of month m, w=5 the
+// last), Jn (1..365, Feb 29 never counted) or n (0..365); at `timeSec` of
+// local time before the change (may be negative or past 24 h)
+struct TzDate {
+  char kind;        // 'M', 'J' or 'N'
+  uint8_t month;    // 1..12
+  uint8_t week;     // 1..5
+  uint8_t wday;     // 0 = Sunday
+  uint16_t day;     // J/N
+  int32_t timeSec;
+};
+
+struct TzRule {
+  int32_t stdOffset;
+  int32_t dstOffset;
+  bool hasDst;
+  TzDate start;     // DST begins (local standard time)
+  TzDate end;       // DST ends (local daylight time)
+};
+
+// ---- civil calendar (proleptic Gregorian, days since 1970-01-01) ----
+inline int64_t tzFloorDiv(int64_t a, int64_t b) { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+
+inline bool tzLeap(int32_t y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+inline int32_t tzDaysFromCivil(int32_t y, uint8_t m, uint8_t d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+inline int32_t tzYearOfDay(int32_t day) {
+  int32_t z = day + 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  return (int32_t)yoe + era * 400 + (mp >= 10);
+}
+
+// 0 = Sunday
+inline uint8_t tzWeekday(int32_t day) { return (uint8_t)((day % 7 + 11) % 7); }
+
+// ---- parsing ----
+inline bool tzParseNum(const char *&s, int32_t &v, int32_t max) {
+  if (*s < '0' || *s > '9') return false;
+  v = 0;
+  while (*s >= '0' && *s <= '9') {
+    v = v * 10 + (*s++ - '0');
+    if (v > max) return false;
+  }
+  return true;
+}
+
+// [+-]hh[:mm[:ss]] in seconds
+inline bool tzParseTime(const char *&s, int32_t &sec, int32_t maxHours) {
+  int32_t sign = 1;
+  if (*s == '+' || *s == '-') sign = *s++ == '-' ? -1 : 1;
+  int32_t h, m = 0, x = 0;
+  if (!tzParseNum(s, h, maxHours)) return false;
+  if (*s == ':') {
+    ++s;
+    if (!tzParseNum(s, m, 59)) return false;
+    if (*s == ':') {
+      ++s;
+      if (!tzParseNum(s, x, 59)) return false;
+    }
+  }
+  sec = sign * (h * 3600 + m * 60 + x);
+  return true;
+}
+
+// alphabetic (3+) or <quoted> (3+ of alnum, + and -)
+inline bool tzParseName(const char *&s) {
+  int n = 0;
+  if (*s == '<') {
+    ++s;
+    while (*s && *s != '>') ++s, ++n;
+    if (*s++ != '>') return false;
+  } else {
+    while ((*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')) ++s, ++n;
+  }
+  return n >= 3;
+}
+
+inline bool tzParseDate(const char *&s, TzDate &d) {
+  int32_t v;
+  d.timeSec = 2 * 3600;
+  if (*s == 'M') {
+    ++s;
+    int32_t w, wd;
+    if (!tzParseNum(s, v, 12) || v < 1 || *s++ != '.') return false;
+    if (!tzParseNum(s, w, 5) || w < 1 || *s++ != '.') return false;
+    if (!tzParseNum(s, wd, 6)) return false;
+    d.kind = 'M';
+    d.month = (uint8_t)v;
+    d.week = (uint8_t)w;
+    d.wday = (uint8_t)wd;
+  } else if (*s == 'J') {
+    ++s;
+    if (!tzParseNum(s, v, 365) || v < 1) return false;
+    d.kind = 'J';
+    d.day = (uint16_t)v;
+  } else {
+    if (!tzParseNum(s, v, 365)) return false;
+    d.kind = 'N';
+    d.day = (uint16_t)v;
+  }
+  if (*s == '/') {
+    ++s;
+    if (!tzParseTime(s, d.timeSec, 167)) return false;
+  }
+  return true;
+}
+
+// False on anything it does not understand; `r` is only set on success
+inline bool tzParse(const char *s, TzRule &r) {
+  TzRule t;
+  int32_t off;
+  if (!s || !tzParseName(s) || !tzParseTime(s, off, 24)) return false;
+  t.stdOffset = -off;
+  t.dstOffset = t.stdOffset + 3600;
+  t.hasDst = false;
+  if (*s) {
+    if (!tzParseName(s)) return false;
+    t.hasDst = true;
+    if (*s && *s != ',') {
+      if (!tzParseTime(s, off, 24)) return false;
+      t.dstOffset = -off;
+    }
+    // no rule given: the US rule, as glibc and newlib assume
+    const char *us = ",M3.2.0,M11.1.0";
+    const char *p = *s ? s : us;
+    if (*p++ != ',' || !tzParseDate(p, t.start) || *p++ != ',' || !tzParseDate(p, t.end) || *p) return false;
+    s = p;
+  }
+  if (*s) return false;
+  r = t;
+  return true;
+}
+
+// ---- offsets ----
+// Day (since 1970-01-01) the rule's date falls on in year y
+inline int32_t tzDateDay(const TzDate &d, int32_t y) {
+  int32_t jan1 = tzDaysFromCivil(y, 1, 1);
+  if (d.kind == 'J') return jan1 + d.day - 1 + (tzLeap(y) && d.day >= 60 ? 1 : 0);
+  if (d.kind == 'N') return jan1 + d.day;
+  static const uint8_t mdays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  int32_t first = tzDaysFromCivil(y, d.month, 1);
+  int32_t day = first + (d.wday - tzWeekday(first) + 7) % 7 + (d.week - 1) * 7;
+  int32_t len = mdays[d.month - 1] + (d.month == 2 && tzLeap(y) ? 1 : 0);
+  while (day >= first + len) day -= 7;
+  return day;
+}
+
+// UTC of a change in year y, from the local offset in force before it
+inline int64_t tzChangeUtc(const TzDate &d, int32_t y, int32_t offsetBefore) {
+  return (int64_t)tzDateDay(d, y) * 86400 + d.timeSec - offsetBefore;
+}
+
+inline int32_t tzOffsetAt(const TzRule &r, int64_t utc) {
+  if (!r.hasDst) return r.stdOffset;
+  int32_t y = tzYearOfDay((int32_t)tzFloorDiv(utc + r.stdOffset, 86400));
+  int64_t s = tzChangeUtc(r.start, y, r.stdOffset);
+  int64_t e = tzChangeUtc(r.end, y, r.dstOffset);
+  // southern hemisphere: DST spans the new year
+  bool dst = s < e ? utc >= s && utc < e : utc < e || utc >= s;
+  return dst ? r.dstOffset : r.stdOffset;
+}
+
+// Local date of a UTC instant, as days since 1970-01-01
+inline int32_t tzLocalDayOf(const TzRule &r, int64_t utc) {
+  return (int32_t)tzFloorDiv(utc + tzOffsetAt(r, utc), 86400);
+}
+
+// ---- one local day ----
+struct LocalDay {
+  static const int64_t NO_CHANGE = INT64_MAX;
+
+  int32_t day;           // days since 1970-01-01
+  uint8_t wday;          // 0 = Sunday
+  int32_t offsetBefore;  // from 00:00
+  int32_t offsetAfter;   // after changeUtc
+  int64_t changeUtc;     // clocks change this day, or NO_CHANGE
+
+  // UTC second of local minute m (0..1439) of the day
+  int64_t toUtc(uint16_t m) const {
+    int64_t local = (int64_t)day * 86400 + (int64_t)m * 60;
+    int64_t a = local - offsetBefore;
+    if (changeUtc == NO_CHANGE || a < changeUtc) return a;   // first occurrence
+    int64_t b = local - offsetAfter;
+    return b >= changeUtc ? b : changeUtc;                   // skipped: at the change
+  }
+};
+
+inline LocalDay tzLocalDay(const TzRule &r, int32_t day) {
+  LocalDay d;
+  d.day = day;
+  d.wday = tzWeekday(day);
+  d.offsetBefore = d.offsetAfter = tzOffsetAt(r, (int64_t)day * 86400 + 43200 - r.stdOffset);
+  d.changeUtc = LocalDay::NO_CHANGE;
+  if (!r.hasDst) return d;
+  int32_t y = tzYearOfDay(day);
+  for (int32_t yy = y - 1; yy <= y + 1; ++yy) {
+    int64_t s = tzChangeUtc(r.start, yy, r.stdOffset);
+    int64_t e = tzChangeUtc(r.end, yy, r.dstOffset);
+    // a change belongs to the day its local time before the change falls in
+    if (tzFloorDiv(s + r.stdOffset, 86400) == day) {
+      d.changeUtc = s;
+      d.offsetBefore = r.stdOffset;
+      d.offsetAfter = r.dstOffset;
+    } else if (tzFloorDiv(e + r.dstOffset, 86400) == day) {
+      d.changeUtc = e;
+      d.offsetBefore = r.dstOffset;
+      d.offsetAfter = r.stdOffset;
+    }
+  }
+  return d;
+}
+
+#endif // LOCAL_TIME_H
@@ -0,0 +1,79 @@
+// Leveled printf-style logging:
+//
+//   LOG_I(LOGM_MQTT, "connected to %s:%d", host, port);
+//
+// A call above LOG_COMPILE_LEVEL is removed by the compiler; a call above its
+// module's runtime level costs one load and compare. In both cases the
+// arguments are not evaluated. The text is only formatted (into a stack
+// buffer, no String) when some sink wants the level. Hardware independent:
+// logEmit() is provided by src/logging.cpp (or by a test).
+#ifndef LOG_MACROS_H
+#define LOG_MACROS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "log_sink.h"
+
+// Strip everything above this level at compile time, e.g.
+// build_flags = -DLOG_COMPILE_LEVEL=LOG_INFO
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+
+enum LogModule : uint8_t {
+  LOGM_MAIN = 0,
+  LOGM_WIFI,
+  LOGM_WEB,
+  LOGM_MQTT,
+  LOGM_SENSOR,
+  LOGM_THERMOSTAT,
+  LOGM_AUTOMATION,
+  LOGM_SCHEDULER,
+  LOGM_RELAYS,
+  LOGM_COUNT
+};
+
+inline const char *logModuleName(LogModule m) {
+  static const char *names[LOGM_COUNT] = {
+    "main", "wifi", "web", "mqtt", "sensor", "thermostat", "automation", "scheduler", "relays"
+  };
+  return m < LOGM_COUNT ? names[m] : "?";
+}
+
+inline bool logModuleParse(const char *s, LogModule &out) {
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) {
+    if (strcmp(s, logModuleName((LogModule)i)) == 0) {
+      out = (LogModule)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runtime level per module (header-only storage, one copy per program)
+template <int = 0>
+struct LogModuleLevels {
+  static uint8_t level[LOGM_COUNT];
+};
+template <int N>
+uint8_t LogModuleLevels<N>::level[LOGM_COUNT] = {
+  LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO
+};
+
+inline void logSetModuleLevel(LogModule m, LogLevel l) { LogModuleLevels<>::level[m] = l; }
+inline LogLevel logModuleLevel(LogModule m) { return (LogLevel)LogModuleLevels<>::level[m]; }
+
+void logEmit(LogLevel level, LogModule module, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define LOG_AT(lvl, module, fmt, ...)                                      \
+  do {                                                                     \
+    if ((lvl) <= LOG_COMPILE_LEVEL && (lvl) <= LogModuleLevels<>::level[module]) \
+      logEmit((lvl), (module), fmt, ##__VA_ARGS__);                        \
+  } while (0)
+
+#define LOG_E(module, fmt, ...) LOG_AT(LOG_ERROR, module, fmt, ##__VA_ARGS__)
+#define LOG_W(module, fmt, ...) LOG_AT(LOG_WARN, module, fmt, ##__VA_ARGS__)
+#define LOG_I(module, fmt, ...) LOG_AT(LOG_INFO, module, fmt, ##__VA_ARGS__)
+#define LOG_D(module, fmt, ...) LOG_AT(LOG_DEBUG, module, fmt, ##__VA_ARGS__)
+
+#endif // LOG_MACROS_H
@@ -0,0 +1,181 @@
+// Log routing: every message goes to a fixed set of sinks (serial ports,
+// flash, telnet, SSE), each with its own level filter. Line-oriented sinks
+// only ever see complete lines; partial logPrint() fragments are joined in
+// a bounded buffer. Hardware independent.
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum LogLevel : uint8_t {
+  LOG_NONE = 0,   // as a sink level: sink disabled
+  LOG_ERROR,
+  LOG_WARN,
+  LOG_INFO,
+  LOG_DEBUG,
+};
+
+inline const char *logLevelName(LogLevel l) {
+  static const char *names[] = { "none", "error", "warn", "info", "debug" };
+  return l <= LOG_DEBUG ? names[l] : "?";
+}
+
+inline bool logLevelParse(const char *s, LogLevel &out) {
+  for (uint8_t i = LOG_NONE; i <= LOG_DEBUG; ++i) {
+    if (strcmp(s, logLevelName((LogLevel)i)) == 0) {
+      out = (LogLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// text is not NUL terminated; `eol` ends the line
+typedef void (*LogSinkFn)(LogLevel level, const char *text, size_t len, bool eol);
+
+template <size_t MaxSinks, size_t LineLen>
+class LogRouter {
+public:
+  struct Sink {
+    const char *name;
+    LogSinkFn fn;
+    LogLevel level;
+    bool lines;          // only complete lines (flash, telnet, SSE)
+    uint32_t written;    // messages passed to the sink
+    uint32_t filtered;   // messages below the sink's level
+  };
+
+  LogRouter() : count(0), partialLen(0), truncated(0) {}
+
+  bool add(const char *name, LogSinkFn fn, LogLevel level, bool lines) {
+    if (count == MaxSinks) return false;
+    Sink &s = sinks[count++];
+    s.name = name;
+    s.fn = fn;
+    s.level = level;
+    s.lines = lines;
+    s.written = s.filtered = 0;
+    return true;
+  }
+
+  bool setLevel(const char *name, LogLevel level) {
+    for (size_t i = 0; i < count; ++i) {
+      if (strcmp(sinks[i].name, name) == 0) {
+        sinks[i].level = level;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Cheap check before formatting a message nobody would receive
+  bool enabled(LogLevel level) const {
+    for (size_t i = 0; i < count; ++i) {
+      if (level <= sinks[i].level) return true;
+    }
+    return false;
+  }
+
+  // `eol` false: a fragment of a line still being built (progress dots)
+  void write(LogLevel level, const char *text, size_t len, bool eol) {
+    if (!eol) {
+      for (size_t i = 0; i < count; ++i) {
+        Sink &s = sinks[i];
+        if (!s.lines && level <= s.level) s.fn(level, text, len, false);
+      }
+      append(text, len);
+      return;
+    }
+    const char *line = text;
+    size_t lineLen = len;
+    if (partialLen) {
+      append(text, len);
+      line = partial;
+      lineLen = partialLen;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      Sink &s = sinks[i];
+      if (level > s.level) {
+        s.filtered++;
+        continue;
+      }
+      if (s.lines) s.fn(level, line, lineLen, true);
+      else s.fn(level, text, len, true);
+      s.written++;
+    }
+    partialLen = 0;
+  }
+
+  size_t size() const { return count; }
+  const Sink &sink(size_t i) const { return sinks[i]; }
+  uint32_t truncatedFragments() const { return truncated; }
+
+private:
+  void append(const char *text, size_t len) {
+    size_t room = LineLen - partialLen;
+    if (len > room) {
+      len = room;
+      truncated++;
+    }
+    memcpy(partial + partialLen, text, len);
+    partialLen += len;
+  }
+
+  Sink sinks[MaxSinks];
+  size_t count;
+  char partial[LineLen];
+  size_t partialLen;
+  uint32_t truncated;
+};
+
+// RAM staging for a slow sink (flash): lines are appended until the buffer
+// is nearly full, the oldest pending line is `maxAgeMs` old, or an error is
+// logged, then written out in one call. Lines that don't fit while a flush is
+// pending are counted and dropped, so memory stays bounded.
+template <size_t Bytes>
+class LogFlushBuffer {
+public:
+  explicit LogFlushBuffer(uint32_t maxAgeMs) : maxAge(maxAgeMs), len(0), firstMs(0), urgent(false), dropped(0) {}
+
+  bool append(const char *text, size_t n, uint32_t nowMs, bool flushSoon) {
+    if (len + n > Bytes) {
+      dropped++;
+      return false;
+    }
+    if (!len) firstMs = nowMs;
+    memcpy(buf + len, text, n);
+    len += n;
+    if (flushSoon) urgent = true;
+    return true;
+  }
+
+  bool due(uint32_t nowMs) const {
+    if (!len) return false;
+    return urgent || len >= Bytes * 3 / 4 || nowMs - firstMs >= maxAge;
+  }
+
+  // Writer: size_t write(const uint8_t *p, size_t n)
+  template <typename Writer>
+  bool flush(Writer &w) {
+    if (!len) return true;
+    bool ok = w.write((const uint8_t *)buf, len) == len;
+    len = 0;
+    urgent = false;
+    return ok;
+  }
+
+  size_t pending() const { return len; }
+  uint32_t droppedLines() const { return dropped; }
+
+private:
+  uint32_t maxAge;
+  char buf[Bytes];
+  size_t len;
+  uint32_t firstMs;
+  bool urgent;
+  uint32_t dropped;
+};
+
+#endif // LOG_SINK_H
@@ -1,11 +1,29 @@
-// Logging to SPIFFS
+// Logging: every message is routed to a set of sinks (USB serial, Serial1,
+// flash, and telnet/SSE once the web server registers them), each with its
+// own level (include/log_sink.h). Flash writes are batched in RAM.
 #ifndef LOGGING_H
 #define LOGGING_H
 
 #include <Arduino.h>
+#include "log_sink.h"
+#include "log_macros.h"
 
 bool initLogging();
+// Flash only (no serial echo), at info level
 void appendLog(const String &s);
 String readLogs();
 
+void logWrite(LogLevel level, const char* text, size_t len, bool eol);
+// Line sinks get complete lines only; at most LOG_MAX_SINKS sinks
+bool logAddSink(const char* name, LogSinkFn fn, LogLevel level, bool lines);
+bool logSetLevel(const char* sink, LogLevel level);
+// False when no sink would take a message at `level`
+bool logEnabled(LogLevel level);
+// Set a module's runtime level by name ("mqtt", "debug"); see log_macros.h
+bool logSetModuleLevelByName(const char* module, LogLevel level);
+// Write the flash buffer when due (full, 30 s old, or after an error)
+void logTick();
+void logFlush();
+String logSinksJson();
+
 #endif // LOGGING_H
@@ -0,0 +1,160 @@
+// Main-loop profiler: per-section execution time and loop period kept in
+// fixed log-linear histograms (4 buckets per power of two, so a percentile
+// is within 25% of the true value; 124 x uint32 per histogram, no heap).
+// Recording a sample is a count-leading-zeros and a few adds, cheap enough
+// to stay on in production.
+//
+// Ticks come from profTicks(): the CPU cycle counter on the ESP32, steady
+// clock nanoseconds on the host. Hardware independent otherwise.
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(ARDUINO) && defined(ESP32)
+#include <Arduino.h>
+inline uint32_t profTicks() { return ESP.getCycleCount(); }
+inline uint32_t profTicksPerUs() { return getCpuFrequencyMhz(); }
+#else
+#include <chrono>
+inline uint32_t profTicks() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t profTicksPerUs() { return 1000; }
+#endif
+
+class LatencyHistogram {
+public:
+  // 0..7 exact, then 4 per octave up to 2^32
+  static const uint8_t BUCKETS = 8 + 29 * 4;
+
+  LatencyHistogram() { reset(); }
+
+  void reset() {
+    memset(counts, 0, sizeof(counts));
+    n = 0;
+    lo = UINT32_MAX;
+    hi = 0;
+    total = 0;
+  }
+
+  void record(uint32_t v) {
+    counts[bucketOf(v)]++;
+    n++;
+    total += v;
+    if (v < lo) lo = v;
+    if (v > hi) hi = v;
+  }
+
+  uint32_t count() const { return n; }
+  uint32_t min() const { return n ? lo : 0; }
+  uint32_t max() const { return hi; }
+  uint64_t sum() const { return total; }
+  uint32_t mean() const { return n ? (uint32_t)(total / n) : 0; }
+
+  // Upper bound of the bucket holding the pct-th percentile, within [min, max]
+  uint32_t percentile(uint8_t pct) const {
+    if (!n) return 0;
+    uint64_t rank = ((uint64_t)n * pct + 99) / 100;
+    if (!rank) rank = 1;
+    uint64_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        uint32_t v = bucketUpper(i);
+        if (v > hi) v = hi;
+        if (v < lo) v = lo;
+        return v;
+      }
+    }
+    return hi;
+  }
+
+  static uint8_t bucketOf(uint32_t v) {
+    if (v < 8) return (uint8_t)v;
+    uint8_t msb = (uint8_t)(31 - __builtin_clz(v));
+    return (uint8_t)(8 + (msb - 3) * 4 + ((v >> (msb - 2)) & 3));
+  }
+
+  static uint32_t bucketUpper(uint8_t i) {
+    if (i < 8) return i;
+    uint8_t msb = (uint8_t)((i - 8) / 4 + 3);
+    uint8_t sub = (uint8_t)((i - 8) % 4);
+    uint64_t lower = (uint64_t)(4 + sub) << (msb - 2);
+    uint64_t upper = lower + ((uint64_t)1 << (msb - 2)) - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+  }
+
+private:
+  uint32_t counts[BUCKETS];
+  uint32_t n;
+  uint32_t lo;
+  uint32_t hi;
+  uint64_t total;
+};
+
+// One histogram per section (a loop() subsystem), plus the loop period
+// (start to start: jitter) and busy time (start to end)
+template <uint8_t Sections>
+class LoopProfiler {
+public:
+  LoopProfiler() : lastStart(0), started(false), loopOpen(false) {}
+
+  void loopStart(uint32_t now) {
+    if (started) periodHist.record(now - lastStart);
+    lastStart = now;
+    started = true;
+    loopOpen = true;
+  }
+
+  void loopEnd(uint32_t now) {
+    if (!loopOpen) return;
+    busyHist.record(now - lastStart);
+    loopOpen = false;
+  }
+
+  void record(uint8_t section, uint32_t ticks) {
+    if (section < Sections) hist[section].record(ticks);
+  }
+
+  // The next period is measured from the next loopStart()
+  void reset() {
+    for (uint8_t i = 0; i < Sections; ++i) hist[i].reset();
+    periodHist.reset();
+    busyHist.reset();
+    started = false;
+    loopOpen = false;
+  }
+
+  const LatencyHistogram &section(uint8_t i) const { return hist[i]; }
+  const LatencyHistogram &period() const { return periodHist; }
+  const LatencyHistogram &busy() const { return busyHist; }
+
+private:
+  LatencyHistogram hist[Sections];
+  LatencyHistogram periodHist;
+  LatencyHistogram busyHist;
+  uint32_t lastStart;
+  bool started;
+  bool loopOpen;
+};
+
+// Times one section until it goes out of scope
+template <typename Profiler>
+class ProfScope {
+public:
+  ProfScope(Profiler &p, uint8_t section) : prof(p), id(section), start(profTicks()) {}
+  ~ProfScope() { prof.record(id, profTicks() - start); }
+
+private:
+  ProfScope(const ProfScope &);
+  ProfScope &operator=(const ProfScope &);
+  Profiler &prof;
+  uint8_t id;
+  uint32_t start;
+};
+
+#endif // LOOP_PROFILER_H
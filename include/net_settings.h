@@ -0,0 +1,158 @@
+// Site network settings (Wi-Fi networks, static IP, MQTT broker, fallback
+// AP password) as plain fixed-size fields, with the validation used by the
+// `net_set` command and a diff that tells which parts need re-applying.
+// Fields are addressed by NetField, in the order of NET_FIELD_NAMES (the
+// command's enum choices). Hardware independent.
+#ifndef NET_SETTINGS_H
+#define NET_SETTINGS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const uint8_t NET_MAX_APS = 3;
+
+struct NetSettings {
+  char ssid[NET_MAX_APS][33];
+  char pass[NET_MAX_APS][65];
+  bool staticIp;          // applies to ssid[0] only
+  uint8_t ip[4];
+  uint8_t gateway[4];
+  uint8_t subnet[4];
+  uint8_t dns[4];
+  char mqttServer[65];
+  uint16_t mqttPort;
+  char mqttUser[33];
+  char mqttPass[65];
+  char apPass[65];        // fallback access point (WPA2: 8..63)
+};
+
+enum NetField : uint8_t {
+  NET_SSID = 0, NET_PASS, NET_SSID2, NET_PASS2, NET_SSID3, NET_PASS3,
+  NET_IP, NET_GATEWAY, NET_SUBNET, NET_DNS,
+  NET_MQTT_SERVER, NET_MQTT_PORT, NET_MQTT_USER, NET_MQTT_PASS,
+  NET_AP_PASS,
+  NET_FIELD_COUNT
+};
+
+static const char *const NET_FIELD_NAMES =
+  "ssid|pass|ssid2|pass2|ssid3|pass3|ip|gateway|subnet|dns|mqtt_server|mqtt_port|mqtt_user|mqtt_pass|ap_pass";
+
+// What a change needs re-applied
+enum NetApply : uint8_t {
+  NET_APPLY_WIFI = 1,   // networks or addressing: reconnect
+  NET_APPLY_AP = 2,     // fallback AP password: restart the AP if open
+  NET_APPLY_MQTT = 4,   // broker or credentials: reconnect MQTT
+};
+
+// Copies at most n-1 characters and always terminates
+inline void netCopy(char *dst, size_t n, const char *src) {
+  size_t len = strlen(src);
+  if (len >= n) len = n - 1;
+  memcpy(dst, src, len);
+  dst[len] = 0;
+}
+
+// Dotted quad, each part 0..255, nothing else; `out` is left alone on error
+inline bool netParseIPv4(const char *s, uint8_t out[4]) {
+  uint8_t q[4];
+  for (int i = 0; i < 4; ++i) {
+    if (*s < '0' || *s > '9') return false;
+    unsigned v = 0;
+    int digits = 0;
+    while (*s >= '0' && *s <= '9') {
+      v = v * 10 + (unsigned)(*s++ - '0');
+      if (++digits > 3 || v > 255) return false;
+    }
+    q[i] = (uint8_t)v;
+    if (i < 3 && *s++ != '.') return false;
+  }
+  if (*s) return false;
+  memcpy(out, q, 4);
+  return true;
+}
+
+// Ones then zeros, e.g. 255.255.255.0
+inline bool netValidMask(const uint8_t m[4]) {
+  uint32_t v = ((uint32_t)m[0] << 24) | ((uint32_t)m[1] << 16) | ((uint32_t)m[2] << 8) | m[3];
+  uint32_t inv = ~v;
+  return v != 0 && (inv & (inv + 1)) == 0;
+}
+
+// Sets one field from text; returns 0 on success, else why not
+inline const char *netSettingsSet(NetSettings &s, uint8_t field, const char *value) {
+  size_t len = strlen(value);
+  switch (field) {
+    case NET_SSID: case NET_SSID2: case NET_SSID3: {
+      if (len > 32) return "ssid: 32 characters at most";
+      netCopy(s.ssid[(field - NET_SSID) / 2], sizeof(s.ssid[0]), value);
+      return 0;
+    }
+    case NET_PASS: case NET_PASS2: case NET_PASS3: {
+      if (len && (len < 8 || len > 64)) return "pass: empty (open network) or 8..64 characters";
+      netCopy(s.pass[(field - NET_PASS) / 2], sizeof(s.pass[0]), value);
+      return 0;
+    }
+    case NET_IP: {
+      if (strcmp(value, "dhcp") == 0) {
+        s.staticIp = false;
+        return 0;
+      }
+      if (!netParseIPv4(value, s.ip)) return "ip: a.b.c.d or dhcp";
+      s.staticIp = true;
+      return 0;
+    }
+    case NET_GATEWAY:
+      return netParseIPv4(value, s.gateway) ? 0 : "gateway: a.b.c.d";
+    case NET_SUBNET: {
+      uint8_t m[4];
+      if (!netParseIPv4(value, m) || !netValidMask(m)) return "subnet: a mask like 255.255.255.0";
+      memcpy(s.subnet, m, 4);
+      return 0;
+    }
+    case NET_DNS:
+      return netParseIPv4(value, s.dns) ? 0 : "dns: a.b.c.d";
+    case NET_MQTT_SERVER:
+      if (len == 0 || len > 64) return "mqtt_server: 1..64 characters";
+      netCopy(s.mqttServer, sizeof(s.mqttServer), value);
+      return 0;
+    case NET_MQTT_PORT: {
+      char *end;
+      long port = strtol(value, &end, 10);
+      if (!len || *end || port < 1 || port > 65535) return "mqtt_port: 1..65535";
+      s.mqttPort = (uint16_t)port;
+      return 0;
+    }
+    case NET_MQTT_USER:
+      if (len > 32) return "mqtt_user: 32 characters at most";
+      netCopy(s.mqttUser, sizeof(s.mqttUser), value);
+      return 0;
+    case NET_MQTT_PASS:
+      if (len > 64) return "mqtt_pass: 64 characters at most";
+      netCopy(s.mqttPass, sizeof(s.mqttPass), value);
+      return 0;
+    case NET_AP_PASS:
+      if (len < 8 || len > 63) return "ap_pass: 8..63 characters";
+      netCopy(s.apPass, sizeof(s.apPass), value);
+      return 0;
+    default:
+      return "unknown field";
+  }
+}
+
+// NetApply bits for going from `a` to `b`
+inline uint8_t netSettingsDiff(const NetSettings &a, const NetSettings &b) {
+  uint8_t d = 0;
+  for (uint8_t i = 0; i < NET_MAX_APS; ++i) {
+    if (strcmp(a.ssid[i], b.ssid[i]) || strcmp(a.pass[i], b.pass[i])) d |= NET_APPLY_WIFI;
+  }
+  if (a.staticIp != b.staticIp || memcmp(a.ip, b.ip, 4) || memcmp(a.gateway, b.gateway, 4) ||
+      memcmp(a.subnet, b.subnet, 4) || memcmp(a.dns, b.dns, 4)) d |= NET_APPLY_WIFI;
+  if (strcmp(a.apPass, b.apPass)) d |= NET_APPLY_AP;
+  if (strcmp(a.mqttServer, b.mqttServer) || a.mqttPort != b.mqttPort ||
+      strcmp(a.mqttUser, b.mqttUser) || strcmp(a.mqttPass, b.mqttPass)) d |= NET_APPLY_MQTT;
+  return d;
+}
+
+#endif // NET_SETTINGS_H
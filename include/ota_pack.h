@@ -0,0 +1,311 @@
+// Compressed and delta OTA images ("packs", made by tools/ota_pack.py),
+// unpacked as they stream in and handed on to the flash writer
+// (include/flash_writer.h), so nothing but a fixed window is held in RAM.
+//
+// A pack is a 48-byte header followed by the body:
+//   0   4  magic "OTAP"
+//   4   1  version, 1
+//   5   1  flags: OTA_PACK_LZ, OTA_PACK_DELTA or both
+//   6   1  LZ window bits W (4..MAX_WINDOW_BITS)
+//   7   1  LZ lookahead bits L (3..W-1)
+//   8   4  size of the unpacked image, little endian
+//   12  4  delta: size of the image it applies to (the base), else 0
+//   16  32 delta: SHA-256 of those base bytes, else zeros
+//
+// LZ uses heatshrink's bit format, bits MSB first: 1 + 8 bits is a literal;
+// 0 + W bits (distance - 1) + L bits (length - 1) copies from the last 2^W
+// output bytes, zeros before the start.
+//
+// A delta (after LZ, if both) is a series of bsdiff-style operations:
+//   varint diffLen, varint extraLen, zigzag varint seek,
+//   diffLen bytes added to the base from the base position (mod 256),
+//   extraLen bytes copied as they are,
+// then the base position moves by diffLen + seek. Between two builds most
+// added bytes are zero, which is what makes the LZ stage pay off.
+//
+// Base is the image the delta applies to, offsets from its start:
+//   bool read(uint32_t offset, uint8_t *p, size_t n)
+// Out takes the unpacked image:
+//   bool write(const uint8_t *p, size_t n)
+// Hardware independent.
+#ifndef OTA_PACK_H
+#define OTA_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "sha256.h"
+
+static const size_t OTA_PACK_HEADER_SIZE = 48;
+static const uint8_t OTA_PACK_VERSION = 1;
+
+enum : uint8_t {
+  OTA_PACK_LZ = 1,
+  OTA_PACK_DELTA = 2,
+};
+
+struct OtaPackHeader {
+  uint8_t flags;
+  uint8_t windowBits;
+  uint8_t lookaheadBits;
+  uint32_t imageSize;
+  uint32_t baseSize;
+  uint8_t baseDigest[Sha256::DIGEST_SIZE];
+};
+
+enum OtaPackError : uint8_t {
+  OTA_PACK_OK = 0,
+  OTA_PACK_ERR_FORMAT,    // a malformed operation
+  OTA_PACK_ERR_BASE,      // reads outside the base, or the base cannot be read
+  OTA_PACK_ERR_SIZE,      // more or fewer bytes than the header announced
+  OTA_PACK_ERR_OUTPUT,    // Out refused the bytes
+};
+
+inline const char *otaPackErrorName(OtaPackError e) {
+  switch (e) {
+    case OTA_PACK_OK: return "ok";
+    case OTA_PACK_ERR_FORMAT: return "malformed pack";
+    case OTA_PACK_ERR_BASE: return "delta outside its base";
+    case OTA_PACK_ERR_SIZE: return "unpacked size";
+    case OTA_PACK_ERR_OUTPUT: return "output";
+  }
+  return "?";
+}
+
+// The first bytes of a stream: a pack, or a plain image?
+inline bool otaPackIsPack(const uint8_t *p, size_t n) {
+  return n >= 4 && memcmp(p, "OTAP", 4) == 0;
+}
+
+inline uint32_t otaPackLe32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// nullptr if `p` is a header this decoder can unpack, else why not
+inline const char *otaPackParseHeader(const uint8_t p[OTA_PACK_HEADER_SIZE], uint8_t maxWindowBits, OtaPackHeader &h) {
+  if (!otaPackIsPack(p, OTA_PACK_HEADER_SIZE)) return "not a pack";
+  if (p[4] != OTA_PACK_VERSION) return "unknown pack version";
+  h.flags = p[5];
+  h.windowBits = p[6];
+  h.lookaheadBits = p[7];
+  h.imageSize = otaPackLe32(p + 8);
+  h.baseSize = otaPackLe32(p + 12);
+  memcpy(h.baseDigest, p + 16, sizeof(h.baseDigest));
+  if (!h.flags || h.flags & ~(OTA_PACK_LZ | OTA_PACK_DELTA)) return "unknown pack flags";
+  if (h.flags & OTA_PACK_LZ) {
+    if (h.windowBits < 4 || h.windowBits > maxWindowBits) return "LZ window too large";
+    if (h.lookaheadBits < 3 || h.lookaheadBits >= h.windowBits) return "bad LZ lookahead";
+  }
+  if (!h.imageSize) return "empty image";
+  if (!(h.flags & OTA_PACK_DELTA) != !h.baseSize) return "base size without delta";
+  return nullptr;
+}
+
+template <typename Base, typename Out, uint8_t MAX_WINDOW_BITS = 12>
+class OtaUnpacker {
+  static_assert(MAX_WINDOW_BITS >= 4 && MAX_WINDOW_BITS <= 15, "window of 16 bytes to 32 KB");
+  static const uint32_t RING = 1u << MAX_WINDOW_BITS;
+
+public:
+  OtaUnpacker(Base &b, Out &o) : base(b), out(o) {
+    OtaPackHeader none = OtaPackHeader();
+    begin(none);
+  }
+
+  // The body of a pack with header `h` follows
+  void begin(const OtaPackHeader &h) {
+    hdr = h;
+    err = OTA_PACK_OK;
+    produced = 0;
+    acc = 0;
+    accBits = 0;
+    lzField = LZ_TAG;
+    lzIndex = 0;
+    head = flushed = 0;
+    memset(ring, 0, sizeof(ring));
+    op = OP_CTRL;
+    ctrlField = 0;
+    varShift = 0;
+    var = 0;
+    srcPos = 0;
+  }
+
+  // Any split of the body; false from the first failure on
+  bool write(const uint8_t *p, size_t n) {
+    if (err) return false;
+    if (!(hdr.flags & OTA_PACK_LZ)) return decoded(p, n);
+    while (n--) {
+      acc = acc << 8 | *p++;
+      accBits += 8;
+      if (!lzBits()) return false;
+    }
+    // hand on what this call decoded; the ring only holds the window
+    return lzFlush();
+  }
+
+  // After the last byte: the image is complete and no operation is cut short
+  bool finish() {
+    if (err) return false;
+    if (op != OP_CTRL || ctrlField || varShift) return fail(OTA_PACK_ERR_FORMAT);
+    if (produced != hdr.imageSize) return fail(OTA_PACK_ERR_SIZE);
+    return true;
+  }
+
+  OtaPackError error() const { return err; }
+  uint32_t bytesOut() const { return produced; }
+
+private:
+  enum LzField : uint8_t { LZ_TAG, LZ_LITERAL, LZ_INDEX, LZ_COUNT };
+  enum Op : uint8_t { OP_CTRL, OP_DIFF, OP_EXTRA };
+
+  bool fail(OtaPackError e) {
+    err = e;
+    return false;
+  }
+
+  uint8_t fieldBits() const {
+    switch (lzField) {
+      case LZ_TAG: return 1;
+      case LZ_LITERAL: return 8;
+      case LZ_INDEX: return hdr.windowBits;
+      default: return hdr.lookaheadBits;
+    }
+  }
+
+  // Decodes every complete field in the accumulator
+  bool lzBits() {
+    for (uint8_t need = fieldBits(); accBits >= need; need = fieldBits()) {
+      accBits -= need;
+      uint32_t v = acc >> accBits & ((1u << need) - 1);
+      acc &= (1u << accBits) - 1;
+      switch (lzField) {
+        case LZ_TAG:
+          lzField = v ? LZ_LITERAL : LZ_INDEX;
+          break;
+        case LZ_LITERAL:
+          if (!lzPut((uint8_t)v)) return false;
+          lzField = LZ_TAG;
+          break;
+        case LZ_INDEX:
+          lzIndex = v + 1;
+          lzField = LZ_COUNT;
+          break;
+        case LZ_COUNT:
+          for (uint32_t i = 0; i <= v; ++i) {
+            if (!lzPut(ring[(head - lzIndex) & (RING - 1)])) return false;
+          }
+          lzField = LZ_TAG;
+          break;
+      }
+    }
+    return true;
+  }
+
+  bool lzPut(uint8_t b) {
+    ring[head & (RING - 1)] = b;
+    head++;
+    // keeps the unflushed part contiguous
+    return (head & (RING - 1)) || lzFlush();
+  }
+
+  bool lzFlush() {
+    if (head == flushed) return true;
+    const uint8_t *p = ring + (flushed & (RING - 1));
+    size_t n = head - flushed;
+    flushed = head;
+    return decoded(p, n);
+  }
+
+  // The LZ output, or the body itself without LZ
+  bool decoded(const uint8_t *p, size_t n) {
+    if (!(hdr.flags & OTA_PACK_DELTA)) return put(p, n);
+    while (n) {
+      if (op == OP_CTRL) {
+        if (!ctrlByte(*p++)) return false;
+        n--;
+        continue;
+      }
+      size_t k = opLeft < n ? opLeft : n;
+      if (op == OP_DIFF) {
+        if (k > sizeof(buf)) k = sizeof(buf);
+        if (!base.read(srcPos, buf, k)) return fail(OTA_PACK_ERR_BASE);
+        for (size_t i = 0; i < k; ++i) buf[i] += p[i];
+        if (!put(buf, k)) return false;
+        srcPos += k;
+      } else if (!put(p, k)) {
+        return false;
+      }
+      p += k;
+      n -= k;
+      opLeft -= k;
+      if (!opLeft && !nextSection()) return false;
+    }
+    return true;
+  }
+
+  // Varints of the control triple, 7 bits per byte, low bits first
+  bool ctrlByte(uint8_t b) {
+    if (varShift > 28) return fail(OTA_PACK_ERR_FORMAT);
+    var |= (uint32_t)(b & 0x7F) << varShift;
+    if (b & 0x80) {
+      varShift += 7;
+      return true;
+    }
+    ctrl[ctrlField++] = var;
+    var = 0;
+    varShift = 0;
+    if (ctrlField < 3) return true;
+    ctrlField = 0;
+    if ((uint64_t)srcPos + ctrl[0] > hdr.baseSize) return fail(OTA_PACK_ERR_BASE);
+    op = OP_DIFF;
+    opLeft = ctrl[0];
+    return opLeft || nextSection();
+  }
+
+  // Diff -> extra -> seek and the next control triple; empty sections skipped
+  bool nextSection() {
+    if (op == OP_DIFF) {
+      op = OP_EXTRA;
+      opLeft = ctrl[1];
+      if (opLeft) return true;
+    }
+    int64_t seek = (int64_t)(ctrl[2] >> 1) ^ -(int64_t)(ctrl[2] & 1);
+    int64_t pos = (int64_t)srcPos + seek;
+    if (pos < 0 || pos > (int64_t)hdr.baseSize) return fail(OTA_PACK_ERR_BASE);
+    srcPos = (uint32_t)pos;
+    op = OP_CTRL;
+    return true;
+  }
+
+  bool put(const uint8_t *p, size_t n) {
+    if (n > hdr.imageSize - produced) return fail(OTA_PACK_ERR_SIZE);
+    if (!out.write(p, n)) return fail(OTA_PACK_ERR_OUTPUT);
+    produced += n;
+    return true;
+  }
+
+  Base &base;
+  Out &out;
+  OtaPackHeader hdr;
+  OtaPackError err;
+  uint32_t produced;
+  // LZ: bit accumulator, current field, ring of the last 2^MAX_WINDOW_BITS bytes
+  uint32_t acc;
+  uint8_t accBits;
+  LzField lzField;
+  uint32_t lzIndex;
+  uint32_t head;
+  uint32_t flushed;
+  // delta: current operation and base position
+  Op op;
+  uint8_t ctrlField;
+  uint8_t varShift;
+  uint32_t var;
+  uint32_t ctrl[3];
+  uint32_t opLeft;
+  uint32_t srcPos;
+  uint8_t buf[256];
+  uint8_t ring[RING];
+};
+
+#endif // OTA_PACK_H
@@ -34,6 +34,10 @@
 #define DHT_IN_PIN 21
 #define DHT_OUT_PIN 20
 
+// Optional analog light sensor (PAR/lux) for the daily light integral.
+// Leave at -1 to estimate DLI from lamp on-time and the configured lamp PPFD.
+#define LIGHT_SENSOR_PIN -1
+
 // Serial1 pins (example) - change if needed
 #define SERIAL1_RX_PIN 16
 #define SERIAL1_TX_PIN 17
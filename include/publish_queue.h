@@ -0,0 +1,94 @@
+// Bounded FIFO of pending MQTT publishes held in fixed-size slots (no heap).
+// Topics are stored relative to the device base topic. Messages can be
+// written to / read back from a byte stream as length-prefixed records so a
+// full queue can be spilled to flash and replayed in order. Hardware
+// independent.
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+template <size_t Cap, size_t TopicLen, size_t PayloadLen>
+class PublishQueue {
+  static_assert(TopicLen < 256 && PayloadLen < 65536, "lengths are stored in 8/16 bits");
+public:
+  struct Msg {
+    char topic[TopicLen + 1];
+    char payload[PayloadLen + 1];
+    uint16_t payloadLen;
+    bool retain;
+
+    // Record layout: topic length (1) | retain (1) | payload length (2) | topic | payload
+    template <typename Writer>
+    bool write(Writer &w) const {
+      uint8_t hdr[4];
+      size_t tl = strlen(topic);
+      hdr[0] = (uint8_t)tl;
+      hdr[1] = retain ? 1 : 0;
+      hdr[2] = (uint8_t)(payloadLen & 0xFF);
+      hdr[3] = (uint8_t)(payloadLen >> 8);
+      if (w.write(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+      if (w.write((const uint8_t *)topic, tl) != tl) return false;
+      return w.write((const uint8_t *)payload, payloadLen) == payloadLen;
+    }
+
+    // False on end of stream or a record that does not fit this queue's slots
+    template <typename Reader>
+    bool read(Reader &r) {
+      uint8_t hdr[4];
+      if (r.read(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+      size_t tl = hdr[0];
+      size_t pl = hdr[2] | hdr[3] << 8;
+      if (tl > TopicLen || pl > PayloadLen) return false;
+      if (r.read((uint8_t *)topic, tl) != tl) return false;
+      if (r.read((uint8_t *)payload, pl) != pl) return false;
+      topic[tl] = 0;
+      payload[pl] = 0;
+      payloadLen = (uint16_t)pl;
+      retain = hdr[1] != 0;
+      return true;
+    }
+
+    size_t recordSize() const { return 4 + strlen(topic) + payloadLen; }
+  };
+
+  PublishQueue() : head(0), count(0) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == Cap; }
+  static size_t capacity() { return Cap; }
+  void clear() { head = 0; count = 0; }
+
+  // False if the queue is full or the message does not fit a slot
+  bool push(const char *topic, const char *payload, size_t payloadLen, bool retain) {
+    size_t tl = strlen(topic);
+    if (count == Cap || tl > TopicLen || payloadLen > PayloadLen) return false;
+    Msg &m = slots[(head + count) % Cap];
+    memcpy(m.topic, topic, tl + 1);
+    memcpy(m.payload, payload, payloadLen);
+    m.payload[payloadLen] = 0;
+    m.payloadLen = (uint16_t)payloadLen;
+    m.retain = retain;
+    count++;
+    return true;
+  }
+
+  // i = 0 is the oldest message
+  const Msg &at(size_t i) const { return slots[(head + i) % Cap]; }
+  const Msg &front() const { return slots[head]; }
+  void pop() {
+    if (!count) return;
+    if (++head == Cap) head = 0;
+    count--;
+  }
+
+private:
+  Msg slots[Cap];
+  size_t head;
+  size_t count;
+};
+
+#endif // PUBLISH_QUEUE_H
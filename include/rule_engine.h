@@ -0,0 +1,260 @@
+// Small sensor/time rule engine. Rules are compiled once from text into flat
+// predicate arrays and evaluated each tick in bounded time without heap use.
+// Hardware independent so it can be replayed against traces on the host.
+//
+// Rule syntax (rules separated by ';' or newline):
+//   <cond> [& <cond>...] -> ch<N> [<duration>[s|m|h]] [h<hysteresis>]
+//   <cond> := <var> (>|<|>=|<=) <number>
+//   <var>  := tin | hin | tout | hout | min (minutes since midnight)
+// Example: "tout>25 & hin>80 -> ch4 10m h0.5"
+// The relay stays on at least <duration>; while a rule is active its
+// thresholds are relaxed by <hysteresis> so it does not chatter. Both hold
+// across a recompile: an unchanged rule keeps its state, and a channel
+// turned on by a rule that was edited or removed stays on until that rule's
+// minimum on-time has run out.
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+enum RuleVar : uint8_t {
+  RULE_VAR_TIN = 0,
+  RULE_VAR_HIN,
+  RULE_VAR_TOUT,
+  RULE_VAR_HOUT,
+  RULE_VAR_MINUTE,
+  RULE_VAR_COUNT
+};
+
+enum RuleOp : uint8_t { RULE_OP_GT = 0, RULE_OP_LT, RULE_OP_GE, RULE_OP_LE };
+
+template <size_t MaxRules, size_t MaxConds>
+class RuleSet {
+public:
+  struct Cond { uint8_t var; uint8_t op; float threshold; };
+  struct Rule {
+    uint8_t firstCond;
+    uint8_t condCount;
+    uint8_t channel;
+    float hysteresis;
+    uint32_t minOnSec;
+  };
+
+  RuleSet() { clear(); }
+
+  void clear() {
+    ruleCount = 0;
+    condCount = 0;
+    for (size_t i = 0; i < MaxRules; ++i) { active[i] = false; onSinceMs[i] = 0; }
+    for (size_t i = 0; i < 8; ++i) { channelOn[i] = false; holdFromMs[i] = 0; holdMs[i] = 0; }
+  }
+
+  size_t size() const { return ruleCount; }
+  const Rule &rule(size_t i) const { return rules[i]; }
+  bool isActive(size_t i) const { return active[i]; }
+
+  // Compile `text`; on failure the previous rule set is kept and a message is
+  // written to err. Returns false on syntax error or capacity overflow.
+  bool compile(const char *text, char *err, size_t errLen) {
+    RuleSet tmp;
+    const char *p = text;
+    int ruleNo = 1;
+    while (*p) {
+      while (*p == ' ' || *p == ';' || *p == '\n' || *p == '\r' || *p == '\t') ++p;
+      if (!*p) break;
+      const char *why = tmp.compileRule(p);
+      if (why) {
+        if (err && errLen) snprintf(err, errLen, "rule %d: %s", ruleNo, why);
+        return false;
+      }
+      ruleNo++;
+    }
+    // keep runtime state of channels we are currently driving
+    for (size_t i = 0; i < 8; ++i) {
+      tmp.channelOn[i] = channelOn[i];
+      tmp.holdFromMs[i] = holdFromMs[i];
+      tmp.holdMs[i] = holdMs[i];
+    }
+    bool matched[MaxRules] = {};
+    for (size_t j = 0; j < ruleCount; ++j) {
+      if (!active[j]) continue;
+      size_t i = 0;
+      while (i < tmp.ruleCount && (matched[i] || !sameRule(tmp, i, j))) ++i;
+      if (i < tmp.ruleCount) {
+        matched[i] = true;
+        tmp.active[i] = true;
+        tmp.onSinceMs[i] = onSinceMs[j];
+      } else {
+        tmp.hold(rules[j].channel, onSinceMs[j], rules[j].minOnSec * 1000UL);
+      }
+    }
+    *this = tmp;
+    return true;
+  }
+
+  // Evaluate all rules. inputs[RULE_VAR_COUNT] may contain NAN for missing
+  // values (conditions on them are false). actuate(channel, on) is called
+  // only when a channel's combined state (OR of its rules) changes.
+  template <typename F>
+  void evaluate(const float *inputs, uint32_t nowMs, F actuate) {
+    for (size_t r = 0; r < ruleCount; ++r) {
+      const Rule &ru = rules[r];
+      bool want = true;
+      for (size_t c = ru.firstCond; c < (size_t)ru.firstCond + ru.condCount; ++c) {
+        if (!holds(conds[c], inputs[conds[c].var], active[r] ? ru.hysteresis : 0.0f)) { want = false; break; }
+      }
+      if (want && !active[r]) {
+        active[r] = true;
+        onSinceMs[r] = nowMs;
+      } else if (!want && active[r] && nowMs - onSinceMs[r] >= ru.minOnSec * 1000UL) {
+        active[r] = false;
+      }
+    }
+    // combine rules per channel
+    bool wantCh[8] = { false, false, false, false, false, false, false, false };
+    bool usedCh[8] = { false, false, false, false, false, false, false, false };
+    for (size_t r = 0; r < ruleCount; ++r) {
+      usedCh[rules[r].channel] = true;
+      if (active[r]) wantCh[rules[r].channel] = true;
+    }
+    // minimum on-time left over from rules replaced by a recompile
+    for (uint8_t ch = 1; ch < 8; ++ch) {
+      if (!holdMs[ch]) continue;
+      if (nowMs - holdFromMs[ch] < holdMs[ch]) wantCh[ch] = true;
+      else holdMs[ch] = 0;
+    }
+    for (uint8_t ch = 1; ch < 8; ++ch) {
+      if (!usedCh[ch] && !channelOn[ch]) continue;
+      if (wantCh[ch] != channelOn[ch]) {
+        channelOn[ch] = wantCh[ch];
+        actuate(ch, wantCh[ch]);
+      }
+    }
+  }
+
+  static const char *varName(uint8_t v) {
+    static const char *names[RULE_VAR_COUNT] = { "tin", "hin", "tout", "hout", "min" };
+    return v < RULE_VAR_COUNT ? names[v] : "?";
+  }
+
+private:
+  // Rule i of `other` is rule j of this set, conditions and all
+  bool sameRule(const RuleSet &other, size_t i, size_t j) const {
+    const Rule &a = other.rules[i], &b = rules[j];
+    if (a.channel != b.channel || a.condCount != b.condCount || a.hysteresis != b.hysteresis || a.minOnSec != b.minOnSec) return false;
+    for (size_t c = 0; c < a.condCount; ++c) {
+      const Cond &x = other.conds[a.firstCond + c], &y = conds[b.firstCond + c];
+      if (x.var != y.var || x.op != y.op || x.threshold != y.threshold) return false;
+    }
+    return true;
+  }
+
+  // Keeps `ch` on until fromMs + ms, or longer if already held longer
+  void hold(uint8_t ch, uint32_t fromMs, uint32_t ms) {
+    if (!ms) return;
+    if (holdMs[ch] && (int32_t)((holdFromMs[ch] + holdMs[ch]) - (fromMs + ms)) >= 0) return;
+    holdFromMs[ch] = fromMs;
+    holdMs[ch] = ms;
+  }
+
+  static bool holds(const Cond &c, float v, float hyst) {
+    if (isnan(v)) return false;
+    switch (c.op) {
+      case RULE_OP_GT: return v > c.threshold - hyst;
+      case RULE_OP_GE: return v >= c.threshold - hyst;
+      case RULE_OP_LT: return v < c.threshold + hyst;
+      default: return v <= c.threshold + hyst;
+    }
+  }
+
+  static void skipSpaces(const char *&p) { while (*p == ' ' || *p == '\t') ++p; }
+
+  static bool parseNumber(const char *&p, float &out) {
+    char *end;
+    out = strtof(p, &end);
+    if (end == p) return false;
+    p = end;
+    return true;
+  }
+
+  // Parse one rule starting at p; advances p past it. Returns error or null.
+  const char *compileRule(const char *&p) {
+    if (ruleCount >= MaxRules) return "too many rules";
+    Rule ru;
+    ru.firstCond = (uint8_t)condCount;
+    ru.condCount = 0;
+    ru.hysteresis = 0;
+    ru.minOnSec = 0;
+    for (;;) {
+      skipSpaces(p);
+      static const char *names[RULE_VAR_COUNT] = { "tout", "hout", "tin", "hin", "min" };
+      static const uint8_t ids[RULE_VAR_COUNT] = { RULE_VAR_TOUT, RULE_VAR_HOUT, RULE_VAR_TIN, RULE_VAR_HIN, RULE_VAR_MINUTE };
+      size_t v = 0;
+      for (; v < RULE_VAR_COUNT; ++v) {
+        size_t n = strlen(names[v]);
+        if (strncmp(p, names[v], n) == 0) { p += n; break; }
+      }
+      if (v == RULE_VAR_COUNT) return "unknown variable";
+      skipSpaces(p);
+      Cond c;
+      c.var = ids[v];
+      if (p[0] == '>' && p[1] == '=') { c.op = RULE_OP_GE; p += 2; }
+      else if (p[0] == '<' && p[1] == '=') { c.op = RULE_OP_LE; p += 2; }
+      else if (p[0] == '>') { c.op = RULE_OP_GT; p += 1; }
+      else if (p[0] == '<') { c.op = RULE_OP_LT; p += 1; }
+      else return "expected comparison";
+      skipSpaces(p);
+      if (!parseNumber(p, c.threshold)) return "expected number";
+      if (condCount >= MaxConds) return "too many conditions";
+      conds[condCount++] = c;
+      ru.condCount++;
+      skipSpaces(p);
+      if (*p == '&') { ++p; continue; }
+      if (p[0] == '-' && p[1] == '>') { p += 2; break; }
+      return "expected '&' or '->'";
+    }
+    skipSpaces(p);
+    if (strncmp(p, "ch", 2) != 0) return "expected ch<N>";
+    p += 2;
+    char *end;
+    long ch = strtol(p, &end, 10);
+    if (end == p || ch < 1 || ch > 6) return "bad channel";
+    p = end;
+    ru.channel = (uint8_t)ch;
+    // optional duration and hysteresis
+    for (;;) {
+      skipSpaces(p);
+      if (*p == 'h') {
+        ++p;
+        if (!parseNumber(p, ru.hysteresis) || ru.hysteresis < 0) return "bad hysteresis";
+      } else if (*p >= '0' && *p <= '9') {
+        float d;
+        if (!parseNumber(p, d) || d < 0) return "bad duration";
+        if (*p == 'm') { d *= 60.0f; ++p; }
+        else if (*p == 'h') { d *= 3600.0f; ++p; }
+        else if (*p == 's') ++p;
+        ru.minOnSec = (uint32_t)d;
+      } else break;
+    }
+    if (*p && *p != ';' && *p != '\n' && *p != '\r') return "unexpected text after rule";
+    rules[ruleCount++] = ru;
+    return 0;
+  }
+
+  Rule rules[MaxRules];
+  Cond conds[MaxConds];
+  size_t ruleCount;
+  size_t condCount;
+  bool active[MaxRules];
+  uint32_t onSinceMs[MaxRules];
+  bool channelOn[8];
+  uint32_t holdFromMs[8];
+  uint32_t holdMs[8];
+};
+
+#endif // RULE_ENGINE_H
@@ -1,22 +1,22 @@
-// Simple logging helper: write to USB Serial if available, UART1, and SSE/telnet
+// Simple logging helpers: route a message to every log sink (USB Serial,
+// UART1, flash, telnet, SSE) whose level lets it through (see logging.h)
 #ifndef SERIAL_UTILS_H
 #define SERIAL_UTILS_H
 #include <Arduino.h>
 #include "webserver.h"
 #include "logging.h"
 
+inline void logPrintln(LogLevel level, const String &s) {
+  logWrite(level, s.c_str(), s.length(), true);
+}
+
 inline void logPrintln(const String &s) {
-  // Emit logs to Serial (USB CDC) if available and to Serial1 (USB-TTL adapter)
-  if (Serial) Serial.println(s);
-  if (Serial1) Serial1.println(s);
-  // Also persist logs to SPIFFS
-  appendLog(s);
+  logPrintln(LOG_INFO, s);
 }
 
+// Fragment of a line (e.g. progress dots); line sinks get it with the next logPrintln
 inline void logPrint(const String &s) {
-  if (Serial) Serial.print(s);
-  if (Serial1) Serial1.print(s);
-  appendLog(s);
+  logWrite(LOG_INFO, s.c_str(), s.length(), false);
 }
 
 #endif // SERIAL_UTILS_H
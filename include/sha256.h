@@ -0,0 +1,124 @@
+// SHA-256 (FIPS 180-4), fed in pieces of any size: OTA images are hashed as
+// they stream in, without holding them. About 110 bytes of state. Hardware
+// independent.
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class Sha256 {
+public:
+  static const size_t DIGEST_SIZE = 32;
+
+  Sha256() { reset(); }
+
+  void reset() {
+    static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    memcpy(h, init, sizeof(h));
+    length = 0;
+    fill = 0;
+  }
+
+  void update(const uint8_t *p, size_t n) {
+    length += n;
+    while (n) {
+      size_t k = 64 - fill < n ? 64 - fill : n;
+      memcpy(block + fill, p, k);
+      fill += k;
+      p += k;
+      n -= k;
+      if (fill == 64) {
+        compress(block);
+        fill = 0;
+      }
+    }
+  }
+
+  // The hasher must be reset() before it is used again
+  void finish(uint8_t out[DIGEST_SIZE]) {
+    uint64_t bits = length * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (fill != 56) update(&pad, 1);
+    uint8_t len[8];
+    for (int i = 0; i < 8; ++i) len[i] = (uint8_t)(bits >> (56 - 8 * i));
+    update(len, 8);
+    for (int i = 0; i < 8; ++i) {
+      out[4 * i] = (uint8_t)(h[i] >> 24);
+      out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+      out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+      out[4 * i + 3] = (uint8_t)h[i];
+    }
+  }
+
+private:
+  static uint32_t ror(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+  void compress(const uint8_t *b) {
+    static const uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    // 16-word rolling schedule instead of 64: less stack
+    uint32_t w[16];
+    for (int i = 0; i < 16; ++i)
+      w[i] = (uint32_t)b[4 * i] << 24 | (uint32_t)b[4 * i + 1] << 16 | (uint32_t)b[4 * i + 2] << 8 | b[4 * i + 3];
+    uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; ++i) {
+      if (i >= 16) {
+        uint32_t w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+        uint32_t s0 = ror(w15, 7) ^ ror(w15, 18) ^ (w15 >> 3);
+        uint32_t s1 = ror(w2, 17) ^ ror(w2, 19) ^ (w2 >> 10);
+        w[i & 15] += s0 + w[(i - 7) & 15] + s1;
+      }
+      uint32_t t1 = hh + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i & 15];
+      uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & bb) ^ (a & c) ^ (bb & c));
+      hh = g; g = f; f = e; e = d + t1;
+      d = c; c = bb; bb = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += bb; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+  }
+
+  uint32_t h[8];
+  uint64_t length;
+  uint8_t block[64];
+  size_t fill;
+};
+
+// "9f86d0...": 64 hex digits, either case; false if malformed
+inline bool sha256FromHex(const char *hex, uint8_t out[Sha256::DIGEST_SIZE]) {
+  for (size_t i = 0; i < 2 * Sha256::DIGEST_SIZE; ++i) {
+    char c = hex[i];
+    uint8_t v;
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+    else return false;
+    if (i & 1) out[i / 2] |= v;
+    else out[i / 2] = v << 4;
+  }
+  return hex[2 * Sha256::DIGEST_SIZE] == 0;
+}
+
+// out: 65 bytes
+inline void sha256ToHex(const uint8_t d[Sha256::DIGEST_SIZE], char *out) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < Sha256::DIGEST_SIZE; ++i) {
+    out[2 * i] = digits[d[i] >> 4];
+    out[2 * i + 1] = digits[d[i] & 15];
+  }
+  out[2 * Sha256::DIGEST_SIZE] = 0;
+}
+
+#endif // SHA256_H
@@ -0,0 +1,45 @@
+// Output of structured data (maps, arrays, scalars) without committing to a
+// wire format: a producer such as sensorWrite() describes its fields once and
+// the writer it is handed decides whether that becomes CBOR, JSON, ... The
+// writers stream into a small buffer, so no document or String is built.
+// Hardware independent.
+#ifndef STRUCT_WRITER_H
+#define STRUCT_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class StructWriter {
+public:
+  virtual ~StructWriter() {}
+
+  // Containers have no size up front; every begin needs its end
+  virtual void beginMap() = 0;
+  virtual void endMap() = 0;
+  virtual void beginArray() = 0;
+  virtual void endArray() = 0;
+  // Inside a map: key, then exactly one value or container
+  virtual void key(const char *k) = 0;
+
+  virtual void intValue(int64_t v) = 0;
+  // NAN is written as null
+  virtual void floatValue(float v) = 0;
+  virtual void boolValue(bool v) = 0;
+  virtual void strValue(const char *s, size_t n) = 0;
+  virtual void nullValue() = 0;
+
+  void strValue(const char *s) { strValue(s, strlen(s)); }
+
+  // Shorthands for the common key/value pair
+  void intField(const char *k, int64_t v) { key(k); intValue(v); }
+  void floatField(const char *k, float v) { key(k); floatValue(v); }
+  void boolField(const char *k, bool v) { key(k); boolValue(v); }
+  void strField(const char *k, const char *s) { key(k); strValue(s); }
+  void strField(const char *k, const char *s, size_t n) { key(k); strValue(s, n); }
+};
+
+// Producer of one document (a module's status, the whole /state snapshot)
+typedef void (*StructProducer)(StructWriter &w);
+
+#endif // STRUCT_WRITER_H
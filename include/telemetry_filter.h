@@ -0,0 +1,124 @@
+// Delta-only telemetry: metrics are grouped per topic and a group is sent
+// only when one of its metrics moved past its deadband since the last send,
+// or when the group's heartbeat elapsed. A sent group carries all of its
+// metrics as one flat JSON object, so the retained message on the broker
+// always holds the complete last state. Hardware independent.
+#ifndef TELEMETRY_FILTER_H
+#define TELEMETRY_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+template <size_t MaxGroups, size_t MaxMetrics>
+class TelemetryFilter {
+public:
+  TelemetryFilter() : groupCount(0), metricCount(0) {}
+
+  // Returns the group id, -1 when full. `name` must outlive the filter.
+  int addGroup(const char *name, uint32_t heartbeatMs) {
+    if (groupCount >= MaxGroups) return -1;
+    Group &g = groupList[groupCount];
+    g.name = name;
+    g.heartbeatMs = heartbeatMs;
+    g.lastSentMs = 0;
+    g.force = true;
+    return (int)groupCount++;
+  }
+
+  // Returns the metric id, -1 when full. deadband 0 sends every change.
+  int addMetric(int group, const char *key, float deadband, uint8_t decimals) {
+    if (metricCount >= MaxMetrics || group < 0 || (size_t)group >= groupCount) return -1;
+    Metric &m = metrics[metricCount];
+    m.key = key;
+    m.deadband = deadband;
+    m.value = NAN;
+    m.sent = NAN;
+    m.group = (uint8_t)group;
+    m.decimals = decimals;
+    return (int)metricCount++;
+  }
+
+  // NAN marks a missing reading; it is sent as null
+  void set(int metric, float v) { metrics[metric].value = v; }
+  float get(int metric) const { return metrics[metric].value; }
+
+  size_t groups() const { return groupCount; }
+  const char *groupName(int group) const { return groupList[group].name; }
+
+  // Send every group on the next check, e.g. after reconnecting
+  void invalidate() {
+    for (size_t g = 0; g < groupCount; ++g) groupList[g].force = true;
+  }
+
+  bool due(int group, uint32_t nowMs) const {
+    const Group &g = groupList[group];
+    if (g.force || nowMs - g.lastSentMs >= g.heartbeatMs) return true;
+    for (size_t i = 0; i < metricCount; ++i) {
+      if (metrics[i].group == group && changed(metrics[i])) return true;
+    }
+    return false;
+  }
+
+  // Write {"key":value,...} for every metric of the group. Returns the
+  // length, or 0 if buf is too small.
+  size_t format(int group, char *buf, size_t len) const {
+    size_t n = 0;
+    bool first = true;
+    if (len < 3) return 0;
+    buf[n++] = '{';
+    for (size_t i = 0; i < metricCount; ++i) {
+      const Metric &m = metrics[i];
+      if (m.group != group) continue;
+      int w = isnan(m.value)
+                  ? snprintf(buf + n, len - n, "%s\"%s\":null", first ? "" : ",", m.key)
+                  : snprintf(buf + n, len - n, "%s\"%s\":%.*f", first ? "" : ",", m.key, (int)m.decimals, (double)m.value);
+      if (w < 0 || (size_t)w >= len - n) return 0;
+      n += (size_t)w;
+      first = false;
+    }
+    if (n + 2 > len) return 0;
+    buf[n++] = '}';
+    buf[n] = 0;
+    return n;
+  }
+
+  void markSent(int group, uint32_t nowMs) {
+    Group &g = groupList[group];
+    g.force = false;
+    g.lastSentMs = nowMs;
+    for (size_t i = 0; i < metricCount; ++i) {
+      if (metrics[i].group == group) metrics[i].sent = metrics[i].value;
+    }
+  }
+
+private:
+  struct Group {
+    const char *name;
+    uint32_t heartbeatMs;
+    uint32_t lastSentMs;
+    bool force;
+  };
+  struct Metric {
+    const char *key;
+    float deadband;
+    float value;
+    float sent;   // value in the last sent message
+    uint8_t group;
+    uint8_t decimals;
+  };
+
+  static bool changed(const Metric &m) {
+    if (isnan(m.value) || isnan(m.sent)) return isnan(m.value) != isnan(m.sent);
+    // small margin so 21.3 - 21.1 (0.2000008f) does not pass a 0.2 deadband
+    return fabsf(m.value - m.sent) > m.deadband * 1.001f;
+  }
+
+  Group groupList[MaxGroups];
+  Metric metrics[MaxMetrics];
+  size_t groupCount;
+  size_t metricCount;
+};
+
+#endif // TELEMETRY_FILTER_H
@@ -0,0 +1,113 @@
+// Fixed-capacity circular time series: O(1) push, oldest entries are
+// overwritten, no heap allocation. Serializes to a compact binary file
+// (header + records oldest to newest). Hardware independent.
+#ifndef TIME_SERIES_RING_H
+#define TIME_SERIES_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One value per calendar day packed into 32 bits:
+// days since 2000-01-01 (15 bits, until 2089) << 17 | seconds (17 bits, <= 86400)
+struct DaySeconds {
+  uint32_t packed;
+
+  static DaySeconds make(int year, int yday, uint32_t seconds) {
+    DaySeconds d;
+    uint32_t days = (uint32_t)(daysBeforeYear(year) + yday);
+    if (seconds > 0x1FFFFUL) seconds = 0x1FFFFUL;
+    d.packed = (days & 0x7FFFUL) << 17 | seconds;
+    return d;
+  }
+
+  uint32_t seconds() const { return packed & 0x1FFFFUL; }
+  uint32_t daysSince2000() const { return packed >> 17; }
+  int year() const {
+    int y = 2000;
+    uint32_t days = daysSince2000();
+    while (days >= (uint32_t)daysInYear(y)) { days -= daysInYear(y); ++y; }
+    return y;
+  }
+  int yday() const { return (int)(daysSince2000() - (uint32_t)daysBeforeYear(year())); }
+
+  static bool isLeap(int y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+  static int daysInYear(int y) { return isLeap(y) ? 366 : 365; }
+  static int daysBeforeYear(int y) {
+    int d = 0;
+    for (int i = 2000; i < y; ++i) d += daysInYear(i);
+    return d;
+  }
+};
+
+template <typename Record, size_t N>
+class TimeSeriesRing {
+  static_assert(N > 0 && N <= 0xFFFF, "count is stored in 16 bits");
+public:
+  TimeSeriesRing() : head(0), count(0) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  static size_t capacity() { return N; }
+  void clear() { head = 0; count = 0; }
+
+  void push(const Record &r) {
+    items[head] = r;
+    if (++head == N) head = 0;
+    if (count < N) count++;
+  }
+
+  // i = 0 is the oldest entry
+  const Record &at(size_t i) const { return items[(head + N - count + i) % N]; }
+  const Record &newest() const { return at(count - 1); }
+
+  // File layout: magic (4) | record size (2) | count (2) | records oldest first.
+  // Writer needs `size_t write(const uint8_t *buf, size_t len)` (e.g. fs::File).
+  template <typename Writer>
+  bool save(Writer &w, uint32_t magic) const {
+    uint8_t hdr[8];
+    putU32(hdr, magic);
+    hdr[4] = (uint8_t)(sizeof(Record) & 0xFF); hdr[5] = (uint8_t)(sizeof(Record) >> 8);
+    hdr[6] = (uint8_t)(count & 0xFF); hdr[7] = (uint8_t)(count >> 8);
+    if (w.write(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+    // at most two contiguous spans
+    size_t start = (head + N - count) % N;
+    size_t first = count < N - start ? count : N - start;
+    size_t bytes = first * sizeof(Record);
+    if (first && w.write((const uint8_t *)&items[start], bytes) != bytes) return false;
+    bytes = (count - first) * sizeof(Record);
+    if (count > first && w.write((const uint8_t *)&items[0], bytes) != bytes) return false;
+    return true;
+  }
+
+  // Reader needs `size_t read(uint8_t *buf, size_t len)`. On a header
+  // mismatch the ring is left empty. Files longer than N keep the newest.
+  template <typename Reader>
+  bool load(Reader &r, uint32_t magic) {
+    clear();
+    uint8_t hdr[8];
+    if (r.read(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+    if (getU32(hdr) != magic) return false;
+    if ((size_t)(hdr[4] | hdr[5] << 8) != sizeof(Record)) return false;
+    size_t n = hdr[6] | hdr[7] << 8;
+    Record rec;
+    for (size_t i = 0; i < n; ++i) {
+      if (r.read((uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) return false;
+      push(rec);
+    }
+    return true;
+  }
+
+private:
+  static void putU32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+  }
+  static uint32_t getU32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  }
+
+  Record items[N];
+  size_t head;
+  size_t count;
+};
+
+#endif // TIME_SERIES_RING_H
@@ -0,0 +1,35 @@
+// Deadlines of the loop supervisor (src/watchdog.cpp), per subsystem. Most
+// return within milliseconds and get the base deadline. MQTT may block while
+// it opens the broker connection: the TCP connect and the TLS handshake run
+// inside its slot (the broker name is resolved beforehand without blocking,
+// src/mqtt.cpp), and so does the wait for CONNACK. Its deadline is the
+// longest of those plus the base deadline, so a dead WAN is a failed attempt
+// and not a watchdog trip. Hardware independent.
+#ifndef WATCHDOG_DEADLINES_H
+#define WATCHDOG_DEADLINES_H
+
+#include <stdint.h>
+#include "log_macros.h"
+
+// Blocking steps of one MQTT connect attempt (src/mqtt.cpp)
+static const uint32_t MQTT_TCP_CONNECT_MS = 1500;
+static const uint32_t MQTT_TLS_HANDSHAKE_S = 5;
+static const uint32_t MQTT_SOCKET_TIMEOUT_S = 2;
+// Longest one mqttLoop() call may block
+static const uint32_t MQTT_BLOCK_MAX_MS =
+    MQTT_TCP_CONNECT_MS + MQTT_TLS_HANDSHAKE_S * 1000UL > MQTT_SOCKET_TIMEOUT_S * 1000UL
+        ? MQTT_TCP_CONNECT_MS + MQTT_TLS_HANDSHAKE_S * 1000UL
+        : MQTT_SOCKET_TIMEOUT_S * 1000UL;
+
+inline uint32_t watchdogDeadlineOf(uint8_t module, uint32_t baseMs) {
+  return module == LOGM_MQTT ? baseMs + MQTT_BLOCK_MAX_MS : baseMs;
+}
+
+// Monitor: LivenessMonitor<LOGM_COUNT> (include/liveness_monitor.h)
+template <typename Monitor>
+void watchdogSetDeadlines(Monitor &m, uint32_t baseMs) {
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) m.setDeadline(i, watchdogDeadlineOf(i, baseMs));
+  m.setIdleDeadline(baseMs);
+}
+
+#endif // WATCHDOG_DEADLINES_H
@@ -0,0 +1,263 @@
+// Connection policy of the Wi-Fi manager (src/wifi_manager.cpp), kept apart
+// from the WiFi library. The caller reports what happened (scan results, link
+// up, link down) and calls tick() every loop; tick() answers with at most one
+// thing to do and never waits:
+//
+//   WIFI_ACT_SCAN      start a scan, report each network with scanResult(),
+//                      then scanDone()
+//   WIFI_ACT_CONNECT   connect to target(): the configured networks seen in
+//                      the last scan strongest first, then the ones not seen
+//                      (hidden SSIDs) in configuration order
+//   WIFI_ACT_START_AP  no link for fallbackAfterMs: open the local access point
+//   WIFI_ACT_STOP_AP   link is back: close it
+//
+// When every candidate of a round refused or timed out, the next scan waits
+// an exponential backoff with +-25% jitter. A dropped link is rescanned at
+// once. Hardware independent.
+#ifndef WIFI_PLANNER_H
+#define WIFI_PLANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum WifiAction : uint8_t {
+  WIFI_ACT_NONE = 0,
+  WIFI_ACT_SCAN,
+  WIFI_ACT_CONNECT,
+  WIFI_ACT_START_AP,
+  WIFI_ACT_STOP_AP,
+};
+
+enum WifiLinkState : uint8_t {
+  WIFI_IDLE = 0,     // before begin()
+  WIFI_SCANNING,
+  WIFI_CONNECTING,
+  WIFI_CONNECTED,
+  WIFI_BACKOFF,
+};
+
+struct WifiPlannerConfig {
+  uint32_t connectTimeoutMs;   // per attempt
+  uint32_t scanTimeoutMs;
+  uint32_t backoffMinMs;
+  uint32_t backoffMaxMs;
+  uint32_t fallbackAfterMs;    // 0 = no fallback access point
+};
+
+struct WifiStats {
+  uint32_t scans;
+  uint32_t attempts;
+  uint32_t failures;     // attempts refused or timed out
+  uint32_t connects;
+  uint32_t disconnects;  // links lost
+};
+
+template <uint8_t MaxAps>
+class WifiPlanner {
+public:
+  static const int NONE = -1;
+  static const uint8_t SSID_LEN = 32;
+
+  explicit WifiPlanner(const WifiPlannerConfig &c)
+    : cfg(c), count(0), st(WIFI_IDLE), issued(false), apOn(false), since(0), offlineSince(0),
+      linkSince(0), linkTotalMs(0), backoffMs(c.backoffMinMs), retryDelayMs(0),
+      orderLen(0), orderPos(0), current(NONE), rng(0x9E3779B9UL), counters() {}
+
+  // Index of the network, NONE if full or the SSID is empty or too long
+  int addAp(const char *ssid) {
+    size_t n = ssid ? strlen(ssid) : 0;
+    if (count >= MaxAps || n == 0 || n > SSID_LEN) return NONE;
+    memcpy(name[count], ssid, n + 1);
+    seen[count] = false;
+    best[count] = 0;
+    return count++;
+  }
+  void clearAps() {
+    count = 0;
+    orderLen = 0;
+    current = NONE;
+  }
+  uint8_t aps() const { return count; }
+  const char *ssid(uint8_t i) const { return i < count ? name[i] : ""; }
+  // Strongest sighting in the last scan
+  bool seenInScan(uint8_t i) const { return i < count && seen[i]; }
+  int rssiInScan(uint8_t i) const { return i < count ? best[i] : 0; }
+
+  // Different seeds keep a fleet from retrying in lockstep
+  void seed(uint32_t s) { rng = s ? s : 1; }
+
+  void begin(uint32_t now) {
+    st = WIFI_SCANNING;
+    issued = false;
+    offlineSince = now;
+  }
+
+  // ---- events ----
+  // Index of the matching network if this is its strongest sighting so far
+  // (the caller keeps that BSSID/channel), NONE otherwise
+  int scanResult(const char *ssid, int rssi) {
+    for (uint8_t i = 0; i < count; ++i) {
+      if (strcmp(ssid, name[i]) != 0) continue;
+      if (seen[i] && rssi <= best[i]) return NONE;
+      seen[i] = true;
+      best[i] = (int16_t)rssi;
+      return i;
+    }
+    return NONE;
+  }
+
+  void scanDone(uint32_t now) {
+    if (st != WIFI_SCANNING) return;
+    orderLen = 0;
+    // seen networks by RSSI, strongest first (insertion sort, MaxAps is tiny)
+    for (uint8_t i = 0; i < count; ++i) {
+      if (!seen[i]) continue;
+      uint8_t j = orderLen++;
+      while (j > 0 && best[order[j - 1]] < best[i]) {
+        order[j] = order[j - 1];
+        --j;
+      }
+      order[j] = i;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+      if (!seen[i]) order[orderLen++] = i;
+    }
+    orderPos = 0;
+    if (!orderLen) {
+      roundFailed(now);
+      return;
+    }
+    st = WIFI_CONNECTING;
+    issued = false;
+  }
+
+  void linkUp(uint32_t now) {
+    if (st == WIFI_CONNECTED) return;
+    st = WIFI_CONNECTED;
+    linkSince = now;
+    backoffMs = cfg.backoffMinMs;
+    counters.connects++;
+  }
+
+  void linkDown(uint32_t now) {
+    if (st == WIFI_CONNECTED) {
+      linkTotalMs += now - linkSince;
+      counters.disconnects++;
+      offlineSince = now;
+      st = WIFI_SCANNING;
+      issued = false;
+    } else if (st == WIFI_CONNECTING && issued) {
+      attemptFailed(now);
+    }
+  }
+
+  // ---- every loop ----
+  WifiAction tick(uint32_t now) {
+    if (st == WIFI_IDLE) return WIFI_ACT_NONE;
+    if (apOn && st == WIFI_CONNECTED) {
+      apOn = false;
+      return WIFI_ACT_STOP_AP;
+    }
+    if (!apOn && cfg.fallbackAfterMs && st != WIFI_CONNECTED && now - offlineSince >= cfg.fallbackAfterMs) {
+      apOn = true;
+      return WIFI_ACT_START_AP;
+    }
+    if (!count) return WIFI_ACT_NONE;
+    switch (st) {
+      case WIFI_BACKOFF:
+        if (now - since < retryDelayMs) return WIFI_ACT_NONE;
+        st = WIFI_SCANNING;
+        issued = false;
+        // fall through
+      case WIFI_SCANNING:
+        if (!issued) {
+          issued = true;
+          since = now;
+          counters.scans++;
+          for (uint8_t i = 0; i < count; ++i) seen[i] = false;
+          return WIFI_ACT_SCAN;
+        }
+        // a scan that never completes: try the list as configured
+        if (now - since >= cfg.scanTimeoutMs) scanDone(now);
+        return WIFI_ACT_NONE;
+      case WIFI_CONNECTING:
+        if (!issued) {
+          issued = true;
+          since = now;
+          current = order[orderPos];
+          counters.attempts++;
+          return WIFI_ACT_CONNECT;
+        }
+        if (now - since >= cfg.connectTimeoutMs) attemptFailed(now);
+        return WIFI_ACT_NONE;
+      default:
+        return WIFI_ACT_NONE;
+    }
+  }
+
+  // Network of the last WIFI_ACT_CONNECT (the current link once up)
+  int target() const { return current; }
+  WifiLinkState state() const { return st; }
+  bool apActive() const { return apOn; }
+  // Until the next scan while backing off, 0 otherwise
+  uint32_t retryInMs(uint32_t now) const {
+    if (st != WIFI_BACKOFF) return 0;
+    uint32_t gone = now - since;
+    return gone < retryDelayMs ? retryDelayMs - gone : 0;
+  }
+  // Current link's age, 0 when down
+  uint32_t linkUpMs(uint32_t now) const { return st == WIFI_CONNECTED ? now - linkSince : 0; }
+  // All links since begin(), the current one included
+  uint64_t connectedMs(uint32_t now) const { return linkTotalMs + linkUpMs(now); }
+  const WifiStats &stats() const { return counters; }
+
+private:
+  void attemptFailed(uint32_t now) {
+    counters.failures++;
+    if (++orderPos < orderLen) {
+      issued = false;
+      return;
+    }
+    roundFailed(now);
+  }
+
+  void roundFailed(uint32_t now) {
+    uint32_t jitter = backoffMs / 4;
+    retryDelayMs = backoffMs - jitter + nextRandom() % (2 * jitter + 1);
+    backoffMs = backoffMs > cfg.backoffMaxMs / 2 ? cfg.backoffMaxMs : backoffMs * 2;
+    st = WIFI_BACKOFF;
+    since = now;
+  }
+
+  uint32_t nextRandom() {
+    // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  }
+
+  WifiPlannerConfig cfg;
+  char name[MaxAps][SSID_LEN + 1];
+  bool seen[MaxAps];
+  int16_t best[MaxAps];
+  uint8_t count;
+  WifiLinkState st;
+  bool issued;           // this state's action was handed out
+  bool apOn;
+  uint32_t since;        // entered the current scan/attempt/backoff
+  uint32_t offlineSince;
+  uint32_t linkSince;
+  uint64_t linkTotalMs;
+  uint32_t backoffMs;
+  uint32_t retryDelayMs;
+  uint8_t order[MaxAps];
+  uint8_t orderLen;
+  uint8_t orderPos;
+  int current;
+  uint32_t rng;
+  WifiStats counters;
+};
+
+#endif // WIFI_PLANNER_H
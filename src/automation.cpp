@@ -2,29 +2,77 @@
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
 #include <vector>
-#include <time.h>
 #include "relays.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "irrigation_engine.h"
+#include "rule_engine.h"
+#include "sensor.h"
+#include "pins.h"
+#include "time_series_ring.h"
+#include "time_service.h"
 
 static const char* AUTO_FILE = "/automation.json";
+static const char* DLI_FILE = "/dli.json";
 
 static unsigned long dailyLightMinSec = 12UL * 3600UL;
 static unsigned long dailyLightAccumSec = 0;
 static int lastDayOfYear = -1;
+static int lastYear = 0;
 
-// history of past days: vector of pair(year, yday) -> accum seconds
-static std::vector<unsigned long> lightHistoryAccum;
-static std::vector<int> lightHistoryYear;
-static std::vector<int> lightHistoryYday;
+// Today's lights-on time is derived from relay edge timestamps
+// (getLightsOnTotalMs) so it doesn't depend on how often automationTick runs.
+static uint64_t dayStartLightsMs = 0;  // getLightsOnTotalMs() when the day began (or at boot)
+static uint64_t dayCarryLightsMs = 0;  // lights-on ms restored from the checkpoint
+// Daily light integral: measured with LIGHT_SENSOR_PIN, else lampPpfd x on-time
+static float lampPpfd = 200.0f;        // umol/m2/s at canopy with lamps on
+static float ppfdPerCount = 1.0f;      // light sensor calibration, umol/m2/s per ADC count
+static double dayDliUmol = 0;          // sensor integral for today (umol/m2)
+static float lastDayDliMol = 0;
+static unsigned long lastLightSample = 0;
+// checkpoint survives reboot; applied once the date is known
+static const unsigned long CHECKPOINT_INTERVAL_MS = 5UL * 60UL * 1000UL;
+static unsigned long lastCheckpoint = 0;
+static int ckYear = -1;
+static int ckYday = -1;
+static unsigned long ckLightMs = 0;
+static double ckDliUmol = 0;
+
+// history of past days (~120 days) of lights-on seconds, kept in its own file
+static const char* LIGHT_HISTORY_FILE = "/light_history.bin";
+static const uint32_t LIGHT_HISTORY_MAGIC = 0x4C484931; // "LHI1"
+static TimeSeriesRing<DaySeconds, 120> lightHistory;
 
 // irrigation
 static uint8_t irrigationCount = 3;
 static uint16_t irrigationDurationSec = 60; // default 60s
 static uint8_t irrigationStartHour = 6; // default first at 06:00
 static std::vector<int> irrigationTimes; // minutes since midnight
-static std::vector<unsigned long> irrigationPendingOff; // millis timestamps for pending offs
-static std::vector<int> triggeredDay; // track last day triggered per event
+static std::vector<int32_t> triggeredDay; // track last local day triggered per event
+// Today's irrigation times as epoch minutes, planned once per local day like
+// the scheduler's (DST: a skipped time runs at the change, a repeated one once)
+static std::vector<int64_t> irrigationPlan;
+static int32_t irrigationPlanDay = INT32_MIN;
+// Epoch minute checked last for irrigation times; -1: start at the next
+// check. A stalled loop or a small forward clock step runs what it skipped.
+static int64_t lastIrrigationMinute = -1;
+static const int64_t IRRIGATION_CATCH_UP_MIN = 60;
 static bool irrigationExplicitTimes = false;
 
+// irrigation zones (valves) and pump capacity; each trigger queues every zone
+static const size_t MAX_IRRIGATION_ZONES = 6;
+static IrrigationEngine<MAX_IRRIGATION_ZONES, 16> irrigation;
+static IrrigationEngine<MAX_IRRIGATION_ZONES, 16>::Zone irrigationZones[MAX_IRRIGATION_ZONES] = { {3, 0} };
+static uint8_t irrigationZoneCount = 1; // default: single valve on CH3
+static uint8_t irrigationMaxConcurrent = 1;
+
+// sensor/time rules, compiled from rulesText at load time
+static RuleSet<8, 24> rules;
+static String rulesText;
+static unsigned long lastRulesEval = 0;
+// DHT22 can't be sampled faster than every 2 s
+static const unsigned long RULES_EVAL_INTERVAL_MS = 2000UL;
+
 static unsigned long lastTick = 0;
 
 static void computeIrrigationTimes() {
@@ -41,19 +89,80 @@ static void computeIrrigationTimes() {
     }
   }
   triggeredDay.assign(irrigationTimes.size(), -1);
-  irrigationPendingOff.assign(irrigationTimes.size(), 0);
+  irrigationPlanDay = INT32_MIN;
+}
+
+static void rulesActuate(uint8_t ch, bool on) {
+  setRelay(ch, on, RELAY_SRC_RULES, RELAY_REASON_RULE);
+}
+
+static void irrigationActuate(uint8_t ch, bool on) {
+  setRelay(ch, on, RELAY_SRC_AUTOMATION, RELAY_REASON_IRRIGATION);
+}
+
+// Push zone table into the engine; zones with duration 0 use irrigationDurationSec
+static uint16_t zoneDurationSec(uint8_t i) {
+  return irrigationZones[i].durationSec ? irrigationZones[i].durationSec : irrigationDurationSec;
+}
+
+// A new zone table: valves of the old one are closed first
+static void applyIrrigationZones() {
+  IrrigationEngine<MAX_IRRIGATION_ZONES, 16>::Zone z[MAX_IRRIGATION_ZONES];
+  for (uint8_t i = 0; i < irrigationZoneCount; ++i) {
+    z[i].channel = irrigationZones[i].channel;
+    z[i].durationSec = zoneDurationSec(i);
+  }
+  irrigation.cancelAll(irrigationActuate);
+  irrigation.setZones(z, irrigationZoneCount);
+  irrigation.setMaxConcurrent(irrigationMaxConcurrent);
+}
+
+// Same zones, new default run time: runs in progress carry on
+static void applyIrrigationDuration() {
+  for (uint8_t i = 0; i < irrigationZoneCount; ++i) irrigation.setZoneDuration(i, zoneDurationSec(i));
+}
+
+static void loadLightHistory() {
+  if (!SPIFFS.exists(LIGHT_HISTORY_FILE)) return;
+  File f = SPIFFS.open(LIGHT_HISTORY_FILE, "r");
+  if (!f) return;
+  if (!lightHistory.load(f, LIGHT_HISTORY_MAGIC)) LOG_W(LOGM_AUTOMATION, "Light history file invalid, ignored");
+  f.close();
+}
+
+static void saveLightHistory() {
+  File f = SPIFFS.open(LIGHT_HISTORY_FILE, "w");
+  if (!f) return;
+  lightHistory.save(f, LIGHT_HISTORY_MAGIC);
+  f.close();
+}
+
+// "history": [{year, yday, accumHours}, ...], oldest first
+static void writeHistory(StructWriter &w) {
+  w.key("history");
+  w.beginArray();
+  for (size_t i = 0; i < lightHistory.size(); ++i) {
+    const DaySeconds &h = lightHistory.at(i);
+    w.beginMap();
+    w.intField("year", h.year());
+    w.intField("yday", h.yday());
+    w.floatField("accumHours", (float)h.seconds() / 3600.0f);
+    w.endMap();
+  }
+  w.endArray();
 }
 
 static void loadAutomation() {
   if (!SPIFFS.exists(AUTO_FILE)) return;
   File f = SPIFFS.open(AUTO_FILE, "r");
   if (!f) return;
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(1024);
   DeserializationError err = deserializeJson(doc, f);
   f.close();
   if (err) return;
   dailyLightMinSec = doc["dailyLightMinSec"] | dailyLightMinSec;
-  dailyLightAccumSec = doc["dailyLightAccumSec"] | 0;
+  lampPpfd = doc["lampPpfd"] | lampPpfd;
+  ppfdPerCount = doc["ppfdPerCount"] | ppfdPerCount;
   irrigationCount = doc["irrigationCount"] | irrigationCount;
   irrigationDurationSec = doc["irrigationDurationSec"] | irrigationDurationSec;
   irrigationStartHour = doc["irrigationStartHour"] | irrigationStartHour;
@@ -66,24 +175,45 @@ static void loadAutomation() {
     irrigationExplicitTimes = irrigationTimes.size() > 0;
     irrigationCount = irrigationExplicitTimes ? (uint8_t)irrigationTimes.size() : irrigationCount;
   }
-  // history
-  if (doc.containsKey("history")) {
-    lightHistoryAccum.clear(); lightHistoryYear.clear(); lightHistoryYday.clear();
+  // irrigation zones [{ch,dur}] and pump capacity
+  if (doc.containsKey("irrigationZones")) {
+    uint8_t n = 0;
+    for (JsonVariant z : doc["irrigationZones"].as<JsonArray>()) {
+      if (n >= MAX_IRRIGATION_ZONES) break;
+      uint8_t ch = z["ch"] | 0;
+      if (ch < 1 || ch > 6) continue;
+      irrigationZones[n].channel = ch;
+      irrigationZones[n].durationSec = z["dur"] | 0;
+      n++;
+    }
+    if (n > 0) irrigationZoneCount = n;
+  }
+  irrigationMaxConcurrent = doc["irrigationMaxConcurrent"] | irrigationMaxConcurrent;
+  // rules
+  if (doc.containsKey("rules")) {
+    rulesText = doc["rules"].as<String>();
+    char err[48];
+    if (!rules.compile(rulesText.c_str(), err, sizeof(err))) {
+      LOG_W(LOGM_AUTOMATION, "Automation rules not loaded: %s", err);
+    }
+  }
+  // legacy history stored inside automation.json: migrate to its own file
+  if (doc.containsKey("history") && lightHistory.empty()) {
     for (JsonVariant h : doc["history"].as<JsonArray>()) {
       int y = h["year"] | 0;
       int d = h["yday"] | 0;
       unsigned long a = h["accumSec"] | 0UL;
-      lightHistoryYear.push_back(y);
-      lightHistoryYday.push_back(d);
-      lightHistoryAccum.push_back(a);
+      lightHistory.push(DaySeconds::make(y, d, a));
     }
+    saveLightHistory();
   }
 }
 
 static void saveAutomation() {
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(1024);
   doc["dailyLightMinSec"] = dailyLightMinSec;
-  doc["dailyLightAccumSec"] = dailyLightAccumSec;
+  doc["lampPpfd"] = lampPpfd;
+  doc["ppfdPerCount"] = ppfdPerCount;
   doc["irrigationCount"] = irrigationCount;
   doc["irrigationDurationSec"] = irrigationDurationSec;
   doc["irrigationStartHour"] = irrigationStartHour;
@@ -91,53 +221,149 @@ static void saveAutomation() {
     JsonArray arr = doc.createNestedArray("irrigationTimes");
     for (int t : irrigationTimes) arr.add(t);
   }
-  // save history
-  if (lightHistoryAccum.size() > 0) {
-    JsonArray harr = doc.createNestedArray("history");
-    for (size_t i = 0; i < lightHistoryAccum.size(); ++i) {
-      JsonObject it = harr.createNestedObject();
-      it["year"] = lightHistoryYear[i];
-      it["yday"] = lightHistoryYday[i];
-      it["accumSec"] = lightHistoryAccum[i];
-    }
+  JsonArray zarr = doc.createNestedArray("irrigationZones");
+  for (uint8_t i = 0; i < irrigationZoneCount; ++i) {
+    JsonObject z = zarr.createNestedObject();
+    z["ch"] = irrigationZones[i].channel;
+    z["dur"] = irrigationZones[i].durationSec;
   }
+  doc["irrigationMaxConcurrent"] = irrigationMaxConcurrent;
+  if (rulesText.length() > 0) doc["rules"] = rulesText;
   File f = SPIFFS.open(AUTO_FILE, "w");
   if (!f) return;
   serializeJson(doc, f);
   f.close();
 }
 
-void automationBegin() {
-  if (!SPIFFS.begin(true)) {
-    Serial.println("SPIFFS mount failed (automation)");
+static uint64_t dayLightsMs() {
+  return dayCarryLightsMs + (getLightsOnTotalMs() - dayStartLightsMs);
+}
+
+// Today's DLI in mol/m2
+static float dayDliMol() {
+#if LIGHT_SENSOR_PIN >= 0
+  return (float)(dayDliUmol / 1e6);
+#else
+  return (float)((double)lampPpfd * (double)dayLightsMs() / 1000.0 / 1e6);
+#endif
+}
+
+// Integrate the light sensor once per second using the exact sample interval
+static void sampleLightSensor(unsigned long now) {
+#if LIGHT_SENSOR_PIN >= 0
+  unsigned long dt = now - lastLightSample;
+  if (dt < 1000UL) return;
+  lastLightSample = now;
+  float ppfd = (float)analogRead(LIGHT_SENSOR_PIN) * ppfdPerCount;
+  dayDliUmol += (double)ppfd * (double)dt / 1000.0;
+#else
+  (void)now;
+#endif
+}
+
+static void loadDliCheckpoint() {
+  if (!SPIFFS.exists(DLI_FILE)) return;
+  File f = SPIFFS.open(DLI_FILE, "r");
+  if (!f) return;
+  DynamicJsonDocument doc(128);
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  if (err) return;
+  ckYear = doc["year"] | -1;
+  ckYday = doc["yday"] | -1;
+  ckLightMs = doc["lightMs"] | 0UL;
+  ckDliUmol = doc["dliUmol"] | 0.0;
+}
+
+static void saveDliCheckpoint() {
+  if (lastDayOfYear < 0) return; // date unknown, nothing to anchor to
+  DynamicJsonDocument doc(128);
+  doc["year"] = lastYear;
+  doc["yday"] = lastDayOfYear;
+  doc["lightMs"] = (unsigned long)dayLightsMs();
+  doc["dliUmol"] = dayDliUmol;
+  File f = SPIFFS.open(DLI_FILE, "w");
+  if (!f) return;
+  serializeJson(doc, f);
+  f.close();
+}
+
+// Clock set or stepped past the catch-up window: irrigation times start
+// again from the current minute (a step back never repeats a run, each
+// time fires once per day). A new zone replans the day.
+static void onClockEvent(ClockEvent ev, int64_t jumpMs) {
+  if (ev == CLOCK_EV_ZONE) {
+    irrigationPlanDay = INT32_MIN;
+  } else if (ev == CLOCK_EV_SET || jumpMs > IRRIGATION_CATCH_UP_MIN * 60000LL || jumpMs < -IRRIGATION_CATCH_UP_MIN * 60000LL) {
+    lastIrrigationMinute = -1;
   }
+}
+
+void automationBegin() {
+  loadLightHistory();
   loadAutomation();
   computeIrrigationTimes();
+  applyIrrigationZones();
+  loadDliCheckpoint();
+  timeOnEvent(onClockEvent);
   lastTick = millis();
-  // determine current day
-  struct tm tm;
-  if (getLocalTime(&tm)) lastDayOfYear = tm.tm_yday;
+  lastLightSample = lastTick;
+  lastCheckpoint = lastTick;
+  dayStartLightsMs = getLightsOnTotalMs();
+}
+
+float getDailyLightHours() {
+  return (float)dayLightsMs() / 3600000.0f;
+}
+
+float getDailyLightIntegral() {
+  return dayDliMol();
+}
+
+float getPpfdPerCount() {
+  return ppfdPerCount;
 }
 
 String automationJson() {
-  DynamicJsonDocument doc(512);
-  doc["dailyLightMinHours"] = (float)dailyLightMinSec / 3600.0f;
-  doc["dailyLightAccumHours"] = (float)dailyLightAccumSec / 3600.0f;
-  doc["irrigationCount"] = irrigationCount;
-  doc["irrigationDurationSec"] = irrigationDurationSec;
-  doc["irrigationStartHour"] = irrigationStartHour;
-  JsonArray arr = doc.createNestedArray("irrigationTimes");
-  for (int t : irrigationTimes) arr.add(t);
-  // include history
-  JsonArray harr = doc.createNestedArray("history");
-  for (size_t i = 0; i < lightHistoryAccum.size(); ++i) {
-    JsonObject it = harr.createNestedObject();
-    it["year"] = lightHistoryYear[i];
-    it["yday"] = lightHistoryYday[i];
-    it["accumHours"] = (float)lightHistoryAccum[i] / 3600.0f;
+  return structToJson<String>(automationWrite);
+}
+
+void automationWrite(StructWriter &w) {
+  w.beginMap();
+  w.floatField("dailyLightMinHours", (float)dailyLightMinSec / 3600.0f);
+  w.floatField("dailyLightAccumHours", (float)dayLightsMs() / 3600000.0f);
+  w.floatField("dli", dayDliMol());
+  w.floatField("dliYesterday", lastDayDliMol);
+  w.strField("dliSource", LIGHT_SENSOR_PIN >= 0 ? "sensor" : "lamp");
+  w.floatField("lampPpfd", lampPpfd);
+  w.intField("irrigationCount", irrigationCount);
+  w.intField("irrigationDurationSec", irrigationDurationSec);
+  w.intField("irrigationStartHour", irrigationStartHour);
+  w.key("irrigationTimes");
+  w.beginArray();
+  for (int t : irrigationTimes) w.intValue(t);
+  w.endArray();
+  w.intField("irrigationMaxConcurrent", irrigationMaxConcurrent);
+  w.intField("irrigationQueued", irrigation.queuedCount());
+  w.key("irrigationZones");
+  w.beginArray();
+  unsigned long nowMs = millis();
+  for (uint8_t i = 0; i < irrigation.getZoneCount(); ++i) {
+    w.beginMap();
+    w.intField("ch", irrigation.zone(i).channel);
+    w.intField("dur", irrigation.zone(i).durationSec);
+    w.boolField("running", irrigation.isRunning(i));
+    w.intField("remainingSec", irrigation.remainingSec(i, nowMs));
+    w.endMap();
   }
-  String out; serializeJson(doc, out);
-  return out;
+  w.endArray();
+  w.strField("rules", rulesText.c_str(), rulesText.length());
+  w.key("rulesActive");
+  w.beginArray();
+  for (size_t i = 0; i < rules.size(); ++i) w.boolValue(rules.isActive(i));
+  w.endArray();
+  writeHistory(w);
+  w.endMap();
 }
 
 bool setDailyLightMinHours(float hours) {
@@ -147,6 +373,14 @@ bool setDailyLightMinHours(float hours) {
   return true;
 }
 
+bool setLightIntegralConfig(float lamp, float perCount) {
+  if (lamp < 0 || perCount <= 0) return false;
+  lampPpfd = lamp;
+  ppfdPerCount = perCount;
+  saveAutomation();
+  return true;
+}
+
 bool setIrrigationConfig(uint8_t countPerDay, uint16_t durationSec, uint8_t startHour) {
   if (countPerDay > 24 || durationSec == 0) return false;
   irrigationCount = countPerDay;
@@ -155,6 +389,7 @@ bool setIrrigationConfig(uint8_t countPerDay, uint16_t durationSec, uint8_t star
   irrigationExplicitTimes = false;
   irrigationTimes.clear();
   computeIrrigationTimes();
+  applyIrrigationDuration();
   saveAutomation();
   return true;
 }
@@ -187,27 +422,105 @@ bool setIrrigationTimesCSV(const String &timesCsv, uint16_t durationSec) {
   irrigationCount = (uint8_t)irrigationTimes.size();
   irrigationExplicitTimes = true;
   triggeredDay.assign(irrigationTimes.size(), -1);
-  irrigationPendingOff.assign(irrigationTimes.size(), 0);
+  irrigationPlanDay = INT32_MIN;
+  applyIrrigationDuration();
   saveAutomation();
   return true;
 }
 
-String automationHistoryJson() {
-  DynamicJsonDocument doc(512);
-  JsonArray harr = doc.createNestedArray("history");
-  for (size_t i = 0; i < lightHistoryAccum.size(); ++i) {
-    JsonObject it = harr.createNestedObject();
-    it["year"] = lightHistoryYear[i];
-    it["yday"] = lightHistoryYday[i];
-    it["accumHours"] = (float)lightHistoryAccum[i] / 3600.0f;
+bool setIrrigationZonesCSV(const String &zonesCsv, uint8_t maxConcurrent) {
+  // parse CSV of CH or CH:SECONDS (e.g. "3:60,4:120,5")
+  IrrigationEngine<MAX_IRRIGATION_ZONES, 16>::Zone parsed[MAX_IRRIGATION_ZONES];
+  uint8_t n = 0;
+  int p = 0;
+  while (p < (int)zonesCsv.length()) {
+    int comma = zonesCsv.indexOf(',', p);
+    if (comma == -1) comma = zonesCsv.length();
+    String token = zonesCsv.substring(p, comma);
+    token.trim();
+    if (token.length() > 0) {
+      if (n >= MAX_IRRIGATION_ZONES) return false;
+      int colon = token.indexOf(':');
+      int ch = (colon > 0 ? token.substring(0, colon) : token).toInt();
+      int dur = colon > 0 ? token.substring(colon + 1).toInt() : 0;
+      if (ch < 1 || ch > 6 || dur < 0 || dur > 65535) return false;
+      parsed[n].channel = (uint8_t)ch;
+      parsed[n].durationSec = (uint16_t)dur;
+      n++;
+    }
+    p = comma + 1;
+  }
+  if (n == 0 || maxConcurrent == 0) return false;
+  for (uint8_t i = 0; i < n; ++i) irrigationZones[i] = parsed[i];
+  irrigationZoneCount = n;
+  irrigationMaxConcurrent = maxConcurrent;
+  applyIrrigationZones();
+  saveAutomation();
+  return true;
+}
+
+bool setAutomationRules(const String &text, String &err) {
+  char buf[48];
+  if (!rules.compile(text.c_str(), buf, sizeof(buf))) {
+    err = buf;
+    return false;
   }
-  String out; serializeJson(doc, out);
-  return out;
+  rulesText = text;
+  saveAutomation();
+  return true;
+}
+
+// Feed current sensor values and local time into the rule engine
+static void evaluateRules(unsigned long now) {
+  if (now - lastRulesEval < RULES_EVAL_INTERVAL_MS) return;
+  lastRulesEval = now;
+  float in[RULE_VAR_COUNT] = { NAN, NAN, NAN, NAN, NAN };
+  // with no rules only release channels a previous rule set left on
+  if (rules.size() > 0) {
+    in[RULE_VAR_TIN] = readTemperatureC(false);
+    in[RULE_VAR_HIN] = readHumidity(false);
+    in[RULE_VAR_TOUT] = readTemperatureC(true);
+    in[RULE_VAR_HOUT] = readHumidity(true);
+  }
+  // time conditions are false until the clock is set (don't block on NTP)
+  struct tm lt;
+  if (timeLocal(lt)) in[RULE_VAR_MINUTE] = (float)(lt.tm_hour * 60 + lt.tm_min);
+  rules.evaluate(in, now, rulesActuate);
+}
+
+void automationHistoryWrite(StructWriter &w) {
+  w.beginMap();
+  writeHistory(w);
+  w.endMap();
+}
+
+String automationHistoryJson() {
+  return structToJson<String>(automationHistoryWrite);
 }
 
 // helper: minutes since midnight
-static int getMinutesSinceMidnight(struct tm &tm) {
-  return tm.tm_hour * 60 + tm.tm_min;
+static void planIrrigation(int32_t day) {
+  LocalDay d = tzLocalDay(timeZone(), day);
+  irrigationPlan.assign(irrigationTimes.size(), INT64_MIN);
+  for (size_t i = 0; i < irrigationTimes.size(); ++i) {
+    int t = irrigationTimes[i];
+    if (t >= 0 && t < 24 * 60) irrigationPlan[i] = d.toUtc((uint16_t)t) / 60;
+  }
+  irrigationPlanDay = day;
+}
+
+// Irrigation times of the planned day due in [from, to]
+static void runIrrigationDue(int64_t from, int64_t to) {
+  for (size_t i = 0; i < irrigationPlan.size() && i < triggeredDay.size(); ++i) {
+    if (triggeredDay[i] == irrigationPlanDay) continue; // already triggered today
+    if (irrigationPlan[i] >= from && irrigationPlan[i] <= to) {
+      // trigger irrigation: queue a run of every zone, the engine sequences them
+      size_t queued = irrigation.enqueueAll();
+      LOG_I(LOGM_AUTOMATION, "Trigger irrigation %d at %02d:%02d: %u zone runs queued", (int)i,
+            irrigationTimes[i] / 60, irrigationTimes[i] % 60, (unsigned)queued);
+      triggeredDay[i] = irrigationPlanDay;
+    }
+  }
 }
 
 void automationTick() {
@@ -216,76 +529,69 @@ void automationTick() {
   if (delta == 0) return;
   lastTick = now;
 
-  // Update daily lights accumulation
-  bool lightsOn = getLights();
-  if (lightsOn) {
-    // add elapsed seconds
-    dailyLightAccumSec += delta / 1000UL;
+  // stop finished valve runs and start queued ones (independent of wall clock)
+  irrigation.tick(now, irrigationActuate);
+  evaluateRules(now);
+
+  sampleLightSensor(now);
+  dailyLightAccumSec = (unsigned long)(dayLightsMs() / 1000ULL);
+  if (now - lastCheckpoint >= CHECKPOINT_INTERVAL_MS) {
+    lastCheckpoint = now;
+    saveDliCheckpoint();
   }
 
   // Check irrigation triggers
   struct tm tm;
-  if (!getLocalTime(&tm)) return; // need time for scheduling
+  if (!timeLocal(tm)) return; // need time for scheduling
   int day = tm.tm_yday;
+  int year = tm.tm_year + 1900;
   if (day != lastDayOfYear) {
-    // day rollover: push yesterday's accumulation into history
-    if (lastDayOfYear >= 0) {
-      time_t nowEpoch = time(nullptr);
-      struct tm prevTm;
-      // we can store lastDayOfYear with current year approximation
-      int yy = 0;
-      if (getLocalTime(&prevTm)) yy = prevTm.tm_year + 1900;
-      lightHistoryYear.push_back(yy);
-      lightHistoryYday.push_back(lastDayOfYear);
-      lightHistoryAccum.push_back(dailyLightAccumSec);
-      // trim to last 120 entries (retain ~120 days)
-      while (lightHistoryAccum.size() > 120) {
-        lightHistoryAccum.erase(lightHistoryAccum.begin());
-        lightHistoryYear.erase(lightHistoryYear.begin());
-        lightHistoryYday.erase(lightHistoryYday.begin());
+    if (lastDayOfYear < 0) {
+      // first time the date is known since boot: resume today's checkpoint
+      if (ckYear == year && ckYday == day) {
+        dayCarryLightsMs = ckLightMs;
+        dayDliUmol += ckDliUmol;
       }
-      saveAutomation();
-    }
-    // day rollover: check lights requirement
-    if (dailyLightAccumSec < dailyLightMinSec) {
-      unsigned long remaining = dailyLightMinSec - dailyLightAccumSec;
-      Serial.printf("Daily lights short by %lu seconds, enforcing now\n", remaining);
-      // ensure lights on and schedule off after remaining seconds
-      setLights(true);
-      scheduleLightsOffAfterSec(remaining);
-      // also set relays min duration to remaining to avoid early off
-      setLightsMinDurationSec(remaining);
+    } else {
+      // day rollover: push yesterday's accumulation into history, tagged
+      // with yesterday's own year so New Year's Eve isn't filed under the new year
+      lightHistory.push(DaySeconds::make(lastYear, lastDayOfYear, dailyLightAccumSec));
+      saveLightHistory();
+      lastDayDliMol = dayDliMol();
+      // day rollover: check lights requirement
+      if (dailyLightAccumSec < dailyLightMinSec) {
+        unsigned long remaining = dailyLightMinSec - dailyLightAccumSec;
+        LOG_I(LOGM_AUTOMATION, "Daily lights short by %lu seconds, enforcing now", remaining);
+        // ensure lights on and schedule off after remaining seconds
+        setLights(true, RELAY_SRC_AUTOMATION, RELAY_REASON_DAILY_LIGHT);
+        scheduleLightsOffAfterSec(remaining);
+        // also set relays min duration to remaining to avoid early off
+        setLightsMinDurationSec(remaining);
+      }
+      // reset accumulators for new day
+      dayStartLightsMs = getLightsOnTotalMs();
+      dayCarryLightsMs = 0;
+      dayDliUmol = 0;
+      dailyLightAccumSec = 0;
     }
-    // reset accumulator for new day
-    dailyLightAccumSec = 0;
     lastDayOfYear = day;
-    // reset irrigation triggered markers
-    for (size_t i = 0; i < triggeredDay.size(); ++i) triggeredDay[i] = -1;
+    lastYear = year;
+    saveDliCheckpoint();
   }
 
-  // check irrigation times
-  int nowMin = getMinutesSinceMidnight(tm);
-  for (size_t i = 0; i < irrigationTimes.size(); ++i) {
-    int t = irrigationTimes[i];
-    if (triggeredDay.size() <= i) continue; // safety
-    if (triggeredDay[i] == tm.tm_yday) continue; // already triggered today
-    if (t == nowMin) {
-      // trigger irrigation: turn on CH3 and schedule off
-      Serial.printf("Trigger irrigation %d at %02d:%02d for %d sec\n", (int)i, tm.tm_hour, tm.tm_min, irrigationDurationSec);
-      setRelay(3, true);
-      irrigationPendingOff[i] = millis() + (unsigned long)irrigationDurationSec * 1000UL;
-      triggeredDay[i] = tm.tm_yday;
-    }
-  }
-
-  // handle irrigation pending offs
-  for (size_t i = 0; i < irrigationPendingOff.size(); ++i) {
-    unsigned long offAt = irrigationPendingOff[i];
-    if (offAt == 0) continue;
-    if ((long)(millis() - offAt) >= 0) {
-      // turn off irrigation channel
-      setRelay(3, false);
-      irrigationPendingOff[i] = 0;
-    }
+  // check irrigation times due since the last check
+  time_t t = timeNow();
+  int64_t nowMin = t / 60;
+  if (nowMin == lastIrrigationMinute) return;
+  bool catchUp = lastIrrigationMinute >= 0 && nowMin > lastIrrigationMinute &&
+                 nowMin - lastIrrigationMinute <= IRRIGATION_CATCH_UP_MIN;
+  int64_t fromMin = catchUp ? lastIrrigationMinute + 1 : nowMin;
+  lastIrrigationMinute = nowMin;
+  int32_t localDay = tzLocalDayOf(timeZone(), t);
+  if (localDay != irrigationPlanDay) {
+    // a catch-up across midnight finishes the day before first
+    if (irrigationPlanDay != INT32_MIN) runIrrigationDue(fromMin, nowMin);
+    planIrrigation(localDay);
   }
+  runIrrigationDue(fromMin, nowMin);
 }
\ No newline at end of file
@@ -2,16 +2,34 @@
 #define AUTOMATION_H
 
 #include <Arduino.h>
+#include "struct_writer.h"
 
 void automationBegin();
 void automationTick();
 String automationJson();
+void automationWrite(StructWriter &w);
 bool setDailyLightMinHours(float hours);
+// Daily light integral: lamp PPFD (umol/m2/s) used when no light sensor is
+// fitted, and the sensor calibration (umol/m2/s per ADC count)
+bool setLightIntegralConfig(float lampPpfd, float ppfdPerCount);
+float getPpfdPerCount();
 bool setIrrigationConfig(uint8_t countPerDay, uint16_t durationSec, uint8_t startHour);
 // set explicit irrigation times as CSV of HH:MM (e.g. "06:00,12:00,18:00")
 bool setIrrigationTimesCSV(const String &timesCsv, uint16_t durationSec);
+// set irrigation zones as CSV of CH[:SECONDS] (e.g. "3:60,4:120") and how many
+// valves may run at once (pump capacity); runs beyond that are queued
+bool setIrrigationZonesCSV(const String &zonesCsv, uint8_t maxConcurrent);
+
+// Replace the sensor/time rules (see include/rule_engine.h for the syntax).
+// On a syntax error the current rules stay active and `err` describes it.
+bool setAutomationRules(const String &text, String &err);
+
+// Today's lights-on hours and daily light integral (mol/m2)
+float getDailyLightHours();
+float getDailyLightIntegral();
 
 // return JSON history of daily light hours
 String automationHistoryJson();
+void automationHistoryWrite(StructWriter &w);
 
 #endif // AUTOMATION_H
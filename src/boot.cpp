@@ -0,0 +1,58 @@
+#include "boot.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "wifi_manager.h"
+#include "time_service.h"
+
+static const char* const STAGE_NAMES[BOOT_STAGE_COUNT] = {
+  "controlReady", "firstControl", "http", "wifi", "ntp", "mqtt"
+};
+
+static uint32_t stageMs[BOOT_STAGE_COUNT];
+
+void bootMark(BootStage stage) {
+  if (stage >= BOOT_STAGE_COUNT || stageMs[stage]) return;
+  uint32_t now = millis();
+  stageMs[stage] = now ? now : 1;
+  LOG_I(LOGM_MAIN, "Boot: %s at %lu ms", STAGE_NAMES[stage], (unsigned long)stageMs[stage]);
+}
+
+uint32_t bootStageMs(BootStage stage) {
+  return stage < BOOT_STAGE_COUNT ? stageMs[stage] : 0;
+}
+
+// Every time the link comes up, so the clock resyncs right after an outage
+static void onWifiLink(bool up) {
+  if (!up) return;
+  bootMark(BOOT_WIFI);
+  timeNtpStart();
+}
+
+// First NTP answer, or the clock set some other way
+static void onClockEvent(ClockEvent ev, int64_t) {
+  if (ev == CLOCK_EV_SYNC || ev == CLOCK_EV_SET) bootMark(BOOT_NTP);
+}
+
+void bootNetworkBegin() {
+  timeOnEvent(onClockEvent);
+  wifiOnLink(onWifiLink);
+  wifiManagerBegin();
+}
+
+void bootWrite(StructWriter &w) {
+  w.beginMap();
+  w.key("stages");
+  w.beginMap();
+  for (uint8_t i = 0; i < BOOT_STAGE_COUNT; ++i) {
+    w.key(STAGE_NAMES[i]);
+    if (stageMs[i]) w.intValue(stageMs[i]);
+    else w.nullValue();
+  }
+  w.endMap();
+  w.boolField("wifi", wifiConnected());
+  w.endMap();
+}
+
+String bootJson() {
+  return structToJson<String>(bootWrite);
+}
@@ -0,0 +1,34 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+
+// Staged boot: setup() brings up only what relay control needs (outputs off,
+// storage, config, sensors) and returns; Wi-Fi, NTP, HTTP and MQTT come up
+// in the background while loop() already controls. Each stage is stamped the
+// first time it is reached, in ms since the app started.
+enum BootStage : uint8_t {
+  BOOT_CONTROL_READY,   // end of setup()
+  BOOT_FIRST_CONTROL,   // first thermostat decision
+  BOOT_HTTP,            // web and telnet servers listening
+  BOOT_WIFI,            // associated, IP assigned
+  BOOT_NTP,             // wall clock set, or first NTP sync if the RTC kept it
+  BOOT_MQTT,            // first broker connection
+  BOOT_STAGE_COUNT
+};
+
+// Cheap after the first call: safe on every loop
+void bootMark(BootStage stage);
+// 0 = not reached yet
+uint32_t bootStageMs(BootStage stage);
+
+// Starts the Wi-Fi manager (src/wifi_manager.cpp) and returns without
+// waiting; NTP is (re)started every time the link comes up
+void bootNetworkBegin();
+
+// {"stages":{"controlReady":812,"firstControl":870,...},"wifi":true}
+void bootWrite(StructWriter &w);
+String bootJson();
+
+#endif // BOOT_H
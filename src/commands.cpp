@@ -0,0 +1,473 @@
+#include "commands.h"
+#include "relays.h"
+#include "sensor.h"
+#include "thermostat.h"
+#include "automation.h"
+#include "scheduler.h"
+#include "mqtt.h"
+#include "logging.h"
+#include "heap_debug.h"
+#include "perf.h"
+#include "watchdog.h"
+#include "boot.h"
+#include "wifi_manager.h"
+#include "net_config.h"
+#include "time_service.h"
+#include "ota.h"
+
+struct CmdContext {
+  RelaySource source;
+  String reply;
+};
+
+static const char* OK_REPLY = "{\"ok\":1}";
+
+// ---- handlers (argument indices follow each schema below) ----
+
+static bool cmdRelay(const CmdArgs &a, CmdContext &c) {
+  uint8_t ch = (uint8_t)a.asInt(0);
+  long st = a.asInt(1);
+  bool on = st == 2 ? !getRelay(ch) : st == 0;
+  setRelay(ch, on, c.source, RELAY_REASON_MANUAL);
+  c.reply = relayStatusJson();
+  return true;
+}
+
+static bool cmdLights(const CmdArgs &a, CmdContext &c) {
+  long st = a.asInt(0);
+  setLights(st == 2 ? !getLights() : st == 0, c.source, RELAY_REASON_MANUAL);
+  c.reply = relayStatusJson();
+  return true;
+}
+
+static bool cmdStatus(const CmdArgs &, CmdContext &c) { c.reply = relayStatusJson(); return true; }
+static bool cmdSensor(const CmdArgs &, CmdContext &c) { c.reply = sensorJson(); return true; }
+static bool cmdThermostat(const CmdArgs &, CmdContext &c) { c.reply = thermostatJson(); return true; }
+static bool cmdAutomation(const CmdArgs &, CmdContext &c) { c.reply = automationJson(); return true; }
+static bool cmdHistory(const CmdArgs &, CmdContext &c) { c.reply = automationHistoryJson(); return true; }
+static bool cmdSchedules(const CmdArgs &, CmdContext &c) { c.reply = scheduleListJson(); return true; }
+static bool cmdMqttStatus(const CmdArgs &, CmdContext &c) { c.reply = mqttStatusJson(); return true; }
+static bool cmdWifiStatus(const CmdArgs &, CmdContext &c) { c.reply = wifiStatusJson(); return true; }
+static bool cmdLogSinks(const CmdArgs &, CmdContext &c) { c.reply = logSinksJson(); return true; }
+static bool cmdBoot(const CmdArgs &, CmdContext &c) { c.reply = bootJson(); return true; }
+static bool cmdTime(const CmdArgs &, CmdContext &c) { c.reply = timeJson(); return true; }
+static bool cmdNet(const CmdArgs &, CmdContext &c) { c.reply = netConfigJson(); return true; }
+static bool cmdOta(const CmdArgs &, CmdContext &c) { c.reply = otaJson(); return true; }
+static bool cmdNetDefaults(const CmdArgs &, CmdContext &c) { netConfigDefaults(); c.reply = netConfigJson(); return true; }
+
+// Staged until net_apply; field choices are in NetField order
+static bool cmdNetSet(const CmdArgs &a, CmdContext &c) {
+  String err;
+  if (netConfigSet((uint8_t)a.asInt(0), a.asStr(1), err)) return true;
+  c.reply = err;
+  return false;
+}
+
+static bool cmdTimeZone(const CmdArgs &a, CmdContext &c) {
+  String err;
+  if (timeSetZone(a.asStr(0), err)) {
+    c.reply = timeJson();
+    return true;
+  }
+  c.reply = err;
+  return false;
+}
+
+// Reboots into the other slot; a firmware on trial is marked bad
+static bool cmdOtaRollback(const CmdArgs &, CmdContext &c) {
+  String err;
+  if (otaRollback(err)) return true;
+  c.reply = err;
+  return false;
+}
+
+static bool cmdNetApply(const CmdArgs &, CmdContext &c) {
+  String err;
+  if (netConfigApply(err)) return true;
+  c.reply = err;
+  return false;
+}
+
+static bool cmdHeap(const CmdArgs &a, CmdContext &c) {
+  c.reply = heapDebugJson();
+  if (a.asBool(0)) heapDebugReset();
+  return true;
+}
+
+static bool cmdPerf(const CmdArgs &a, CmdContext &c) {
+  c.reply = perfJson();
+  if (a.asBool(0)) perfReset();
+  return true;
+}
+
+static bool cmdWatchdog(const CmdArgs &a, CmdContext &c) {
+  c.reply = watchdogJson();
+  if (a.asBool(0)) watchdogClearHistory();
+  return true;
+}
+
+// level choices are in LogLevel order
+static bool cmdLogLevel(const CmdArgs &a, CmdContext &c) {
+  if (logSetLevel(a.asStr(0), (LogLevel)a.asInt(1))) return true;
+  c.reply = "unknown sink";
+  return false;
+}
+
+static bool cmdLogModule(const CmdArgs &a, CmdContext &c) {
+  if (logSetModuleLevelByName(a.asStr(0), (LogLevel)a.asInt(1))) return true;
+  c.reply = "unknown module";
+  return false;
+}
+
+// Arguments left out keep their current value
+static bool cmdThermostatSet(const CmdArgs &a, CmdContext &c) {
+  return setThermostat(a.asFloat(0, getThermostatSetpoint()),
+                       a.asFloat(1, getThermostatHysteresis()),
+                       a.asBool(2, getThermostatEnabled()));
+}
+
+static bool cmdThermostatAdvanced(const CmdArgs &a, CmdContext &c) {
+  return setThermostatAdvanced((unsigned long)a.asInt(0, (long)getThermostatMaxRuntime()),
+                               a.asFloat(1, getThermostatOvertempCutoff()),
+                               a.asFloat(2, getThermostatExternalLimit()),
+                               a.asBool(3, getThermostatLogging()));
+}
+
+static bool cmdDailyLight(const CmdArgs &a, CmdContext &c) { return setDailyLightMinHours(a.asFloat(0)); }
+// perCount left out keeps the current sensor calibration
+static bool cmdDli(const CmdArgs &a, CmdContext &c) { return setLightIntegralConfig(a.asFloat(0), a.asFloat(1, getPpfdPerCount())); }
+
+static bool cmdIrrigation(const CmdArgs &a, CmdContext &c) {
+  return setIrrigationConfig((uint8_t)a.asInt(0), (uint16_t)a.asInt(1), (uint8_t)a.asInt(2));
+}
+
+static bool cmdIrrTimes(const CmdArgs &a, CmdContext &c) {
+  return setIrrigationTimesCSV(String(a.asStr(0)), (uint16_t)a.asInt(1));
+}
+
+static bool cmdZones(const CmdArgs &a, CmdContext &c) {
+  return setIrrigationZonesCSV(String(a.asStr(0)), (uint8_t)a.asInt(1, 1));
+}
+
+static bool cmdRules(const CmdArgs &a, CmdContext &c) {
+  String err;
+  if (setAutomationRules(String(a.asStr(0)), err)) return true;
+  c.reply = err; // error detail for the transport
+  return false;
+}
+
+static bool cmdScheduleAdd(const CmdArgs &a, CmdContext &c) {
+  return addSchedule((uint8_t)a.asInt(0), (uint8_t)a.asInt(1), (uint8_t)a.asInt(2), a.asBool(3, true), (uint8_t)a.asInt(4, 0x7F));
+}
+
+static bool cmdScheduleEdit(const CmdArgs &a, CmdContext &c) {
+  return editSchedule((size_t)a.asInt(0), (uint8_t)a.asInt(1), (uint8_t)a.asInt(2), (uint8_t)a.asInt(3), a.asBool(4, true), (uint8_t)a.asInt(5, 0x7F));
+}
+
+static bool cmdScheduleEnable(const CmdArgs &a, CmdContext &c) {
+  return setScheduleEnabled((size_t)a.asInt(0), a.asBool(1));
+}
+
+static bool cmdScheduleDelete(const CmdArgs &a, CmdContext &c) { return removeSchedule((size_t)a.asInt(0)); }
+static bool cmdHelp(const CmdArgs &, CmdContext &c) { c.reply = commandHelp(); return true; }
+static bool cmdStats(const CmdArgs &a, CmdContext &c);
+
+// ---- schemas ----
+
+static const char* ON_OFF_TOGGLE = "on|off|toggle";
+static const CmdArgSpec RELAY_ARGS[] = {
+  { "ch", CMD_ARG_INT, true, 1, 6, nullptr },
+  { "state", CMD_ARG_ENUM, true, 0, 0, ON_OFF_TOGGLE },
+};
+static const CmdArgSpec LIGHTS_ARGS[] = {
+  { "state", CMD_ARG_ENUM, true, 0, 0, ON_OFF_TOGGLE },
+};
+static const CmdArgSpec THERM_ARGS[] = {
+  { "setpoint", CMD_ARG_FLOAT, false, -20, 60, nullptr },
+  { "hysteresis", CMD_ARG_FLOAT, false, 0, 10, nullptr },
+  { "enabled", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec THERM_ADV_ARGS[] = {
+  { "maxruntime", CMD_ARG_INT, false, 0, 86400, nullptr },
+  { "overtemp", CMD_ARG_FLOAT, false, 0, 0, nullptr },
+  { "extlimit", CMD_ARG_FLOAT, false, 0, 0, nullptr },
+  { "log", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec DAILY_ARGS[] = {
+  { "hours", CMD_ARG_FLOAT, true, 0, 24, nullptr },
+};
+static const CmdArgSpec DLI_ARGS[] = {
+  { "lampPpfd", CMD_ARG_FLOAT, true, 0, 3000, nullptr },
+  { "perCount", CMD_ARG_FLOAT, false, 0, 0, nullptr },
+};
+static const CmdArgSpec IRRIGATION_ARGS[] = {
+  { "count", CMD_ARG_INT, true, 0, 24, nullptr },
+  { "duration", CMD_ARG_INT, true, 0, 65535, nullptr },
+  { "start", CMD_ARG_INT, true, 0, 23, nullptr },
+};
+static const CmdArgSpec IRR_TIMES_ARGS[] = {
+  { "times", CMD_ARG_STR, true, 0, 0, nullptr },
+  { "duration", CMD_ARG_INT, true, 0, 65535, nullptr },
+};
+static const CmdArgSpec ZONES_ARGS[] = {
+  { "zones", CMD_ARG_STR, true, 0, 0, nullptr },
+  { "concurrent", CMD_ARG_INT, false, 1, 6, nullptr },
+};
+static const CmdArgSpec RULES_ARGS[] = {
+  { "rules", CMD_ARG_STR, true, 0, 0, nullptr },
+};
+static const CmdArgSpec SCHED_ADD_ARGS[] = {
+  { "ch", CMD_ARG_INT, true, 1, 6, nullptr },
+  { "hour", CMD_ARG_INT, true, 0, 23, nullptr },
+  { "minute", CMD_ARG_INT, true, 0, 59, nullptr },
+  { "on", CMD_ARG_BOOL, false, 0, 0, nullptr },
+  { "days", CMD_ARG_INT, false, 0, 127, nullptr },
+};
+static const CmdArgSpec SCHED_EDIT_ARGS[] = {
+  { "index", CMD_ARG_INT, true, 0, 255, nullptr },
+  { "ch", CMD_ARG_INT, true, 1, 6, nullptr },
+  { "hour", CMD_ARG_INT, true, 0, 23, nullptr },
+  { "minute", CMD_ARG_INT, true, 0, 59, nullptr },
+  { "on", CMD_ARG_BOOL, false, 0, 0, nullptr },
+  { "days", CMD_ARG_INT, false, 0, 127, nullptr },
+};
+static const CmdArgSpec SCHED_ENABLE_ARGS[] = {
+  { "index", CMD_ARG_INT, true, 0, 255, nullptr },
+  { "enabled", CMD_ARG_BOOL, true, 0, 0, nullptr },
+};
+static const CmdArgSpec INDEX_ARGS[] = {
+  { "index", CMD_ARG_INT, true, 0, 255, nullptr },
+};
+static const CmdArgSpec LOG_LEVEL_ARGS[] = {
+  { "sink", CMD_ARG_STR, true, 0, 0, nullptr },
+  { "level", CMD_ARG_ENUM, true, 0, 0, "none|error|warn|info|debug" },
+};
+static const CmdArgSpec LOG_MODULE_ARGS[] = {
+  { "module", CMD_ARG_STR, true, 0, 0, nullptr },
+  { "level", CMD_ARG_ENUM, true, 0, 0, "none|error|warn|info|debug" },
+};
+static const CmdArgSpec STATS_ARGS[] = {
+  { "reset", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec HEAP_ARGS[] = {
+  { "reset", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec PERF_ARGS[] = {
+  { "reset", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec WATCHDOG_ARGS[] = {
+  { "clear", CMD_ARG_BOOL, false, 0, 0, nullptr },
+};
+static const CmdArgSpec NET_SET_ARGS[] = {
+  { "field", CMD_ARG_ENUM, true, 0, 0, NET_FIELD_NAMES },
+  { "value", CMD_ARG_STR, false, 0, 0, nullptr },   // empty: clear (ssid, pass, mqtt_user...)
+};
+static const CmdArgSpec TIME_ZONE_ARGS[] = {
+  { "tz", CMD_ARG_STR, true, 0, 0, nullptr },
+};
+
+#define ARGS(a) a, (uint8_t)(sizeof(a) / sizeof(a[0]))
+#define NO_ARGS nullptr, 0
+
+static const CmdDef<CmdContext> COMMANDS[] = {
+  { "relay", nullptr, ARGS(RELAY_ARGS), cmdRelay, "switch a relay" },
+  { "lights", nullptr, ARGS(LIGHTS_ARGS), cmdLights, "switch the lights (relay 2)" },
+  { "status", nullptr, NO_ARGS, cmdStatus, "relay states" },
+  { "sensor", nullptr, NO_ARGS, cmdSensor, "temperature and humidity" },
+  { "thermostat", nullptr, NO_ARGS, cmdThermostat, "thermostat settings" },
+  { "thermostat_set", "setpoint", ARGS(THERM_ARGS), cmdThermostatSet, "set setpoint/hysteresis/enabled (omitted values are kept)" },
+  { "thermostat_advanced", nullptr, ARGS(THERM_ADV_ARGS), cmdThermostatAdvanced, "max runtime, overtemp cutoff, exterior limit, CSV log (omitted values are kept)" },
+  { "automation", nullptr, NO_ARGS, cmdAutomation, "automation settings and state" },
+  { "history", nullptr, NO_ARGS, cmdHistory, "daily light history" },
+  { "daily_light", nullptr, ARGS(DAILY_ARGS), cmdDailyLight, "minimum daily light hours" },
+  { "dli", nullptr, ARGS(DLI_ARGS), cmdDli, "lamp PPFD and light sensor calibration" },
+  { "irrigation", nullptr, ARGS(IRRIGATION_ARGS), cmdIrrigation, "evenly spaced irrigation runs" },
+  { "irr_times", nullptr, ARGS(IRR_TIMES_ARGS), cmdIrrTimes, "explicit irrigation times HH:MM,..." },
+  { "zones", nullptr, ARGS(ZONES_ARGS), cmdZones, "irrigation zones CH[:SEC],... and pump capacity" },
+  { "rules", nullptr, ARGS(RULES_ARGS), cmdRules, "sensor/time rules (include/rule_engine.h)" },
+  { "schedules", nullptr, NO_ARGS, cmdSchedules, "list schedules" },
+  { "schedule_add", nullptr, ARGS(SCHED_ADD_ARGS), cmdScheduleAdd, "add a schedule" },
+  { "schedule_edit", nullptr, ARGS(SCHED_EDIT_ARGS), cmdScheduleEdit, "edit a schedule" },
+  { "schedule_enable", nullptr, ARGS(SCHED_ENABLE_ARGS), cmdScheduleEnable, "enable/disable a schedule" },
+  { "schedule_delete", nullptr, ARGS(INDEX_ARGS), cmdScheduleDelete, "delete a schedule" },
+  { "mqtt_status", nullptr, NO_ARGS, cmdMqttStatus, "MQTT connection and queue" },
+  { "wifi_status", nullptr, NO_ARGS, cmdWifiStatus, "WiFi link, RSSI, reconnects and fallback AP" },
+  { "net", nullptr, NO_ARGS, cmdNet, "network settings in effect and staged (passwords masked)" },
+  { "net_set", nullptr, ARGS(NET_SET_ARGS), cmdNetSet, "stage a network setting: ssid|pass|ssid2|...|ip|gateway|subnet|dns|mqtt_*|ap_pass" },
+  { "net_apply", nullptr, NO_ARGS, cmdNetApply, "save staged network settings and reconnect, no reboot" },
+  { "net_defaults", nullptr, NO_ARGS, cmdNetDefaults, "stage the compiled-in network settings" },
+  { "log_sinks", nullptr, NO_ARGS, cmdLogSinks, "log sinks, levels and counters" },
+  { "log_level", nullptr, ARGS(LOG_LEVEL_ARGS), cmdLogLevel, "set a sink's level: serial|serial1|flash|telnet|sse none..debug" },
+  { "log_module", nullptr, ARGS(LOG_MODULE_ARGS), cmdLogModule, "set a module's level: main|wifi|web|mqtt|sensor|thermostat|automation|scheduler|relays none..debug" },
+  { "stats", nullptr, ARGS(STATS_ARGS), cmdStats, "per-command latency" },
+  { "heap", nullptr, ARGS(HEAP_ARGS), cmdHeap, "free heap, largest block, allocations per module and request" },
+  { "perf", nullptr, ARGS(PERF_ARGS), cmdPerf, "loop period/jitter and time per module (min/p50/p99/max)" },
+  { "watchdog", nullptr, ARGS(WATCHDOG_ARGS), cmdWatchdog, "reset reason and watchdog trips (module, backtrace)" },
+  { "time", nullptr, NO_ARGS, cmdTime, "clock source, local time, NTP syncs and clock steps" },
+  { "time_zone", nullptr, ARGS(TIME_ZONE_ARGS), cmdTimeZone, "set the POSIX TZ rule schedules run in, e.g. CET-1CEST,M3.5.0,M10.5.0/3" },
+  { "ota", nullptr, NO_ARGS, cmdOta, "OTA upload progress, running slot and version, trial state" },
+  { "ota_rollback", nullptr, NO_ARGS, cmdOtaRollback, "reboot into the firmware in the other slot" },
+  { "boot", nullptr, NO_ARGS, cmdBoot, "ms from reset to each boot stage (control, wifi, ntp, mqtt)" },
+  { "help", nullptr, NO_ARGS, cmdHelp, "this list" },
+};
+
+static const size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+// Serial and HTTP only. The MQTT broker is shared (public by default), so
+// whoever can publish to the cmd topic could otherwise repoint the board's
+// Wi-Fi and broker for good, or reboot it into the other slot (which after
+// a filesystem update holds no firmware).
+static const char* const LOCAL_ONLY[] = { "net_set", "net_apply", "net_defaults", "ota_rollback", nullptr };
+static CommandDispatcher<CmdContext, COMMAND_COUNT> dispatcher(COMMANDS, LOCAL_ONLY);
+
+static bool cmdStats(const CmdArgs &a, CmdContext &c) {
+  c.reply = commandStatsJson();
+  if (a.asBool(0)) dispatcher.resetStats();
+  return true;
+}
+
+// ---- transports ----
+
+static String errorReply(const String &msg) {
+  String s = "{\"ok\":0,\"error\":\"";
+  for (size_t i = 0; i < msg.length(); ++i) {
+    char ch = msg[i];
+    if (ch == '"' || ch == '\\') s += '\\';
+    s += ch;
+  }
+  s += "\"}";
+  return s;
+}
+
+static bool finish(CmdStatus st, CmdContext &ctx, const char* err, String &reply) {
+  if (st == CMD_OK) {
+    reply = ctx.reply.length() ? ctx.reply : String(OK_REPLY);
+    return true;
+  }
+  // handlers may leave a more specific message in the reply
+  reply = errorReply(st == CMD_FAILED && ctx.reply.length() ? ctx.reply : String(err));
+  return false;
+}
+
+bool commandRun(const char* name, const CmdPair* pairs, size_t n, RelaySource source, String &reply) {
+  CmdContext ctx;
+  ctx.source = source;
+  char err[64] = "";
+  CmdStatus st = dispatcher.dispatch(name, pairs, n, ctx, err, sizeof(err), micros, source == RELAY_SRC_MQTT);
+  return finish(st, ctx, err, reply);
+}
+
+bool commandRunLine(const String &line, RelaySource source, String &reply) {
+  char buf[384];
+  strncpy(buf, line.c_str(), sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = 0;
+  CmdContext ctx;
+  ctx.source = source;
+  char err[64] = "";
+  CmdStatus st = dispatcher.dispatchLine(buf, ctx, err, sizeof(err), micros, source == RELAY_SRC_MQTT);
+  return finish(st, ctx, err, reply);
+}
+
+// Decode %XX escapes and '+' in place (JS encodeURIComponent output)
+// A '%' not followed by two hex digits is kept as it is
+static void urlDecodeInPlace(char *s) {
+  char *out = s;
+  for (; *s; ++s) {
+    if (*s == '+') *out++ = ' ';
+    else if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+      char hex[3] = { s[1], s[2], 0 };
+      *out++ = (char)strtol(hex, nullptr, 16);
+      s += 2;
+    } else *out++ = *s;
+  }
+  *out = 0;
+}
+
+bool commandRunQuery(const char* name, const String &query, RelaySource source, String &reply, const char* skipKey) {
+  char buf[512];
+  strncpy(buf, query.c_str(), sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = 0;
+  CmdPair pairs[CMD_MAX_PAIRS];
+  size_t n = 0;
+  char *p = buf;
+  while (*p && n < CMD_MAX_PAIRS) {
+    char *amp = strchr(p, '&');
+    if (amp) *amp = 0;
+    char *eq = strchr(p, '=');
+    if (eq) {
+      *eq = 0;
+      urlDecodeInPlace(p);
+      urlDecodeInPlace(eq + 1);
+      if (!skipKey || strcmp(p, skipKey) != 0) {
+        pairs[n].key = p;
+        pairs[n++].value = eq + 1;
+      }
+    }
+    if (!amp) break;
+    p = amp + 1;
+  }
+  return commandRun(name, pairs, n, source, reply);
+}
+
+bool commandRunJson(JsonObjectConst obj, RelaySource source, String &reply) {
+  const char* name = obj["cmd"];
+  if (!name) {
+    reply = errorReply("missing 'cmd'");
+    return false;
+  }
+  CmdPair pairs[CMD_MAX_PAIRS];
+  char values[CMD_MAX_PAIRS][24];
+  size_t n = 0;
+  for (JsonPairConst kv : obj) {
+    if (n == CMD_MAX_PAIRS) break;
+    const char* key = kv.key().c_str();
+    if (strcmp(key, "cmd") == 0 || strcmp(key, "id") == 0) continue;
+    pairs[n].key = key;
+    if (kv.value().is<const char*>()) {
+      pairs[n].value = kv.value().as<const char*>();
+    } else {
+      // numbers and booleans in their JSON spelling ("2", "24.5", "true")
+      serializeJson(kv.value(), values[n], sizeof(values[n]));
+      pairs[n].value = values[n];
+    }
+    n++;
+  }
+  return commandRun(name, pairs, n, source, reply);
+}
+
+String commandHelp() {
+  String s;
+  for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+    const CmdDef<CmdContext> &d = COMMANDS[i];
+    s += d.name;
+    for (uint8_t a = 0; a < d.argCount; ++a) {
+      const CmdArgSpec &arg = d.args[a];
+      s += arg.required ? " <" : " [";
+      s += arg.name;
+      if (arg.type == CMD_ARG_ENUM) { s += ":"; s += arg.choices; }
+      s += arg.required ? ">" : "]";
+    }
+    s += " - ";
+    s += d.help;
+    if (dispatcher.localOnly(i)) s += " (serial/HTTP only)";
+    s += "\n";
+  }
+  return s;
+}
+
+String commandStatsJson() {
+  String s = "{";
+  bool first = true;
+  for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+    const CommandDispatcher<CmdContext, COMMAND_COUNT>::Stats &st = dispatcher.stats(i);
+    if (!st.calls) continue;
+    if (!first) s += ",";
+    first = false;
+    s += "\"" + String(COMMANDS[i].name) + "\":{\"calls\":" + String(st.calls);
+    s += ",\"errors\":" + String(st.errors);
+    s += ",\"avgUs\":" + String((unsigned long)(st.totalUs / st.calls));
+    s += ",\"maxUs\":" + String(st.maxUs);
+    s += ",\"lastUs\":" + String(st.lastUs) + "}";
+  }
+  s += "}";
+  return s;
+}
@@ -0,0 +1,29 @@
+// Command table shared by the serial console, HTTP and MQTT. Each transport
+// only converts its input into arguments (see include/command_dispatcher.h);
+// validation, actuation and per-command latency stats live here.
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "relay_journal.h"
+#include "command_dispatcher.h"
+
+// All functions return true on success. `reply` is the command's output
+// (JSON, or {"ok":1} for plain setters); on failure it is
+// {"ok":0,"error":"..."}.
+
+// Arguments as already-decoded key/value pairs
+bool commandRun(const char* name, const CmdPair* pairs, size_t n, RelaySource source, String &reply);
+// "relay 2 on", "thermostat_set setpoint=24", "rules tin<5 -> ch1"
+bool commandRunLine(const String &line, RelaySource source, String &reply);
+// URL query "ch=2&state=on" (percent-encoded); `skipKey` is ignored if present
+bool commandRunQuery(const char* name, const String &query, RelaySource source, String &reply, const char* skipKey = nullptr);
+// {"cmd":"relay","ch":2,"state":"on"}; every member but "cmd" and "id" is an argument
+bool commandRunJson(JsonObjectConst obj, RelaySource source, String &reply);
+
+String commandHelp();
+// {"<name>":{"calls":..,"errors":..,"avgUs":..,"maxUs":..,"lastUs":..},...}
+String commandStatsJson();
+
+#endif // COMMANDS_H
@@ -2,6 +2,10 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// Network defaults. Everything from here to the MQTT credentials (except
+// MQTT_USE_TLS and the AP SSID/timings) can be overridden per site in
+// /network.json with the net_set/net_apply commands (src/net_config.h).
+
 // WiFi (replaced with provided network credentials)
 #define WIFI_SSID "Redmi 9T"
 #define WIFI_PASS "murcia09"
@@ -13,7 +17,161 @@
 #define STATIC_SUBNET IPAddress(255,255,255,0)
 #define STATIC_DNS IPAddress(8,8,8,8)
 
+// Wi-Fi manager (src/wifi_manager.cpp). Up to two more networks, tried when
+// they are stronger than WIFI_SSID or it is out of range (empty = unused; the
+// static IP above only applies to WIFI_SSID, the others use DHCP). With no
+// link for WIFI_AP_AFTER_MS the board also opens an access point for local
+// access (0 = never); WIFI_AP_SSID empty = "invernadero-<last 4 of MAC>".
+#ifndef WIFI_SSID_2
+#define WIFI_SSID_2 ""
+#define WIFI_PASS_2 ""
+#endif
+#ifndef WIFI_SSID_3
+#define WIFI_SSID_3 ""
+#define WIFI_PASS_3 ""
+#endif
+#ifndef WIFI_AP_SSID
+#define WIFI_AP_SSID ""
+#endif
+// at least 8 characters (WPA2)
+#ifndef WIFI_AP_PASS
+#define WIFI_AP_PASS "invernadero"
+#endif
+#ifndef WIFI_AP_AFTER_MS
+#define WIFI_AP_AFTER_MS 120000UL
+#endif
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000UL
+#endif
+// Wait after every network failed, doubling up to the maximum
+#ifndef WIFI_BACKOFF_MIN_MS
+#define WIFI_BACKOFF_MIN_MS 2000UL
+#endif
+#ifndef WIFI_BACKOFF_MAX_MS
+#define WIFI_BACKOFF_MAX_MS 300000UL
+#endif
+
 // Relay logic: set to true if relay is active LOW (typical relay boards)
 #define RELAY_ACTIVE_LOW true
 
+// Simultaneous SSE (/events) and telnet log clients. Each one holds an lwIP
+// socket (CONFIG_LWIP_MAX_SOCKETS, 10 by default). Five more are taken by the
+// two listeners, the HTTP request being served, MQTT and an OTA upload.
+#ifndef WEB_SSE_CLIENTS
+#define WEB_SSE_CLIENTS 3
+#endif
+#ifndef WEB_TELNET_CLIENTS
+#define WEB_TELNET_CLIENTS 2
+#endif
+
+// MQTT broker. Override from platformio.ini build_flags, e.g. for a local
+// Mosquitto: -DMQTT_SERVER=\"192.168.1.10\" -DMQTT_PORT=1883 -DMQTT_USE_TLS=0
+#ifndef MQTT_SERVER
+#define MQTT_SERVER "broker.hivemq.com"
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT 8883
+#endif
+#ifndef MQTT_USE_TLS
+#define MQTT_USE_TLS 1
+#endif
+#ifndef MQTT_USER
+#define MQTT_USER ""
+#endif
+#ifndef MQTT_PASS
+#define MQTT_PASS ""
+#endif
+// Home Assistant MQTT discovery prefix; empty string disables discovery
+#ifndef MQTT_DISCOVERY_PREFIX
+#define MQTT_DISCOVERY_PREFIX "homeassistant"
+#endif
+
+// Heap telemetry (src/heap_debug.cpp, /debug/heap): log interval, largest
+// free block below which the log line becomes a warning, requests kept
+#ifndef HEAP_LOG_INTERVAL_MS
+#define HEAP_LOG_INTERVAL_MS 300000UL
+#endif
+#ifndef HEAP_LOW_BLOCK_BYTES
+#define HEAP_LOW_BLOCK_BYTES 8192
+#endif
+#ifndef HEAP_DEBUG_REQUESTS
+#define HEAP_DEBUG_REQUESTS 8
+#endif
+
+// Watchdog supervision (src/watchdog.cpp): a loop() subsystem that does not
+// return within WATCHDOG_DEADLINE_MS trips the supervisor, which puts the
+// relays in WATCHDOG_SAFE_RELAYS (bit n-1 = channel n on; 0 = all off) and
+// restarts. MQTT gets longer, for a broker connect that times out
+// (include/watchdog_deadlines.h). The task watchdog (panic + backtrace) is
+// the backstop if the supervisor itself cannot run.
+#ifndef WATCHDOG_DEADLINE_MS
+#define WATCHDOG_DEADLINE_MS 8000UL
+#endif
+#ifndef WATCHDOG_SAFE_RELAYS
+#define WATCHDOG_SAFE_RELAYS 0x00
+#endif
+#ifndef WATCHDOG_TWDT_SEC
+#define WATCHDOG_TWDT_SEC 20
+#endif
+// Trips kept in /watchdog.json
+#ifndef WATCHDOG_HISTORY
+#define WATCHDOG_HISTORY 4
+#endif
+
+// Time service (src/time_service.cpp). TIME_TZ is a POSIX TZ rule for local
+// time, e.g. "CET-1CEST,M3.5.0,M10.5.0/3" (Madrid) or "<-03>3" (Buenos
+// Aires); "UTC0" keeps everything in UTC. It is the default: the time_zone
+// command sets another at runtime (saved in /time.json). A step of the wall
+// clock larger than TIME_JUMP_MS is reported to the scheduler and automation
+// as a jump.
+// /time reports the clock as stale after TIME_STALE_SEC without an NTP sync.
+#ifndef TIME_TZ
+#define TIME_TZ "UTC0"
+#endif
+#ifndef TIME_NTP_SERVER_1
+#define TIME_NTP_SERVER_1 "pool.ntp.org"
+#endif
+#ifndef TIME_NTP_SERVER_2
+#define TIME_NTP_SERVER_2 "time.nist.gov"
+#endif
+#ifndef TIME_JUMP_MS
+#define TIME_JUMP_MS 2000UL
+#endif
+#ifndef TIME_STALE_SEC
+#define TIME_STALE_SEC (24UL * 3600UL)
+#endif
+
+// OTA updates (src/ota.cpp, partitions.csv). An upload is taken from the
+// socket at most OTA_TICK_BYTES per loop, about as much of the image is
+// written to flash (a pack unpacks to more than its size) and it is read
+// back OTA_VERIFY_BYTES per loop, so control keeps running; one that stalls
+// for OTA_IDLE_MS is dropped. Uploads must carry ?token=<OTA_TOKEN>; while it is empty /ota
+// refuses every upload.
+// New firmware boots on trial: it is confirmed after OTA_TRIAL_MIN_SEC with
+// Wi-Fi up and rolled back if that has not happened within
+// OTA_TRIAL_TIMEOUT_SEC (the bootloader rolls back if it crashes first).
+#ifndef OTA_TICK_BYTES
+#define OTA_TICK_BYTES 8192
+#endif
+#ifndef OTA_VERIFY_BYTES
+#define OTA_VERIFY_BYTES 32768
+#endif
+#ifndef OTA_IDLE_MS
+#define OTA_IDLE_MS 15000UL
+#endif
+#ifndef OTA_TOKEN
+#define OTA_TOKEN ""
+#endif
+#ifndef OTA_TRIAL_MIN_SEC
+#define OTA_TRIAL_MIN_SEC 60
+#endif
+#ifndef OTA_TRIAL_TIMEOUT_SEC
+#define OTA_TRIAL_TIMEOUT_SEC 600
+#endif
+// Compressed and delta uploads (tools/ota_pack.py): largest LZ window
+// accepted, 2^bits bytes of RAM while a pack streams in.
+#ifndef OTA_LZ_WINDOW_BITS
+#define OTA_LZ_WINDOW_BITS 12
+#endif
+
 #endif // CONFIG_H
@@ -0,0 +1,171 @@
+#include "heap_debug.h"
+#include "config.h"
+#include "logging.h"
+#include "json_writer.h"
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// The firmware is linked with -Wl,--wrap=malloc,--wrap=free,... (see
+// platformio.ini), so every allocation of the sketch, the Arduino core,
+// ArduinoJson and ESP-IDF comes through here first. The hooks must not
+// allocate or log.
+extern "C" {
+void *__real_malloc(size_t n);
+void __real_free(void *p);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+}
+
+static TaskHandle_t loopTask = nullptr;
+
+static inline uint8_t tagNow() {
+  return loopTask && xTaskGetCurrentTaskHandle() == loopTask ? heapCurrentTag() : HEAP_TAG_OTHER;
+}
+
+extern "C" void *__wrap_malloc(size_t n) {
+  void *p = __real_malloc(n);
+  heapCountAlloc(tagNow(), n, p != nullptr);
+  return p;
+}
+
+extern "C" void *__wrap_calloc(size_t n, size_t size) {
+  void *p = __real_calloc(n, size);
+  heapCountAlloc(tagNow(), n * size, p != nullptr);
+  return p;
+}
+
+// String growth: counted as a new block replacing the old one
+extern "C" void *__wrap_realloc(void *p, size_t n) {
+  void *q = __real_realloc(p, n);
+  uint8_t tag = tagNow();
+  if (n) heapCountAlloc(tag, n, q != nullptr);
+  if (p && (q || !n)) heapCountFree(tag);
+  return q;
+}
+
+extern "C" void __wrap_free(void *p) {
+  if (p) heapCountFree(tagNow());
+  __real_free(p);
+}
+
+// Recent HTTP requests, newest overwrites oldest
+struct RequestDelta {
+  char path[24];
+  uint32_t allocs;
+  uint32_t bytes;
+  int32_t freeDelta;   // free heap after - before (negative: still held)
+  uint32_t ms;
+};
+static RequestDelta requests[HEAP_DEBUG_REQUESTS];
+static uint8_t requestNext = 0;
+static uint32_t requestCount = 0;
+static RequestDelta worstRequest;
+static HeapSnapshot requestBefore;
+static uint32_t requestFreeBefore = 0;
+static unsigned long requestStart = 0;
+static unsigned long lastLog = 0;
+
+static uint32_t freeHeap() { return heap_caps_get_free_size(MALLOC_CAP_8BIT); }
+static uint32_t largestBlock() { return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT); }
+static uint32_t minFreeHeap() { return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT); }
+
+// Share of free memory not usable for the largest allocation
+static uint32_t fragmentationPct(uint32_t freeBytes, uint32_t largest) {
+  return freeBytes ? 100 - (uint32_t)((uint64_t)largest * 100 / freeBytes) : 0;
+}
+
+void heapDebugBegin() {
+  loopTask = xTaskGetCurrentTaskHandle();
+  memset(&worstRequest, 0, sizeof(worstRequest));
+}
+
+void heapDebugTick() {
+  unsigned long now = millis();
+  if (now - lastLog < HEAP_LOG_INTERVAL_MS) return;
+  lastLog = now;
+  uint32_t freeBytes = freeHeap();
+  uint32_t largest = largestBlock();
+  HeapSnapshot all = HeapSnapshot::take();
+  LogLevel level = largest < HEAP_LOW_BLOCK_BYTES ? LOG_WARN : LOG_INFO;
+  LOG_AT(level, LOGM_MAIN, "heap: free %u largest %u min %u frag %u%% allocs %u frees %u",
+         (unsigned)freeBytes, (unsigned)largest, (unsigned)minFreeHeap(),
+         (unsigned)fragmentationPct(freeBytes, largest), (unsigned)all.allocs, (unsigned)all.frees);
+}
+
+void heapDebugRequestBegin() {
+  requestBefore = HeapSnapshot::take(LOGM_WEB);
+  requestFreeBefore = freeHeap();
+  requestStart = millis();
+}
+
+void heapDebugRequestEnd(const char* path) {
+  HeapSnapshot d = HeapSnapshot::take(LOGM_WEB).since(requestBefore);
+  RequestDelta &r = requests[requestNext];
+  requestNext = (requestNext + 1) % HEAP_DEBUG_REQUESTS;
+  requestCount++;
+  strncpy(r.path, path, sizeof(r.path) - 1);
+  r.path[sizeof(r.path) - 1] = 0;
+  r.allocs = d.allocs;
+  r.bytes = d.bytes;
+  r.freeDelta = (int32_t)(freeHeap() - requestFreeBefore);
+  r.ms = millis() - requestStart;
+  if (r.allocs >= worstRequest.allocs) worstRequest = r;
+}
+
+static void writeRequest(StructWriter &w, const RequestDelta &r) {
+  w.beginMap();
+  w.strField("path", r.path);
+  w.intField("allocs", r.allocs);
+  w.intField("bytes", r.bytes);
+  w.intField("freeDelta", r.freeDelta);
+  w.intField("ms", r.ms);
+  w.endMap();
+}
+
+void heapDebugWrite(StructWriter &w) {
+  uint32_t freeBytes = freeHeap();
+  uint32_t largest = largestBlock();
+  w.beginMap();
+  w.intField("uptimeSec", millis() / 1000);
+  w.intField("freeHeap", freeBytes);
+  w.intField("largestFreeBlock", largest);
+  w.intField("minFreeHeap", minFreeHeap());
+  w.intField("fragmentationPct", fragmentationPct(freeBytes, largest));
+  w.key("modules");
+  w.beginArray();
+  for (uint8_t i = 0; i < HEAP_TAG_COUNT; ++i) {
+    const HeapCounters &c = heapCounters(i);
+    w.beginMap();
+    w.strField("module", heapTagName(i));
+    w.intField("allocs", c.allocs);
+    w.intField("frees", c.frees);
+    w.intField("bytes", c.bytes);
+    w.intField("failed", c.failed);
+    w.endMap();
+  }
+  w.endArray();
+  w.intField("requestCount", requestCount);
+  w.key("requests");
+  w.beginArray();
+  uint8_t n = requestCount < HEAP_DEBUG_REQUESTS ? requestCount : HEAP_DEBUG_REQUESTS;
+  for (uint8_t i = 1; i <= n; ++i) {
+    writeRequest(w, requests[(requestNext + HEAP_DEBUG_REQUESTS - i) % HEAP_DEBUG_REQUESTS]);
+  }
+  w.endArray();
+  w.key("worstRequest");
+  if (requestCount) writeRequest(w, worstRequest);
+  else w.nullValue();
+  w.endMap();
+}
+
+String heapDebugJson() {
+  return structToJson<String>(heapDebugWrite);
+}
+
+void heapDebugReset() {
+  heapCountersReset();
+  requestCount = 0;
+  requestNext = 0;
+  memset(&worstRequest, 0, sizeof(worstRequest));
+}
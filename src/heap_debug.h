@@ -0,0 +1,21 @@
+#ifndef HEAP_DEBUG_H
+#define HEAP_DEBUG_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+#include "heap_stats.h"
+
+// Call at the start of setup(): from then on the loop task's allocations are
+// charged to the HeapScope in effect (include/heap_stats.h)
+void heapDebugBegin();
+// Periodic heap log line every HEAP_LOG_INTERVAL_MS
+void heapDebugTick();
+// Around one HTTP request; the delta is kept for /debug/heap
+void heapDebugRequestBegin();
+void heapDebugRequestEnd(const char* path);
+// Free heap, largest block, min-ever free, per-module counters, recent requests
+void heapDebugWrite(StructWriter &w);
+String heapDebugJson();
+void heapDebugReset();
+
+#endif // HEAP_DEBUG_H
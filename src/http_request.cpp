@@ -0,0 +1,66 @@
+#include "http_request.h"
+
+// Header lines read before giving up on the blank line
+static const int HTTP_MAX_HEADERS = 32;
+
+void httpReadRequest(Stream &client, HttpRequest &req) {
+  String line = client.readStringUntil('\n');
+  // line contains something like: GET /path?query HTTP/1.1\r
+  int firstSpace = line.indexOf(' ');
+  int secondSpace = line.indexOf(' ', firstSpace + 1);
+  req.method = firstSpace > 0 ? line.substring(0, firstSpace) : String("GET");
+  req.path = "/";
+  if (firstSpace != -1 && secondSpace != -1) {
+    req.path = line.substring(firstSpace + 1, secondSpace);
+  }
+  // headers: Accept and those of an upload matter, the rest is drained up
+  // to the blank line
+  req.accept = String();
+  req.contentLength = -1;
+  req.expectContinue = false;
+  // a header split across TCP segments waits for the rest (stream timeout);
+  // nothing before the timeout ends the headers too
+  for (int i = 0; i < HTTP_MAX_HEADERS; ++i) {
+    line = client.readStringUntil('\n');
+    if (!line.length()) break;
+    line.trim();
+    if (!line.length()) break;
+    if (line.length() > 7 && line.substring(0, 7).equalsIgnoreCase("accept:")) req.accept = line.substring(7);
+    else if (line.length() > 15 && line.substring(0, 15).equalsIgnoreCase("content-length:")) req.contentLength = line.substring(15).toInt();
+    else if (line.length() > 7 && line.substring(0, 7).equalsIgnoreCase("expect:")) req.expectContinue = line.indexOf("100") > 0;
+  }
+}
+
+String urlDecode(const String &in) {
+  String out;
+  out.reserve(in.length());
+  for (int i = 0; i < (int)in.length(); ++i) {
+    char c = in[i];
+    if (c == '+') c = ' ';
+    else if (c == '%' && i + 2 < (int)in.length()) {
+      char hex[3] = { in[i + 1], in[i + 2], 0 };
+      c = (char)strtol(hex, nullptr, 16);
+      i += 2;
+    }
+    out += c;
+  }
+  return out;
+}
+
+String queryParam(const String &query, const char* key) {
+  int p = 0;
+  while (p < (int)query.length()) {
+    int amp = query.indexOf('&', p);
+    if (amp == -1) amp = query.length();
+    int eq = query.indexOf('=', p);
+    if (eq > p && eq < amp && query.substring(p, eq) == key) return urlDecode(query.substring(eq + 1, amp));
+    p = amp + 1;
+  }
+  return String();
+}
+
+bool wantsCbor(const String &path, const String &accept) {
+  if (accept.indexOf("application/cbor") >= 0) return true;
+  int q = path.indexOf('?');
+  return q >= 0 && queryParam(path.substring(q + 1), "fmt") == "cbor";
+}
@@ -0,0 +1,28 @@
+// HTTP request parsing for the web server: request line, the headers that
+// matter and query strings. Kept out of webserver.cpp so the host benchmarks
+// (bench/) can run it against a mocked client.
+#ifndef HTTP_REQUEST_H
+#define HTTP_REQUEST_H
+
+#include <Arduino.h>
+
+struct HttpRequest {
+  String method;          // "GET", "POST", ...
+  String path;            // path and query as sent ("/" if the line is malformed)
+  String accept;          // Accept header value, "" if absent
+  long contentLength;     // -1 if absent
+  bool expectContinue;    // Expect: 100-continue (curl, for large bodies)
+};
+
+// Reads "GET /path?query HTTP/1.1" and drains the headers up to the blank
+// line, waiting up to the stream timeout for each; a body is left in the
+// stream
+void httpReadRequest(Stream &client, HttpRequest &req);
+// Decode %XX escapes and '+' (JS encodeURIComponent output)
+String urlDecode(const String &in);
+// Value of `key` in a query string ("" if absent), decoded
+String queryParam(const String &query, const char* key);
+// Machine clients ask for CBOR with `Accept: application/cbor` or ?fmt=cbor
+bool wantsCbor(const String &path, const String &accept);
+
+#endif // HTTP_REQUEST_H
@@ -1,33 +1,160 @@
 #include "logging.h"
+#include "storage.h"
 #include <SPIFFS.h>
+#include <stdarg.h>
+
+static const char* LOG_FILE = "/logs.txt";
+static const char* LOG_FILE_OLD = "/logs.old";
+// /logs.txt is rotated to /logs.old past this size
+static const size_t LOG_FILE_MAX = 64 * 1024;
+static const size_t LOG_MAX_SINKS = 6;
+static const size_t LOG_LINE_LEN = 192;
+
+static LogRouter<LOG_MAX_SINKS, LOG_LINE_LEN> router;
+static LogFlushBuffer<2048> flashBuffer(30000);
+static uint32_t flashWrites = 0;
+static uint32_t flashErrors = 0;
+static bool flashReady = false;
+
+struct FileWriter {
+  File &f;
+  size_t write(const uint8_t* p, size_t n) { return f.write(p, n); }
+};
+
+static void serialSink(LogLevel, const char* text, size_t len, bool eol) {
+  if (!Serial) return;
+  Serial.write((const uint8_t*)text, len);
+  if (eol) Serial.println();
+}
+
+static void serial1Sink(LogLevel, const char* text, size_t len, bool eol) {
+  if (!Serial1) return;
+  Serial1.write((const uint8_t*)text, len);
+  if (eol) Serial1.println();
+}
+
+// "<millis>: <text>\n", staged in RAM until logTick() writes a batch
+static void flashSink(LogLevel level, const char* text, size_t len, bool) {
+  char line[LOG_LINE_LEN + 16];
+  int n = snprintf(line, sizeof(line), "%lu: %.*s\n", millis(), (int)len, text);
+  if (n < 0) return;
+  if ((size_t)n >= sizeof(line)) {
+    n = sizeof(line) - 1;
+    line[n - 1] = '\n';
+  }
+  flashBuffer.append(line, n, millis(), level <= LOG_ERROR);
+}
 
 bool initLogging() {
-  if (SPIFFS.begin(true)) {
-    return true;
+  flashReady = storageReady();
+  if (!router.size()) {
+    router.add("serial", serialSink, LOG_INFO, false);
+    router.add("serial1", serial1Sink, LOG_INFO, false);
+    router.add("flash", flashSink, LOG_INFO, true);
   }
-  return false;
+  return flashReady;
 }
 
 void appendLog(const String &s) {
-  if (!SPIFFS.begin()) {
-    // try to init once
-    SPIFFS.begin(true);
+  flashSink(LOG_INFO, s.c_str(), s.length(), true);
+}
+
+void logWrite(LogLevel level, const char* text, size_t len, bool eol) {
+  router.write(level, text, len, eol);
+}
+
+bool logAddSink(const char* name, LogSinkFn fn, LogLevel level, bool lines) {
+  return router.add(name, fn, level, lines);
+}
+
+bool logSetLevel(const char* sink, LogLevel level) {
+  return router.setLevel(sink, level);
+}
+
+bool logEnabled(LogLevel level) {
+  return router.enabled(level);
+}
+
+// Target of the LOG_x macros: "<E|W|I|D> <module>: <text>", formatted on the
+// stack and only if some sink takes the level
+void logEmit(LogLevel level, LogModule module, const char* fmt, ...) {
+  if (!router.enabled(level)) return;
+  char line[LOG_LINE_LEN];
+  int n = snprintf(line, sizeof(line), "%c %s: ", "-EWID"[level], logModuleName(module));
+  va_list ap;
+  va_start(ap, fmt);
+  int m = vsnprintf(line + n, sizeof(line) - n, fmt, ap);
+  va_end(ap);
+  size_t len = n + (m > 0 ? m : 0);
+  if (len >= sizeof(line)) len = sizeof(line) - 1;
+  router.write(level, line, len, true);
+}
+
+bool logSetModuleLevelByName(const char* module, LogLevel level) {
+  LogModule m;
+  if (!logModuleParse(module, m)) return false;
+  logSetModuleLevel(m, level);
+  return true;
+}
+
+void logFlush() {
+  if (!flashReady || !flashBuffer.pending()) return;
+  File f = SPIFFS.open(LOG_FILE, FILE_APPEND);
+  if (!f) {
+    flashErrors++;
+    return;
   }
-  File f = SPIFFS.open("/logs.txt", FILE_APPEND);
-  if (!f) return;
-  String line = String(millis()) + ": " + s + "\n";
-  f.print(line);
+  FileWriter w = { f };
+  if (flashBuffer.flush(w)) flashWrites++;
+  else flashErrors++;
+  size_t size = f.size();
   f.close();
+  if (size > LOG_FILE_MAX) {
+    SPIFFS.remove(LOG_FILE_OLD);
+    SPIFFS.rename(LOG_FILE, LOG_FILE_OLD);
+  }
+}
+
+void logTick() {
+  if (flashBuffer.due(millis())) logFlush();
 }
 
+// The rotated part first, so lines stay in order
 String readLogs() {
-  if (!SPIFFS.begin()) return String();
-  File f = SPIFFS.open("/logs.txt", FILE_READ);
-  if (!f) return String();
+  if (!flashReady) return String();
+  logFlush();
+  const char* files[2] = { LOG_FILE_OLD, LOG_FILE };
   String out;
-  while (f.available()) {
-    out += (char)f.read();
+  for (int i = 0; i < 2; ++i) {
+    if (!SPIFFS.exists(files[i])) continue;
+    File f = SPIFFS.open(files[i], FILE_READ);
+    if (!f) continue;
+    out.reserve(out.length() + f.size());
+    while (f.available()) {
+      out += (char)f.read();
+    }
+    f.close();
   }
-  f.close();
   return out;
 }
+
+String logSinksJson() {
+  String s = "{\"sinks\":[";
+  for (size_t i = 0; i < router.size(); ++i) {
+    const LogRouter<LOG_MAX_SINKS, LOG_LINE_LEN>::Sink &k = router.sink(i);
+    if (i) s += ",";
+    s += String("{\"name\":\"") + k.name + "\",\"level\":\"" + logLevelName(k.level) + "\"";
+    s += ",\"written\":" + String(k.written) + ",\"filtered\":" + String(k.filtered) + "}";
+  }
+  s += "],\"flash\":{\"pending\":" + String((unsigned long)flashBuffer.pending());
+  s += ",\"writes\":" + String(flashWrites) + ",\"errors\":" + String(flashErrors);
+  s += ",\"dropped\":" + String(flashBuffer.droppedLines()) + "}";
+  s += ",\"truncated\":" + String(router.truncatedFragments());
+  s += ",\"modules\":{";
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) {
+    if (i) s += ",";
+    s += String("\"") + logModuleName((LogModule)i) + "\":\"" + logLevelName(logModuleLevel((LogModule)i)) + "\"";
+  }
+  s += "}}";
+  return s;
+}
@@ -1,4 +1,4 @@
-// Greenhouse application scaffold (diagnostic probe variant)
+// Greenhouse application
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
 #include <time.h>
@@ -8,32 +8,186 @@
 #include "pins.h"
 #include "scheduler.h"
 #include "sensor.h"
+#include "thermostat.h"
+#include "automation.h"
+#include "mqtt.h"
+#include "heap_debug.h"
+#include "perf.h"
+#include "watchdog.h"
+#include "storage.h"
+#include "boot.h"
+#include "wifi_manager.h"
+#include "net_config.h"
+#include "time_service.h"
+#include "ota.h"
+#include <WiFi.h>
+
+#include "led.h"
+#include "serial_utils.h"
+#include "serial_cmds.h"
 
 void setup() {
+  // Stage 1, control: nothing here waits on the network or a sensor
+  // relays off before anything else can take time
+  relaysBegin();
+  // allocations are tagged per module from here on
+  heapDebugBegin();
+  perfBegin();
+  // USB CDC is not waited for: log lines before a host attaches still reach
+  // the flash log
   Serial.begin(9600);
-  // brief pause to allow USB CDC enumeration on some hosts
-  delay(200);
+  // start a secondary UART (Serial1) on configurable pins
+  Serial1.begin(9600, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+
+  // one SPIFFS mount for every module, after undoing a filesystem update
+  // that a reset cut short
+  otaRecoverFs();
+  bool mounted = storageBegin();
+  // Initialize SPIFFS logging (logs of previous runs: /logs)
+  initLogging();
+  LOG_I(LOGM_MAIN, "=== Greenhouse app starting ===");
+  LOG_I(LOGM_MAIN, "Build: %s", __TIMESTAMP__);
+  if (!mounted) LOG_E(LOGM_MAIN, "SPIFFS mount failed, settings not loaded");
+
+  // time zone, and the clock if the RTC kept it through the reset
+  timeBegin();
+
+  // Initialize LED
+  initLed();
+  relaysRestore();
+  // thermostat, automation (daily lights and irrigation) and schedules
+  thermostatBegin();
+  automationBegin();
+  schedulerBegin();
+  // start sensor (DHT22): first read on the first loop()
+  sensorBegin();
 
-  // Boot marker
-  Serial.println("=== PROBE START ===");
+  // Serial command handler
+  serialCmdsBegin();
 
-  // Aggressive boot burst: print many lines quickly to force host visibility
-  for (int i = 0; i < 200; ++i) {
-    char buf[64];
-    snprintf(buf, sizeof(buf), "BOOT_BURST %03d: alive", i);
-    Serial.println(buf);
+  // supervise loop(): reports a watchdog reset of the previous boot
+  watchdogBegin();
+  // firmware fresh from an OTA update runs on trial until it proves healthy
+  otaBegin();
+  bootMark(BOOT_CONTROL_READY);
+
+  // Stage 2, network: comes up in the background (wifiManagerTick, mqttLoop)
+  // with the site settings of /network.json over the config.h defaults
+  netConfigBegin();
+  bootNetworkBegin();
+  webBegin();
+  // MQTT (connects in the background from mqttLoop)
+  mqttBegin();
+
+  LOG_I(LOGM_MAIN, "Initialization complete");
+}
+
+// Print WiFi status every 3 seconds using the same color-logic as the RGB LED
+static unsigned long _wifiStatusLastPrint = 0;
+static void wifiStatusPrintTick() {
+  unsigned long now = millis();
+  if (now - _wifiStatusLastPrint < 3000) return;
+  _wifiStatusLastPrint = now;
+  if (wifiConnected()) {
+    LOG_D(LOGM_WIFI, "[BLUE] WiFi connected, IP: %s", WiFi.localIP().toString().c_str());
+    setPixelColorRGB(0, 0, 255);
+  } else if (wifiApActive()) {
+    LOG_D(LOGM_WIFI, "[PURPLE] WiFi access point, IP: %s", WiFi.softAPIP().toString().c_str());
+    setPixelColorRGB(128, 0, 128);
+  } else {
+    // if an SSID is configured we assume it's attempting to connect (green),
+    // otherwise it's effectively disconnected (red)
+    String ssid = WiFi.SSID();
+    if (ssid.length() > 0) {
+      LOG_D(LOGM_WIFI, "[GREEN] WiFi connecting to '%s'...", ssid.c_str());
+      setPixelColorRGB(0, 255, 0);
+    } else {
+      LOG_D(LOGM_WIFI, "[RED] WiFi disconnected");
+      setPixelColorRGB(255, 0, 0);
+    }
   }
-  Serial.flush();
 }
 
 void loop() {
-  static unsigned long last = 0;
+  perfLoopStart();
   unsigned long now = millis();
-  // Faster heartbeat to confirm ongoing activity
-  if (now - last >= 500) {
-    last = now;
-    Serial.println("PROBE: alive");
-    Serial.flush();
+  // Periodic diagnostic heartbeat to help verify serial output (every 1s)
+  static unsigned long _diagLast = 0;
+  if (now - _diagLast >= 1000) {
+    _diagLast = now;
+    LOG_D(LOGM_MAIN, "DIAG: alive");
+  }
+
+  // Each subsystem runs in a PerfScope: its time goes to /debug/perf and its
+  // allocations to /debug/heap
+  // sample the DHT sensors (every 2 s); everyone else reads the cache
+  { PerfScope s(LOGM_SENSOR); sensorTick(); }
+
+  // Handle web requests frequently (also pushes state changes to SSE clients)
+  // and a slice of a running OTA upload
+  {
+    PerfScope s(LOGM_WEB);
+    webHandle();
+    otaTick();
   }
+
+  // Clock (jump events, NTP syncs), then the schedules once per minute
+  // when the time is known
+  {
+    PerfScope s(LOGM_SCHEDULER);
+    timeTick();
+    schedulerLoop();
+  }
+
+  // thermostat loop (controls relay 1 if enabled)
+  { PerfScope s(LOGM_THERMOSTAT); thermostatLoop(); }
+
+  // relays background tasks (e.g. enforce lights min duration)
+  { PerfScope s(LOGM_RELAYS); relaysTick(); }
+  // automation tick
+  { PerfScope s(LOGM_AUTOMATION); automationTick(); }
+
+  // Wi-Fi manager (scan/connect/backoff); WiFi status periodically
+  // (matches LED color logic)
+  {
+    PerfScope s(LOGM_WIFI);
+    wifiManagerTick();
+    wifiStatusPrintTick();
+  }
+
+  // Print current time (local if available via NTP) every 2 seconds
+  static unsigned long _timeLast = 0;
+  if (millis() - _timeLast >= 2000) {
+    _timeLast = millis();
+    struct tm timeinfo;
+    if (timeLocal(timeinfo)) {
+      char buf[64];
+      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+      LOG_D(LOGM_MAIN, "Hora: %s", buf);
+    } else {
+      // fallback: uptime
+      unsigned long s = (unsigned long)(timeMonoMs() / 1000);
+      unsigned long hh = s / 3600;
+      unsigned long mm = (s % 3600) / 60;
+      unsigned long ss = s % 60;
+      LOG_D(LOGM_MAIN, "Uptime: %02lu:%02lu:%02lu", hh, mm, ss);
+    }
+  }
+
+  // MQTT background maintenance (reconnect state machine, backlog replay)
+  { PerfScope s(LOGM_MQTT); mqttLoop(); }
+
+  {
+    PerfScope s(LOGM_MAIN);
+    // write buffered log lines to flash when due
+    logTick();
+    // serial command processing (reads Serial / Serial1)
+    serialCmdsLoop();
+    // periodic free heap / largest block / fragmentation log line
+    heapDebugTick();
+  }
+  perfLoopEnd();
+
+  // Small yield to allow background tasks (outside the loop's busy time)
   delay(10);
-}
\ No newline at end of file
+}
@@ -1,3 +0,0 @@
-// Disabled backup of original main; file intentionally left empty so it
-// does not introduce duplicate `setup()`/`loop()` symbols during build.
-
@@ -0,0 +1,481 @@
+#include "mqtt.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <PubSubClient.h>
+#include <ArduinoJson.h>
+#include <SPIFFS.h>
+#include <lwip/dns.h>
+#include "config.h"
+#include "relays.h"
+#include "relay_journal.h"
+#include "sensor.h"
+#include "thermostat.h"
+#include "automation.h"
+#include "serial_utils.h"
+#include "commands.h"
+#include "publish_queue.h"
+#include "telemetry_filter.h"
+#include "boot.h"
+#include "wifi_manager.h"
+#include "net_config.h"
+#include "watchdog_deadlines.h"
+
+#if MQTT_USE_TLS
+static WiFiClientSecure net;
+#else
+static WiFiClient net;
+#endif
+static PubSubClient client(net);
+
+// Publishes made while offline: RAM first, then appended to flash in batches
+typedef PublishQueue<16, 16, 240> MqttQueue;
+static MqttQueue queue;
+static MqttQueue::Msg replayMsg;
+static const char* SPILL_FILE = "/mqtt_queue.bin";
+static const size_t SPILL_MAX_BYTES = 32 * 1024;
+// replay a few messages per loop() so control is not starved after an outage
+static const size_t REPLAY_PER_LOOP = 8;
+
+static const unsigned long BACKOFF_MIN_MS = 1000;
+static const unsigned long BACKOFF_MAX_MS = 60000;
+// The only blocking steps of an attempt are bounded by the timeouts of
+// include/watchdog_deadlines.h (which sizes the watchdog deadline of this
+// module from them), and an attempt is made at most once per backoff period.
+// The broker name is looked up without blocking first: a DNS server that
+// does not answer would otherwise hold the loop for 15 s.
+static const unsigned long DNS_TIMEOUT_MS = 10000;
+static const uint16_t KEEPALIVE_S = 30;
+
+// Telemetry groups are sampled every 2 s and sent only when a value moves
+// past its deadband, or every 15 minutes as a heartbeat
+static const unsigned long TELEMETRY_SAMPLE_MS = 2000;
+static const uint32_t TELEMETRY_HEARTBEAT_MS = 15UL * 60UL * 1000UL;
+static TelemetryFilter<4, 16> telemetry;
+static int mInTemp, mInHum, mOutTemp, mOutHum;
+static int mRelay[6];
+static int mSetpoint, mHysteresis, mThermEnabled, mHeating;
+static int mAccumHours, mDli;
+static unsigned long lastSample = 0;
+
+enum MqttState : uint8_t {
+  MQTT_WAIT_WIFI = 0,
+  MQTT_BACKOFF,
+  MQTT_RESOLVE,      // broker name lookup in flight
+  MQTT_TCP_CONNECT,  // next pass opens the socket
+  MQTT_SESSION,      // socket open, next pass sends CONNECT
+  MQTT_CONNECTED,
+};
+
+static MqttState state = MQTT_WAIT_WIFI;
+static unsigned long stateSince = 0;
+static unsigned long backoffMs = BACKOFF_MIN_MS;
+static unsigned long retryDelayMs = 0;
+static uint32_t connects = 0;
+static uint32_t failures = 0;
+static uint32_t dropped = 0;
+static uint32_t replayed = 0;
+static uint32_t publishCount = 0;
+static uint32_t publishBytes = 0;
+static size_t spillBytes = 0;    // size of SPILL_FILE
+static size_t spillReadPos = 0;  // next record to replay from SPILL_FILE
+static uint32_t relayCursor = 0;
+static String baseTopic;
+static String clientId;
+static String deviceId;   // MAC without colons
+// QoS1 may deliver a command twice; remember hashes of recent command ids
+static bool reconfigure = false;   // broker settings changed: reconnect
+static uint32_t recentCmdIds[8];
+static uint8_t recentCmdNext = 0;
+
+static const char* stateName(MqttState s) {
+  switch (s) {
+    case MQTT_WAIT_WIFI: return "wait_wifi";
+    case MQTT_BACKOFF: return "backoff";
+    case MQTT_RESOLVE: return "resolve";
+    case MQTT_TCP_CONNECT: return "tcp_connect";
+    case MQTT_SESSION: return "session";
+    default: return "connected";
+  }
+}
+
+static void setState(MqttState s) {
+  state = s;
+  stateSince = millis();
+}
+
+// Broker lookup: lwIP answers from its cache at once or calls back from its
+// own task. A lookup that timed out may still call back, hence the number.
+enum DnsResult : uint8_t { DNS_PENDING, DNS_FOUND, DNS_FAILED };
+static volatile uint8_t dnsResult = DNS_PENDING;
+static volatile uint32_t dnsLookup = 0;
+
+static void onDnsFound(const char*, const ip_addr_t *addr, void *arg) {
+  if ((uint32_t)(uintptr_t)arg == dnsLookup) dnsResult = addr ? DNS_FOUND : DNS_FAILED;
+}
+
+// Afterwards the name is in the lwIP cache, so net.connect() does not wait
+// on DNS again
+static void startLookup() {
+  ip_addr_t addr;
+  dnsResult = DNS_PENDING;
+  uint32_t n = dnsLookup + 1;
+  dnsLookup = n;
+  err_t err = dns_gethostbyname(netConfig().mqttServer, &addr, onDnsFound, (void*)(uintptr_t)n);
+  if (err == ERR_OK) dnsResult = DNS_FOUND;
+  else if (err != ERR_INPROGRESS) dnsResult = DNS_FAILED;
+  setState(MQTT_RESOLVE);
+}
+
+static bool publishNow(const char* subtopic, const char* payload, size_t len, bool retain) {
+  String topic = baseTopic + "/" + subtopic;
+  if (!client.publish(topic.c_str(), (const uint8_t*)payload, len, retain)) return false;
+  publishCount++;
+  publishBytes += topic.length() + len;
+  return true;
+}
+
+static bool publishNow(const MqttQueue::Msg &m) {
+  return publishNow(m.topic, m.payload, m.payloadLen, m.retain);
+}
+
+// Move the RAM queue to the end of the spill file (one flash write per batch)
+static void spillQueue() {
+  File f = SPIFFS.open(SPILL_FILE, FILE_APPEND);
+  while (!queue.empty()) {
+    const MqttQueue::Msg &m = queue.front();
+    size_t n = m.recordSize();
+    if (f && spillBytes + n <= SPILL_MAX_BYTES && m.write(f)) spillBytes += n;
+    else dropped++;
+    queue.pop();
+  }
+  if (f) f.close();
+}
+
+// Replay the backlog oldest first: spill file, then RAM queue
+static void replayBacklog() {
+  size_t sent = 0;
+  if (spillBytes > 0) {
+    File f = SPIFFS.open(SPILL_FILE, FILE_READ);
+    bool done = true;
+    if (f && f.seek(spillReadPos)) {
+      while (replayMsg.read(f)) {
+        if (!publishNow(replayMsg)) { f.close(); return; }
+        spillReadPos += replayMsg.recordSize();
+        replayed++;
+        if (++sent == REPLAY_PER_LOOP) { done = spillReadPos >= spillBytes; break; }
+      }
+    }
+    if (f) f.close();
+    if (!done) return;
+    // end of file (or a torn record from a power cut): start over
+    SPIFFS.remove(SPILL_FILE);
+    spillBytes = 0;
+    spillReadPos = 0;
+  }
+  while (sent < REPLAY_PER_LOOP && !queue.empty()) {
+    if (!publishNow(queue.front())) return;
+    queue.pop();
+    replayed++;
+    sent++;
+  }
+}
+
+bool mqttPublish(const char* subtopic, const String &payload, bool retain, bool queueIfOffline) {
+  bool backlog = !queue.empty() || spillBytes > 0;
+  if (state == MQTT_CONNECTED && !backlog &&
+      publishNow(subtopic, payload.c_str(), payload.length(), retain)) return true;
+  if (!queueIfOffline) return false;
+  if (queue.full()) spillQueue();
+  if (!queue.push(subtopic, payload.c_str(), payload.length(), retain)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+bool mqttConnected() {
+  return state == MQTT_CONNECTED;
+}
+
+// rc: PubSubClient state for a refused CONNECT, 0 otherwise
+static void scheduleRetry(const char* why, int rc = 0) {
+  failures++;
+  client.disconnect();
+  net.stop();
+  // exponential backoff with +-25% jitter so boards do not retry in lockstep
+  unsigned long jitter = backoffMs / 4;
+  retryDelayMs = backoffMs - jitter + (unsigned long)random((long)(2 * jitter + 1));
+  backoffMs = min(backoffMs * 2, BACKOFF_MAX_MS);
+  LOG_W(LOGM_MQTT, "%s (rc=%d), retry in %lu ms", why, rc, retryDelayMs);
+  setState(MQTT_BACKOFF);
+}
+
+static uint32_t hashId(const String &s) {
+  uint32_t h = 2166136261UL; // FNV-1a
+  for (size_t i = 0; i < s.length(); ++i) { h ^= (uint8_t)s[i]; h *= 16777619UL; }
+  return h ? h : 1;
+}
+
+// A command published with retain (the dashboard's "send retained") would
+// come back on every resubscribe and run again: an empty retained message
+// clears it. That one arrives here too, and is ignored as it does not parse.
+static void clearRetainedCmd() {
+  publishNow("cmd", "", 0, true);
+}
+
+static void onMessage(char* topic, byte* payload, unsigned int length) {
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, payload, length)) return;
+  const char* cmd = doc["cmd"];
+  if (!cmd) return;
+  // optional "id" (string or number) makes redelivered commands idempotent
+  String id;
+  if (!doc["id"].isNull()) {
+    serializeJson(doc["id"], id);
+    uint32_t h = hashId(id);
+    for (uint8_t i = 0; i < 8; ++i) {
+      if (recentCmdIds[i] == h) {
+        clearRetainedCmd();
+        return;
+      }
+    }
+    recentCmdIds[recentCmdNext] = h;
+    recentCmdNext = (recentCmdNext + 1) % 8;
+  }
+  LOG_I(LOGM_MQTT, "RX [%s] %s", topic, cmd);
+  String reply;
+  bool ok = commandRunJson(doc.as<JsonObjectConst>(), RELAY_SRC_MQTT, reply);
+  // after the run: publishing reuses the client buffer the payload is in
+  clearRetainedCmd();
+  if (id.length()) {
+    // the full reply can be large (automation JSON); acks carry status only
+    String ack = String("{\"id\":") + id + ",\"ok\":" + (ok ? "1" : "0");
+    if (!ok) ack += ",\"reply\":" + reply;
+    mqttPublish("ack", ack + "}");
+  }
+}
+
+static void telemetryBegin() {
+  int g = telemetry.addGroup("sensor", TELEMETRY_HEARTBEAT_MS);
+  mInTemp = telemetry.addMetric(g, "inTemp", 0.2f, 1);
+  mInHum = telemetry.addMetric(g, "inHum", 1.0f, 0);
+  mOutTemp = telemetry.addMetric(g, "outTemp", 0.2f, 1);
+  mOutHum = telemetry.addMetric(g, "outHum", 1.0f, 0);
+  g = telemetry.addGroup("relays", TELEMETRY_HEARTBEAT_MS);
+  static const char* relayKeys[6] = { "ch1", "ch2", "ch3", "ch4", "ch5", "ch6" };
+  for (int i = 0; i < 6; ++i) mRelay[i] = telemetry.addMetric(g, relayKeys[i], 0, 0);
+  g = telemetry.addGroup("thermostat", TELEMETRY_HEARTBEAT_MS);
+  mSetpoint = telemetry.addMetric(g, "setpoint", 0.05f, 1);
+  mHysteresis = telemetry.addMetric(g, "hysteresis", 0.05f, 2);
+  mThermEnabled = telemetry.addMetric(g, "enabled", 0, 0);
+  mHeating = telemetry.addMetric(g, "heating", 0, 0);
+  g = telemetry.addGroup("automation", TELEMETRY_HEARTBEAT_MS);
+  mAccumHours = telemetry.addMetric(g, "accumHours", 0.05f, 2);
+  mDli = telemetry.addMetric(g, "dli", 0.05f, 2);
+}
+
+static void telemetrySample() {
+  telemetry.set(mInTemp, readTemperatureC(false));
+  telemetry.set(mInHum, readHumidity(false));
+  telemetry.set(mOutTemp, readTemperatureC(true));
+  telemetry.set(mOutHum, readHumidity(true));
+  for (int i = 0; i < 6; ++i) telemetry.set(mRelay[i], getRelay(i + 1) ? 1 : 0);
+  telemetry.set(mSetpoint, getThermostatSetpoint());
+  telemetry.set(mHysteresis, getThermostatHysteresis());
+  telemetry.set(mThermEnabled, getThermostatEnabled() ? 1 : 0);
+  telemetry.set(mHeating, getThermostatHeating() ? 1 : 0);
+  telemetry.set(mAccumHours, getDailyLightHours());
+  telemetry.set(mDli, getDailyLightIntegral());
+}
+
+// Publish each group that changed or reached its heartbeat as one retained
+// JSON object. Telemetry is state, so it is never queued while offline; all
+// groups are sent again after reconnecting.
+static void telemetryTick() {
+  unsigned long now = millis();
+  if (now - lastSample < TELEMETRY_SAMPLE_MS) return;
+  lastSample = now;
+  telemetrySample();
+  char buf[160];
+  for (size_t g = 0; g < telemetry.groups(); ++g) {
+    if (!telemetry.due((int)g, now)) continue;
+    size_t n = telemetry.format((int)g, buf, sizeof(buf));
+    if (n && publishNow(telemetry.groupName((int)g), buf, n, true)) telemetry.markSent((int)g, now);
+  }
+}
+
+// Home Assistant discovery: one retained config per entity, using the short
+// key names HA accepts ("~" expands to the base topic) to stay under the
+// client buffer. Entities read the retained telemetry groups and relays are
+// switched through the same "cmd" topic as every other command.
+static bool publishDiscoveryConfig(const char* component, const char* objectId, const String &body) {
+  String topic = String(MQTT_DISCOVERY_PREFIX) + "/" + component + "/gh_" + deviceId + "/" + objectId + "/config";
+  String payload = "{\"~\":\"" + baseTopic + "\",\"uniq_id\":\"gh_" + deviceId + "_" + objectId + "\"";
+  payload += ",\"avty_t\":\"~/online\",\"pl_avail\":\"1\",\"pl_not_avail\":\"0\"";
+  payload += ",\"dev\":{\"ids\":[\"gh_" + deviceId + "\"],\"name\":\"Invernadero " + deviceId.substring(6) + "\",\"mf\":\"DIY\",\"mdl\":\"ESP32-S3 greenhouse\"}";
+  payload += "," + body + "}";
+  if (!client.publish(topic.c_str(), (const uint8_t*)payload.c_str(), payload.length(), true)) return false;
+  publishCount++;
+  publishBytes += topic.length() + payload.length();
+  return true;
+}
+
+static void publishSensorConfig(const char* key, const char* group, const char* name,
+                                const char* devClass, const char* unit) {
+  String body = String("\"name\":\"") + name + "\",\"stat_t\":\"~/" + group + "\"";
+  body += String(",\"val_tpl\":\"{{ value_json.") + key + " }}\"";
+  if (devClass) body += String(",\"dev_cla\":\"") + devClass + "\",\"stat_cla\":\"measurement\"";
+  if (unit) body += String(",\"unit_of_meas\":\"") + unit + "\"";
+  publishDiscoveryConfig("sensor", key, body);
+}
+
+static void publishDiscovery() {
+  if (!strlen(MQTT_DISCOVERY_PREFIX)) return;
+  for (int ch = 1; ch <= 6; ++ch) {
+    String id = String("ch") + ch;
+    String body = "\"name\":\"Rele " + String(ch) + "\",\"stat_t\":\"~/relays\"";
+    body += ",\"val_tpl\":\"{{ value_json." + id + " }}\",\"stat_on\":\"1\",\"stat_off\":\"0\"";
+    body += ",\"cmd_t\":\"~/cmd\"";
+    body += ",\"pl_on\":\"{\\\"cmd\\\":\\\"relay\\\",\\\"ch\\\":" + String(ch) + ",\\\"state\\\":\\\"on\\\"}\"";
+    body += ",\"pl_off\":\"{\\\"cmd\\\":\\\"relay\\\",\\\"ch\\\":" + String(ch) + ",\\\"state\\\":\\\"off\\\"}\"";
+    publishDiscoveryConfig("switch", id.c_str(), body);
+  }
+  publishSensorConfig("inTemp", "sensor", "Temperatura interior", "temperature", "°C");
+  publishSensorConfig("inHum", "sensor", "Humedad interior", "humidity", "%");
+  publishSensorConfig("outTemp", "sensor", "Temperatura exterior", "temperature", "°C");
+  publishSensorConfig("outHum", "sensor", "Humedad exterior", "humidity", "%");
+  publishSensorConfig("setpoint", "thermostat", "Consigna termostato", "temperature", "°C");
+  publishSensorConfig("accumHours", "automation", "Horas de luz hoy", "duration", "h");
+  publishSensorConfig("dli", "automation", "DLI", 0, "mol/m²/d");
+  publishDiscoveryConfig("binary_sensor", "heating",
+    "\"name\":\"Calefaccion\",\"stat_t\":\"~/thermostat\",\"val_tpl\":\"{{ value_json.heating }}\","
+    "\"pl_on\":\"1\",\"pl_off\":\"0\",\"dev_cla\":\"heat\"");
+}
+
+// Queue every relay transition, also while offline, so the broker sees them all
+static void pumpRelayEvents() {
+  uint32_t head = relayJournalHead();
+  RelayEvent e;
+  while (relayCursor != head) {
+    if (relayJournalGet(relayCursor, e)) mqttPublish("relay", relayEventJson(relayCursor, e));
+    relayCursor++;
+  }
+}
+
+void mqttBegin() {
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  deviceId = mac;
+  baseTopic = String("greenhouse/") + mac;
+  clientId = String("gh-") + mac;
+#if MQTT_USE_TLS
+  // No CA configured: accept any certificate (see README, Security)
+  net.setInsecure();
+  net.setHandshakeTimeout(MQTT_TLS_HANDSHAKE_S);
+#endif
+  // PubSubClient keeps the pointer: netConfig() storage outlives the client
+  client.setServer(netConfig().mqttServer, netConfig().mqttPort);
+  client.setCallback(onMessage);
+  client.setBufferSize(768);  // discovery configs are the largest messages
+  client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  client.setKeepAlive(KEEPALIVE_S);
+  // backlog left over from before a reboot is replayed after connecting
+  if (SPIFFS.exists(SPILL_FILE)) {
+    File f = SPIFFS.open(SPILL_FILE, FILE_READ);
+    if (f) { spillBytes = f.size(); f.close(); }
+  }
+  relayCursor = relayJournalHead();
+  telemetryBegin();
+  setState(MQTT_WAIT_WIFI);
+  LOG_I(LOGM_MQTT, "broker %s:%u, topics %s/#", netConfig().mqttServer, netConfig().mqttPort, baseTopic.c_str());
+}
+
+void mqttReconfigure() {
+  reconfigure = true;
+}
+
+void mqttLoop() {
+  pumpRelayEvents();
+  bool wifiUp = wifiConnected();
+  if (reconfigure) {
+    reconfigure = false;
+    client.disconnect();
+    net.stop();
+    client.setServer(netConfig().mqttServer, netConfig().mqttPort);
+    backoffMs = BACKOFF_MIN_MS;
+    LOG_I(LOGM_MQTT, "broker now %s:%u, reconnecting", netConfig().mqttServer, netConfig().mqttPort);
+    setState(MQTT_WAIT_WIFI);
+    return;
+  }
+  if (!wifiUp && state != MQTT_WAIT_WIFI) {
+    client.disconnect();
+    net.stop();
+    setState(MQTT_WAIT_WIFI);
+    return;
+  }
+  switch (state) {
+    case MQTT_WAIT_WIFI:
+      if (wifiUp) startLookup();
+      break;
+    case MQTT_BACKOFF:
+      if (millis() - stateSince >= retryDelayMs) startLookup();
+      break;
+    case MQTT_RESOLVE:
+      if (dnsResult == DNS_FOUND) setState(MQTT_TCP_CONNECT);
+      else if (dnsResult == DNS_FAILED) scheduleRetry("broker name not found");
+      else if (millis() - stateSince >= DNS_TIMEOUT_MS) scheduleRetry("DNS timeout");
+      break;
+    case MQTT_TCP_CONNECT:
+      if (net.connect(netConfig().mqttServer, netConfig().mqttPort, MQTT_TCP_CONNECT_MS)) setState(MQTT_SESSION);
+      else scheduleRetry("TCP connect failed");
+      break;
+    case MQTT_SESSION: {
+      // Socket is already open, so connect() only sends CONNECT and waits for
+      // CONNACK (bounded by the socket timeout). Persistent session: the
+      // broker keeps QoS1 commands sent while we were away.
+      String willTopic = baseTopic + "/online";
+      const NetSettings &n = netConfig();
+      const char* user = n.mqttUser[0] ? n.mqttUser : nullptr;
+      const char* pass = n.mqttPass[0] ? n.mqttPass : nullptr;
+      if (client.connect(clientId.c_str(), user, pass, willTopic.c_str(), 1, true, "0", false)) {
+        connects++;
+        backoffMs = BACKOFF_MIN_MS;
+        client.subscribe((baseTopic + "/cmd").c_str(), 1);
+        client.publish(willTopic.c_str(), "1", true);
+        publishDiscovery();
+        LOG_I(LOGM_MQTT, "connected");
+        setState(MQTT_CONNECTED);
+        bootMark(BOOT_MQTT);
+        telemetry.invalidate();
+        lastSample = millis() - TELEMETRY_SAMPLE_MS;
+      } else {
+        scheduleRetry("connect failed", client.state());
+      }
+      break;
+    }
+    case MQTT_CONNECTED:
+      if (!client.loop()) {
+        scheduleRetry("connection lost");
+        break;
+      }
+      replayBacklog();
+      telemetryTick();
+      break;
+  }
+}
+
+String mqttStatusJson() {
+  String s = "{\"state\":\"" + String(stateName(state)) + "\"";
+  s += ",\"server\":\"" + String(netConfig().mqttServer) + "\",\"port\":" + String(netConfig().mqttPort);
+  s += ",\"connects\":" + String(connects);
+  s += ",\"failures\":" + String(failures);
+  s += ",\"retryMs\":" + String(state == MQTT_BACKOFF ? retryDelayMs : 0UL);
+  s += ",\"queued\":" + String((unsigned long)queue.size());
+  s += ",\"spillBytes\":" + String((unsigned long)(spillBytes - spillReadPos));
+  s += ",\"replayed\":" + String(replayed);
+  s += ",\"dropped\":" + String(dropped);
+  s += ",\"published\":" + String(publishCount);
+  s += ",\"publishedBytes\":" + String(publishBytes);
+  s += "}";
+  return s;
+}
@@ -0,0 +1,22 @@
+// MQTT client: delta-only telemetry to greenhouse/<mac>/{sensor,relays,
+// thermostat,automation} (retained), relay events to .../relay, commands from
+// greenhouse/<mac>/cmd (QoS1, persistent session). Reconnects with backoff
+// without stalling loop(); publishes made while offline are queued in RAM,
+// spilled to SPIFFS when the queue fills and replayed after reconnecting.
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <Arduino.h>
+
+void mqttBegin();
+void mqttLoop();
+// Broker or credentials changed in netConfig(): reconnect from the next loop
+void mqttReconfigure();
+bool mqttConnected();
+// Publish to greenhouse/<mac>/<subtopic>. With queueIfOffline the message is
+// kept until the broker is reachable again (in order); otherwise it is dropped.
+// Returns false only if the message was dropped.
+bool mqttPublish(const char* subtopic, const String &payload, bool retain = false, bool queueIfOffline = true);
+String mqttStatusJson();
+
+#endif // MQTT_H
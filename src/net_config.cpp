@@ -0,0 +1,198 @@
+#include "net_config.h"
+#include "config.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "storage.h"
+#include "wifi_manager.h"
+#include "mqtt.h"
+#include <SPIFFS.h>
+#include <ArduinoJson.h>
+
+static const char* NET_FILE = "/network.json";
+
+static NetSettings active;
+static NetSettings staged;
+static bool pending = false;
+
+static void copyIp(uint8_t out[4], const IPAddress &ip) {
+  for (int i = 0; i < 4; ++i) out[i] = ip[i];
+}
+
+static void loadDefaults(NetSettings &s) {
+  memset(&s, 0, sizeof(s));
+  netCopy(s.ssid[0], sizeof(s.ssid[0]), WIFI_SSID);
+  netCopy(s.pass[0], sizeof(s.pass[0]), WIFI_PASS);
+  netCopy(s.ssid[1], sizeof(s.ssid[1]), WIFI_SSID_2);
+  netCopy(s.pass[1], sizeof(s.pass[1]), WIFI_PASS_2);
+  netCopy(s.ssid[2], sizeof(s.ssid[2]), WIFI_SSID_3);
+  netCopy(s.pass[2], sizeof(s.pass[2]), WIFI_PASS_3);
+  s.staticIp = true;
+  copyIp(s.ip, STATIC_IP);
+  copyIp(s.gateway, STATIC_GATEWAY);
+  copyIp(s.subnet, STATIC_SUBNET);
+  copyIp(s.dns, STATIC_DNS);
+  netCopy(s.mqttServer, sizeof(s.mqttServer), MQTT_SERVER);
+  s.mqttPort = MQTT_PORT;
+  netCopy(s.mqttUser, sizeof(s.mqttUser), MQTT_USER);
+  netCopy(s.mqttPass, sizeof(s.mqttPass), MQTT_PASS);
+  netCopy(s.apPass, sizeof(s.apPass), WIFI_AP_PASS);
+}
+
+static String ipText(const uint8_t ip[4]) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return String(buf);
+}
+
+// Each stored value goes through the same checks as net_set; a bad one
+// keeps the default
+static void setLoaded(NetSettings &s, uint8_t field, JsonVariantConst v) {
+  if (v.isNull()) return;
+  String text;
+  if (v.is<const char*>()) text = v.as<const char*>();
+  else serializeJson(v, text);   // numbers
+  const char* err = netSettingsSet(s, field, text.c_str());
+  if (err) LOG_W(LOGM_WIFI, "%s: %s", NET_FILE, err);
+}
+
+static void loadSettings(NetSettings &s) {
+  if (!storageReady() || !SPIFFS.exists(NET_FILE)) return;
+  File f = SPIFFS.open(NET_FILE, "r");
+  if (!f) return;
+  DynamicJsonDocument doc(1536);
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  if (err) {
+    LOG_E(LOGM_WIFI, "%s unreadable (%s), using defaults", NET_FILE, err.c_str());
+    return;
+  }
+  JsonArrayConst wifi = doc["wifi"];
+  for (uint8_t i = 0; i < NET_MAX_APS && i < wifi.size(); ++i) {
+    setLoaded(s, NET_SSID + 2 * i, wifi[i]["ssid"]);
+    setLoaded(s, NET_PASS + 2 * i, wifi[i]["pass"]);
+  }
+  setLoaded(s, NET_IP, doc["ip"]);
+  setLoaded(s, NET_GATEWAY, doc["gateway"]);
+  setLoaded(s, NET_SUBNET, doc["subnet"]);
+  setLoaded(s, NET_DNS, doc["dns"]);
+  setLoaded(s, NET_MQTT_SERVER, doc["mqtt"]["server"]);
+  setLoaded(s, NET_MQTT_PORT, doc["mqtt"]["port"]);
+  setLoaded(s, NET_MQTT_USER, doc["mqtt"]["user"]);
+  setLoaded(s, NET_MQTT_PASS, doc["mqtt"]["pass"]);
+  setLoaded(s, NET_AP_PASS, doc["apPass"]);
+}
+
+static bool saveSettings(const NetSettings &s) {
+  DynamicJsonDocument doc(1536);
+  JsonArray wifi = doc.createNestedArray("wifi");
+  for (uint8_t i = 0; i < NET_MAX_APS; ++i) {
+    JsonObject ap = wifi.createNestedObject();
+    ap["ssid"] = s.ssid[i];
+    ap["pass"] = s.pass[i];
+  }
+  doc["ip"] = s.staticIp ? ipText(s.ip) : String("dhcp");
+  doc["gateway"] = ipText(s.gateway);
+  doc["subnet"] = ipText(s.subnet);
+  doc["dns"] = ipText(s.dns);
+  JsonObject mqtt = doc.createNestedObject("mqtt");
+  mqtt["server"] = s.mqttServer;
+  mqtt["port"] = s.mqttPort;
+  mqtt["user"] = s.mqttUser;
+  mqtt["pass"] = s.mqttPass;
+  doc["apPass"] = s.apPass;
+  File f = SPIFFS.open(NET_FILE, "w");
+  if (!f) return false;
+  bool ok = serializeJson(doc, f) > 0;
+  f.close();
+  return ok;
+}
+
+void netConfigBegin() {
+  loadDefaults(active);
+  loadSettings(active);
+  staged = active;
+  LOG_I(LOGM_WIFI, "Network: %s, %s, MQTT %s:%u", active.ssid[0][0] ? active.ssid[0] : "(no primary SSID)",
+        active.staticIp ? ipText(active.ip).c_str() : "dhcp", active.mqttServer, active.mqttPort);
+}
+
+const NetSettings &netConfig() {
+  return active;
+}
+
+bool netConfigSet(uint8_t field, const char* value, String &err) {
+  if (!pending) staged = active;
+  const char* why = netSettingsSet(staged, field, value);
+  if (why) {
+    err = why;
+    return false;
+  }
+  pending = true;
+  return true;
+}
+
+void netConfigDefaults() {
+  loadDefaults(staged);
+  pending = true;
+}
+
+bool netConfigApply(String &err) {
+  if (!pending) return true;
+  if (!storageReady() || !saveSettings(staged)) {
+    err = "could not write /network.json";
+    return false;
+  }
+  uint8_t diff = netSettingsDiff(active, staged);
+  active = staged;
+  pending = false;
+  LOG_I(LOGM_WIFI, "Network settings saved%s%s%s", diff & NET_APPLY_WIFI ? ", WiFi reconnects" : "",
+        diff & NET_APPLY_AP ? ", access point updated" : "", diff & NET_APPLY_MQTT ? ", MQTT reconnects" : "");
+  if (diff & (NET_APPLY_WIFI | NET_APPLY_AP)) wifiManagerReconfigure(diff & NET_APPLY_WIFI, diff & NET_APPLY_AP);
+  if (diff & NET_APPLY_MQTT) mqttReconfigure();
+  return true;
+}
+
+static const char* masked(const char* secret) {
+  return secret[0] ? "***" : "";
+}
+
+static void settingsWrite(StructWriter &w, const NetSettings &s) {
+  w.beginMap();
+  w.key("wifi");
+  w.beginArray();
+  for (uint8_t i = 0; i < NET_MAX_APS; ++i) {
+    w.beginMap();
+    w.strField("ssid", s.ssid[i]);
+    w.strField("pass", masked(s.pass[i]));
+    w.endMap();
+  }
+  w.endArray();
+  w.strField("ip", s.staticIp ? ipText(s.ip).c_str() : "dhcp");
+  w.strField("gateway", ipText(s.gateway).c_str());
+  w.strField("subnet", ipText(s.subnet).c_str());
+  w.strField("dns", ipText(s.dns).c_str());
+  w.key("mqtt");
+  w.beginMap();
+  w.strField("server", s.mqttServer);
+  w.intField("port", s.mqttPort);
+  w.strField("user", s.mqttUser);
+  w.strField("pass", masked(s.mqttPass));
+  w.endMap();
+  w.strField("apPass", masked(s.apPass));
+  w.endMap();
+}
+
+void netConfigWrite(StructWriter &w) {
+  w.beginMap();
+  w.boolField("pending", pending);
+  w.key("active");
+  settingsWrite(w, active);
+  if (pending) {
+    w.key("staged");
+    settingsWrite(w, staged);
+  }
+  w.endMap();
+}
+
+String netConfigJson() {
+  return structToJson<String>(netConfigWrite);
+}
@@ -0,0 +1,29 @@
+// Site network settings (Wi-Fi networks, static IP, MQTT broker, fallback
+// AP password), kept in /network.json over the config.h defaults so one
+// image serves every site. Edits are staged with netConfigSet() and take
+// effect together on netConfigApply(): saved, then Wi-Fi and/or MQTT
+// reconnect with the new values, no reboot.
+#ifndef NET_CONFIG_H
+#define NET_CONFIG_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+#include "net_settings.h"
+
+// Loads /network.json; call after storageBegin(), before the Wi-Fi manager
+// and MQTT start
+void netConfigBegin();
+// Settings in effect
+const NetSettings &netConfig();
+
+// field: NetField; err gets the reason on failure
+bool netConfigSet(uint8_t field, const char* value, String &err);
+// Stage the config.h defaults
+void netConfigDefaults();
+bool netConfigApply(String &err);
+
+// {"pending":false,"active":{...},"staged":{...}}, passwords masked
+void netConfigWrite(StructWriter &w);
+String netConfigJson();
+
+#endif // NET_CONFIG_H
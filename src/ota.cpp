@@ -0,0 +1,608 @@
+#include "ota.h"
+#include "config.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "storage.h"
+#include "boot.h"
+#include "flash_writer.h"
+#include "ota_pack.h"
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <new>
+
+static const uint32_t FLASH_SECTOR = 4096;
+// a filesystem image without the dashboard is not the one we want
+#define FS_HEALTH_FILE "/web_dashboard.html"
+
+// A partition the way include/flash_writer.h uses it
+struct EspPartition {
+  const esp_partition_t *part;
+  uint32_t size() const { return part ? part->size : 0; }
+  bool erase(uint32_t off, uint32_t len) { return esp_partition_erase_range(part, off, len) == ESP_OK; }
+  bool write(uint32_t off, const uint8_t *p, size_t n) { return esp_partition_write(part, off, p, n) == ESP_OK; }
+  bool read(uint32_t off, uint8_t *p, size_t n) { return esp_partition_read(part, off, p, n) == ESP_OK; }
+};
+
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_RECEIVING,    // socket (-> unpacker) -> inactive app slot
+  OTA_BASE,         // delta: hashing the running firmware it applies to
+  OTA_VERIFYING,    // flash readback
+  OTA_SWAPPING,     // fs: staged image <-> live filesystem, a sector per loop
+  OTA_REBOOTING,    // reply sent, restart due
+  OTA_DONE,
+  OTA_FAILED,
+};
+static const char* const STATE_NAMES[] = { "idle", "receiving", "base", "verifying", "swapping", "rebooting", "done", "failed" };
+
+typedef FlashStreamWriter<EspPartition> Writer;
+typedef OtaUnpacker<EspPartition, Writer, OTA_LZ_WINDOW_BITS> Unpacker;
+
+// Both kinds are staged in the inactive app slot
+static EspPartition staging = { nullptr };
+static EspPartition fsPart = { nullptr };
+static Writer writer(staging);
+static WiFiClient uploader;
+// the upload: a plain image, or a pack (include/ota_pack.h) unpacked on the
+// way to the writer; its first bytes wait in `head` until that is known
+static uint32_t bodySize = 0;
+static uint32_t bodyReceived = 0;
+static uint8_t head[OTA_PACK_HEADER_SIZE];
+static size_t headFill = 0;
+static uint8_t imageDigest[Sha256::DIGEST_SIZE];
+static OtaPackHeader pack;
+static Unpacker* unpacker = nullptr;   // only while a pack streams in
+// delta: the running firmware is the base, hashed before anything is written
+static EspPartition running = { nullptr };
+static Sha256 baseSha;
+static uint32_t baseChecked = 0;
+static OtaState state = OTA_IDLE;
+static bool fsUpdate = false;
+static unsigned long startMs = 0;
+static unsigned long lastDataMs = 0;
+static unsigned long rebootAtMs = 0;
+static String lastError;
+// Site settings an fs image must not replace: read before the swap, written
+// back over whatever the image brings once the new filesystem is mounted
+static const char* const KEEP_FILES[] = {
+  "/network.json", "/time.json", "/schedules.json", "/automation.json", "/thermostat.json", "/relays_state.json",
+};
+static const size_t KEEP_COUNT = sizeof(KEEP_FILES) / sizeof(KEEP_FILES[0]);
+static uint8_t* keptData[KEEP_COUNT] = {};
+static size_t keptSize[KEEP_COUNT] = {};
+
+// fs swap: sectors [0, swapEnd) of the live partition and the staging slot,
+// a step of a sector per loop. Progress goes to NVS after every step, so
+// that otaRecoverFs() can put the previous filesystem back after a reset.
+struct SwapRecord {
+  uint32_t next;
+  uint32_t end;
+  uint8_t step;
+  uint8_t back;
+};
+static Preferences swapLog;
+static uint32_t swapNext = 0;
+static uint8_t swapPhase = 0;
+static uint32_t swapEnd = 0;
+static bool swappingBack = false;
+// set by otaRecoverFs(), logged by otaBegin() once logging is up
+static uint32_t recoveredSectors = 0;
+static bool recoveryFailed = false;
+// the running firmware came from an OTA and is not confirmed yet
+static bool trial = false;
+
+// The Arduino core confirms a new image at startup unless told otherwise:
+// trialTick() does it once the firmware has proven itself
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+static bool busy() {
+  return state == OTA_RECEIVING || state == OTA_BASE || state == OTA_VERIFYING || state == OTA_SWAPPING || state == OTA_REBOOTING;
+}
+
+static void reply(WiFiClient &c, int code, const String &body) {
+  const char* text = code == 200 ? "OK" : code == 403 ? "Forbidden" : code == 409 ? "Conflict" :
+                     code == 411 ? "Length Required" : code == 413 ? "Payload Too Large" :
+                     code == 500 ? "Internal Server Error" : "Bad Request";
+  c.print("HTTP/1.1 "); c.print(code); c.print(" "); c.print(text); c.print("\r\n");
+  c.print("Content-Type: application/json\r\n");
+  c.print("Content-Length: "); c.print(body.length()); c.print("\r\n");
+  c.print("Connection: close\r\n\r\n");
+  c.print(body);
+}
+
+static String errorJson(const String &why) {
+  return String("{\"ok\":0,\"error\":\"") + why + "\"}";
+}
+
+static void dropUnpacker() {
+  delete unpacker;
+  unpacker = nullptr;
+}
+
+static const char* encodingName() {
+  if (!pack.flags) return "raw";
+  return pack.flags & OTA_PACK_DELTA ? "delta" : "lz";
+}
+
+static void fail(int code, const String &why) {
+  lastError = why;
+  writer.abort();
+  dropUnpacker();
+  LOG_E(LOGM_WEB, "OTA %s update failed: %s", fsUpdate ? "filesystem" : "firmware", why.c_str());
+  if (uploader) {
+    reply(uploader, code, errorJson(why));
+    uploader.stop();
+  }
+  state = OTA_FAILED;
+}
+
+// Why an upload cannot start (code: HTTP status), nullptr if it can
+static const char* refuse(const HttpRequest &req, const String &query, int &code) {
+  String type = queryParam(query, "type");
+  code = 409;
+  if (busy()) return "update in progress";
+  // an upload would overwrite the image a failed trial rolls back to
+  if (trial) return "firmware on trial, wait for it to be confirmed or roll back";
+  code = 403;
+  // no token, no OTA: anyone on the network could flash the board
+  if (!strlen(OTA_TOKEN)) return "OTA disabled, set OTA_TOKEN in config.h";
+  if (queryParam(query, "token") != OTA_TOKEN) return "bad token";
+  code = 400;
+  if (type.length() && type != "app" && type != "fs") return "type must be app or fs";
+  // of the image as written to flash, also when it comes packed
+  if (!sha256FromHex(queryParam(query, "sha256").c_str(), imageDigest)) return "sha256 must be 64 hex digits";
+  code = 411;
+  if (req.contentLength <= 0) return "Content-Length required";
+  code = 500;
+  staging.part = esp_ota_get_next_update_partition(nullptr);
+  if (!staging.part) return "no OTA slot: flash partitions.csv over USB once";
+  fsUpdate = type == "fs";
+  if (fsUpdate) {
+    fsPart.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    if (!fsPart.part) return "no spiffs partition";
+    // plus the sector the swap parks data in
+    if (fsPart.size() + FLASH_SECTOR > staging.size()) return "spiffs partition too large for the OTA slot";
+  }
+  running.part = esp_ota_get_running_partition();
+  return nullptr;
+}
+
+// Once the image size is known (Content-Length, or the pack header)
+static const char* sizeProblem(uint32_t size, int &code) {
+  code = 413;
+  // mkspiffs images fill the partition: a shorter one would leave old sectors behind
+  if (fsUpdate && size != fsPart.size()) return "fs image must be the size of the spiffs partition";
+  if (!writer.begin(size, imageDigest)) return "image larger than the OTA slot";
+  return nullptr;
+}
+
+void otaAccept(WiFiClient &client, const HttpRequest &req) {
+  int q = req.path.indexOf('?');
+  String query = q >= 0 ? req.path.substring(q + 1) : String();
+  int code;
+  const char* why = refuse(req, query, code);
+  if (why) {
+    LOG_W(LOGM_WEB, "OTA upload refused: %s", why);
+    reply(client, code, errorJson(why));
+    client.stop();
+    return;
+  }
+  if (req.expectContinue) client.print("HTTP/1.1 100 Continue\r\n\r\n");
+  uploader = client;
+  lastError = String();
+  bodySize = (uint32_t)req.contentLength;
+  bodyReceived = 0;
+  headFill = 0;
+  memset(&pack, 0, sizeof(pack));
+  startMs = lastDataMs = millis();
+  state = OTA_RECEIVING;
+  LOG_I(LOGM_WEB, "OTA %s upload: %ld bytes into %s", fsUpdate ? "filesystem" : "firmware", req.contentLength,
+        staging.part->label);
+}
+
+// Upload bytes after the header, to the unpacker or straight to flash
+static bool consume(const uint8_t *p, size_t n) {
+  if (!unpacker) {
+    if (writer.write(p, n)) return true;
+    fail(500, flashWriteErrorName(writer.error()));
+    return false;
+  }
+  if (unpacker->write(p, n)) return true;
+  if (unpacker->error() == OTA_PACK_ERR_OUTPUT) fail(500, flashWriteErrorName(writer.error()));
+  else fail(400, otaPackErrorName(unpacker->error()));
+  return false;
+}
+
+// The first bytes are in: a pack header, or the start of a plain image
+static bool startImage() {
+  int code = 400;
+  const char* why = nullptr;
+  uint32_t size = bodySize;
+  if (otaPackIsPack(head, headFill)) {
+    why = headFill < OTA_PACK_HEADER_SIZE ? "truncated pack" : otaPackParseHeader(head, OTA_LZ_WINDOW_BITS, pack);
+    if (!why && pack.flags & OTA_PACK_DELTA) {
+      // the filesystem changes under a delta while it streams in (logs, settings)
+      if (fsUpdate) why = "deltas are for firmware only";
+      else if (!running.part || pack.baseSize > running.size()) why = "delta base larger than the running slot";
+    }
+    if (!why) {
+      size = pack.imageSize;
+      unpacker = new (std::nothrow) Unpacker(running, writer);
+      if (!unpacker) {
+        code = 500;
+        why = "out of memory";
+      }
+    }
+  }
+  if (!why) why = sizeProblem(size, code);
+  if (why) {
+    fail(code, why);
+    return false;
+  }
+  if (!unpacker) return consume(head, headFill);
+  unpacker->begin(pack);
+  LOG_I(LOGM_WEB, "OTA %s: %lu bytes unpack to %lu", encodingName(), (unsigned long)bodySize, (unsigned long)size);
+  if (pack.flags & OTA_PACK_DELTA) {
+    baseSha.reset();
+    baseChecked = 0;
+    state = OTA_BASE;
+  }
+  return true;
+}
+
+static const size_t FEED_MAX = 512;
+
+// Input bytes per call of the unpacker: they unpack to at most ~FEED_MAX
+// bytes, so the flash budget is checked often. An LZ back-reference is
+// 1 + W + L bits for up to 2^L bytes: 19 bytes of input with the tool's
+// defaults (W = 12, L = 6), a single one with L = 11.
+static size_t feedSlice() {
+  if (!unpacker || !(pack.flags & OTA_PACK_LZ)) return FEED_MAX;
+  size_t n = FEED_MAX * (1 + pack.windowBits + pack.lookaheadBits) / (8UL << pack.lookaheadBits);
+  return n ? n : 1;
+}
+
+// At most OTA_TICK_BYTES from the socket and, as a pack can unpack to many
+// times its size, about as much to flash
+static void receiveStep() {
+  uint8_t buf[FEED_MAX];
+  size_t budget = OTA_TICK_BYTES;
+  const uint32_t writtenBefore = writer.bytesReceived();
+  while (budget && writer.bytesReceived() - writtenBefore < OTA_TICK_BYTES && bodyReceived < bodySize &&
+         state == OTA_RECEIVING) {
+    int avail = uploader.available();
+    if (avail <= 0) break;
+    size_t n = bodySize - bodyReceived;
+    if ((size_t)avail < n) n = avail;
+    if (sizeof(buf) < n) n = sizeof(buf);
+    if (budget < n) n = budget;
+    if (feedSlice() < n) n = feedSlice();
+    if (headFill < OTA_PACK_HEADER_SIZE && OTA_PACK_HEADER_SIZE - headFill < n) n = OTA_PACK_HEADER_SIZE - headFill;
+    int got = uploader.read(buf, n);
+    if (got <= 0) break;
+    bodyReceived += got;
+    budget -= got;
+    lastDataMs = millis();
+    if (headFill < OTA_PACK_HEADER_SIZE) {
+      memcpy(head + headFill, buf, got);
+      headFill += got;
+      if ((headFill == OTA_PACK_HEADER_SIZE || bodyReceived == bodySize) && !startImage()) return;
+    } else if (!consume(buf, got)) {
+      return;
+    }
+  }
+  if (state != OTA_RECEIVING) return;
+  if (bodyReceived == bodySize) {
+    if (unpacker && !unpacker->finish()) {
+      fail(400, otaPackErrorName(unpacker->error()));
+      return;
+    }
+    dropUnpacker();
+    if (writer.finish()) state = OTA_VERIFYING;
+    else fail(writer.error() == FLASH_ERR_DIGEST ? 400 : 500, flashWriteErrorName(writer.error()));
+    return;
+  }
+  if (!uploader.connected() && !uploader.available()) fail(400, "connection closed");
+  else if (millis() - lastDataMs > OTA_IDLE_MS) fail(400, "upload stalled");
+}
+
+// A delta only fits the exact firmware it was made against
+static void baseStep() {
+  uint8_t buf[256];
+  size_t budget = OTA_VERIFY_BYTES;
+  while (baseChecked < pack.baseSize && budget) {
+    size_t n = pack.baseSize - baseChecked < sizeof(buf) ? pack.baseSize - baseChecked : sizeof(buf);
+    if (!running.read(baseChecked, buf, n)) {
+      fail(500, "cannot read the running firmware");
+      return;
+    }
+    baseSha.update(buf, n);
+    baseChecked += n;
+    budget = budget > n ? budget - n : 0;
+  }
+  if (baseChecked < pack.baseSize) return;
+  uint8_t d[Sha256::DIGEST_SIZE];
+  baseSha.finish(d);
+  if (memcmp(d, pack.baseDigest, sizeof(d)) != 0) {
+    fail(409, "delta made for another firmware than the running one");
+    return;
+  }
+  // the socket waited meanwhile
+  lastDataMs = millis();
+  state = OTA_RECEIVING;
+}
+
+static void swapSave() {
+  SwapRecord r = { swapNext, swapEnd, swapPhase, swappingBack };
+  swapLog.putBytes("swap", &r, sizeof(r));
+}
+
+// Back over sectors [0, swapEnd) from the first
+static void swapBack(uint32_t end) {
+  swapEnd = end;
+  swapNext = 0;
+  swapPhase = 0;
+  swappingBack = true;
+  swapSave();
+}
+
+// The next step of the swap, then its record
+static bool swapAdvance() {
+  if (!flashSwapStep<FLASH_SECTOR, 256>(fsPart, staging, swapNext * FLASH_SECTOR, staging.size() - FLASH_SECTOR, swapPhase)) return false;
+  if (++swapPhase == FLASH_SWAP_STEPS) {
+    swapPhase = 0;
+    swapNext++;
+  }
+  swapSave();
+  return true;
+}
+
+static void dropSettings() {
+  for (size_t i = 0; i < KEEP_COUNT; ++i) {
+    delete[] keptData[i];
+    keptData[i] = nullptr;
+    keptSize[i] = 0;
+  }
+}
+
+// false if one of them cannot be held in RAM
+static bool keepSettings() {
+  for (size_t i = 0; i < KEEP_COUNT; ++i) {
+    if (!SPIFFS.exists(KEEP_FILES[i])) continue;
+    File f = SPIFFS.open(KEEP_FILES[i], "r");
+    if (!f) continue;
+    size_t n = f.size();
+    keptData[i] = new (std::nothrow) uint8_t[n ? n : 1];
+    bool ok = keptData[i] && f.read(keptData[i], n) == n;
+    f.close();
+    if (!ok) {
+      dropSettings();
+      return false;
+    }
+    keptSize[i] = n;
+  }
+  return true;
+}
+
+static void restoreSettings() {
+  for (size_t i = 0; i < KEEP_COUNT; ++i) {
+    if (!keptData[i]) continue;
+    File f = SPIFFS.open(KEEP_FILES[i], "w");
+    if (!f || f.write(keptData[i], keptSize[i]) != keptSize[i]) LOG_E(LOGM_WEB, "Could not restore %s after the filesystem update", KEEP_FILES[i]);
+    if (f) f.close();
+  }
+  dropSettings();
+}
+
+static void verifyStep() {
+  if (!writer.verifyStep(OTA_VERIFY_BYTES)) {
+    if (writer.error()) fail(500, flashWriteErrorName(writer.error()));
+    return;
+  }
+  unsigned long sec = (millis() - startMs) / 1000;
+  if (!fsUpdate) {
+    // also checks the image format and the hash esptool appends
+    if (esp_ota_set_boot_partition(staging.part) != ESP_OK) {
+      fail(400, "not a valid firmware image");
+      return;
+    }
+    LOG_I(LOGM_WEB, "Firmware verified in %lu s, rebooting into %s", sec, staging.part->label);
+    reply(uploader, 200, "{\"ok\":1,\"reboot\":true}");
+    uploader.stop();
+    state = OTA_REBOOTING;
+    rebootAtMs = millis() + 1000;
+    return;
+  }
+  if (!swapLog.begin("ota", false)) {
+    fail(500, "NVS unavailable for the swap log");
+    return;
+  }
+  if (!keepSettings()) {
+    swapLog.end();
+    fail(500, "out of memory");
+    return;
+  }
+  reply(uploader, 200, "{\"ok\":1,\"applying\":true}");
+  uploader.stop();
+  LOG_I(LOGM_WEB, "Filesystem image verified in %lu s, swapping it in", sec);
+  storageEnd();
+  swapNext = 0;
+  swapPhase = 0;
+  swapEnd = fsPart.size() / FLASH_SECTOR;
+  swappingBack = false;
+  swapSave();
+  state = OTA_SWAPPING;
+}
+
+// One step per loop (an erase and a sector of writes, well under a watchdog
+// deadline)
+static void swapStep() {
+  if (swapNext < swapEnd) {
+    if (swapAdvance()) return;
+    LOG_E(LOGM_WEB, "Filesystem swap failed at sector %lu", (unsigned long)swapNext);
+    if (swappingBack) swapNext = swapEnd;   // nothing more to try
+    else {
+      // put back what was swapped so far
+      swapBack(swapNext);
+      lastError = "flash error while swapping, previous filesystem restored";
+      return;
+    }
+  }
+  bool mounted = storageRemount();
+  if (!swappingBack && !(mounted && SPIFFS.exists(FS_HEALTH_FILE))) {
+    LOG_E(LOGM_WEB, "New filesystem %s, swapping the previous one back", mounted ? "has no " FS_HEALTH_FILE : "does not mount");
+    storageEnd();
+    swapBack(swapEnd);
+    lastError = "new filesystem failed its check, previous one restored";
+    return;
+  }
+  swapLog.remove("swap");
+  swapLog.end();
+  // still nothing mountable: start over with an empty one rather than none
+  if (!mounted) storageBegin();
+  // the previous filesystem, when swapped back, still has them
+  if (!swappingBack || !mounted) restoreSettings();
+  else dropSettings();
+  if (swappingBack) {
+    state = OTA_FAILED;
+    LOG_E(LOGM_WEB, "OTA filesystem update failed: %s", lastError.c_str());
+  } else {
+    state = OTA_DONE;
+    LOG_I(LOGM_WEB, "Filesystem updated in %lu s", (millis() - startMs) / 1000);
+  }
+}
+
+// Healthy: control ran and Wi-Fi came up, and it kept running a while
+static void trialTick() {
+  if (!trial) return;
+  unsigned long up = millis() / 1000;
+  if (up >= OTA_TRIAL_MIN_SEC && bootStageMs(BOOT_FIRST_CONTROL) && bootStageMs(BOOT_WIFI)) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    trial = false;
+    LOG_I(LOGM_MAIN, "New firmware confirmed after %lu s", up);
+  } else if (up >= OTA_TRIAL_TIMEOUT_SEC) {
+    LOG_E(LOGM_MAIN, "New firmware not healthy after %lu s (Wi-Fi %s), rolling back", up,
+          bootStageMs(BOOT_WIFI) ? "up" : "never up");
+    logFlush();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    // only returns when there is nothing to roll back to
+    trial = false;
+    LOG_E(LOGM_MAIN, "No previous firmware to roll back to, keeping this one");
+  }
+}
+
+// A reset in the middle of the swap leaves the filesystem half old, half
+// new. The sector it was in is finished, then every sector swapped so far
+// swapped back (or, if it was swapping back already, the rest of them).
+void otaRecoverFs() {
+  if (!swapLog.begin("ota", false)) return;
+  SwapRecord r;
+  if (swapLog.getBytes("swap", &r, sizeof(r)) != sizeof(r)) {
+    swapLog.end();
+    return;
+  }
+  staging.part = esp_ota_get_next_update_partition(nullptr);
+  fsPart.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+  swapNext = r.next;
+  swapEnd = r.end;
+  swapPhase = r.step;
+  swappingBack = r.back;
+  bool ok = staging.part && fsPart.part && swapEnd <= fsPart.size() / FLASH_SECTOR && swapNext <= swapEnd &&
+            swapPhase < FLASH_SWAP_STEPS && fsPart.size() + FLASH_SECTOR <= staging.size();
+  while (ok && swapPhase) ok = swapAdvance();
+  if (ok && !swappingBack) swapBack(swapNext);
+  while (ok && swapNext < swapEnd) {
+    ok = swapAdvance();
+    // a full filesystem takes a while; the idle task gets to run
+    if (!swapPhase) delay(1);
+  }
+  recoveredSectors = swapEnd;
+  recoveryFailed = !ok;
+  swapLog.remove("swap");
+  swapLog.end();
+}
+
+void otaBegin() {
+  if (recoveryFailed) LOG_E(LOGM_MAIN, "Filesystem update interrupted by a reset, and the previous filesystem could not be swapped back");
+  else if (recoveredSectors) LOG_W(LOGM_MAIN, "Filesystem update interrupted by a reset, previous filesystem swapped back (%lu sectors)",
+                                   (unsigned long)recoveredSectors);
+  const esp_partition_t *run = esp_ota_get_running_partition();
+  esp_ota_img_states_t st;
+  trial = run && esp_ota_get_state_partition(run, &st) == ESP_OK && st == ESP_OTA_IMG_PENDING_VERIFY;
+  if (trial) LOG_W(LOGM_MAIN, "Firmware in %s on trial: confirmed after %d s with Wi-Fi, rolled back after %d s otherwise",
+                   run->label, OTA_TRIAL_MIN_SEC, OTA_TRIAL_TIMEOUT_SEC);
+}
+
+void otaTick() {
+  switch (state) {
+    case OTA_RECEIVING: receiveStep(); break;
+    case OTA_BASE: baseStep(); break;
+    case OTA_VERIFYING: verifyStep(); break;
+    case OTA_SWAPPING: swapStep(); break;
+    case OTA_REBOOTING:
+      if ((long)(millis() - rebootAtMs) >= 0) {
+        logFlush();
+        esp_restart();
+      }
+      break;
+    default: break;
+  }
+  trialTick();
+}
+
+bool otaRollback(String &err) {
+  if (busy()) {
+    err = "update in progress";
+    return false;
+  }
+  if (trial) {
+    LOG_W(LOGM_MAIN, "Firmware on trial rolled back on request");
+    logFlush();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    err = "no previous firmware to roll back to";
+    return false;
+  }
+  // the slot may hold a staged filesystem image instead: then this refuses
+  const esp_partition_t *other = esp_ota_get_next_update_partition(nullptr);
+  if (!other || esp_ota_set_boot_partition(other) != ESP_OK) {
+    err = "no valid firmware in the other slot";
+    return false;
+  }
+  LOG_W(LOGM_MAIN, "Rolling back to the firmware in %s", other->label);
+  state = OTA_REBOOTING;
+  rebootAtMs = millis() + 1000;
+  return true;
+}
+
+void otaWrite(StructWriter &w) {
+  const esp_partition_t *run = esp_ota_get_running_partition();
+  const esp_app_desc_t *app = esp_ota_get_app_description();
+  w.beginMap();
+  w.strField("state", STATE_NAMES[state]);
+  w.strField("type", fsUpdate ? "fs" : "app");
+  w.strField("encoding", encodingName());
+  w.intField("upload", bodySize);
+  w.intField("received", bodyReceived);
+  w.intField("size", writer.size());
+  w.intField("unpacked", writer.bytesReceived());
+  w.intField("verified", writer.bytesVerified());
+  if (state == OTA_SWAPPING) {
+    w.intField("swapped", swapNext);
+    w.intField("sectors", swapEnd);
+    w.boolField("back", swappingBack);
+  }
+  w.strField("error", lastError.c_str());
+  w.strField("running", run ? run->label : "");
+  w.strField("version", app->version);
+  w.strField("built", (String(app->date) + " " + app->time).c_str());
+  w.boolField("trial", trial);
+  w.endMap();
+}
+
+String otaJson() {
+  return structToJson<String>(otaWrite);
+}
@@ -0,0 +1,38 @@
+// Over-the-air updates of the firmware and of the SPIFFS image (the web
+// dashboard). An upload is a raw POST to /ota?type=app|fs&sha256=<hex>
+// streamed into the inactive app partition in flash pages
+// (include/flash_writer.h), never held in RAM. otaTick() takes a bounded
+// slice of it per loop, so relays, thermostat and schedules keep running.
+// The body may also be a pack from tools/ota_pack.py, compressed or a delta
+// against the running firmware, unpacked on the way (include/ota_pack.h).
+// Once the SHA-256 and the flash readback match:
+//   - app: the next boot runs the new firmware on trial; it is confirmed
+//     when healthy, otherwise the previous one comes back
+//   - fs: the image is swapped sector by sector with the live filesystem,
+//     which is remounted and checked; on failure it is swapped back, and
+//     after a reset in the middle of it, at the next boot
+#ifndef OTA_H
+#define OTA_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "struct_writer.h"
+#include "http_request.h"
+
+// Before SPIFFS is mounted: puts the previous filesystem back if a reset
+// cut a filesystem update short (a half-swapped one would be formatted)
+void otaRecoverFs();
+// Stage 1 of setup(): is the running firmware on trial?
+void otaBegin();
+// POST /ota: takes the client over, or answers the error and closes it
+void otaAccept(WiFiClient &client, const HttpRequest &req);
+// Every loop: upload, readback, filesystem swap, trial confirmation
+void otaTick();
+// Back to the firmware in the other slot (reboots); false if there is none
+bool otaRollback(String &err);
+
+// {"state":"receiving","type":"app","encoding":"delta","upload":41250,"received":...,"size":1048576,...}
+void otaWrite(StructWriter &w);
+String otaJson();
+
+#endif // OTA_H
@@ -0,0 +1,78 @@
+#include "perf.h"
+#include "json_writer.h"
+
+static ModuleProfiler profiler;
+static uint32_t scopeCostTicks = 0;
+static unsigned long sinceMs = 0;
+
+ModuleProfiler &perfProfiler() { return profiler; }
+
+void perfBegin() {
+  // cost of one PerfScope's timing, to report the profiler's own overhead
+  static LoopProfiler<1> scratch;
+  const uint32_t n = 64;
+  uint32_t t0 = profTicks();
+  for (uint32_t i = 0; i < n; ++i) {
+    ProfScope<LoopProfiler<1> > s(scratch, 0);
+  }
+  scopeCostTicks = (profTicks() - t0) / n;
+  sinceMs = millis();
+}
+
+void perfLoopStart() { profiler.loopStart(profTicks()); }
+void perfLoopEnd() { profiler.loopEnd(profTicks()); }
+
+static float toUs(uint32_t ticks) { return (float)ticks / profTicksPerUs(); }
+
+static void writeHist(StructWriter &w, const LatencyHistogram &h) {
+  w.intField("count", h.count());
+  w.floatField("minUs", toUs(h.min()));
+  w.floatField("p50Us", toUs(h.percentile(50)));
+  w.floatField("p99Us", toUs(h.percentile(99)));
+  w.floatField("maxUs", toUs(h.max()));
+  w.floatField("meanUs", toUs(h.mean()));
+}
+
+void perfWrite(StructWriter &w) {
+  const LatencyHistogram &period = profiler.period();
+  const LatencyHistogram &busy = profiler.busy();
+  uint64_t scopes = 0;
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) scopes += profiler.section(i).count();
+  w.beginMap();
+  w.intField("sinceSec", (millis() - sinceMs) / 1000);
+  w.intField("ticksPerUs", profTicksPerUs());
+  w.key("period");
+  w.beginMap();
+  writeHist(w, period);
+  w.endMap();
+  w.key("busy");
+  w.beginMap();
+  writeHist(w, busy);
+  w.endMap();
+  // how late a loop can start compared with the typical one
+  w.floatField("jitterUs", toUs(period.percentile(99) - period.percentile(50)));
+  w.floatField("overheadPct", busy.sum() ? (float)(scopes * scopeCostTicks) * 100.0f / (float)busy.sum() : 0.0f);
+  w.key("modules");
+  w.beginArray();
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) {
+    const LatencyHistogram &h = profiler.section(i);
+    if (!h.count()) continue;
+    w.beginMap();
+    w.strField("module", logModuleName((LogModule)i));
+    writeHist(w, h);
+    // share of the loop's busy time
+    w.floatField("busyPct", busy.sum() ? (float)h.sum() * 100.0f / (float)busy.sum() : 0.0f);
+    w.endMap();
+  }
+  w.endArray();
+  w.endMap();
+}
+
+String perfJson() {
+  return structToJson<String>(perfWrite);
+}
+
+void perfReset() {
+  profiler.reset();
+  sinceMs = millis();
+}
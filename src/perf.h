@@ -0,0 +1,36 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+#include "loop_profiler.h"
+#include "heap_stats.h"
+#include "watchdog.h"
+
+// Sections are the log modules (main, wifi, web, mqtt, sensor, ...)
+typedef LoopProfiler<LOGM_COUNT> ModuleProfiler;
+ModuleProfiler &perfProfiler();
+
+void perfBegin();
+// First and last thing in loop(): loop period (jitter) and busy time
+void perfLoopStart();
+void perfLoopEnd();
+// min/p50/p99/max per module and for the loop, in microseconds
+void perfWrite(StructWriter &w);
+String perfJson();
+void perfReset();
+
+// One loop() subsystem: its run time goes to /debug/perf, its allocations
+// are charged to the same module in /debug/heap, and it checks in with the
+// watchdog supervisor on the way in and out
+class PerfScope {
+public:
+  explicit PerfScope(LogModule m) : heap(m), prof(perfProfiler(), m), live(watchdogMonitor(), m) {}
+
+private:
+  HeapScope heap;
+  ProfScope<ModuleProfiler> prof;
+  LivenessScope<WatchdogMonitor> live;
+};
+
+#endif // PERF_H
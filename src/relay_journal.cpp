@@ -0,0 +1,133 @@
+#include "relay_journal.h"
+#include "logging.h"
+#include "time_service.h"
+#include <SPIFFS.h>
+#include <atomic>
+
+static const char* JOURNAL_FILE = "/relay_journal.bin";
+static const char* JOURNAL_OLD_FILE = "/relay_journal.old";
+// Rotate the journal file once it grows past this size (~1365 events)
+static const size_t JOURNAL_MAX_BYTES = 16 * 1024;
+static const unsigned long JOURNAL_FLUSH_INTERVAL_MS = 60000UL;
+static const uint32_t JOURNAL_FLUSH_BATCH = 16;
+
+// Ring capacity must be a power of two
+static const uint32_t RING_SIZE = 64;
+static RelayEvent ring[RING_SIZE];
+// Single producer (the loop task); readers keep their own cursor and detect
+// overwrites by re-checking the head after copying a slot.
+static std::atomic<uint32_t> head(0);
+static uint32_t flushCursor = 0;
+static uint32_t flushLost = 0;
+static unsigned long lastFlush = 0;
+
+void relayJournalBegin() {
+  lastFlush = millis();
+  // boot marker so the replay tool knows millis() restarted
+  relayJournalRecord(0, false, RELAY_SRC_BOOT, RELAY_REASON_NONE);
+}
+
+void relayJournalRecord(uint8_t ch, bool on, RelaySource source, RelayReason reason) {
+  uint32_t seq = head.load(std::memory_order_relaxed);
+  RelayEvent &e = ring[seq & (RING_SIZE - 1)];
+  e.epoch = (uint32_t)timeNow();   // 0 while the clock is not set
+  e.ms = millis();
+  e.ch = ch;
+  e.on = on ? 1 : 0;
+  e.source = source;
+  e.reason = reason;
+  head.store(seq + 1, std::memory_order_release);
+}
+
+uint32_t relayJournalHead() {
+  return head.load(std::memory_order_acquire);
+}
+
+bool relayJournalGet(uint32_t seq, RelayEvent &out) {
+  uint32_t h = head.load(std::memory_order_acquire);
+  if ((int32_t)(h - seq) <= 0) return false; // not written yet
+  if (h - seq > RING_SIZE) return false;     // already overwritten
+  out = ring[seq & (RING_SIZE - 1)];
+  // slot may have been reused while copying
+  h = head.load(std::memory_order_acquire);
+  return h - seq <= RING_SIZE;
+}
+
+void relayJournalFlush() {
+  uint32_t h = relayJournalHead();
+  if (flushCursor == h) return;
+  if (h - flushCursor > RING_SIZE) {
+    flushLost += (h - flushCursor) - RING_SIZE;
+    flushCursor = h - RING_SIZE;
+  }
+  File f = SPIFFS.open(JOURNAL_FILE, FILE_APPEND);
+  if (!f) return;
+  if (f.size() >= JOURNAL_MAX_BYTES) {
+    f.close();
+    if (SPIFFS.exists(JOURNAL_OLD_FILE)) SPIFFS.remove(JOURNAL_OLD_FILE);
+    SPIFFS.rename(JOURNAL_FILE, JOURNAL_OLD_FILE);
+    f = SPIFFS.open(JOURNAL_FILE, FILE_APPEND);
+    if (!f) return;
+  }
+  RelayEvent e;
+  while (flushCursor != h) {
+    if (relayJournalGet(flushCursor, e)) f.write((const uint8_t*)&e, sizeof(e));
+    else flushLost++;
+    flushCursor++;
+  }
+  f.close();
+  if (flushLost) {
+    LOG_W(LOGM_RELAYS, "Relay journal: %lu events lost before flush", (unsigned long)flushLost);
+    flushLost = 0;
+  }
+}
+
+void relayJournalTick() {
+  uint32_t pending = relayJournalHead() - flushCursor;
+  if (pending == 0) return;
+  unsigned long now = millis();
+  if (pending >= JOURNAL_FLUSH_BATCH || now - lastFlush >= JOURNAL_FLUSH_INTERVAL_MS) {
+    lastFlush = now;
+    relayJournalFlush();
+  }
+}
+
+const char* relaySourceName(uint8_t source) {
+  switch (source) {
+    case RELAY_SRC_BOOT: return "boot";
+    case RELAY_SRC_RELAYS: return "relays";
+    case RELAY_SRC_SCHEDULER: return "scheduler";
+    case RELAY_SRC_THERMOSTAT: return "thermostat";
+    case RELAY_SRC_AUTOMATION: return "automation";
+    case RELAY_SRC_HTTP: return "http";
+    case RELAY_SRC_SERIAL: return "serial";
+    case RELAY_SRC_MQTT: return "mqtt";
+    case RELAY_SRC_RULES: return "rules";
+    default: return "unknown";
+  }
+}
+
+const char* relayReasonName(uint8_t reason) {
+  switch (reason) {
+    case RELAY_REASON_MANUAL: return "manual";
+    case RELAY_REASON_SCHEDULE: return "schedule";
+    case RELAY_REASON_SETPOINT: return "setpoint";
+    case RELAY_REASON_EXT_LIMIT: return "ext_limit";
+    case RELAY_REASON_OVERTEMP: return "overtemp";
+    case RELAY_REASON_MAX_RUNTIME: return "max_runtime";
+    case RELAY_REASON_LIGHTS_MIN: return "lights_min";
+    case RELAY_REASON_DAILY_LIGHT: return "daily_light";
+    case RELAY_REASON_IRRIGATION: return "irrigation";
+    case RELAY_REASON_RULE: return "rule";
+    default: return "none";
+  }
+}
+
+String relayEventJson(uint32_t seq, const RelayEvent &e) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "{\"seq\":%lu,\"t\":%lu,\"ms\":%lu,\"ch\":%u,\"on\":%u,\"src\":\"%s\",\"reason\":\"%s\"}",
+           (unsigned long)seq, (unsigned long)e.epoch, (unsigned long)e.ms, e.ch, e.on,
+           relaySourceName(e.source), relayReasonName(e.reason));
+  return String(buf);
+}
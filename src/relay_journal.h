@@ -0,0 +1,62 @@
+// Relay actuation journal: every relay transition is recorded as a fixed-size
+// event in a RAM ring, periodically appended to SPIFFS and streamed over SSE.
+#ifndef RELAY_JOURNAL_H
+#define RELAY_JOURNAL_H
+
+#include <Arduino.h>
+
+// Who requested the transition
+enum RelaySource : uint8_t {
+  RELAY_SRC_UNKNOWN = 0,
+  RELAY_SRC_BOOT,        // boot marker (ch = 0), millis() restarts after it
+  RELAY_SRC_RELAYS,      // relays module itself (deferred lights-off)
+  RELAY_SRC_SCHEDULER,
+  RELAY_SRC_THERMOSTAT,
+  RELAY_SRC_AUTOMATION,
+  RELAY_SRC_HTTP,
+  RELAY_SRC_SERIAL,
+  RELAY_SRC_MQTT,
+  RELAY_SRC_RULES,       // sensor-driven rule engine (automation)
+};
+
+// Why it was requested
+enum RelayReason : uint8_t {
+  RELAY_REASON_NONE = 0,
+  RELAY_REASON_MANUAL,       // explicit on/off/toggle from a user transport
+  RELAY_REASON_SCHEDULE,
+  RELAY_REASON_SETPOINT,     // thermostat hysteresis band
+  RELAY_REASON_EXT_LIMIT,    // thermostat blocked by exterior temperature
+  RELAY_REASON_OVERTEMP,
+  RELAY_REASON_MAX_RUNTIME,
+  RELAY_REASON_LIGHTS_MIN,   // lights off deferred until minimum-on elapsed
+  RELAY_REASON_DAILY_LIGHT,  // automation enforcing the daily light minimum
+  RELAY_REASON_IRRIGATION,
+  RELAY_REASON_RULE,
+};
+
+// On-flash record layout (little endian, 12 bytes). Keep in sync with
+// tools/relay_journal.py.
+struct RelayEvent {
+  uint32_t epoch;  // wall clock seconds, 0 if time was not synced yet
+  uint32_t ms;     // millis() at the transition
+  uint8_t ch;      // 1..6, 0 for boot markers
+  uint8_t on;
+  uint8_t source;  // RelaySource
+  uint8_t reason;  // RelayReason
+};
+static_assert(sizeof(RelayEvent) == 12, "RelayEvent must stay 12 bytes");
+
+void relayJournalBegin();
+void relayJournalRecord(uint8_t ch, bool on, RelaySource source, RelayReason reason);
+// Sequence number of the next event to be written
+uint32_t relayJournalHead();
+// Copy event `seq`; false if not written yet or already overwritten in the ring
+bool relayJournalGet(uint32_t seq, RelayEvent &out);
+// Append pending events to flash when enough have accumulated or periodically
+void relayJournalTick();
+void relayJournalFlush();
+String relayEventJson(uint32_t seq, const RelayEvent &e);
+const char* relaySourceName(uint8_t source);
+const char* relayReasonName(uint8_t reason);
+
+#endif // RELAY_JOURNAL_H
@@ -1,9 +1,12 @@
 #include "relays.h"
 #include "config.h"
 #include "pins.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "storage.h"
+#include "time_service.h"
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
-#include <time.h>
 
 static const int relayPins[6] = {
   RELAY_CH1_PIN,
@@ -16,11 +19,31 @@ static const int relayPins[6] = {
 
 // Lights minimum-on enforcement (default 12 hours)
 static unsigned long lightsMinSec = 12UL * 3600UL;
-static unsigned long lightsOnSince = 0; // millis when lights were turned on
-static unsigned long pendingLightsOffAt = 0; // millis when allowed to turn off
+// timeMonoMs() stamps: 64-bit, no wrap after 49 days of uptime
+static uint64_t lightsOnSince = 0; // when lights were turned on
+static uint64_t pendingLightsOffAt = 0; // when allowed to turn off
 static const char* RELAYS_STATE_FILE = "/relays_state.json";
 // store epoch seconds when lights were turned on across reboot
 static time_t lightsOnSinceEpoch = 0;
+// who asked for the deferred lights-off (attributed when it finally happens)
+static RelaySource pendingLightsOffSource = RELAY_SRC_RELAYS;
+// lights-on time accounting from edge timestamps (ms precision)
+static uint64_t lightsOnTotalMs = 0;
+static uint64_t lightsEdgeMs = 0;
+
+// Drive the output and journal the transition if the state changes
+static void writeRelay(int idx, bool on, RelaySource source, RelayReason reason) {
+  bool wasOn = getRelay(idx + 1);
+  bool level = on ? (RELAY_ACTIVE_LOW ? LOW : HIGH) : (RELAY_ACTIVE_LOW ? HIGH : LOW);
+  digitalWrite(relayPins[idx], level);
+  if (wasOn == on) return;
+  relayJournalRecord(idx + 1, on, source, reason);
+  if (idx == 1) {
+    uint64_t now = timeMonoMs();
+    if (on) lightsEdgeMs = now;
+    else lightsOnTotalMs += now - lightsEdgeMs;
+  }
+}
 
 void relaysBegin() {
   for (int i = 0; i < 6; ++i) {
@@ -29,36 +52,36 @@ void relaysBegin() {
     if (RELAY_ACTIVE_LOW) digitalWrite(relayPins[i], HIGH);
     else digitalWrite(relayPins[i], LOW);
   }
-  // Mount SPIFFS and restore persisted lights-on time if present
-  if (!SPIFFS.begin(true)) {
-    Serial.println("SPIFFS mount failed (relays)");
-  } else {
-    if (SPIFFS.exists(RELAYS_STATE_FILE)) {
-      File f = SPIFFS.open(RELAYS_STATE_FILE, "r");
-      if (f) {
-        DynamicJsonDocument doc(256);
-        if (!deserializeJson(doc, f)) {
-          lightsOnSinceEpoch = doc["lightsOnSinceEpoch"] | 0;
-        }
-        f.close();
+  relayJournalBegin();
+}
+
+void relaysRestore() {
+  if (!storageReady()) return;
+  if (SPIFFS.exists(RELAYS_STATE_FILE)) {
+    File f = SPIFFS.open(RELAYS_STATE_FILE, "r");
+    if (f) {
+      DynamicJsonDocument doc(256);
+      if (!deserializeJson(doc, f)) {
+        lightsOnSinceEpoch = doc["lightsOnSinceEpoch"] | 0;
       }
+      f.close();
     }
-    // If lights are physically on, reconstruct lightsOnSince using epoch
-    if (lightsOnSinceEpoch > 0 && getLights()) {
-      time_t now = time(nullptr);
-      if (now > lightsOnSinceEpoch) {
-        unsigned long elapsed = (unsigned long)(now - lightsOnSinceEpoch);
-        // set lightsOnSince so millis-based logic sees the elapsed time
-        lightsOnSince = millis() - elapsed * 1000UL;
-      } else {
-        // cannot compute, just set lightsOnSince = millis()
-        lightsOnSince = millis();
-      }
+  }
+  // If lights are physically on, reconstruct lightsOnSince using epoch
+  if (lightsOnSinceEpoch > 0 && getLights()) {
+    time_t now = timeNow();
+    if (now > lightsOnSinceEpoch) {
+      uint64_t elapsed = (uint64_t)(now - lightsOnSinceEpoch);
+      // before boot: modulo 2^64, so now - lightsOnSince is still the elapsed time
+      lightsOnSince = timeMonoMs() - elapsed * 1000ULL;
+    } else {
+      // clock not set yet: count from now
+      lightsOnSince = timeMonoMs();
     }
   }
 }
 
-void setRelay(uint8_t channel, bool on) {
+void setRelay(uint8_t channel, bool on, RelaySource source, RelayReason reason) {
   if (channel < 1 || channel > 6) return;
   int idx = channel - 1;
   // Enforce lights minimum-on when channel == 2
@@ -67,12 +90,11 @@ void setRelay(uint8_t channel, bool on) {
     if (on) {
       // turn on immediately if not already
       if (!currentlyOn) {
-        bool level = (RELAY_ACTIVE_LOW ? LOW : HIGH);
-        digitalWrite(relayPins[idx], level);
-        lightsOnSince = millis();
+        writeRelay(idx, true, source, reason);
+        lightsOnSince = timeMonoMs();
         // persist epoch time if RTC/NTP available
-        time_t now = time(nullptr);
-        if (now > 100000) {
+        time_t now = timeNow();
+        if (now) {
           lightsOnSinceEpoch = now;
           // save file
           DynamicJsonDocument doc(256);
@@ -88,11 +110,10 @@ void setRelay(uint8_t channel, bool on) {
     } else {
       // request to turn off: if min duration not reached, schedule pending
       if (currentlyOn) {
-        unsigned long now = millis();
-        unsigned long elapsedSec = (now - lightsOnSince) / 1000UL;
+        uint64_t now = timeMonoMs();
+        unsigned long elapsedSec = (unsigned long)((now - lightsOnSince) / 1000ULL);
         if (lightsOnSince == 0 || elapsedSec >= lightsMinSec) {
-          bool level = (RELAY_ACTIVE_LOW ? HIGH : LOW);
-          digitalWrite(relayPins[idx], level);
+          writeRelay(idx, false, source, reason);
           lightsOnSince = 0;
           pendingLightsOffAt = 0;
           // clear persisted epoch
@@ -100,16 +121,16 @@ void setRelay(uint8_t channel, bool on) {
           if (SPIFFS.exists(RELAYS_STATE_FILE)) SPIFFS.remove(RELAYS_STATE_FILE);
         } else {
           // schedule off for later
-          pendingLightsOffAt = lightsOnSince + lightsMinSec * 1000UL;
-          Serial.printf("Lights off deferred, will allow at %lu (in %lu s)\n", pendingLightsOffAt, (lightsMinSec - elapsedSec));
+          pendingLightsOffAt = lightsOnSince + lightsMinSec * 1000ULL;
+          pendingLightsOffSource = source;
+          LOG_I(LOGM_RELAYS, "Lights off deferred, will allow in %lu s", (lightsMinSec - elapsedSec));
         }
       }
       return;
     }
   }
 
-  bool level = on ? (RELAY_ACTIVE_LOW ? LOW : HIGH) : (RELAY_ACTIVE_LOW ? HIGH : LOW);
-  digitalWrite(relayPins[idx], level);
+  writeRelay(idx, on, source, reason);
 }
 
 bool getRelay(uint8_t channel) {
@@ -120,9 +141,20 @@ bool getRelay(uint8_t channel) {
   return val == HIGH;
 }
 
+String relayStatusJson() {
+  return structToJson<String>(relayStatusWrite);
+}
+
+void relayStatusWrite(StructWriter &w) {
+  static const char *keys[] = { "ch1", "ch2", "ch3", "ch4", "ch5", "ch6" };
+  w.beginMap();
+  for (int i = 1; i <= 6; ++i) w.intField(keys[i - 1], getRelay(i) ? 1 : 0);
+  w.endMap();
+}
+
 // Lights convenience mapped to channel 2
-void setLights(bool on) {
-  setRelay(2, on);
+void setLights(bool on, RelaySource source, RelayReason reason) {
+  setRelay(2, on, source, reason);
 }
 
 bool getLights() {
@@ -130,20 +162,25 @@ bool getLights() {
 }
 
 void relaysTick() {
+  relayJournalTick();
   if (pendingLightsOffAt == 0) return;
-  unsigned long now = millis();
-  // handle wrap-around safely
-  if ((long)(now - pendingLightsOffAt) >= 0) {
+  if ((int64_t)(timeMonoMs() - pendingLightsOffAt) >= 0) {
     // time reached
     int idx = 2 - 1;
-    bool level = (RELAY_ACTIVE_LOW ? HIGH : LOW);
-    digitalWrite(relayPins[idx], level);
-    Serial.println("Lights auto-turned off after minimum duration");
+    writeRelay(idx, false, pendingLightsOffSource, RELAY_REASON_LIGHTS_MIN);
+    LOG_I(LOGM_RELAYS, "Lights auto-turned off after minimum duration");
     lightsOnSince = 0;
     pendingLightsOffAt = 0;
   }
 }
 
+void relaysForceSafe(uint8_t onMask) {
+  for (int i = 0; i < 6; ++i) {
+    bool on = onMask & (1 << i);
+    digitalWrite(relayPins[i], on ? (RELAY_ACTIVE_LOW ? LOW : HIGH) : (RELAY_ACTIVE_LOW ? HIGH : LOW));
+  }
+}
+
 void setLightsMinDurationSec(unsigned long secs) {
   lightsMinSec = secs;
 }
@@ -157,11 +194,15 @@ void scheduleLightsOffAfterSec(unsigned long secs) {
     pendingLightsOffAt = 0;
     return;
   }
-  unsigned long now = millis();
-  unsigned long at = now + secs * 1000UL;
-  pendingLightsOffAt = at;
+  pendingLightsOffAt = timeMonoMs() + secs * 1000ULL;
+  pendingLightsOffSource = RELAY_SRC_AUTOMATION;
 }
 
-unsigned long getLightsOnSinceMillis() {
+uint64_t getLightsOnSinceMs() {
   return lightsOnSince;
 }
+
+uint64_t getLightsOnTotalMs() {
+  if (getLights()) return lightsOnTotalMs + (timeMonoMs() - lightsEdgeMs);
+  return lightsOnTotalMs;
+}
@@ -2,19 +2,34 @@
 #define RELAYS_H
 
 #include <Arduino.h>
+#include "struct_writer.h"
+#include "relay_journal.h"
 
+// All outputs off; first thing in setup()
 void relaysBegin();
-void setRelay(uint8_t channel, bool on);
+// Persisted lights-on time, once storage is mounted
+void relaysRestore();
+// source/reason are recorded in the relay journal for every transition
+void setRelay(uint8_t channel, bool on, RelaySource source = RELAY_SRC_UNKNOWN, RelayReason reason = RELAY_REASON_NONE);
 bool getRelay(uint8_t channel);
+// {"ch1":0,...,"ch6":1}
+String relayStatusJson();
+void relayStatusWrite(StructWriter &w);
 // Convenience for lights mapped to channel 2
-void setLights(bool on);
+void setLights(bool on, RelaySource source = RELAY_SRC_UNKNOWN, RelayReason reason = RELAY_REASON_NONE);
 bool getLights();
 void relaysTick();
+// Drive every output to `onMask` (bit n-1 = channel n) right away. Touches
+// only the GPIOs (no journal, no flash), so the watchdog supervisor may call
+// it from its own task while the loop is stuck.
+void relaysForceSafe(uint8_t onMask);
 void setLightsMinDurationSec(unsigned long secs);
 unsigned long getLightsMinDurationSec();
 // Schedule an automatic lights-off after given seconds from now
 void scheduleLightsOffAfterSec(unsigned long secs);
-// Return millis when lights were turned on (0 if off)
-unsigned long getLightsOnSinceMillis();
+// timeMonoMs() when lights were turned on (0 if off)
+uint64_t getLightsOnSinceMs();
+// Cumulative lights-on time since boot in ms, taken from on/off edge timestamps
+uint64_t getLightsOnTotalMs();
 
 #endif // RELAYS_H
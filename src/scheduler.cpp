@@ -1,17 +1,34 @@
 #include "scheduler.h"
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
-#include <WiFi.h>
 #include <vector>
-#include <time.h>
+#include <algorithm>
 #include "relays.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "time_service.h"
 
 static const char* SCHEDULE_FILE = "/schedules.json";
+// Minutes a stalled loop or a small forward step of the clock still runs
+static const int64_t CATCH_UP_MIN = 60;
 static std::vector<ScheduleEntry> schedules;
-static int lastCheckedMinute = -1;
+// Epoch minute run last: minutes run in order, each at most once
+static int64_t lastMinute = -1;
+
+// The local day's runs as epoch minutes, in time order: built once per day
+// (and after an edit or a zone change), so the per-minute check is integer
+// compares. Times in the hour skipped by DST run at the change, times in
+// the repeated hour on their first pass (include/local_time.h).
+struct PlannedRun {
+  int64_t minute;
+  uint16_t index;
+};
+static std::vector<PlannedRun> plan;
+static int32_t planDay = INT32_MIN;
 
 void loadSchedules() {
   schedules.clear();
+  planDay = INT32_MIN;
   if (!SPIFFS.exists(SCHEDULE_FILE)) return;
   File f = SPIFFS.open(SCHEDULE_FILE, "r");
   if (!f) return;
@@ -50,64 +67,85 @@ void saveSchedules() {
   f.close();
 }
 
-void schedulerBegin() {
-  if (!SPIFFS.begin(true)) {
-    Serial.println("SPIFFS mount failed");
+// A step back leaves lastMinute ahead, so the minutes already run wait
+// until the clock is past them again, unless the clock was off by more than
+// the catch-up window: then it starts over from now. A step forward runs
+// the minutes it skipped (schedulerLoop), up to the window. A new zone
+// only moves the local times: the plan is rebuilt.
+static void onClockEvent(ClockEvent ev, int64_t jumpMs) {
+  if (ev == CLOCK_EV_ZONE) {
+    planDay = INT32_MIN;
+  } else if (ev == CLOCK_EV_SET) {
+    lastMinute = -1;
+  } else if (jumpMs < -CATCH_UP_MIN * 60000) {
+    lastMinute = timeNow() / 60 - 1;
+    LOG_W(LOGM_SCHEDULER, "Clock stepped back %ld min, schedules restart from now", (long)(-jumpMs / 60000));
   }
+}
+
+void schedulerBegin() {
   loadSchedules();
+  timeOnEvent(onClockEvent);
+}
 
-  // Try to configure time if WiFi connected
-  if (WiFi.status() == WL_CONNECTED) {
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-    Serial.println("NTP configured");
+static void buildPlan(int32_t day) {
+  LocalDay d = tzLocalDay(timeZone(), day);
+  plan.clear();
+  for (size_t i = 0; i < schedules.size(); ++i) {
+    const ScheduleEntry &e = schedules[i];
+    // check day-of-week mask (bit0 = Sunday)
+    if (!e.enabled || (e.days & (1 << d.wday)) == 0 || e.hour > 23 || e.minute > 59) continue;
+    PlannedRun r = { d.toUtc(e.hour * 60 + e.minute) / 60, (uint16_t)i };
+    plan.push_back(r);
   }
+  // same minute: in list order
+  std::stable_sort(plan.begin(), plan.end(), [](const PlannedRun &a, const PlannedRun &b) { return a.minute < b.minute; });
+  planDay = day;
 }
 
-static bool timeNow(uint8_t &hour, uint8_t &minute) {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) return false;
-  hour = timeinfo.tm_hour;
-  minute = timeinfo.tm_min;
-  return true;
+static void runPlanned(int64_t from, int64_t to) {
+  for (const PlannedRun &r : plan) {
+    if (r.minute < from) continue;
+    if (r.minute > to) break;
+    const ScheduleEntry &e = schedules[r.index];
+    LOG_I(LOGM_SCHEDULER, "Schedule trigger ch%d -> %s", (int)e.ch, e.on ? "ON" : "OFF");
+    setRelay(e.ch, e.on, RELAY_SRC_SCHEDULER, RELAY_REASON_SCHEDULE);
+  }
 }
 
 void schedulerLoop() {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) return; // need RTC/NTP
-  uint8_t hour = timeinfo.tm_hour;
-  uint8_t minute = timeinfo.tm_min;
-  int wday = timeinfo.tm_wday; // 0=Sunday..6=Saturday
-  if (minute == lastCheckedMinute) return; // only check once per minute
-  lastCheckedMinute = minute;
-
-  for (size_t i = 0; i < schedules.size(); ++i) {
-    auto &e = schedules[i];
-    if (!e.enabled) continue;
-    // check day-of-week mask (bit0 = Sunday)
-    if ((e.days & (1 << wday)) == 0) continue;
-    if (e.hour == hour && e.minute == minute) {
-      Serial.print("Schedule trigger ch"); Serial.print(e.ch);
-      Serial.print(" -> "); Serial.println(e.on ? "ON" : "OFF");
-      setRelay(e.ch, e.on);
-    }
+  time_t now = timeNow();
+  if (!now) return; // need RTC/NTP
+  int64_t minute = now / 60;
+  if (minute <= lastMinute) return; // only check once per minute
+  int64_t from = lastMinute >= 0 && minute - lastMinute <= CATCH_UP_MIN ? lastMinute + 1 : minute;
+  lastMinute = minute;
+  int32_t day = tzLocalDayOf(timeZone(), now);
+  if (day != planDay) {
+    // a catch-up across midnight finishes the day before first
+    if (planDay != INT32_MIN) runPlanned(from, minute);
+    buildPlan(day);
   }
+  runPlanned(from, minute);
 }
 
 String scheduleListJson() {
-  DynamicJsonDocument doc(4096);
-  JsonArray arr = doc.to<JsonArray>();
+  return structToJson<String>(scheduleListWrite);
+}
+
+void scheduleListWrite(StructWriter &w) {
+  w.beginArray();
   for (auto &e : schedules) {
-    JsonObject obj = arr.createNestedObject();
-    obj["ch"] = e.ch;
-    obj["hour"] = e.hour;
-    obj["minute"] = e.minute;
-    obj["on"] = e.on;
-    obj["enabled"] = e.enabled;
-    obj["days"] = e.days;
+    w.beginMap();
+    w.intField("ch", e.ch);
+    w.intField("hour", e.hour);
+    w.intField("minute", e.minute);
+    w.boolField("on", e.on);
+    w.boolField("enabled", e.enabled);
+    w.intField("days", e.days);
+    w.endMap();
   }
-  String out;
-  serializeJson(doc, out);
-  return out;
+  w.endArray();
 }
 
 bool addSchedule(uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t daysMask) {
@@ -116,6 +154,7 @@ bool addSchedule(uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t days
   e.ch = ch; e.hour = hour; e.minute = minute; e.on = on; e.enabled = true; e.days = daysMask;
   schedules.push_back(e);
   saveSchedules();
+  planDay = INT32_MIN;
   return true;
 }
 
@@ -123,6 +162,7 @@ bool removeSchedule(size_t index) {
   if (index >= schedules.size()) return false;
   schedules.erase(schedules.begin() + index);
   saveSchedules();
+  planDay = INT32_MIN;
   return true;
 }
 
@@ -130,6 +170,7 @@ bool setScheduleEnabled(size_t index, bool enabled) {
   if (index >= schedules.size()) return false;
   schedules[index].enabled = enabled;
   saveSchedules();
+  planDay = INT32_MIN;
   return true;
 }
 
@@ -142,5 +183,6 @@ bool editSchedule(size_t index, uint8_t ch, uint8_t hour, uint8_t minute, bool o
   schedules[index].on = on;
   schedules[index].days = daysMask;
   saveSchedules();
+  planDay = INT32_MIN;
   return true;
 }
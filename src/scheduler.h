@@ -2,6 +2,7 @@
 #define SCHEDULER_H
 
 #include <Arduino.h>
+#include "struct_writer.h"
 
 struct ScheduleEntry {
   uint8_t ch;
@@ -13,8 +14,11 @@ struct ScheduleEntry {
 };
 
 void schedulerBegin();
+// Reads /schedules.json again (schedulerBegin does this once)
+void loadSchedules();
 void schedulerLoop();
 String scheduleListJson();
+void scheduleListWrite(StructWriter &w);
 bool addSchedule(uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t daysMask = 0x7F);
 bool removeSchedule(size_t index);
 bool editSchedule(size_t index, uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t daysMask);
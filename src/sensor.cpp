@@ -1,6 +1,7 @@
 #include "sensor.h"
 #include "pins.h"
-#include "logging.h"
+#include "serial_utils.h"
+#include "json_writer.h"
 #include <DHTesp.h>
 
 static DHTesp dht_in;
@@ -10,71 +11,74 @@ static float lastInHum = NAN;
 static float lastOutTemp = NAN;
 static float lastOutHum = NAN;
 
+// The DHT22 needs 2 s between conversions and a read blocks for ~25 ms, so
+// sample on a fixed period and serve every caller from the cache.
+static const unsigned long SENSOR_SAMPLE_MS = 2000;
+static unsigned long lastSampleMs = 0;
+static uint32_t sampleCount = 0;
+
+static void sample() {
+  TempAndHumidity v = dht_in.getTempAndHumidity();
+  if (!isnan(v.temperature)) lastInTemp = v.temperature;
+  if (!isnan(v.humidity)) lastInHum = v.humidity;
+  v = dht_out.getTempAndHumidity();
+  if (!isnan(v.temperature)) lastOutTemp = v.temperature;
+  if (!isnan(v.humidity)) lastOutHum = v.humidity;
+
+  // Log sensor presence/absence for diagnostics, once after the first read
+  if (sampleCount == 0) {
+    if (isnan(lastInTemp) || isnan(lastInHum)) {
+      LOG_W(LOGM_SENSOR, "Indoor DHT sensor not responding or disconnected");
+    }
+    if (isnan(lastOutTemp) || isnan(lastOutHum)) {
+      LOG_W(LOGM_SENSOR, "Outdoor DHT sensor not responding or disconnected");
+    }
+  }
+  sampleCount++;
+}
+
+// No read here: the first sensorTick() samples right away, so setup() does
+// not wait on the sensors
 void sensorBegin() {
   dht_in.setup(DHT_IN_PIN, DHTesp::DHT22);
   dht_out.setup(DHT_OUT_PIN, DHTesp::DHT22);
-  delay(50);
-  float t = dht_in.getTemperature();
-  float h = dht_in.getHumidity();
-  if (!isnan(t)) lastInTemp = t;
-  if (!isnan(h)) lastInHum = h;
-  t = dht_out.getTemperature();
-  h = dht_out.getHumidity();
-  if (!isnan(t)) lastOutTemp = t;
-  if (!isnan(h)) lastOutHum = h;
-
-  // Log sensor presence/absence for diagnostics
-  if (isnan(lastInTemp) || isnan(lastInHum)) {
-    Serial.println("[WARN] Indoor DHT sensor not responding or disconnected");
-    appendLog(String("Indoor DHT missing or read failed"));
-  }
-  if (isnan(lastOutTemp) || isnan(lastOutHum)) {
-    Serial.println("[WARN] Outdoor DHT sensor not responding or disconnected");
-    appendLog(String("Outdoor DHT missing or read failed"));
-  }
+  lastSampleMs = millis() - SENSOR_SAMPLE_MS;
 }
 
-// Log sensor presence on startup if readings are missing
-  
+void sensorTick() {
+  unsigned long now = millis();
+  if (now - lastSampleMs < SENSOR_SAMPLE_MS) return;
+  lastSampleMs = now;
+  sample();
+}
 
 float readTemperatureC(bool outside) {
-  if (outside) {
-    float t = dht_out.getTemperature();
-    if (!isnan(t)) lastOutTemp = t;
-    return lastOutTemp;
-  } else {
-    float t = dht_in.getTemperature();
-    if (!isnan(t)) lastInTemp = t;
-    return lastInTemp;
-  }
+  return outside ? lastOutTemp : lastInTemp;
 }
 
 float readHumidity(bool outside) {
-  if (outside) {
-    float h = dht_out.getHumidity();
-    if (!isnan(h)) lastOutHum = h;
-    return lastOutHum;
-  } else {
-    float h = dht_in.getHumidity();
-    if (!isnan(h)) lastInHum = h;
-    return lastInHum;
-  }
+  return outside ? lastOutHum : lastInHum;
+}
+
+uint32_t sensorSampleCount() {
+  return sampleCount;
 }
 
 String sensorJson() {
-  float tin = readTemperatureC(false);
-  float hin = readHumidity(false);
-  float tout = readTemperatureC(true);
-  float hout = readHumidity(true);
-  String s = "{";
-  s += "\"in\":{";
-  if (isnan(tin)) s += "\"temp\":null,"; else s += "\"temp\":" + String(tin,2) + ",";
-  if (isnan(hin)) s += "\"hum\":null"; else s += "\"hum\":" + String(hin,2);
-  s += "},";
-  s += "\"out\":{";
-  if (isnan(tout)) s += "\"temp\":null,"; else s += "\"temp\":" + String(tout,2) + ",";
-  if (isnan(hout)) s += "\"hum\":null"; else s += "\"hum\":" + String(hout,2);
-  s += "}";
-  s += "}";
-  return s;
+  return structToJson<String>(sensorWrite);
+}
+
+void sensorWrite(StructWriter &w) {
+  w.beginMap();
+  w.key("in");
+  w.beginMap();
+  w.floatField("temp", readTemperatureC(false));
+  w.floatField("hum", readHumidity(false));
+  w.endMap();
+  w.key("out");
+  w.beginMap();
+  w.floatField("temp", readTemperatureC(true));
+  w.floatField("hum", readHumidity(true));
+  w.endMap();
+  w.endMap();
 }
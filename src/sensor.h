@@ -2,11 +2,19 @@
 #define SENSOR_H
 
 #include <Arduino.h>
+#include "struct_writer.h"
 
 void sensorBegin();
+// Sample both DHT22s every SENSOR_SAMPLE_MS; call from loop()
+void sensorTick();
+// Last good sample (NAN until the first one); these never touch the bus.
 // readTemperatureC(false) -> interior, true -> exterior
 float readTemperatureC(bool outside = false);
 float readHumidity(bool outside = false);
+// Incremented on every sample, lets consumers skip unchanged data
+uint32_t sensorSampleCount();
 String sensorJson();
+// Same content as sensorJson() for any output format
+void sensorWrite(StructWriter &w);
 
 #endif // SENSOR_H
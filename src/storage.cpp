@@ -0,0 +1,23 @@
+#include "storage.h"
+#include <SPIFFS.h>
+
+static bool mounted = false;
+
+bool storageBegin() {
+  if (!mounted) mounted = SPIFFS.begin(true);
+  return mounted;
+}
+
+bool storageReady() {
+  return mounted;
+}
+
+void storageEnd() {
+  if (mounted) SPIFFS.end();
+  mounted = false;
+}
+
+bool storageRemount() {
+  if (!mounted) mounted = SPIFFS.begin(false);
+  return mounted;
+}
@@ -0,0 +1,17 @@
+// SPIFFS is mounted once, early in setup(); modules check storageReady()
+// instead of mounting it again
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+
+// Mounts SPIFFS, formatting it if it cannot be mounted; false if unusable
+bool storageBegin();
+bool storageReady();
+// A filesystem update (src/ota.cpp) rewrites the partition under SPIFFS: it
+// is unmounted meanwhile, storageReady() is false and file opens just fail
+void storageEnd();
+// Mounts again without formatting; false if the partition holds no filesystem
+bool storageRemount();
+
+#endif // STORAGE_H
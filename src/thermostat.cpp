@@ -3,6 +3,10 @@
 #include <ArduinoJson.h>
 #include "sensor.h"
 #include "relays.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "boot.h"
+#include "time_service.h"
 
 static const char* THERM_FILE = "/thermostat.json";
 static const char* THERM_LOG = "/therm_log.csv";
@@ -15,7 +19,7 @@ static unsigned long maxRuntimeSec = 0; // 0 = disabled
 static float overtempCutoff = 200.0f; // very high default
 static float externalLimit = 200.0f; // if exterior >= this, don't enable heater
 static bool loggingEnabled = false;
-static unsigned long heaterOnSince = 0; // millis when heater turned on
+static uint64_t heaterOnSince = 0; // timeMonoMs() when heater turned on
 static int lastLogMinute = -1;
 
 static void loadThermostat() {
@@ -51,45 +55,50 @@ static void saveThermostat() {
 }
 
 void thermostatBegin() {
-  if (!SPIFFS.begin(true)) {
-    Serial.println("SPIFFS mount failed (thermostat)");
-  }
   loadThermostat();
 }
 
+void thermostatWrite(StructWriter &w) {
+  w.beginMap();
+  w.floatField("setpoint", setpoint);
+  w.floatField("hysteresis", hysteresis);
+  w.boolField("enabled", enabled);
+  w.floatField("temp", readTemperatureC(false));
+  w.endMap();
+}
+
 String thermostatJson() {
-  DynamicJsonDocument doc(256);
-  doc["setpoint"] = setpoint;
-  doc["hysteresis"] = hysteresis;
-  doc["enabled"] = enabled;
-  float temp = readTemperatureC(false);
-  doc["temp"] = temp;
-  String out;
-  serializeJson(doc, out);
-  return out;
+  return structToJson<String>(thermostatWrite);
 }
 
 String thermostatStatusJson() {
-  DynamicJsonDocument doc(512);
-  doc["setpoint"] = setpoint;
-  doc["hysteresis"] = hysteresis;
-  doc["enabled"] = enabled;
-  doc["maxRuntimeSec"] = maxRuntimeSec;
-  doc["overtempCutoff"] = overtempCutoff;
-  doc["externalLimit"] = externalLimit;
-  doc["loggingEnabled"] = loggingEnabled;
-  float temp = readTemperatureC(false);
-  float tout = readTemperatureC(true);
-  doc["temp"] = temp;
-  doc["temp_out"] = tout;
-  // heater runtime
-  if (heaterOnSince && lastState) doc["heaterRunSec"] = (millis() - heaterOnSince) / 1000;
-  else doc["heaterRunSec"] = 0;
-  String out;
-  serializeJson(doc, out);
-  return out;
+  return structToJson<String>(thermostatStatusWrite);
+}
+
+void thermostatStatusWrite(StructWriter &w) {
+  w.beginMap();
+  w.floatField("setpoint", setpoint);
+  w.floatField("hysteresis", hysteresis);
+  w.boolField("enabled", enabled);
+  w.intField("maxRuntimeSec", maxRuntimeSec);
+  w.floatField("overtempCutoff", overtempCutoff);
+  w.floatField("externalLimit", externalLimit);
+  w.boolField("loggingEnabled", loggingEnabled);
+  w.floatField("temp", readTemperatureC(false));
+  w.floatField("temp_out", readTemperatureC(true));
+  w.intField("heaterRunSec", heaterOnSince && lastState ? (timeMonoMs() - heaterOnSince) / 1000 : 0);
+  w.endMap();
 }
 
+float getThermostatSetpoint() { return setpoint; }
+float getThermostatHysteresis() { return hysteresis; }
+bool getThermostatEnabled() { return enabled; }
+unsigned long getThermostatMaxRuntime() { return maxRuntimeSec; }
+float getThermostatOvertempCutoff() { return overtempCutoff; }
+float getThermostatExternalLimit() { return externalLimit; }
+bool getThermostatLogging() { return loggingEnabled; }
+bool getThermostatHeating() { return lastState; }
+
 bool setThermostat(float sp, float h, bool en) {
   if (h < 0) return false;
   setpoint = sp;
@@ -109,16 +118,18 @@ bool setThermostatAdvanced(unsigned long maxRuntime, float overtemp, float extLi
 }
 
 void thermostatLoop() {
-  if (!enabled) return;
+  // first decision since reset: heater left off, or a reading to act on
+  if (!enabled) { bootMark(BOOT_FIRST_CONTROL); return; }
   float temp = readTemperatureC(false); // interior sensor
   if (isnan(temp)) return;
+  bootMark(BOOT_FIRST_CONTROL);
   // Safety: overtemp cutoff
   if (temp >= overtempCutoff) {
-    if (lastState) { setRelay(1, false); lastState = false; }
+    if (lastState) { setRelay(1, false, RELAY_SRC_THERMOSTAT, RELAY_REASON_OVERTEMP); lastState = false; }
     // disable thermostat to avoid restarting until user re-enables
     enabled = false;
     saveThermostat();
-    Serial.println("Thermostat disabled: overtemp cutoff reached");
+    LOG_W(LOGM_THERMOSTAT, "Thermostat disabled: overtemp cutoff reached");
     return;
   }
 
@@ -130,13 +141,13 @@ void thermostatLoop() {
   // turn ON if temp <= setpoint - hysteresis and not blocked
   if (temp <= (setpoint - hysteresis) && !extBlock) {
     if (!lastState) {
-      setRelay(1, true);
+      setRelay(1, true, RELAY_SRC_THERMOSTAT, RELAY_REASON_SETPOINT);
       lastState = true;
-      heaterOnSince = millis();
+      heaterOnSince = timeMonoMs();
     }
   } else if (temp >= (setpoint + hysteresis) || extBlock) {
     if (lastState) {
-      setRelay(1, false);
+      setRelay(1, false, RELAY_SRC_THERMOSTAT, extBlock ? RELAY_REASON_EXT_LIMIT : RELAY_REASON_SETPOINT);
       lastState = false;
       heaterOnSince = 0;
     }
@@ -144,28 +155,28 @@ void thermostatLoop() {
 
   // Max runtime enforcement
   if (lastState && heaterOnSince && maxRuntimeSec > 0) {
-    unsigned long runSec = (millis() - heaterOnSince) / 1000;
+    uint64_t runSec = (timeMonoMs() - heaterOnSince) / 1000;
     if (runSec >= maxRuntimeSec) {
-      setRelay(1, false);
+      setRelay(1, false, RELAY_SRC_THERMOSTAT, RELAY_REASON_MAX_RUNTIME);
       lastState = false;
       heaterOnSince = 0;
       enabled = false; // disable until user re-enables
       saveThermostat();
-      Serial.println("Thermostat disabled: max runtime exceeded");
+      LOG_W(LOGM_THERMOSTAT, "Thermostat disabled: max runtime exceeded");
     }
   }
 
   // Logging: append CSV once per minute
   if (loggingEnabled) {
     struct tm ti;
-    if (getLocalTime(&ti)) {
+    if (timeLocal(ti)) {
       int minute = ti.tm_min;
       if (minute != lastLogMinute) {
         lastLogMinute = minute;
         // append log
         File f = SPIFFS.open(THERM_LOG, FILE_APPEND);
         if (f) {
-          time_t nowt = time(nullptr);
+          time_t nowt = timeNow();
           char buf[64];
           snprintf(buf, sizeof(buf), "%lu,%0.2f,%0.2f,%0.2f,%0.2f,%d\n", (unsigned long)nowt, temp, readHumidity(false), tout, readHumidity(true), lastState?1:0);
           f.print(buf);
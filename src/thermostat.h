@@ -2,13 +2,25 @@
 #define THERMOSTAT_H
 
 #include <Arduino.h>
+#include "struct_writer.h"
 
 void thermostatBegin();
 void thermostatLoop();
 String thermostatJson();
+void thermostatWrite(StructWriter &w);
 bool setThermostat(float setpoint, float hysteresis, bool enabled);
 // Advanced safety and logging
 bool setThermostatAdvanced(unsigned long maxRuntimeSec, float overtempCutoff, float externalLimit, bool loggingEnabled);
 String thermostatStatusJson();
+void thermostatStatusWrite(StructWriter &w);
+float getThermostatSetpoint();
+float getThermostatHysteresis();
+bool getThermostatEnabled();
+unsigned long getThermostatMaxRuntime();
+float getThermostatOvertempCutoff();
+float getThermostatExternalLimit();
+bool getThermostatLogging();
+// true while the thermostat holds the heater (relay 1) on
+bool getThermostatHeating();
 
 #endif // THERMOSTAT_H
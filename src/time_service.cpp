@@ -0,0 +1,231 @@
+#include "time_service.h"
+#include "config.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "storage.h"
+#include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include <sys/time.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+
+static const uint8_t TIME_MAX_HOOKS = 4;
+static const char* TIME_FILE = "/time.json";
+
+static ClockTracker tracker(TIME_JUMP_MS);
+static TimeHook hooks[TIME_MAX_HOOKS];
+static uint8_t hookCount = 0;
+static uint32_t ntpStarts = 0;
+// Set on the SNTP task, taken by timeTick()
+static bool evSynced = false;
+// local time of cachedSec: one localtime_r per second at most
+static time_t cachedSec = 0;
+static struct tm cachedTm;
+static TzRule zone;
+static char zoneSpec[48];
+
+static const char* sourceName(ClockSource s) {
+  switch (s) {
+    case CLOCK_RTC: return "rtc";
+    case CLOCK_NTP: return "ntp";
+    default: return "none";
+  }
+}
+
+// The system clock: kept by the RTC timer across resets, set by SNTP
+static int64_t wallClockMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void onSntpSync(struct timeval*) {
+  __atomic_store_n(&evSynced, true, __ATOMIC_RELEASE);
+}
+
+static void runHooks(ClockEvent ev, int64_t jumpMs) {
+  for (uint8_t i = 0; i < hookCount; ++i) hooks[i](ev, jumpMs);
+}
+
+static void formatLocal(char* buf, size_t n) {
+  struct tm lt;
+  if (timeLocal(lt)) strftime(buf, n, "%Y-%m-%d %H:%M:%S", &lt);
+  else buf[0] = 0;
+}
+
+// newlib's localtime_r (timeLocal) follows the same rule
+static void applyZone(const char* spec, const TzRule &rule) {
+  strncpy(zoneSpec, spec, sizeof(zoneSpec) - 1);
+  zoneSpec[sizeof(zoneSpec) - 1] = 0;
+  zone = rule;
+  setenv("TZ", zoneSpec, 1);
+  tzset();
+  cachedSec = 0;
+}
+
+static void loadZone() {
+  TzRule rule;
+  if (!tzParse(TIME_TZ, rule)) {
+    LOG_E(LOGM_MAIN, "TIME_TZ \"%s\" is not a POSIX TZ rule, using UTC", TIME_TZ);
+    tzParse("UTC0", rule);
+    applyZone("UTC0", rule);
+  } else {
+    applyZone(TIME_TZ, rule);
+  }
+  if (!storageReady() || !SPIFFS.exists(TIME_FILE)) return;
+  File f = SPIFFS.open(TIME_FILE, "r");
+  if (!f) return;
+  StaticJsonDocument<192> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  const char* spec = doc["tz"] | "";
+  if (err || strlen(spec) >= sizeof(zoneSpec) || !tzParse(spec, rule)) {
+    LOG_W(LOGM_MAIN, "%s: no valid zone, using %s", TIME_FILE, zoneSpec);
+    return;
+  }
+  applyZone(spec, rule);
+}
+
+static bool saveZone(const char* spec) {
+  if (!storageReady()) return false;
+  StaticJsonDocument<192> doc;
+  doc["tz"] = spec;
+  File f = SPIFFS.open(TIME_FILE, "w");
+  if (!f) return false;
+  bool ok = serializeJson(doc, f) > 0;
+  f.close();
+  return ok;
+}
+
+uint64_t timeMonoMs() {
+  return (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+void timeBegin() {
+  // local time follows the zone rule before NTP answers, and on an RTC clock
+  loadZone();
+  tracker.begin(timeMonoMs(), wallClockMs());
+  if (tracker.valid()) {
+    char buf[24];
+    formatLocal(buf, sizeof(buf));
+    LOG_I(LOGM_MAIN, "Clock kept across the reset: %s (%s), waiting for NTP", buf, zoneSpec);
+  }
+}
+
+// A fresh SNTP start syncs right away instead of at the next poll, which
+// matters after a long outage
+void timeNtpStart() {
+  sntp_set_time_sync_notification_cb(onSntpSync);
+  configTzTime(zoneSpec, TIME_NTP_SERVER_1, TIME_NTP_SERVER_2);
+  ntpStarts++;
+  LOG_I(LOGM_MAIN, "NTP started (%s, %s)", TIME_NTP_SERVER_1, TIME_NTP_SERVER_2);
+}
+
+void timeTick() {
+  uint64_t mono = timeMonoMs();
+  bool synced = __atomic_exchange_n(&evSynced, false, __ATOMIC_ACQUIRE);
+  if (synced) tracker.synced(mono);
+  // the step (if any) first, so SYNC hooks see the corrected clock
+  ClockEvent ev = tracker.observe(mono, wallClockMs());
+  if (ev != CLOCK_EV_NONE) {
+    cachedSec = 0;
+    int64_t jump = ev == CLOCK_EV_JUMP ? tracker.lastJumpMs() : 0;
+    char buf[24];
+    formatLocal(buf, sizeof(buf));
+    if (ev == CLOCK_EV_SET) LOG_I(LOGM_MAIN, "Clock set: %s (%s)", buf, zoneSpec);
+    else LOG_W(LOGM_MAIN, "Clock stepped %+ld s, now %s", (long)(jump / 1000), buf);
+    runHooks(ev, jump);
+  }
+  if (synced) {
+    LOG_D(LOGM_MAIN, "NTP sync #%lu", (unsigned long)tracker.syncs());
+    runHooks(CLOCK_EV_SYNC, 0);
+  }
+}
+
+bool timeOnEvent(TimeHook hook) {
+  if (hookCount >= TIME_MAX_HOOKS) return false;
+  hooks[hookCount++] = hook;
+  return true;
+}
+
+bool timeValid() {
+  return tracker.valid();
+}
+
+time_t timeNow() {
+  return (time_t)(tracker.wallMs(timeMonoMs()) / 1000);
+}
+
+bool timeLocal(struct tm &out) {
+  time_t t = timeNow();
+  if (!t) return false;
+  if (t != cachedSec) {
+    localtime_r(&t, &cachedTm);
+    cachedSec = t;
+  }
+  out = cachedTm;
+  return true;
+}
+
+const TzRule &timeZone() {
+  return zone;
+}
+
+const char* timeZoneSpec() {
+  return zoneSpec;
+}
+
+bool timeSetZone(const char* spec, String &err) {
+  TzRule rule;
+  if (strlen(spec) >= sizeof(zoneSpec) || !tzParse(spec, rule)) {
+    err = "not a POSIX TZ rule, e.g. CET-1CEST,M3.5.0,M10.5.0/3";
+    return false;
+  }
+  if (!saveZone(spec)) {
+    err = "could not write /time.json";
+    return false;
+  }
+  applyZone(spec, rule);
+  char buf[24];
+  formatLocal(buf, sizeof(buf));
+  LOG_I(LOGM_MAIN, "Time zone %s, local time %s", zoneSpec, buf);
+  runHooks(CLOCK_EV_ZONE, 0);
+  return true;
+}
+
+void timeWrite(StructWriter &w) {
+  uint64_t mono = timeMonoMs();
+  uint64_t sinceSync = tracker.sinceSyncMs(mono);
+  char buf[24];
+  formatLocal(buf, sizeof(buf));
+  time_t now = timeNow();
+  int32_t offset = tzOffsetAt(zone, now);
+  w.beginMap();
+  w.boolField("valid", tracker.valid());
+  w.strField("source", sourceName(tracker.source()));
+  w.key("epoch");
+  if (tracker.valid()) w.intValue(now);
+  else w.nullValue();
+  w.strField("local", buf);
+  w.strField("tz", zoneSpec);
+  w.intField("utcOffsetSec", offset);
+  w.boolField("dst", zone.hasDst && offset == zone.dstOffset);
+  w.intField("uptimeMs", mono);
+  w.key("ntp");
+  w.beginMap();
+  w.intField("starts", ntpStarts);
+  w.intField("syncs", tracker.syncs());
+  w.key("lastSyncSec");
+  if (sinceSync != UINT64_MAX) w.intValue(sinceSync / 1000);
+  else w.nullValue();
+  // never synced counts as stale once the clock runs on the RTC alone
+  w.boolField("stale", sinceSync == UINT64_MAX ? tracker.valid() : sinceSync / 1000 > TIME_STALE_SEC);
+  w.endMap();
+  w.intField("jumps", tracker.jumps());
+  w.intField("lastJumpMs", tracker.lastJumpMs());
+  w.endMap();
+}
+
+String timeJson() {
+  return structToJson<String>(timeWrite);
+}
@@ -0,0 +1,51 @@
+// One clock for every module. timeMonoMs() is a 64-bit millisecond count
+// since boot that never wraps or jumps: use it for durations and timeouts.
+// The wall clock (UTC epoch, local time in TIME_TZ) is read once per loop
+// by timeTick() and served from cache, so no caller ever waits on NTP.
+// After a reset the RTC timer keeps the wall clock; NTP is (re)started on
+// every Wi-Fi link and its syncs are tracked. When the clock is first set
+// or steps (NTP correction, RTC that was off), the registered hooks are
+// told so they can re-anchor what they count in wall-clock minutes.
+// The zone is a POSIX TZ rule (include/local_time.h), TIME_TZ unless one
+// was set at runtime (saved in /time.json); the scheduler and automation
+// plan their local times with it, once per local day.
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "struct_writer.h"
+#include "clock_tracker.h"
+#include "local_time.h"
+
+// ev: CLOCK_EV_SET, CLOCK_EV_JUMP, CLOCK_EV_SYNC or CLOCK_EV_ZONE; jumpMs: the step
+// (positive forward), 0 for the others
+typedef void (*TimeHook)(ClockEvent ev, int64_t jumpMs);
+
+// Stage 1 of setup(), after storage: time zone, and whether the RTC kept the clock
+void timeBegin();
+// (Re)start SNTP; called on every Wi-Fi link up
+void timeNtpStart();
+// Every loop, before the scheduler: reads the clocks, runs the hooks
+void timeTick();
+// false when full (4 hooks)
+bool timeOnEvent(TimeHook hook);
+
+uint64_t timeMonoMs();
+bool timeValid();
+// UTC epoch seconds, 0 while the clock is not set
+time_t timeNow();
+// Local time in the zone; false while the clock is not set
+bool timeLocal(struct tm &out);
+
+const TzRule &timeZone();
+const char* timeZoneSpec();
+// Validate, save and apply a POSIX TZ rule ("CET-1CEST,M3.5.0,M10.5.0/3");
+// the hooks get CLOCK_EV_ZONE. false (err set) if invalid or not saved
+bool timeSetZone(const char* spec, String &err);
+
+// {"valid":true,"source":"ntp","epoch":...,"local":"2024-06-10 08:13:20",...}
+void timeWrite(StructWriter &w);
+String timeJson();
+
+#endif // TIME_SERVICE_H
@@ -0,0 +1,262 @@
+#include "watchdog.h"
+#include "config.h"
+#include "relays.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "watchdog_deadlines.h"
+#include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include <esp_attr.h>
+#include <esp_idf_version.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if defined(__XTENSA__)
+#include <freertos/xtensa_context.h>
+#include <esp_debug_helpers.h>
+#endif
+
+static const char* WATCHDOG_FILE = "/watchdog.json";
+static const uint32_t SUPERVISOR_POLL_MS = 100;
+static const uint8_t BACKTRACE_DEPTH = 8;
+static const uint32_t RTC_MAGIC = 0x57444731; // "WDG1"
+// the supervisor, not the panic backstop, must catch a stuck connect
+static_assert(WATCHDOG_DEADLINE_MS + MQTT_BLOCK_MAX_MS < WATCHDOG_TWDT_SEC * 1000UL,
+              "WATCHDOG_TWDT_SEC must exceed the MQTT deadline");
+
+// Kept in RTC memory that the bootloader does not clear, so it survives
+// esp_restart(), watchdog and panic resets (not a power cycle)
+struct WatchdogRtc {
+  uint32_t magic;
+  uint8_t tripped;     // the supervisor restarted the chip
+  uint8_t slot;        // subsystem running at the last supervisor poll
+  uint8_t depth;
+  uint32_t stalledMs;
+  uint32_t uptimeMs;
+  uint32_t backtrace[BACKTRACE_DEPTH];
+  uint32_t sum;
+};
+static RTC_NOINIT_ATTR WatchdogRtc rtc;
+
+static WatchdogMonitor monitor;
+static TaskHandle_t loopTask = nullptr;
+static TaskHandle_t supervisor = nullptr;
+static esp_reset_reason_t bootReason = ESP_RST_UNKNOWN;
+
+WatchdogMonitor &watchdogMonitor() { return monitor; }
+
+// Guards against the random contents RTC memory has after power-on
+static uint32_t rtcSum(const WatchdogRtc &r) {
+  const uint8_t* p = (const uint8_t*)&r;
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < offsetof(WatchdogRtc, sum); ++i) h = (h ^ p[i]) * 16777619UL;
+  return h;
+}
+
+static void rtcSeal() { rtc.sum = rtcSum(rtc); }
+
+static const char* resetReasonName(esp_reset_reason_t r) {
+  switch (r) {
+    case ESP_RST_POWERON: return "power_on";
+    case ESP_RST_EXT: return "external";
+    case ESP_RST_SW: return "software";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "int_wdt";
+    case ESP_RST_TASK_WDT: return "task_wdt";
+    case ESP_RST_WDT: return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deep_sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    case ESP_RST_SDIO: return "sdio";
+    default: return "unknown";
+  }
+}
+
+static const char* slotName(uint8_t slot) {
+  return slot < LOGM_COUNT ? logModuleName((LogModule)slot) : "loop";
+}
+
+#if defined(__XTENSA__)
+// A return address carries the call window size in its top bits; map it back
+// into the code segment and onto the call instruction
+static uint32_t callerPc(uint32_t pc) {
+  if (pc & 0x80000000) pc = (pc & 0x3fffffff) | 0x40000000;
+  return pc - 3;
+}
+
+// Walk the stack of a suspended task. pxTopOfStack (the TCB's first member)
+// points at the context saved when it was switched out: an interrupt frame
+// if it was preempted, a solicited frame if it blocked in a FreeRTOS call.
+static uint8_t captureBacktrace(TaskHandle_t task, uint32_t* out, uint8_t max) {
+  const void* top = *(const void* const*)task;
+  esp_backtrace_frame_t f;
+  const XtExcFrame* x = (const XtExcFrame*)top;
+  if (x->exit) {
+    f.pc = x->pc;
+    f.sp = x->a1;
+    f.next_pc = x->a0;
+  } else {
+    const XtSolFrame* s = (const XtSolFrame*)top;
+    f.pc = s->pc;
+    f.sp = s->a1;
+    f.next_pc = s->a0;
+  }
+  uint8_t n = 0;
+  out[n++] = f.pc;
+  while (n < max && f.next_pc && esp_backtrace_get_next_frame(&f)) out[n++] = callerPc(f.pc);
+  return n;
+}
+#else
+static uint8_t captureBacktrace(TaskHandle_t, uint32_t*, uint8_t) { return 0; }
+#endif
+
+// Runs on the supervisor task with loop() stuck: no logging, flash or heap
+static void trip(const LivenessStall &st) {
+  vTaskSuspend(loopTask);
+  relaysForceSafe(WATCHDOG_SAFE_RELAYS);
+  rtc.tripped = 1;
+  rtc.slot = st.slot;
+  rtc.stalledMs = st.stalledMs;
+  rtc.uptimeMs = millis();
+  rtc.depth = captureBacktrace(loopTask, rtc.backtrace, BACKTRACE_DEPTH);
+  rtcSeal();
+  esp_restart();
+}
+
+static void supervise(void*) {
+  LivenessStall st;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_POLL_MS));
+    bool stalled = monitor.check(millis(), st);
+    // what was running if the task watchdog or a panic gets there first
+    rtc.slot = st.slot;
+    rtc.stalledMs = st.stalledMs;
+    rtc.uptimeMs = millis();
+    rtcSeal();
+    if (stalled) trip(st);
+  }
+}
+
+// Previous boot ended in a trip or a crash: log it and keep it on flash
+static void recordTrip(esp_reset_reason_t reason, bool detail) {
+  const char* cause = detail && rtc.tripped ? "supervisor" : resetReasonName(reason);
+  const char* module = detail ? slotName(rtc.slot) : "unknown";
+  char bt[BACKTRACE_DEPTH * 11 + 1];
+  size_t n = 0;
+  bt[0] = 0;
+  uint8_t depth = detail && rtc.depth <= BACKTRACE_DEPTH ? rtc.depth : 0;
+  for (uint8_t i = 0; i < depth; ++i) n += snprintf(bt + n, sizeof(bt) - n, " 0x%08lx", (unsigned long)rtc.backtrace[i]);
+  LOG_W(LOGM_MAIN, "Watchdog reset (%s): %s stalled %lu ms at uptime %lu s%s%s", cause, module,
+        detail ? (unsigned long)rtc.stalledMs : 0UL, detail ? (unsigned long)(rtc.uptimeMs / 1000) : 0UL,
+        depth ? ", backtrace:" : "", bt);
+
+  DynamicJsonDocument old(2048);
+  if (SPIFFS.exists(WATCHDOG_FILE)) {
+    File f = SPIFFS.open(WATCHDOG_FILE, "r");
+    if (f) {
+      if (deserializeJson(old, f)) old.clear();
+      f.close();
+    }
+  }
+  DynamicJsonDocument doc(2048);
+  JsonArray arr = doc.to<JsonArray>();
+  JsonArray prev = old.as<JsonArray>();
+  // newest last, WATCHDOG_HISTORY at most
+  size_t skip = prev.size() >= WATCHDOG_HISTORY ? prev.size() - (WATCHDOG_HISTORY - 1) : 0;
+  for (JsonVariant v : prev) {
+    if (skip) { skip--; continue; }
+    arr.add(v);
+  }
+  JsonObject e = arr.createNestedObject();
+  e["cause"] = cause;
+  e["resetReason"] = resetReasonName(reason);
+  e["module"] = module;
+  e["stalledMs"] = detail ? rtc.stalledMs : 0;
+  e["uptimeSec"] = detail ? rtc.uptimeMs / 1000 : 0;
+  JsonArray trace = e.createNestedArray("backtrace");
+  for (uint8_t i = 0; i < depth; ++i) {
+    char pc[11];
+    snprintf(pc, sizeof(pc), "0x%08lx", (unsigned long)rtc.backtrace[i]);
+    trace.add(pc);
+  }
+  File f = SPIFFS.open(WATCHDOG_FILE, "w");
+  if (!f) return;
+  serializeJson(doc, f);
+  f.close();
+}
+
+void watchdogBegin() {
+  bootReason = esp_reset_reason();
+  bool valid = rtc.magic == RTC_MAGIC && rtc.sum == rtcSum(rtc);
+  bool crash = bootReason == ESP_RST_PANIC || bootReason == ESP_RST_INT_WDT ||
+               bootReason == ESP_RST_TASK_WDT || bootReason == ESP_RST_WDT;
+  if ((valid && rtc.tripped) || crash) recordTrip(bootReason, valid);
+  memset(&rtc, 0, sizeof(rtc));
+  rtc.magic = RTC_MAGIC;
+  rtc.slot = WatchdogMonitor::IDLE;
+  rtcSeal();
+
+  watchdogSetDeadlines(monitor, WATCHDOG_DEADLINE_MS);
+  loopTask = xTaskGetCurrentTaskHandle();
+  // on the other core, so a loop spinning with its core busy is still seen
+  BaseType_t core = xPortGetCoreID() ? 0 : 1;
+  if (xTaskCreatePinnedToCore(supervise, "wdt_supervisor", 3072, nullptr, configMAX_PRIORITIES - 5, &supervisor, core) != pdPASS) {
+    supervisor = nullptr;
+    LOG_E(LOGM_MAIN, "Watchdog supervisor task not started");
+  }
+
+  // Backstop: panic (backtrace on the console) if loop() is not back within
+  // WATCHDOG_TWDT_SEC; the Arduino core feeds it after every loop() call
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_task_wdt_config_t cfg = { WATCHDOG_TWDT_SEC * 1000, 0, true };
+  esp_task_wdt_reconfigure(&cfg);
+#else
+  esp_task_wdt_init(WATCHDOG_TWDT_SEC, true);
+#endif
+  enableLoopWDT();
+  LOG_I(LOGM_MAIN, "Watchdog: %lu ms per subsystem (mqtt %lu ms), task watchdog %d s", (unsigned long)WATCHDOG_DEADLINE_MS,
+        (unsigned long)watchdogDeadlineOf(LOGM_MQTT, WATCHDOG_DEADLINE_MS), WATCHDOG_TWDT_SEC);
+}
+
+void watchdogWrite(StructWriter &w) {
+  w.beginMap();
+  w.strField("resetReason", resetReasonName(bootReason));
+  w.intField("deadlineMs", WATCHDOG_DEADLINE_MS);
+  w.intField("mqttDeadlineMs", watchdogDeadlineOf(LOGM_MQTT, WATCHDOG_DEADLINE_MS));
+  w.intField("taskWdtSec", WATCHDOG_TWDT_SEC);
+  w.intField("safeRelays", WATCHDOG_SAFE_RELAYS);
+  w.boolField("supervising", supervisor != nullptr);
+  w.intField("checkIns", monitor.checkIns());
+  w.key("trips");
+  w.beginArray();
+  if (SPIFFS.exists(WATCHDOG_FILE)) {
+    File f = SPIFFS.open(WATCHDOG_FILE, "r");
+    DynamicJsonDocument doc(2048);
+    if (f && !deserializeJson(doc, f)) {
+      for (JsonObject e : doc.as<JsonArray>()) {
+        w.beginMap();
+        w.strField("cause", e["cause"] | "");
+        w.strField("resetReason", e["resetReason"] | "");
+        w.strField("module", e["module"] | "");
+        w.intField("stalledMs", e["stalledMs"] | 0UL);
+        w.intField("uptimeSec", e["uptimeSec"] | 0UL);
+        w.key("backtrace");
+        w.beginArray();
+        for (JsonVariant pc : e["backtrace"].as<JsonArray>()) w.strValue(pc | "");
+        w.endArray();
+        w.endMap();
+      }
+    }
+    if (f) f.close();
+  }
+  w.endArray();
+  w.endMap();
+}
+
+String watchdogJson() {
+  return structToJson<String>(watchdogWrite);
+}
+
+void watchdogClearHistory() {
+  if (SPIFFS.exists(WATCHDOG_FILE)) SPIFFS.remove(WATCHDOG_FILE);
+}
@@ -0,0 +1,23 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+#include "liveness_monitor.h"
+#include "log_macros.h"
+
+// One slot per log module (main, wifi, web, mqtt, ...); loop() checks in
+// through PerfScope (src/perf.h)
+typedef LivenessMonitor<LOGM_COUNT> WatchdogMonitor;
+WatchdogMonitor &watchdogMonitor();
+
+// Call at the end of setup(), after initLogging(): logs and stores on flash
+// what tripped before the last reset, then starts the supervisor task and
+// the task watchdog on loop()
+void watchdogBegin();
+// Reset reason, limits, check-ins and the trips kept in /watchdog.json
+void watchdogWrite(StructWriter &w);
+String watchdogJson();
+void watchdogClearHistory();
+
+#endif // WATCHDOG_H
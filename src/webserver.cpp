@@ -2,76 +2,390 @@
 #include "webserver.h"
 #include "config.h"
 #include "relays.h"
+#include "relay_journal.h"
 #include <SPIFFS.h>
 #include "sensor.h"
 #include "thermostat.h"
 #include "automation.h"
-#include "led.h"
+#include "mqtt.h"
+#include "commands.h"
 #include "serial_utils.h"
+#include "broadcast_hub.h"
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "chunked_sink.h"
+#include "heap_debug.h"
+#include "perf.h"
+#include "watchdog.h"
+#include "boot.h"
+#include "wifi_manager.h"
+#include "net_config.h"
+#include "time_service.h"
+#include "scheduler.h"
+#include "http_request.h"
+#include "ota.h"
+#include <lwip/sockets.h>
 
 static WiFiServer server(80);
 // Telnet-like server for remote serial log viewing
 static WiFiServer telnetServer(23);
 
-// SSE clients (simple fixed-size array)
-static WiFiClient sseClients[4];
-static WiFiClient telnetClients[2];
+// next relay journal event to push to SSE/telnet clients
+static uint32_t relayEventCursor = 0;
+
+// Stream clients are fed from broadcast hubs (include/broadcast_hub.h): each
+// message is stored once and every socket is drained without blocking from
+// its own cursor, so a stalled client only delays itself. Slot i of a hub
+// owns socket i of the matching array.
+static BroadcastHub<4096, WEB_SSE_CLIENTS, 512> sseHub;
+static WiFiClient sseClients[WEB_SSE_CLIENTS];
+// SSE subscriber that still needs a "state" snapshot (new, or skipped ahead)
+static bool sseResync[WEB_SSE_CLIENTS];
+// also the log backlog replayed to new telnet clients, so it is fed even
+// while nobody is connected
+static BroadcastHub<4096, WEB_TELNET_CLIENTS, 256> telnetHub;
+static WiFiClient telnetClients[WEB_TELNET_CLIENTS];
+
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+// 2 listeners + the HTTP request being served + MQTT + an OTA upload, which
+// keeps its socket (src/ota.cpp) while other requests are served
+static_assert(WEB_SSE_CLIENTS + WEB_TELNET_CLIENTS + 5 <= CONFIG_LWIP_MAX_SOCKETS,
+              "more stream clients than lwIP sockets");
+#endif
+
+// last values pushed, to send only what changed
+static uint32_t pushedSensorSample = 0;
+static float pushedSensor[4] = { NAN, NAN, NAN, NAN };
+static float pushedThermostat[4] = { NAN, NAN, NAN, NAN };
+static float pushedLight[2] = { NAN, NAN };
+static unsigned long lastLightCheck = 0;
+static const unsigned long LIGHT_PUSH_MS = 10000;
+
+// BroadcastHub writer over a raw socket; never waits for buffer space
+struct SocketWriter {
+  int fd;
+  bool failed;
+  size_t write(const uint8_t* p, size_t n) {
+    int sent = send(fd, p, n, MSG_DONTWAIT);
+    if (sent >= 0) return (size_t)sent;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) failed = true;
+    return 0;
+  }
+};
+
+static String thermostatPushJson() {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "{\"setpoint\":%.2f,\"hysteresis\":%.2f,\"enabled\":%d,\"heating\":%d}",
+           getThermostatSetpoint(), getThermostatHysteresis(),
+           getThermostatEnabled() ? 1 : 0, getThermostatHeating() ? 1 : 0);
+  return String(buf);
+}
+
+static String lightPushJson() {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "{\"accumHours\":%.2f,\"dli\":%.2f}",
+           getDailyLightHours(), getDailyLightIntegral());
+  return String(buf);
+}
 
-static void telnetCleanSlot(int i) {
-  if (telnetClients[i] && !telnetClients[i].connected()) {
-    telnetClients[i].stop();
-    telnetClients[i] = WiFiClient();
+// Everything the dashboard shows live, sent on subscribe and after an overflow
+static String statePushJson() {
+  String s = "{\"relays\":[";
+  for (int i = 1; i <= 6; ++i) {
+    if (i > 1) s += ",";
+    s += getRelay(i) ? "1" : "0";
   }
+  s += "],\"sensor\":" + sensorJson();
+  s += ",\"thermostat\":" + thermostatPushJson();
+  s += ",\"light\":" + lightPushJson();
+  s += "}";
+  return s;
+}
+
+static bool sseUnicastState(int id) {
+  String snap = statePushJson();
+  HubPart parts[] = { { "event: state\ndata: ", 19 }, { snap.c_str(), snap.length() }, { "\n\n", 2 } };
+  return sseHub.unicast(id, parts, 3);
 }
 
-static void sseCleanSlot(int i) {
-  if (sseClients[i] && !sseClients[i].connected()) {
-    sseClients[i].stop();
-    sseClients[i] = WiFiClient();
+// Drain every subscriber of `hub` into its socket; closes dead or
+// disconnect-policy subscribers
+template <typename Hub>
+static void pumpSubscribers(Hub &hub, WiFiClient* socks) {
+  for (size_t i = 0; i < Hub::capacity(); ++i) {
+    if (!hub.active(i)) continue;
+    SocketWriter w = { socks[i].fd(), false };
+    if (socks[i].connected() && !hub.closing(i)) hub.pump(i, w);
+    if (w.failed || !socks[i].connected() || hub.closing(i)) {
+      socks[i].stop();
+      socks[i] = WiFiClient();
+      hub.unsubscribe(i);
+    }
   }
 }
 
-void webBroadcast(const String &msg) {
-  for (int i = 0; i < 4; ++i) {
-    if (sseClients[i] && sseClients[i].connected()) {
-      sseClients[i].print("data: ");
-      sseClients[i].print(msg);
-      sseClients[i].print("\n\n");
-    } else {
-      sseCleanSlot(i);
+static void sseFlush() {
+  for (int i = 0; i < WEB_SSE_CLIENTS; ++i) {
+    if (!sseHub.active(i)) continue;
+    if (sseHub.takeGap(i)) sseResync[i] = true;
+    if (sseResync[i] && sseUnicastState(i)) sseResync[i] = false;
+  }
+  pumpSubscribers(sseHub, sseClients);
+}
+
+static void telnetFlush() {
+  for (int i = 0; i < WEB_TELNET_CLIENTS; ++i) {
+    if (!telnetHub.active(i)) continue;
+    // output only: discard keystrokes and option negotiation
+    while (telnetClients[i].available()) telnetClients[i].read();
+    if (telnetHub.takeGap(i)) {
+      static const char note[] = "[...] lines dropped, client too slow\r\n";
+      telnetHub.unicast(i, note, sizeof(note) - 1);
     }
   }
+  pumpSubscribers(telnetHub, telnetClients);
+}
+
+static bool sseSubscribe(WiFiClient &client) {
+  // state streams skip stale deltas and resync from a snapshot
+  int id = sseHub.subscribe(HUB_SKIP_TO_LATEST);
+  if (id < 0) return false;
+  sseClients[id] = client;
+  sseClients[id].setNoDelay(true);
+  sseResync[id] = !sseUnicastState(id);
+  return true;
+}
+
+static void sseBroadcast(const char* event, const char* data, size_t n) {
+  if (!sseHub.subscribers()) return;
+  if (event) {
+    HubPart parts[] = { { "event: ", 7 }, { event, strlen(event) }, { "\ndata: ", 7 }, { data, n }, { "\n\n", 2 } };
+    sseHub.publish(parts, 5);
+  } else {
+    HubPart parts[] = { { "data: ", 6 }, { data, n }, { "\n\n", 2 } };
+    sseHub.publish(parts, 3);
+  }
+}
+
+void webBroadcast(const String &msg) {
+  sseBroadcast(nullptr, msg.c_str(), msg.length());
   // also send to telnet clients (plain text)
-  for (int i = 0; i < 2; ++i) {
-    if (telnetClients[i] && telnetClients[i].connected()) {
-      telnetClients[i].print(msg);
-      telnetClients[i].print("\r\n");
-    } else {
-      telnetCleanSlot(i);
-    }
+  HubPart parts[] = { { msg.c_str(), msg.length() }, { "\r\n", 2 } };
+  telnetHub.publish(parts, 2);
+}
+
+void webBroadcastEvent(const char* event, const String &data) {
+  sseBroadcast(event, data.c_str(), data.length());
+  HubPart parts[] = { { "[", 1 }, { event, strlen(event) }, { "] ", 2 }, { data.c_str(), data.length() }, { "\r\n", 2 } };
+  telnetHub.publish(parts, 5);
+}
+
+// Log sinks (see logging.h): complete lines only
+static void telnetLogSink(LogLevel, const char* text, size_t len, bool) {
+  HubPart parts[] = { { text, len }, { "\r\n", 2 } };
+  telnetHub.publish(parts, 2);
+}
+
+static void sseLogSink(LogLevel, const char* text, size_t len, bool) {
+  sseBroadcast("log", text, len);
+}
+
+// Accepted independently of HTTP traffic. A new client first gets the
+// retained backlog, then live lines.
+static void acceptTelnet() {
+  WiFiClient t = telnetServer.available();
+  if (!t) return;
+  int id = telnetHub.subscribe(HUB_DROP_OLDEST, true);
+  if (id < 0) {
+    t.print("Too many telnet clients\r\n");
+    t.stop();
+    return;
   }
+  static const char welcome[] = "Welcome to device serial log\r\n";
+  telnetClients[id] = t;
+  telnetClients[id].setNoDelay(true);
+  telnetHub.unicast(id, welcome, sizeof(welcome) - 1);
 }
 
-String relayStatusJson() {
-  String s = "{";
-  for (int i = 1; i <= 6; ++i) {
-    s += "\"ch" + String(i) + "\":" + (getRelay(i) ? "1" : "0");
-    if (i < 6) s += ",";
+template <typename Hub>
+static void addHubStats(String &s, const char* name, Hub &hub) {
+  s += String("\"") + name + "\":{\"published\":" + String(hub.published());
+  s += ",\"evicted\":" + String(hub.evicted()) + ",\"usedBytes\":" + String((unsigned long)hub.usedBytes());
+  s += ",\"clients\":[";
+  bool first = true;
+  for (size_t i = 0; i < Hub::capacity(); ++i) {
+    if (!hub.active(i)) continue;
+    const typename Hub::SubStats &st = hub.stats(i);
+    if (!first) s += ",";
+    first = false;
+    s += "{\"slot\":" + String((unsigned)i) + ",\"frames\":" + String(st.frames);
+    s += ",\"bytes\":" + String(st.bytes) + ",\"dropped\":" + String(st.dropped);
+    s += ",\"gaps\":" + String(st.gaps) + ",\"stalls\":" + String(st.stalls);
+    s += ",\"lagBytes\":" + String(hub.lagBytes(i)) + ",\"maxLagBytes\":" + String(st.maxLagBytes) + "}";
   }
+  s += "]}";
+}
+
+// Per-client fan-out counters for /events/stats
+static String streamStatsJson() {
+  String s = "{";
+  addHubStats(s, "sse", sseHub);
+  s += ",";
+  addHubStats(s, "telnet", telnetHub);
   s += "}";
   return s;
 }
 
-static void sendResponse(WiFiClient &client, const char* contentType, const String &body) {
-  client.print("HTTP/1.1 200 OK\r\n");
+// Stream new relay journal events as they happen
+static void pumpRelayEvents() {
+  uint32_t head = relayJournalHead();
+  RelayEvent e;
+  while (relayEventCursor != head) {
+    if (relayJournalGet(relayEventCursor, e)) {
+      webBroadcastEvent("relay", relayEventJson(relayEventCursor, e));
+    }
+    relayEventCursor++;
+  }
+}
+
+static bool moved(float a, float b, float deadband) {
+  if (isnan(a) != isnan(b)) return true;
+  return !isnan(a) && fabsf(a - b) >= deadband;
+}
+
+// Push sensor samples, thermostat state and the daily light counters when
+// they change, so the dashboard needs no polling
+static void pumpStateDeltas() {
+  uint32_t seq = sensorSampleCount();
+  if (seq != pushedSensorSample) {
+    pushedSensorSample = seq;
+    float v[4] = { readTemperatureC(false), readHumidity(false), readTemperatureC(true), readHumidity(true) };
+    bool changed = false;
+    for (int i = 0; i < 4; ++i) {
+      if (moved(v[i], pushedSensor[i], 0.05f)) changed = true;
+      pushedSensor[i] = v[i];
+    }
+    if (changed) {
+      String s = sensorJson();
+      sseBroadcast("sensor", s.c_str(), s.length());
+    }
+  }
+  float t[4] = { getThermostatSetpoint(), getThermostatHysteresis(),
+                 getThermostatEnabled() ? 1.0f : 0.0f, getThermostatHeating() ? 1.0f : 0.0f };
+  bool changed = false;
+  for (int i = 0; i < 4; ++i) {
+    if (moved(t[i], pushedThermostat[i], 0.005f)) changed = true;
+    pushedThermostat[i] = t[i];
+  }
+  if (changed) {
+    String s = thermostatPushJson();
+    sseBroadcast("thermostat", s.c_str(), s.length());
+  }
+  unsigned long now = millis();
+  if (now - lastLightCheck >= LIGHT_PUSH_MS) {
+    lastLightCheck = now;
+    float l[2] = { getDailyLightHours(), getDailyLightIntegral() };
+    if (moved(l[0], pushedLight[0], 0.01f) || moved(l[1], pushedLight[1], 0.01f)) {
+      pushedLight[0] = l[0];
+      pushedLight[1] = l[1];
+      String s = lightPushJson();
+      sseBroadcast("light", s.c_str(), s.length());
+    }
+  }
+}
+
+// Endpoints kept for the web UI; each maps onto a command of the shared table
+struct LegacyCommand {
+  const char* path;
+  const char* action;   // value of ?action=, nullptr = any
+  const char* command;
+};
+static const LegacyCommand LEGACY_COMMANDS[] = {
+  { "/relay", nullptr, "relay" },
+  { "/thermostat", "set", "thermostat_set" },
+  { "/thermostat", "setAdvanced", "thermostat_advanced" },
+  { "/automation", "setDaily", "daily_light" },
+  { "/automation", "setDli", "dli" },
+  { "/automation", "setIrrigation", "irrigation" },
+  { "/automation", "setIrrTimes", "irr_times" },
+  { "/automation", "setZones", "zones" },
+  { "/automation", "setRules", "rules" },
+  { "/schedule", "add", "schedule_add" },
+  { "/schedule", "edit", "schedule_edit" },
+  { "/schedule", "enable", "schedule_enable" },
+  { "/schedule", "delete", "schedule_delete" },
+};
+
+static void sendResponse(WiFiClient &client, const char* contentType, const String &body, int code = 200) {
+  client.print(code == 200 ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 400 Bad Request\r\n");
   client.print("Content-Type: "); client.print(contentType); client.print("\r\n");
   client.print("Content-Length: "); client.print(body.length()); client.print("\r\n");
   client.print("Connection: close\r\n\r\n");
   client.print(body);
 }
 
+// The flash log, rotated part (/logs.old) first, then /logs.txt
+static void sendLogFiles(WiFiClient &client) {
+  logFlush();
+  const char* files[2] = { "/logs.old", "/logs.txt" };
+  if (!SPIFFS.exists(files[0]) && !SPIFFS.exists(files[1])) {
+    sendResponse(client, "text/plain", String("No logs"));
+    return;
+  }
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n");
+  client.print("Connection: close\r\n\r\n");
+  for (int i = 0; i < 2; ++i) {
+    if (!SPIFFS.exists(files[i])) continue;
+    File f = SPIFFS.open(files[i], "r");
+    if (!f) continue;
+    uint8_t buf[256];
+    while (f.available()) {
+      size_t n = f.read(buf, sizeof(buf));
+      client.write(buf, n);
+    }
+    f.close();
+  }
+}
+
+// Data responses are encoded straight into the socket, no document or String
+// in between: the writer's 256-byte buffer goes out as one chunk each time it
+// fills, so peak memory does not depend on the response size
+static void sendStruct(WiFiClient &client, StructProducer produce, bool cbor) {
+  client.print("HTTP/1.1 200 OK\r\nContent-Type: ");
+  client.print(cbor ? "application/cbor" : "application/json");
+  client.print("\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n");
+  ChunkedSink<WiFiClient> chunks(client);
+  if (cbor) {
+    CborWriter<ChunkedSink<WiFiClient> > w(chunks);
+    produce(w);
+    w.flush();
+  } else {
+    JsonWriter<ChunkedSink<WiFiClient> > w(chunks);
+    produce(w);
+    w.flush();
+  }
+  chunks.finish();
+}
+
+// Everything a poller needs in one response
+static void stateWrite(StructWriter &w) {
+  w.beginMap();
+  w.intField("uptimeSec", millis() / 1000);
+  w.key("relays");
+  relayStatusWrite(w);
+  w.key("sensor");
+  sensorWrite(w);
+  w.key("thermostat");
+  thermostatStatusWrite(w);
+  w.key("automation");
+  automationWrite(w);
+  w.key("schedules");
+  scheduleListWrite(w);
+  w.endMap();
+}
+
 // Very small URL parser for GET path and query
-static void handleRequest(WiFiClient &client, const String &path) {
+static void handleRequest(WiFiClient &client, const String &path, bool cbor) {
   // Serve onboard MQTT dashboard (prefer SPIFFS file, fallback to embedded)
   if (path == "/mqtt" || path == "/dashboard") {
     if (SPIFFS.exists("/web_dashboard.html")) {
@@ -119,12 +433,12 @@ document.getElementById('subAll').onclick = ()=>{ if(!client||!client.connected)
     page += "<h1>Invernadero - Control</h1>";
     page += "<h2>Relés</h2><ul>";
     for (int i = 1; i <= 6; ++i) {
-      page += "<li>Relé CH" + String(i) + ": " + (getRelay(i) ? "ENCENDIDO" : "APAGADO") + " <a href='/relay?ch=" + String(i) + "&state=toggle'>Alternar</a></li>";
+      page += "<li>Relé CH" + String(i) + ": <span id='r" + String(i) + "'>" + (getRelay(i) ? "ENCENDIDO" : "APAGADO") + "</span> <button onclick=\"fetch('/relay?ch=" + String(i) + "&state=toggle')\">Alternar</button></li>";
     }
     page += "</ul>";
 
     page += "<h2>Luces</h2>";
-    page += "<div>Estado: " + String(getLights() ? "ENCENDIDO" : "APAGADO") + " <button onclick=\"fetch('/relay?ch=2&state=toggle').then(()=>location.reload())\">Alternar luces</button>";
+    page += "<div>Estado: <span id='lights'>" + String(getLights() ? "ENCENDIDO" : "APAGADO") + "</span> <button onclick=\"fetch('/relay?ch=2&state=toggle')\">Alternar luces</button>";
     page += " <button onclick=\"document.getElementById('ch').value=2;\">Usar CH2 para agregar horario</button></div>";
 
     page += "<h2>Temperatura</h2>";
@@ -141,6 +455,8 @@ document.getElementById('subAll').onclick = ()=>{ if(!client||!client.connected)
     page += "Min diario de luces (h): <input id='dailyHours' size=4> <button id='setDaily'>Guardar</button>";
     page += " Riego - cantidad: <input id='irCount' size=2> Duración(s): <input id='irDur' size=3> Hora inicio: <input id='irStart' size=2> <button id='setIrr'>Guardar riego</button>";
     page += "<br>O tiempos explícitos (CSV HH:MM): <input id='irTimes' size=20> <button id='setIrrTimes'>Definir tiempos</button>";
+    page += "<br>Zonas de riego (CSV CH:seg): <input id='irZones' size=20> Válvulas simultáneas: <input id='irConc' size=2> <button id='setZones'>Guardar zonas</button>";
+    page += "<br>Reglas (ej. <code>tout&gt;25 &amp; hin&gt;80 -&gt; ch4 10m h0.5</code>; separar con ;): <input id='rules' size=50> <button id='setRules'>Guardar reglas</button> <span id='rulesErr'></span>";
 
     page += "<h2>Horarios</h2>";
     page += "<div id='schedules'><em>Cargando...</em></div>";
@@ -174,19 +490,55 @@ async function loadSchedules(){
   html += '</table>';
   document.getElementById('schedules').innerHTML = html;
 }
-async function loadSensor(){
-  try{
-    let r = await fetch('/sensor');
-    let o = await r.json();
-    document.getElementById('sensor').innerText = `Interior: ${o.in.temp} °C, ${o.in.hum} % \nExterior: ${o.out.temp} °C, ${o.out.hum} %`;
-  }catch(e){ document.getElementById('sensor').innerText = 'Error de temperatura'; }
+// Live values arrive over /events (SSE): a full "state" on connect, then
+// relay/sensor/thermostat/light deltas; fetches are only for the forms
+let lastTemp = null, therm = null, auto = null;
+function showRelay(ch, on){
+  let el = document.getElementById('r'+ch);
+  if (el) el.innerText = on ? 'ENCENDIDO' : 'APAGADO';
+  if (ch == 2) document.getElementById('lights').innerText = on ? 'ENCENDIDO' : 'APAGADO';
+}
+function showSensor(o){
+  lastTemp = o.in.temp;
+  document.getElementById('sensor').innerText = `Interior: ${o.in.temp} °C, ${o.in.hum} % \nExterior: ${o.out.temp} °C, ${o.out.hum} %`;
+  if (therm) showThermostat(therm);
+}
+function showThermostat(o){
+  therm = o;
+  document.getElementById('thermostat').innerText = `Temp: ${lastTemp} °C | Consigna: ${o.setpoint} °C | Histeresis: ${o.hysteresis} °C | Habilitado: ${o.enabled} | Calefacción: ${o.heating ? 'sí' : 'no'}`;
+}
+function showAutomation(){
+  let o = auto;
+  if (!o) return;
+  document.getElementById('automation').innerText = `Lights min: ${o.dailyLightMinHours} h | Accum: ${o.dailyLightAccumHours.toFixed(2)} h | DLI: ${o.dli.toFixed(2)} mol/m²/d (${o.dliSource}) | Irr count: ${o.irrigationCount} | Dur(s): ${o.irrigationDurationSec} | Start: ${o.irrigationStartHour}`;
+}
+function showLight(l){
+  if (!auto) return;
+  auto.dailyLightAccumHours = l.accumHours;
+  auto.dli = l.dli;
+  showAutomation();
+}
+function connectEvents(){
+  const es = new EventSource('/events');
+  es.addEventListener('state', e=>{
+    let o = JSON.parse(e.data);
+    o.relays.forEach((on,i)=>showRelay(i+1, on));
+    showSensor(o.sensor);
+    showThermostat(o.thermostat);
+    showLight(o.light);
+  });
+  es.addEventListener('relay', e=>{ let o = JSON.parse(e.data); showRelay(o.ch, o.on); });
+  es.addEventListener('sensor', e=>showSensor(JSON.parse(e.data)));
+  es.addEventListener('thermostat', e=>showThermostat(JSON.parse(e.data)));
+  es.addEventListener('light', e=>showLight(JSON.parse(e.data)));
 }
 
 async function loadThermostat(){
   try{
     let r = await fetch('/thermostat');
     let o = await r.json();
-    document.getElementById('thermostat').innerText = `Temp: ${o.temp} °C | Consigna: ${o.setpoint} °C | Histeresis: ${o.hysteresis} °C | Habilitado: ${o.enabled}`;
+    if (lastTemp === null) lastTemp = o.temp;
+    if (!therm) showThermostat(o);
     document.getElementById('setpoint').value = o.setpoint;
     document.getElementById('hysteresis').value = o.hysteresis;
     document.getElementById('ten').value = o.enabled? '1':'0';
@@ -197,11 +549,15 @@ async function loadAutomation(){
   try{
     let r = await fetch('/automation');
     let o = await r.json();
-    document.getElementById('automation').innerText = `Lights min: ${o.dailyLightMinHours} h | Accum: ${o.dailyLightAccumHours} h | Irr count: ${o.irrigationCount} | Dur(s): ${o.irrigationDurationSec} | Start: ${o.irrigationStartHour}`;
+    auto = o;
+    showAutomation();
     document.getElementById('dailyHours').value = o.dailyLightMinHours;
     document.getElementById('irCount').value = o.irrigationCount;
     document.getElementById('irDur').value = o.irrigationDurationSec;
     document.getElementById('irStart').value = o.irrigationStartHour;
+    if (o.irrigationZones) document.getElementById('irZones').value = o.irrigationZones.map(z=>`${z.ch}:${z.dur}`).join(',');
+    document.getElementById('irConc').value = o.irrigationMaxConcurrent;
+    document.getElementById('rules').value = o.rules || '';
     // render history if present
     try{
       if (o.history && o.history.length) {
@@ -240,6 +596,21 @@ document.getElementById('setIrrTimes').addEventListener('click', async ()=>{
   loadAutomation();
 });
 
+document.getElementById('setZones').addEventListener('click', async ()=>{
+  let zones = document.getElementById('irZones').value;
+  let conc = document.getElementById('irConc').value || '1';
+  await fetch(`/automation?action=setZones&zones=${encodeURIComponent(zones)}&concurrent=${encodeURIComponent(conc)}`);
+  loadAutomation();
+});
+
+document.getElementById('setRules').addEventListener('click', async ()=>{
+  let rules = document.getElementById('rules').value;
+  let r = await fetch(`/automation?action=setRules&rules=${encodeURIComponent(rules)}`);
+  let o = await r.json();
+  document.getElementById('rulesErr').innerText = o.ok ? '' : o.error;
+  loadAutomation();
+});
+
 document.getElementById('setTherm').addEventListener('click', async ()=>{
   let sp = document.getElementById('setpoint').value;
   let hy = document.getElementById('hysteresis').value;
@@ -293,12 +664,9 @@ document.getElementById('addBtn').addEventListener('click', async ()=>{
   loadSchedules();
 });
 loadSchedules();
-setInterval(loadSensor, 5000);
-loadSensor();
-setInterval(loadThermostat, 5000);
 loadThermostat();
- loadAutomation();
- setInterval(loadAutomation, 10000);
+loadAutomation();
+connectEvents();
 </script>
 )RAW";
 
@@ -307,126 +675,155 @@ loadThermostat();
     return;
   }
 
+    if (path.startsWith("/events/stats")) {
+      sendResponse(client, "application/json", streamStatsJson());
+      return;
+    }
+
     // Server-Sent Events endpoint: keep connection open and register client
     if (path.startsWith("/events")) {
       client.print("HTTP/1.1 200 OK\r\n");
       client.print("Content-Type: text/event-stream\r\n");
       client.print("Cache-Control: no-cache\r\n");
       client.print("Connection: keep-alive\r\n\r\n");
-      // register client in first free slot
-      for (int i = 0; i < 4; ++i) {
-        if (!sseClients[i] || !sseClients[i].connected()) {
-          sseClients[i] = client;
-          return; // keep connection open
-        }
-      }
-      // no slot available
-      String msg = "No SSE slots available";
-      sendResponse(client, "text/plain", msg);
+      // reconnecting EventSource clients pick up where they left via the snapshot
+      client.print("retry: 3000\n\n");
+      if (sseSubscribe(client)) return; // keep connection open
+      // no slot available: end the stream, the browser retries later
+      client.stop();
       return;
     }
 
   // Direct download of logs file
   if (path.startsWith("/logs") || path.startsWith("/logs.txt")) {
-    if (SPIFFS.exists("/logs.txt")) {
-      File f = SPIFFS.open("/logs.txt", "r");
-      if (f) {
-        client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n");
-        client.print("Connection: close\r\n\r\n");
-        while (f.available()) client.write(f.read());
-        f.close();
-        return;
+    sendLogFiles(client);
+    return;
+  }
+
+  // Raw relay journal (older rotated file first) for tools/relay_journal.py
+  if (path.startsWith("/journal")) {
+    relayJournalFlush();
+    client.print("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n");
+    client.print("Connection: close\r\n\r\n");
+    const char* files[2] = { "/relay_journal.old", "/relay_journal.bin" };
+    for (int i = 0; i < 2; ++i) {
+      if (!SPIFFS.exists(files[i])) continue;
+      File f = SPIFFS.open(files[i], "r");
+      if (!f) continue;
+      uint8_t buf[256];
+      while (f.available()) {
+        size_t n = f.read(buf, sizeof(buf));
+        client.write(buf, n);
       }
+      f.close();
     }
-    sendResponse(client, "text/plain", String("No logs"));
     return;
   }
 
-  // /relay?ch=1&state=on  or /status
-  if (path.startsWith("/relay")) {
+  // Commands go through the shared table in src/commands.cpp:
+  // /cmd?name=<command>&<args>, plus the legacy endpoints used by the UI
+  {
     int q = path.indexOf('?');
+    String base = q >= 0 ? path.substring(0, q) : path;
     String query = q >= 0 ? path.substring(q + 1) : String();
-    int ch = 0; String state;
-    // parse simple query
-    int p = 0;
-    while (p < (int)query.length()) {
-      int amp = query.indexOf('&', p);
-      if (amp == -1) amp = query.length();
-      String pair = query.substring(p, amp);
-      int eq = pair.indexOf('=');
-      if (eq > 0) {
-        String k = pair.substring(0, eq);
-        String v = pair.substring(eq + 1);
-        if (k == "ch") ch = v.toInt();
-        else if (k == "state") state = v;
+    String name;
+    const char* skipKey = "action";
+    if (base == "/cmd") {
+      name = queryParam(query, "name");
+      skipKey = "name";
+    } else if (base == "/relay" && !query.length()) {
+      name = "status";   // a bare /relay has always returned the relay states
+    } else {
+      String action = queryParam(query, "action");
+      for (size_t i = 0; i < sizeof(LEGACY_COMMANDS) / sizeof(LEGACY_COMMANDS[0]); ++i) {
+        const LegacyCommand &l = LEGACY_COMMANDS[i];
+        if (base == l.path && (!l.action || action == l.action)) { name = l.command; break; }
       }
-      p = amp + 1;
     }
-    if (state == "on") setRelay(ch, true);
-    else if (state == "off") setRelay(ch, false);
-    else if (state == "toggle") setRelay(ch, !getRelay(ch));
-    sendResponse(client, "application/json", relayStatusJson());
+    if (name.length()) {
+      String reply;
+      bool ok = commandRunQuery(name.c_str(), query, RELAY_SRC_HTTP, reply, skipKey);
+      sendResponse(client, "application/json", reply, ok ? 200 : 400);
+      return;
+    }
+  }
+
+  if (path.startsWith("/mqtt/status")) {
+    sendResponse(client, "application/json", mqttStatusJson());
+    return;
+  }
+
+  if (path.startsWith("/wifi/status")) {
+    sendStruct(client, wifiStatusWrite, cbor);
+    return;
+  }
+  if (path.startsWith("/time")) {
+    sendStruct(client, timeWrite, cbor);
+    return;
+  }
+  // read-only; changes go through /cmd?name=net_set and net_apply
+  if (path.startsWith("/network")) {
+    sendStruct(client, netConfigWrite, cbor);
+    return;
+  }
+  // progress of an upload; the upload itself is a POST, see webHandle()
+  if (path.startsWith("/ota")) {
+    sendStruct(client, otaWrite, cbor);
+    return;
+  }
+
+  // Heap telemetry; ?reset=1 clears the counters after reporting them
+  if (path.startsWith("/debug/heap")) {
+    sendStruct(client, heapDebugWrite, cbor);
+    int q = path.indexOf('?');
+    if (q >= 0 && queryParam(path.substring(q + 1), "reset") == "1") heapDebugReset();
+    return;
+  }
+
+  // Loop and per-module timing; ?reset=1 starts a new measurement window
+  if (path.startsWith("/debug/perf")) {
+    sendStruct(client, perfWrite, cbor);
+    int q = path.indexOf('?');
+    if (q >= 0 && queryParam(path.substring(q + 1), "reset") == "1") perfReset();
+    return;
+  }
+
+  if (path.startsWith("/debug/watchdog")) {
+    sendStruct(client, watchdogWrite, cbor);
+    int q = path.indexOf('?');
+    if (q >= 0 && queryParam(path.substring(q + 1), "clear") == "1") watchdogClearHistory();
+    return;
+  }
+
+  if (path.startsWith("/debug/boot")) {
+    sendStruct(client, bootWrite, cbor);
+    return;
+  }
+
+  if (path.startsWith("/state")) {
+    sendStruct(client, stateWrite, cbor);
     return;
   }
 
   if (path.startsWith("/status")) {
-    sendResponse(client, "application/json", relayStatusJson());
+    sendStruct(client, relayStatusWrite, cbor);
     return;
   }
 
   if (path.startsWith("/schedules")) {
-    // return JSON list of schedules
-    extern String scheduleListJson();
-    String j = scheduleListJson();
-    sendResponse(client, "application/json", j);
+    sendStruct(client, scheduleListWrite, cbor);
     return;
   }
 
   if (path.startsWith("/sensor")) {
-    extern String sensorJson();
-    String j = sensorJson();
-    sendResponse(client, "application/json", j);
+    sendStruct(client, sensorWrite, cbor);
     return;
   }
 
   if (path.startsWith("/thermostat")) {
     int q = path.indexOf('?');
     String query = q >= 0 ? path.substring(q + 1) : String();
-    int p = 0;
-    String action;
-    float sp = 0; float hy = 0; int enabledVal = -1;
-    while (p < (int)query.length()) {
-      int amp = query.indexOf('&', p);
-      if (amp == -1) amp = query.length();
-      String pair = query.substring(p, amp);
-      int eq = pair.indexOf('=');
-      if (eq > 0) {
-        String k = pair.substring(0, eq);
-        String v = pair.substring(eq + 1);
-        if (k == "action") action = v;
-        else if (k == "setpoint") sp = v.toFloat();
-        else if (k == "hysteresis") hy = v.toFloat();
-        else if (k == "enabled") enabledVal = v.toInt();
-      }
-      p = amp + 1;
-    }
-    if (action == "set") {
-      bool en = (enabledVal == 1);
-      bool ok = setThermostat(sp, hy, en);
-      sendResponse(client, "application/json", String(ok?"{\"ok\":1}":"{\"ok\":0}"));
-      return;
-    }
-    if (action == "setAdvanced") {
-      int maxr = 0; float overt = 200.0; float extl = 200.0; bool logen = false;
-      // parse again simpler
-      int mpos = query.indexOf("maxruntime="); if (mpos>=0) { int amp = query.indexOf('&', mpos); if (amp==-1) amp=query.length(); maxr = query.substring(mpos+11, amp).toInt(); }
-      int opos = query.indexOf("overtemp="); if (opos>=0) { int amp = query.indexOf('&', opos); if (amp==-1) amp=query.length(); overt = query.substring(opos+9, amp).toFloat(); }
-      int epos = query.indexOf("extlimit="); if (epos>=0) { int amp = query.indexOf('&', epos); if (amp==-1) amp=query.length(); extl = query.substring(epos+9, amp).toFloat(); }
-      int lpos = query.indexOf("log="); if (lpos>=0) { int amp = query.indexOf('&', lpos); if (amp==-1) amp=query.length(); logen = query.substring(lpos+4, amp).toInt() == 1; }
-      bool ok = setThermostatAdvanced((unsigned long)maxr, overt, extl, logen);
-      sendResponse(client, "application/json", String(ok?"{\"ok\":1}":"{\"ok\":0}"));
-      return;
-    }
+    String action = queryParam(query, "action");
     if (action == "download") {
       // stream log file if exists
       if (SPIFFS.exists("/therm_log.csv")) {
@@ -446,151 +843,27 @@ loadThermostat();
 
     // Allow downloading the general logs file
     if (action == "download_logs") {
-      if (SPIFFS.exists("/logs.txt")) {
-        File f = SPIFFS.open("/logs.txt", "r");
-        if (f) {
-          client.print("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n");
-          client.print("Connection: close\r\n\r\n");
-          while (f.available()) client.write(f.read());
-          f.close();
-          return;
-        }
-      }
-      String nf = "No logs";
-      sendResponse(client, "text/plain", nf);
+      sendLogFiles(client);
       return;
     }
-    // default: return thermostat JSON
-    extern String thermostatJson();
-    String j = thermostatJson();
-    sendResponse(client, "application/json", j);
+    // default: setpoint, hysteresis, enabled and temperature
+    sendStruct(client, thermostatWrite, cbor);
     return;
   }
 
   if (path.startsWith("/automation")) {
     int q = path.indexOf('?');
     String query = q >= 0 ? path.substring(q + 1) : String();
-    int p = 0; String action;
-    while (p < (int)query.length()) {
-      int amp = query.indexOf('&', p);
-      if (amp == -1) amp = query.length();
-      String pair = query.substring(p, amp);
-      int eq = pair.indexOf('=');
-      if (eq > 0) {
-        String k = pair.substring(0, eq);
-        String v = pair.substring(eq + 1);
-        if (k == "action") action = v;
-      }
-      p = amp + 1;
-    }
-    if (action == "setDaily") {
-      int hpos = query.indexOf("hours=");
-      if (hpos >= 0) {
-        int amp = query.indexOf('&', hpos); if (amp == -1) amp = query.length();
-        float h = query.substring(hpos+6, amp).toFloat();
-        extern bool setDailyLightMinHours(float hours);
-        bool ok = setDailyLightMinHours(h);
-        sendResponse(client, "application/json", String(ok?"{\"ok\":1}":"{\"ok\":0}"));
-        return;
-      }
-    }
-    if (action == "setIrrigation") {
-      int cpos = query.indexOf("count="); int dpos = query.indexOf("duration="); int spos = query.indexOf("start=");
-      if (cpos>=0 && dpos>=0 && spos>=0) {
-        int amp = query.indexOf('&', cpos); if (amp==-1) amp = query.length(); int cnt = query.substring(cpos+6, amp).toInt();
-        amp = query.indexOf('&', dpos); if (amp==-1) amp = query.length(); int dur = query.substring(dpos+9, amp).toInt();
-        amp = query.indexOf('&', spos); if (amp==-1) amp = query.length(); int st = query.substring(spos+6, amp).toInt();
-        extern bool setIrrigationConfig(uint8_t countPerDay, uint16_t durationSec, uint8_t startHour);
-        bool ok = setIrrigationConfig((uint8_t)cnt, (uint16_t)dur, (uint8_t)st);
-        sendResponse(client, "application/json", String(ok?"{\"ok\":1}":"{\"ok\":0}"));
-        return;
-      }
-      if (action == "setIrrTimes") {
-        int tpos = query.indexOf("times="); int dpos = query.indexOf("duration=");
-        if (tpos >= 0 && dpos >= 0) {
-          int amp = query.indexOf('&', tpos); if (amp == -1) amp = query.length(); String times = query.substring(tpos+6, amp);
-          amp = query.indexOf('&', dpos); if (amp == -1) amp = query.length(); int dur = query.substring(dpos+9, amp).toInt();
-          extern bool setIrrigationTimesCSV(const String &timesCsv, uint16_t durationSec);
-          bool ok = setIrrigationTimesCSV(times, (uint16_t)dur);
-          sendResponse(client, "application/json", String(ok?"{\"ok\":1}":"{\"ok\":0}"));
-          return;
-        }
-      }
-      if (action == "history") {
-        extern String automationHistoryJson();
-        String j = automationHistoryJson();
-        sendResponse(client, "application/json", j);
-        return;
-      }
+    String action = queryParam(query, "action");
+    if (action == "history") {
+      sendStruct(client, automationHistoryWrite, cbor);
+      return;
     }
-    extern String automationJson();
-    String j = automationJson();
-    sendResponse(client, "application/json", j);
+    sendStruct(client, automationWrite, cbor);
     return;
   }
 
   if (path.startsWith("/schedule")) {
-    int q = path.indexOf('?');
-    String query = q >= 0 ? path.substring(q + 1) : String();
-    int ch = 0; String action; int hour = -1; int minute = -1; int index = -1; int daysMask = 0x7F;
-    int p = 0;
-    while (p < (int)query.length()) {
-      int amp = query.indexOf('&', p);
-      if (amp == -1) amp = query.length();
-      String pair = query.substring(p, amp);
-      int eq = pair.indexOf('=');
-      if (eq > 0) {
-        String k = pair.substring(0, eq);
-        String v = pair.substring(eq + 1);
-        if (k == "ch") ch = v.toInt();
-        else if (k == "action") action = v;
-        else if (k == "hour") hour = v.toInt();
-        else if (k == "minute") minute = v.toInt();
-        else if (k == "index") index = v.toInt();
-        else if (k == "days") daysMask = v.toInt();
-      }
-      p = amp + 1;
-    }
-    // action=add -> needs ch,hour,minute and optional on flag
-    if (action == "add" && ch > 0 && hour >= 0 && minute >= 0) {
-      String onVal = "1";
-      // parse on= from query
-      int onPos = query.indexOf("on=");
-      if (onPos >= 0) {
-        int amp = query.indexOf('&', onPos);
-        if (amp == -1) amp = query.length();
-        onVal = query.substring(onPos + 3, amp);
-      }
-      bool onFlag = (onVal == "1" || onVal == "true" || onVal == "on");
-      extern bool addSchedule(uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t daysMask);
-      bool ok = addSchedule((uint8_t)ch, (uint8_t)hour, (uint8_t)minute, onFlag, (uint8_t)daysMask);
-      sendResponse(client, "application/json", String(ok ? "{\"ok\":1}" : "{\"ok\":0}"));
-      return;
-    }
-
-    // action=edit -> edit schedule including days
-    if (action == "edit" && index >= 0 && ch > 0 && hour >= 0 && minute >= 0) {
-      String onVal = "1";
-      int onPos = query.indexOf("on=");
-      if (onPos >= 0) {
-        int amp = query.indexOf('&', onPos);
-        if (amp == -1) amp = query.length();
-        onVal = query.substring(onPos + 3, amp);
-      }
-      bool onFlag = (onVal == "1" || onVal == "true" || onVal == "on");
-      extern bool editSchedule(size_t index, uint8_t ch, uint8_t hour, uint8_t minute, bool on, uint8_t daysMask);
-      bool ok = editSchedule((size_t)index, (uint8_t)ch, (uint8_t)hour, (uint8_t)minute, onFlag, (uint8_t)daysMask);
-      sendResponse(client, "application/json", String(ok ? "{\"ok\":1}" : "{\"ok\":0}"));
-      return;
-    }
-
-    // action=delete -> remove schedule by index
-    if (action == "delete" && index >= 0) {
-      extern bool removeSchedule(size_t index);
-      bool ok = removeSchedule((size_t)index);
-      sendResponse(client, "application/json", String(ok ? "{\"ok\":1}" : "{\"ok\":0}"));
-      return;
-    }
     // unsupported -> return 400
     String notfound = "Solicitud de horario inválida";
     client.print("HTTP/1.1 400 Bad Request\r\nContent-Length: ");
@@ -606,81 +879,46 @@ loadThermostat();
   client.print(notfound);
 }
 
+// Listens right away; Wi-Fi is brought up separately (bootNetworkBegin) and
+// clients can connect once it is
 void webBegin() {
-  WiFi.mode(WIFI_STA);
-  logPrint(String("Connecting to WiFi '")); logPrint(String(WIFI_SSID)); logPrintln(String("'..."));
-  // Configure static IP if defined in config.h
-  if (WiFi.config(STATIC_IP, STATIC_GATEWAY, STATIC_SUBNET, STATIC_DNS)) {
-    logPrintln(String("Static IP configured"));
-  }
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  unsigned long start = millis();
-  // Blink green while attempting to connect
-  unsigned long lastToggle = 0;
-  bool ledOn = false;
-  while (WiFi.status() != WL_CONNECTED && millis() - start < 30000) {
-    unsigned long now = millis();
-    if (now - lastToggle >= 500) {
-      lastToggle = now;
-      ledOn = !ledOn;
-      if (ledOn) setPixelColorRGB(0, 255, 0);
-      else setPixelColorRGB(0, 0, 0);
-    }
-    delay(200);
-    logPrint(String("."));
-  }
-  Serial.println();
-  if (WiFi.status() == WL_CONNECTED) {
-    logPrint(String("WiFi connected, IP: ")); logPrintln(WiFi.localIP().toString());
-    // solid blue when connected
-    setPixelColorRGB(0, 0, 255);
-  } else {
-    logPrintln(String("WiFi connection failed (timeout)"));
-    // solid red on failure
-    setPixelColorRGB(255, 0, 0);
-  }
+  relayEventCursor = relayJournalHead();
   server.begin();
   telnetServer.begin();
-  logPrintln(String("Web server started on port 80"));
+  logAddSink("telnet", telnetLogSink, LOG_INFO, true);
+  logAddSink("sse", sseLogSink, LOG_WARN, true);
+  LOG_I(LOGM_WEB, "Web server started on port 80");
+  bootMark(BOOT_HTTP);
 }
 
 void webHandle() {
+  acceptTelnet();
+  pumpRelayEvents();
+  pumpStateDeltas();
+  sseFlush();
+  telnetFlush();
   WiFiClient client = server.available();
   if (!client) return;
   // wait for data
   unsigned long timeout = millis() + 1000;
   while (!client.available() && millis() < timeout) yield();
   if (!client.available()) { client.stop(); return; }
-  String req = client.readStringUntil('\r');
-  // req contains something like: GET /path?query HTTP/1.1
-  // extract path
-  int firstSpace = req.indexOf(' ');
-  int secondSpace = req.indexOf(' ', firstSpace + 1);
-  String path = "/";
-  if (firstSpace != -1 && secondSpace != -1) {
-    path = req.substring(firstSpace + 1, secondSpace);
-  }
-  handleRequest(client, path);
+  HttpRequest req;
+  httpReadRequest(client, req);
+  const String &path = req.path;
+  // the body streams to flash over the next loops: otaTick() owns the client
+  if (req.method == "POST" && path.startsWith("/ota")) {
+    otaAccept(client, req);
+    return;
+  }
+  heapDebugRequestBegin();
+  handleRequest(client, path, wantsCbor(path, req.accept));
+  heapDebugRequestEnd(path.c_str());
   // if this was an SSE connection we registered it and must not close here
-  if (path.startsWith("/events")) {
+  if (path.startsWith("/events") && !path.startsWith("/events/stats")) {
     // don't stop the client; keep connection open for SSE
     return;
   }
   delay(1);
   client.stop();
-
-  // Accept telnet clients (non-blocking)
-  WiFiClient t = telnetServer.available();
-  if (t) {
-    // register in first free slot
-    for (int i = 0; i < 2; ++i) {
-      if (!telnetClients[i] || !telnetClients[i].connected()) {
-        telnetClients[i] = t;
-        telnetClients[i].print("Welcome to device serial log\r\n");
-        break;
-      }
-    }
-    // if no slot, reject
-    if (t && t.connected()) t.stop();
-  }
 }
@@ -4,5 +4,7 @@
 void webBegin();
 void webHandle();
 void webBroadcast(const String &msg);
+// Named SSE event (`event: <name>`); telnet clients get "[<name>] <data>"
+void webBroadcastEvent(const char* event, const String &data);
 
 #endif // WEBSERVER_H
@@ -0,0 +1,282 @@
+#include "wifi_manager.h"
+#include "config.h"
+#include "logging.h"
+#include "json_writer.h"
+#include "wifi_planner.h"
+#include "net_config.h"
+#include <WiFi.h>
+
+static const uint8_t WIFI_MAX_APS = NET_MAX_APS;
+static const uint8_t WIFI_MAX_HOOKS = 4;
+static const uint32_t SCAN_TIMEOUT_MS = 10000;
+// New settings wait this long, so the reply to net_apply gets out first
+static const uint32_t RECONFIGURE_DELAY_MS = 1000;
+
+static const WifiPlannerConfig PLANNER_CFG = {
+  WIFI_CONNECT_TIMEOUT_MS, SCAN_TIMEOUT_MS, WIFI_BACKOFF_MIN_MS, WIFI_BACKOFF_MAX_MS, WIFI_AP_AFTER_MS
+};
+static WifiPlanner<WIFI_MAX_APS> planner(PLANNER_CFG);
+
+// Password and the strongest BSS of each network in the last scan
+struct WifiAp {
+  const char* pass;  // in netConfig()
+  bool primary;      // first network of the settings: static IP if set
+  uint8_t bssid[6];
+  int32_t channel;   // 0 = not in the scan: the driver searches
+};
+static WifiAp aps[WIFI_MAX_APS];
+static WifiLinkHook hooks[WIFI_MAX_HOOKS];
+static uint8_t hookCount = 0;
+static String apSsid;
+static bool linkUp = false;
+static bool scanRunning = false;
+static uint8_t lastReason = 0;
+static bool reconfigureNetworks = false;
+static bool reconfigureAp = false;
+static unsigned long reconfigureAt = 0;
+
+// Set on the driver's event task, taken by wifiManagerTick()
+static bool evLost = false;
+static uint8_t evReason = 0;
+
+static const char* stateName(WifiLinkState s) {
+  switch (s) {
+    case WIFI_SCANNING: return "scanning";
+    case WIFI_CONNECTING: return "connecting";
+    case WIFI_CONNECTED: return "connected";
+    case WIFI_BACKOFF: return "backoff";
+    default: return "idle";
+  }
+}
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  if (event != ARDUINO_EVENT_WIFI_STA_DISCONNECTED) return;
+  // our own disconnect() before a scan or the next attempt
+  if (info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE) return;
+  __atomic_store_n(&evReason, info.wifi_sta_disconnected.reason, __ATOMIC_RELAXED);
+  __atomic_store_n(&evLost, true, __ATOMIC_RELEASE);
+}
+
+static void loadNetworks() {
+  const NetSettings &n = netConfig();
+  planner.clearAps();
+  for (uint8_t k = 0; k < NET_MAX_APS; ++k) {
+    if (!n.ssid[k][0]) continue;
+    int i = planner.addAp(n.ssid[k]);
+    if (i < 0) continue;
+    aps[i].pass = n.pass[k];
+    aps[i].primary = k == 0;
+    aps[i].channel = 0;
+  }
+}
+
+static void runHooks(bool up) {
+  for (uint8_t i = 0; i < hookCount; ++i) hooks[i](up);
+}
+
+static void connectTo(int i) {
+  if (i < 0) return;
+  WiFi.disconnect();
+  // the static IP belongs to the primary network; the others use DHCP
+  const NetSettings &n = netConfig();
+  if (aps[i].primary && n.staticIp) {
+    WiFi.config(IPAddress(n.ip[0], n.ip[1], n.ip[2], n.ip[3]),
+                IPAddress(n.gateway[0], n.gateway[1], n.gateway[2], n.gateway[3]),
+                IPAddress(n.subnet[0], n.subnet[1], n.subnet[2], n.subnet[3]),
+                IPAddress(n.dns[0], n.dns[1], n.dns[2], n.dns[3]));
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  }
+  const char* ssid = planner.ssid(i);
+  if (aps[i].channel) {
+    LOG_I(LOGM_WIFI, "Connecting to WiFi '%s' (%d dBm, channel %ld)...", ssid, planner.rssiInScan(i), (long)aps[i].channel);
+    WiFi.begin(ssid, aps[i].pass, aps[i].channel, aps[i].bssid);
+  } else {
+    LOG_I(LOGM_WIFI, "Connecting to WiFi '%s' (not in scan)...", ssid);
+    WiFi.begin(ssid, aps[i].pass);
+  }
+}
+
+static void startAp() {
+  if (WiFi.softAP(apSsid.c_str(), netConfig().apPass)) {
+    LOG_W(LOGM_WIFI, "Access point '%s' at %s", apSsid.c_str(), WiFi.softAPIP().toString().c_str());
+  } else {
+    LOG_E(LOGM_WIFI, "Access point '%s' could not be started", apSsid.c_str());
+  }
+}
+
+// New networks or addressing: drop the link and start over with a scan
+static void applyReconfigure(unsigned long now) {
+  if (reconfigureNetworks) {
+    if (scanRunning) {
+      WiFi.scanDelete();
+      scanRunning = false;
+    }
+    if (linkUp) {
+      linkUp = false;
+      planner.linkDown(now);
+      runHooks(false);
+    }
+    WiFi.disconnect();
+    loadNetworks();
+    planner.begin(now);
+    LOG_I(LOGM_WIFI, "WiFi: %u network(s), reconnecting with the new settings", planner.aps());
+  }
+  // a new password takes a restart of the access point
+  if (reconfigureAp && planner.apActive()) startAp();
+  reconfigureNetworks = false;
+  reconfigureAp = false;
+}
+
+static void startScan(unsigned long now) {
+  // abandons an attempt still in progress
+  WiFi.disconnect();
+  for (uint8_t i = 0; i < WIFI_MAX_APS; ++i) aps[i].channel = 0;
+  scanRunning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+  // no scan: try the networks as configured
+  if (!scanRunning) planner.scanDone(now);
+}
+
+static void pollScan(unsigned long now) {
+  int16_t n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING) return;
+  scanRunning = false;
+  for (int16_t i = 0; i < n; ++i) {
+    int ap = planner.scanResult(WiFi.SSID(i).c_str(), WiFi.RSSI(i));
+    if (ap < 0) continue;
+    memcpy(aps[ap].bssid, WiFi.BSSID(i), 6);
+    aps[ap].channel = WiFi.channel(i);
+  }
+  WiFi.scanDelete();
+  planner.scanDone(now);
+}
+
+void wifiManagerBegin() {
+  // credentials come from netConfig(), not from NVS; the planner reconnects
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.onEvent(onWifiEvent);
+  loadNetworks();
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  apSsid = strlen(WIFI_AP_SSID) ? String(WIFI_AP_SSID) : "invernadero-" + mac.substring(8);
+  planner.seed((uint32_t)ESP.getEfuseMac());
+  planner.begin(millis());
+  LOG_I(LOGM_WIFI, "WiFi: %u network(s), fallback AP '%s' after %lu s", planner.aps(), apSsid.c_str(),
+        (unsigned long)(WIFI_AP_AFTER_MS / 1000));
+}
+
+void wifiManagerTick() {
+  unsigned long now = millis();
+  if ((reconfigureNetworks || reconfigureAp) && now - reconfigureAt >= RECONFIGURE_DELAY_MS) applyReconfigure(now);
+  bool lost = __atomic_exchange_n(&evLost, false, __ATOMIC_ACQUIRE);
+  bool up = WiFi.status() == WL_CONNECTED;
+  if (lost) lastReason = __atomic_load_n(&evReason, __ATOMIC_RELAXED);
+  if (linkUp && (lost || !up)) {
+    linkUp = false;
+    planner.linkDown(now);
+    LOG_W(LOGM_WIFI, "WiFi link lost (reason %u), reconnecting", lastReason);
+    runHooks(false);
+  } else if (lost) {
+    // the current attempt was refused: next network right away
+    LOG_I(LOGM_WIFI, "WiFi attempt failed (reason %u)", lastReason);
+    planner.linkDown(now);
+  } else if (up && !linkUp) {
+    linkUp = true;
+    planner.linkUp(now);
+    LOG_I(LOGM_WIFI, "WiFi connected to '%s', IP: %s, %d dBm", WiFi.SSID().c_str(),
+          WiFi.localIP().toString().c_str(), WiFi.RSSI());
+    runHooks(true);
+  }
+
+  if (scanRunning) pollScan(now);
+
+  switch (planner.tick(now)) {
+    case WIFI_ACT_SCAN:
+      startScan(now);
+      break;
+    case WIFI_ACT_CONNECT:
+      connectTo(planner.target());
+      break;
+    case WIFI_ACT_START_AP:
+      LOG_W(LOGM_WIFI, "No WiFi link for %lu s", (unsigned long)(WIFI_AP_AFTER_MS / 1000));
+      WiFi.mode(WIFI_AP_STA);
+      startAp();
+      break;
+    case WIFI_ACT_STOP_AP:
+      WiFi.softAPdisconnect(true);
+      LOG_I(LOGM_WIFI, "WiFi link back, access point closed");
+      break;
+    default:
+      break;
+  }
+}
+
+void wifiManagerReconfigure(bool networks, bool ap) {
+  reconfigureNetworks |= networks;
+  reconfigureAp |= ap;
+  reconfigureAt = millis();
+}
+
+bool wifiOnLink(WifiLinkHook hook) {
+  if (hookCount >= WIFI_MAX_HOOKS) return false;
+  hooks[hookCount++] = hook;
+  return true;
+}
+
+bool wifiConnected() {
+  return linkUp;
+}
+
+bool wifiApActive() {
+  return planner.apActive();
+}
+
+void wifiStatusWrite(StructWriter &w) {
+  unsigned long now = millis();
+  const WifiStats &s = planner.stats();
+  int t = planner.target();
+  w.beginMap();
+  w.strField("state", stateName(planner.state()));
+  w.strField("ssid", linkUp && t >= 0 ? planner.ssid(t) : "");
+  w.strField("ip", linkUp ? WiFi.localIP().toString().c_str() : "");
+  w.key("rssi");
+  if (linkUp) w.intValue(WiFi.RSSI());
+  else w.nullValue();
+  w.intField("linkSec", planner.linkUpMs(now) / 1000);
+  w.intField("connectedSec", planner.connectedMs(now) / 1000);
+  w.intField("uptimeSec", now / 1000);
+  w.intField("connects", s.connects);
+  w.intField("reconnects", s.connects ? s.connects - 1 : 0);
+  w.intField("disconnects", s.disconnects);
+  w.intField("attempts", s.attempts);
+  w.intField("failures", s.failures);
+  w.intField("scans", s.scans);
+  w.intField("lastReason", lastReason);
+  w.intField("retryMs", planner.retryInMs(now));
+  w.key("ap");
+  w.beginMap();
+  w.boolField("active", planner.apActive());
+  w.strField("ssid", apSsid.c_str());
+  w.strField("ip", planner.apActive() ? WiFi.softAPIP().toString().c_str() : "");
+  w.intField("clients", planner.apActive() ? WiFi.softAPgetStationNum() : 0);
+  w.endMap();
+  // configured networks and their RSSI in the last scan (null: not seen)
+  w.key("networks");
+  w.beginArray();
+  for (uint8_t i = 0; i < planner.aps(); ++i) {
+    w.beginMap();
+    w.strField("ssid", planner.ssid(i));
+    w.key("rssi");
+    if (planner.seenInScan(i)) w.intValue(planner.rssiInScan(i));
+    else w.nullValue();
+    w.endMap();
+  }
+  w.endArray();
+  w.endMap();
+}
+
+String wifiStatusJson() {
+  return structToJson<String>(wifiStatusWrite);
+}
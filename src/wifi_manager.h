@@ -0,0 +1,31 @@
+// Wi-Fi connection manager: scans, connects to the strongest configured
+// network, reconnects with backoff and opens a fallback access point, all
+// from wifiManagerTick() without waiting (policy: include/wifi_planner.h).
+// Driver events only set flags; everything else runs on the loop task.
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+#include "struct_writer.h"
+
+// Called on the loop task when the station link comes up (IP assigned) or
+// goes down
+typedef void (*WifiLinkHook)(bool up);
+
+// Networks, addressing and AP password come from netConfig() (src/net_config.h)
+void wifiManagerBegin();
+void wifiManagerTick();
+// Settings changed: reconnect (networks) and/or restart an open access
+// point (ap), from the tick a second later
+void wifiManagerReconfigure(bool networks, bool ap);
+// false if the hook table is full
+bool wifiOnLink(WifiLinkHook hook);
+bool wifiConnected();
+bool wifiApActive();
+
+// {"state":"connected","ssid":"casa","ip":"192.168.1.50","rssi":-61,
+//  "linkSec":3600,"connectedSec":86000,"connects":3,"reconnects":2,...}
+void wifiStatusWrite(StructWriter &w);
+String wifiStatusJson();
+
+#endif // WIFI_MANAGER_H
@@ -0,0 +1,66 @@
+// Allocation counting for host tests. Replaces the global operator new/delete
+// (std::string, std::vector, ...), so include it from exactly one file of a
+// test. Wrap a hot path in an AllocGuard and assert it did not allocate:
+//
+//   AllocGuard g;
+//   hub.publish(buf, n);
+//   TEST_ASSERT_NO_ALLOC(g);
+//
+// Guards read shared counters: a new guard restarts the peak, so read one
+// before starting the next. Only C++ allocations are seen; the firmware
+// counterpart that also sees malloc (Arduino String, ArduinoJson) is
+// include/heap_stats.h.
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+
+struct AllocCounters {
+  size_t live;     // bytes currently allocated
+  size_t peak;     // high-water mark of `live` since the last guard
+  size_t allocs;   // calls to operator new
+};
+
+static AllocCounters allocCounters;
+
+void *operator new(size_t n) {
+  // size kept in front of the block, padded to keep alignment
+  size_t *p = (size_t *)malloc(n + 16);
+  if (!p) throw std::bad_alloc();
+  *p = n;
+  allocCounters.live += n;
+  allocCounters.allocs++;
+  if (allocCounters.live > allocCounters.peak) allocCounters.peak = allocCounters.live;
+  return (char *)p + 16;
+}
+
+void operator delete(void *q) noexcept {
+  if (!q) return;
+  size_t *p = (size_t *)((char *)q - 16);
+  allocCounters.live -= *p;
+  free(p);
+}
+
+class AllocGuard {
+public:
+  AllocGuard() : startAllocs(allocCounters.allocs), startLive(allocCounters.live) {
+    allocCounters.peak = allocCounters.live;
+  }
+  // operator new calls since construction
+  size_t allocs() const { return allocCounters.allocs - startAllocs; }
+  // most heap held at once above the starting level
+  size_t peakBytes() const { return allocCounters.peak - startLive; }
+  // net bytes still held (leak check)
+  long retainedBytes() const { return (long)allocCounters.live - (long)startLive; }
+
+private:
+  size_t startAllocs;
+  size_t startLive;
+};
+
+#define TEST_ASSERT_NO_ALLOC(guard) \
+  TEST_ASSERT_EQUAL_MESSAGE(0, (int)(guard).allocs(), "hot path allocated")
+
+#endif // ALLOC_GUARD_H
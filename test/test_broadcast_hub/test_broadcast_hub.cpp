@@ -0,0 +1,191 @@
+// Host tests for the SSE/telnet broadcast hub (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "broadcast_hub.h"
+#include "../common/alloc_guard.h"
+
+// Socket that accepts at most `budget` bytes per pump, like a full TCP window
+struct SlowSocket {
+  std::string received;
+  size_t budget;
+  size_t calls;
+  explicit SlowSocket(size_t b) : budget(b), calls(0) {}
+  size_t write(const uint8_t *p, size_t n) {
+    calls++;
+    if (n > budget) n = budget;
+    received.append((const char *)p, n);
+    budget -= n;
+    return n;
+  }
+};
+
+static void frame(char *buf, size_t len, int i) {
+  snprintf(buf, len, "<%04d:%s>", i, "payload-payload-payload");
+}
+
+// every "<nnnn:...>" in `s` must be whole and numbers strictly increasing;
+// a frame still being written at the end is ignored
+static int checkFrames(const std::string &s, int *count) {
+  int last = -1;
+  *count = 0;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    if (s[pos] != '<') return -1;
+    size_t end = s.find('>', pos);
+    if (end == std::string::npos) break;
+    int n = atoi(s.c_str() + pos + 1);
+    if (n <= last || end - pos + 1 != 30) return -1;
+    last = n;
+    (*count)++;
+    pos = end + 1;
+  }
+  return last;
+}
+
+void test_fast_subscriber_gets_everything() {
+  BroadcastHub<256, 2, 64> hub;
+  int id = hub.subscribe(HUB_DROP_OLDEST);
+  char buf[40];
+  for (int i = 0; i < 100; ++i) {
+    frame(buf, sizeof(buf), i);
+    TEST_ASSERT_TRUE(hub.publish(buf, strlen(buf)));
+    SlowSocket sock(1000);
+    hub.pump(id, sock);
+    TEST_ASSERT_EQUAL_STRING(buf, sock.received.c_str());
+  }
+  TEST_ASSERT_EQUAL(100, hub.stats(id).frames);
+  TEST_ASSERT_EQUAL(0, hub.stats(id).dropped);
+  TEST_ASSERT_TRUE(hub.idle(id));
+}
+
+void test_slow_consumer_does_not_hold_back_fast_one() {
+  BroadcastHub<512, 3, 64> hub;
+  int fast = hub.subscribe(HUB_DROP_OLDEST);
+  int slow = hub.subscribe(HUB_DROP_OLDEST);
+  int latest = hub.subscribe(HUB_SKIP_TO_LATEST);
+  std::string fastOut, slowOut, latestOut;
+  char buf[40];
+  for (int i = 0; i < 400; ++i) {
+    frame(buf, sizeof(buf), i);
+    AllocGuard g;
+    hub.publish(buf, strlen(buf));
+    // publishing happens inside every log call: it must not touch the heap
+    TEST_ASSERT_NO_ALLOC(g);
+    SlowSocket f(4096);
+    hub.pump(fast, f);
+    fastOut += f.received;
+    // 7 bytes per loop: every frame is split across several pumps
+    SlowSocket s(7);
+    hub.pump(slow, s);
+    slowOut += s.received;
+    SlowSocket l(7);
+    hub.pump(latest, l);
+    latestOut += l.received;
+    // publishing never waits for a subscriber
+    TEST_ASSERT_TRUE(s.calls <= 3);
+  }
+  int n;
+  TEST_ASSERT_EQUAL(399, checkFrames(fastOut, &n));
+  TEST_ASSERT_EQUAL(400, n);
+  // slow subscribers lose frames, but every frame they get is intact and in order
+  TEST_ASSERT_TRUE(checkFrames(slowOut, &n) > 0);
+  TEST_ASSERT_TRUE(n < 400);
+  TEST_ASSERT_TRUE(hub.stats(slow).dropped > 0);
+  TEST_ASSERT_TRUE(hub.stats(slow).stalls > 0);
+  TEST_ASSERT_TRUE(hub.takeGap(slow));
+  TEST_ASSERT_FALSE(hub.takeGap(slow));
+  TEST_ASSERT_TRUE(checkFrames(latestOut, &n) > 0);
+  TEST_ASSERT_TRUE(hub.lagBytes(slow) <= 512);
+  TEST_ASSERT_EQUAL(0, hub.stats(fast).dropped);
+  char msg[120];
+  snprintf(msg, sizeof(msg), "slow: %u frames, %u dropped, %u gaps; skip-to-latest: %u frames, %u dropped",
+           (unsigned)hub.stats(slow).frames, (unsigned)hub.stats(slow).dropped, (unsigned)hub.stats(slow).gaps,
+           (unsigned)hub.stats(latest).frames, (unsigned)hub.stats(latest).dropped);
+  TEST_MESSAGE(msg);
+}
+
+void test_partial_frame_survives_eviction() {
+  BroadcastHub<64, 1, 40> hub;
+  int id = hub.subscribe(HUB_DROP_OLDEST);
+  char buf[40];
+  frame(buf, sizeof(buf), 1);
+  hub.publish(buf, strlen(buf));
+  SlowSocket a(10);
+  hub.pump(id, a);
+  // overwrite the half-sent frame several times over
+  for (int i = 2; i < 10; ++i) {
+    frame(buf, sizeof(buf), i);
+    hub.publish(buf, strlen(buf));
+  }
+  SlowSocket b(4096);
+  hub.pump(id, b);
+  std::string out = a.received + b.received;
+  int n;
+  TEST_ASSERT_EQUAL(9, checkFrames(out, &n));
+  TEST_ASSERT_TRUE(hub.takeGap(id));
+}
+
+void test_disconnect_policy_and_unicast() {
+  BroadcastHub<128, 2, 40> hub;
+  int id = hub.subscribe(HUB_DISCONNECT);
+  TEST_ASSERT_TRUE(hub.unicast(id, "hello\n", 6));
+  TEST_ASSERT_FALSE(hub.unicast(id, "again\n", 6));
+  char buf[40];
+  for (int i = 0; i < 20; ++i) {
+    frame(buf, sizeof(buf), i);
+    hub.publish(buf, strlen(buf));
+  }
+  SlowSocket s(4096);
+  hub.pump(id, s);
+  TEST_ASSERT_EQUAL_STRING("hello\n", s.received.c_str());
+  TEST_ASSERT_TRUE(hub.closing(id));
+  hub.unsubscribe(id);
+  TEST_ASSERT_EQUAL(0, (int)hub.subscribers());
+}
+
+void test_replay_and_slot_limit() {
+  BroadcastHub<128, 2, 40> hub;
+  char buf[40];
+  for (int i = 0; i < 3; ++i) {
+    frame(buf, sizeof(buf), i);
+    hub.publish(buf, strlen(buf));
+  }
+  int a = hub.subscribe(HUB_DROP_OLDEST, true);
+  int b = hub.subscribe(HUB_DROP_OLDEST);
+  TEST_ASSERT_EQUAL(-1, hub.subscribe(HUB_DROP_OLDEST));
+  SlowSocket sa(4096), sb(4096);
+  hub.pump(a, sa);
+  hub.pump(b, sb);
+  int n;
+  TEST_ASSERT_EQUAL(2, checkFrames(sa.received, &n));
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_EQUAL(0, (int)sb.received.size());
+  TEST_ASSERT_FALSE(hub.publish(buf, 41));
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fast_subscriber_gets_everything);
+  RUN_TEST(test_slow_consumer_does_not_hold_back_fast_one);
+  RUN_TEST(test_partial_frame_survives_eviction);
+  RUN_TEST(test_disconnect_policy_and_unicast);
+  RUN_TEST(test_replay_and_slot_limit);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,131 @@
+// Host tests for the streaming CBOR encoder (pio test -e native)
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include "cbor_writer.h"
+
+struct ByteSink {
+  std::string out;
+  size_t calls;
+  size_t limit;   // accept at most this many bytes in total
+  ByteSink() : calls(0), limit((size_t)-1) {}
+  size_t write(const uint8_t *p, size_t n) {
+    calls++;
+    if (out.size() + n > limit) n = limit - out.size();
+    out.append((const char *)p, n);
+    return n;
+  }
+};
+
+static std::string hex(const std::string &s) {
+  std::string h;
+  char b[3];
+  for (size_t i = 0; i < s.size(); ++i) {
+    snprintf(b, sizeof(b), "%02x", (uint8_t)s[i]);
+    h += b;
+  }
+  return h;
+}
+
+template <typename Fn>
+static std::string encode(Fn fn) {
+  ByteSink sink;
+  CborWriter<ByteSink> w(sink);
+  fn(w);
+  w.flush();
+  return hex(sink.out);
+}
+
+// Expected bytes from the examples in RFC 8949 appendix A
+struct Ints { int64_t v; void operator()(StructWriter &w) const { w.intValue(v); } };
+
+void test_rfc_scalars() {
+  const struct { int64_t v; const char *hex; } cases[] = {
+    { 0, "00" }, { 23, "17" }, { 24, "1818" }, { 100, "1864" }, { 1000, "1903e8" },
+    { 1000000, "1a000f4240" }, { 1000000000000LL, "1b000000e8d4a51000" },
+    { -1, "20" }, { -100, "3863" }, { -1000, "3903e7" },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    Ints fn = { cases[i].v };
+    TEST_ASSERT_EQUAL_STRING(cases[i].hex, encode(fn).c_str());
+  }
+  struct Misc {
+    void operator()(StructWriter &w) const {
+      w.boolValue(false);
+      w.boolValue(true);
+      w.nullValue();
+      w.floatValue(100000.0f);
+      w.floatValue(NAN);
+      w.strValue("IETF");
+    }
+  };
+  TEST_ASSERT_EQUAL_STRING("f4f5f6fa47c35000f66449455446", encode(Misc()).c_str());
+}
+
+void test_nested_indefinite_containers() {
+  // {_ "a": 1, "b": [_ 2, 3]}
+  struct Doc {
+    void operator()(StructWriter &w) const {
+      w.beginMap();
+      w.intField("a", 1);
+      w.key("b");
+      w.beginArray();
+      w.intValue(2);
+      w.intValue(3);
+      w.endArray();
+      w.endMap();
+    }
+  };
+  TEST_ASSERT_EQUAL_STRING("bf61610161629f0203ffff", encode(Doc()).c_str());
+}
+
+void test_streams_through_small_buffer() {
+  ByteSink sink;
+  CborWriter<ByteSink, 16> w(sink);
+  std::string big(100, 'x');
+  w.beginArray();
+  for (int i = 0; i < 50; ++i) w.floatField("temp", 21.5f);
+  w.strValue(big.c_str(), big.size());
+  w.endArray();
+  w.flush();
+  // 2 markers + 50 * (5 key + 5 float) + 2 head + 100
+  TEST_ASSERT_EQUAL(604, (int)w.size());
+  TEST_ASSERT_EQUAL(604, (int)sink.out.size());
+  TEST_ASSERT_TRUE(sink.calls >= 604 / 16);
+  TEST_ASSERT_EQUAL_STRING("7864", hex(sink.out.substr(501, 2)).c_str());
+  TEST_ASSERT_TRUE(w.ok());
+}
+
+void test_short_write_is_reported() {
+  ByteSink sink;
+  sink.limit = 20;
+  CborWriter<ByteSink, 16> w(sink);
+  for (int i = 0; i < 10; ++i) w.intField("n", 1000);
+  TEST_ASSERT_FALSE(w.flush());
+  TEST_ASSERT_FALSE(w.ok());
+  TEST_ASSERT_EQUAL(20, (int)sink.out.size());
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_rfc_scalars);
+  RUN_TEST(test_nested_indefinite_containers);
+  RUN_TEST(test_streams_through_small_buffer);
+  RUN_TEST(test_short_write_is_reported);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,94 @@
+// Host tests for the time service's clock bookkeeping (pio test -e native):
+// first set, RTC carry-over, steps in both directions, slow drift and NTP
+// sync tracking.
+#include <unity.h>
+#include "clock_tracker.h"
+
+static const int64_t T0 = 1718000000LL * 1000;   // 2024-06-10 06:13:20 UTC
+
+void test_unset_until_ntp() {
+  ClockTracker c;
+  c.begin(500, 0);
+  TEST_ASSERT_FALSE(c.valid());
+  TEST_ASSERT_EQUAL(0, c.wallMs(1000));
+  TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(1000, 1000));     // 1970 + 1 s
+  TEST_ASSERT_EQUAL(CLOCK_EV_SET, c.observe(5000, T0));
+  TEST_ASSERT_TRUE(c.valid());
+  TEST_ASSERT_EQUAL(CLOCK_NTP, c.source());
+  TEST_ASSERT_TRUE(c.wallMs(6500) == T0 + 1500);
+  TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(6000, T0 + 1000));
+  TEST_ASSERT_EQUAL(0, c.jumps());
+}
+
+void test_rtc_kept_across_reset() {
+  ClockTracker c;
+  c.begin(300, T0);
+  TEST_ASSERT_TRUE(c.valid());
+  TEST_ASSERT_EQUAL(CLOCK_RTC, c.source());
+  // no SET event: the clock was valid from the start
+  TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(1300, T0 + 1000));
+  TEST_ASSERT_TRUE(c.sinceSyncMs(1300) == UINT64_MAX);
+  // the first NTP sync corrects the RTC by 40 s
+  c.synced(60000);
+  TEST_ASSERT_EQUAL(CLOCK_NTP, c.source());
+  TEST_ASSERT_EQUAL(CLOCK_EV_JUMP, c.observe(60000, T0 + 59700 - 40000));
+  TEST_ASSERT_TRUE(c.lastJumpMs() == -40000);
+  TEST_ASSERT_EQUAL(1, c.syncs());
+  TEST_ASSERT_TRUE(c.sinceSyncMs(70000) == 10000);
+}
+
+void test_steps_and_drift() {
+  ClockTracker c(2000);
+  c.observe(0, T0);
+  // drift of 1 s over an hour stays under the threshold, and is followed
+  int64_t wall = T0;
+  uint64_t mono = 0;
+  for (int i = 0; i < 3600; ++i) {
+    mono += 1000;
+    wall += 1000 + (i % 4 == 0 ? 1 : 0);
+    TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(mono, wall));
+  }
+  TEST_ASSERT_TRUE(c.wallMs(mono) == wall);
+  // an hour forward, then back
+  TEST_ASSERT_EQUAL(CLOCK_EV_JUMP, c.observe(mono + 10, wall + 10 + 3600000));
+  TEST_ASSERT_TRUE(c.lastJumpMs() == 3600000);
+  TEST_ASSERT_EQUAL(CLOCK_EV_JUMP, c.observe(mono + 20, wall + 20));
+  TEST_ASSERT_TRUE(c.lastJumpMs() == -3600000);
+  TEST_ASSERT_EQUAL(2, c.jumps());
+  // the wall clock never goes back to 1970 once set
+  TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(mono + 30, 0));
+  TEST_ASSERT_TRUE(c.valid());
+}
+
+void test_64bit_monotonic() {
+  // past the 49.7 days where a 32-bit millis() wraps
+  ClockTracker c;
+  uint64_t mono = 0xFFFFFF00ULL;
+  c.observe(mono, T0);
+  TEST_ASSERT_EQUAL(CLOCK_EV_NONE, c.observe(mono + 0x200, T0 + 0x200));
+  TEST_ASSERT_TRUE(c.wallMs(mono + 86400000ULL) == T0 + 86400000LL);
+  c.synced(mono);
+  TEST_ASSERT_TRUE(c.sinceSyncMs(mono + 0x200) == 0x200);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_unset_until_ntp);
+  RUN_TEST(test_rtc_kept_across_reset);
+  RUN_TEST(test_steps_and_drift);
+  RUN_TEST(test_64bit_monotonic);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
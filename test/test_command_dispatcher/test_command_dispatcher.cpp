@@ -0,0 +1,189 @@
+// Host tests for the shared command dispatcher (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "command_dispatcher.h"
+
+struct Ctx {
+  int relayCh;
+  long relayState;
+  float setpoint;
+  float hysteresis;
+  bool enabled;
+  char rules[64];
+};
+
+static bool runRelay(const CmdArgs &a, Ctx &c) {
+  c.relayCh = (int)a.asInt(0);
+  c.relayState = a.asInt(1);
+  return true;
+}
+
+static bool runThermostat(const CmdArgs &a, Ctx &c) {
+  // optional arguments keep the current value
+  c.setpoint = a.asFloat(0, c.setpoint);
+  c.hysteresis = a.asFloat(1, c.hysteresis);
+  c.enabled = a.asBool(2, c.enabled);
+  return c.hysteresis >= 0;
+}
+
+static bool runRules(const CmdArgs &a, Ctx &c) {
+  snprintf(c.rules, sizeof(c.rules), "%s", a.asStr(0));
+  return true;
+}
+
+static const CmdArgSpec RELAY_ARGS[] = {
+  { "ch", CMD_ARG_INT, true, 1, 6, 0 },
+  { "state", CMD_ARG_ENUM, true, 0, 0, "on|off|toggle" },
+};
+static const CmdArgSpec THERM_ARGS[] = {
+  { "setpoint", CMD_ARG_FLOAT, false, 0, 0, 0 },
+  { "hysteresis", CMD_ARG_FLOAT, false, 0, 0, 0 },
+  { "enabled", CMD_ARG_BOOL, false, 0, 0, 0 },
+};
+static const CmdArgSpec RULES_ARGS[] = {
+  { "rules", CMD_ARG_STR, true, 0, 0, 0 },
+};
+
+static const CmdDef<Ctx> TABLE[] = {
+  { "relay", 0, RELAY_ARGS, 2, runRelay, "switch a relay" },
+  { "thermostat_set", "setpoint", THERM_ARGS, 3, runThermostat, "thermostat settings" },
+  { "rules", 0, RULES_ARGS, 1, runRules, "automation rules" },
+};
+
+static uint32_t fakeUs = 0;
+static uint32_t fakeClock() { return fakeUs += 7; }
+
+static Ctx fresh() {
+  Ctx c;
+  memset(&c, 0, sizeof(c));
+  c.setpoint = 23.0f;
+  c.hysteresis = 0.8f;
+  c.enabled = true;
+  return c;
+}
+
+void test_keyed_and_positional_are_equivalent() {
+  CommandDispatcher<Ctx, 3> d(TABLE);
+  Ctx c = fresh();
+  char err[48];
+  CmdPair kv[] = { { "state", "toggle" }, { "ch", "4" } };
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatch("relay", kv, 2, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL(4, c.relayCh);
+  TEST_ASSERT_EQUAL(2, c.relayState);
+  char line[] = "relay 2 on";
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatchLine(line, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL(2, c.relayCh);
+  TEST_ASSERT_EQUAL(0, c.relayState);
+}
+
+void test_schema_validation_errors() {
+  CommandDispatcher<Ctx, 3> d(TABLE);
+  Ctx c = fresh();
+  char err[48];
+  CmdPair badCh[] = { { "ch", "7" }, { "state", "on" } };
+  TEST_ASSERT_EQUAL(CMD_BAD_ARGS, d.dispatch("relay", badCh, 2, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("bad value for 'ch'", err);
+  CmdPair badState[] = { { "ch", "1" }, { "state", "blink" } };
+  TEST_ASSERT_EQUAL(CMD_BAD_ARGS, d.dispatch("relay", badState, 2, c, err, sizeof(err), fakeClock));
+  CmdPair missing[] = { { "ch", "1" } };
+  TEST_ASSERT_EQUAL(CMD_BAD_ARGS, d.dispatch("relay", missing, 1, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("missing 'state'", err);
+  CmdPair unknown[] = { { "ch", "1" }, { "state", "on" }, { "color", "red" } };
+  TEST_ASSERT_EQUAL(CMD_BAD_ARGS, d.dispatch("relay", unknown, 3, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("unknown argument 'color'", err);
+  CmdPair notNumber[] = { { "ch", "1x" }, { "state", "on" } };
+  TEST_ASSERT_EQUAL(CMD_BAD_ARGS, d.dispatch("relay", notNumber, 2, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL(CMD_UNKNOWN, d.dispatch("reboot", 0, 0, c, err, sizeof(err), fakeClock));
+  // nothing was actuated
+  TEST_ASSERT_EQUAL(0, c.relayCh);
+}
+
+void test_optional_args_keep_current_values() {
+  CommandDispatcher<Ctx, 3> d(TABLE);
+  Ctx c = fresh();
+  char err[48];
+  // legacy serial verb: "setpoint <val>" must not reset hysteresis/enabled
+  char line[] = "setpoint 24.5";
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatchLine(line, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 24.5f, c.setpoint);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.8f, c.hysteresis);
+  TEST_ASSERT_TRUE(c.enabled);
+  char line2[] = "thermostat_set enabled=off hysteresis=-1";
+  TEST_ASSERT_EQUAL(CMD_FAILED, d.dispatchLine(line2, c, err, sizeof(err), fakeClock));
+}
+
+void test_trailing_string_takes_rest_of_line() {
+  CommandDispatcher<Ctx, 3> d(TABLE);
+  Ctx c = fresh();
+  char err[48];
+  char line[] = "rules tout>=25 & hin>80 -> ch4 10m h0.5  \r\n";
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatchLine(line, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("tout>=25 & hin>80 -> ch4 10m h0.5", c.rules);
+  char keyed[] = "rules rules=tin<5->ch1";
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatchLine(keyed, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("tin<5->ch1", c.rules);
+}
+
+void test_local_only_refused_to_remote() {
+  static const char *const LOCAL[] = { "rules", 0 };
+  CommandDispatcher<Ctx, 3> d(TABLE, LOCAL);
+  TEST_ASSERT_TRUE(d.localOnly(2));
+  TEST_ASSERT_FALSE(d.localOnly(0));
+  Ctx c = fresh();
+  char err[48];
+  char line[] = "rules tin<5 -> ch1";
+  TEST_ASSERT_EQUAL(CMD_DENIED, d.dispatchLine(line, c, err, sizeof(err), fakeClock, true));
+  TEST_ASSERT_EQUAL_STRING("rules is not allowed from here", err);
+  TEST_ASSERT_EQUAL_STRING("", c.rules);
+  TEST_ASSERT_EQUAL(0, d.stats(2).calls);
+  CmdPair kv[] = { { "rules", "hin>90 -> ch5" } };
+  TEST_ASSERT_EQUAL(CMD_DENIED, d.dispatch("rules", kv, 1, c, err, sizeof(err), fakeClock, true));
+  // other commands from the same transport, and this one from a local one
+  CmdPair rk[] = { { "ch", "3" }, { "state", "on" } };
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatch("relay", rk, 2, c, err, sizeof(err), fakeClock, true));
+  TEST_ASSERT_EQUAL(CMD_OK, d.dispatch("rules", kv, 1, c, err, sizeof(err), fakeClock));
+  TEST_ASSERT_EQUAL_STRING("hin>90 -> ch5", c.rules);
+}
+
+void test_latency_stats() {
+  CommandDispatcher<Ctx, 3> d(TABLE);
+  Ctx c = fresh();
+  char err[48];
+  CmdPair kv[] = { { "ch", "1" }, { "state", "on" } };
+  fakeUs = 0;
+  d.dispatch("relay", kv, 2, c, err, sizeof(err), fakeClock);
+  d.dispatch("relay", kv, 1, c, err, sizeof(err), fakeClock);
+  const CommandDispatcher<Ctx, 3>::Stats &s = d.stats(0);
+  TEST_ASSERT_EQUAL(2, s.calls);
+  TEST_ASSERT_EQUAL(1, s.errors);
+  TEST_ASSERT_EQUAL(7, s.maxUs);
+  TEST_ASSERT_EQUAL(14, (int)s.totalUs);
+  d.resetStats();
+  TEST_ASSERT_EQUAL(0, d.stats(0).calls);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_keyed_and_positional_are_equivalent);
+  RUN_TEST(test_schema_validation_errors);
+  RUN_TEST(test_optional_args_keep_current_values);
+  RUN_TEST(test_trailing_string_takes_rest_of_line);
+  RUN_TEST(test_local_only_refused_to_remote);
+  RUN_TEST(test_latency_stats);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
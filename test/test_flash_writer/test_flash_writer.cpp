@@ -0,0 +1,274 @@
+// Host tests for the OTA flash writer (pio test -e native) on a simulated
+// partition with NOR flash rules: erase sets a whole sector to 0xFF, a write
+// can only clear bits, and writing an unerased byte is an error. Covers
+// SHA-256 vectors, streaming in odd splits, size/digest/flash failures,
+// readback of a bad cell, and the sector swap used for filesystem images.
+#include <unity.h>
+#include <vector>
+#include <string.h>
+#include "flash_writer.h"
+#include "../common/alloc_guard.h"
+
+static const uint32_t SECTOR = 4096;
+
+struct SimPartition {
+  std::vector<uint8_t> mem;
+  uint32_t erases;
+  uint32_t writes;
+  uint32_t maxWrite;       // largest single write
+  int64_t failWriteAt;     // offset whose write fails, -1: none
+  int64_t stuckAt;         // byte that keeps bit 0 set, -1: none
+
+  explicit SimPartition(uint32_t size) : mem(size, 0x5A), erases(0), writes(0), maxWrite(0), failWriteAt(-1), stuckAt(-1) {}
+
+  uint32_t size() const { return (uint32_t)mem.size(); }
+
+  bool erase(uint32_t off, uint32_t len) {
+    if (off % SECTOR || len % SECTOR || off + len > mem.size()) return false;
+    memset(&mem[off], 0xFF, len);
+    erases += len / SECTOR;
+    return true;
+  }
+
+  bool write(uint32_t off, const uint8_t *p, size_t n) {
+    if (off + n > mem.size()) return false;
+    if (failWriteAt >= off && failWriteAt < (int64_t)(off + n)) return false;
+    for (size_t i = 0; i < n; ++i) {
+      if (mem[off + i] != 0xFF && p[i] != 0xFF) return false;   // not erased
+      mem[off + i] &= p[i];
+      if ((int64_t)(off + i) == stuckAt) mem[off + i] |= 1;
+    }
+    writes++;
+    if (n > maxWrite) maxWrite = (uint32_t)n;
+    return true;
+  }
+
+  bool read(uint32_t off, uint8_t *p, size_t n) {
+    if (off + n > mem.size()) return false;
+    memcpy(p, &mem[off], n);
+    return true;
+  }
+};
+
+typedef FlashStreamWriter<SimPartition> Writer;
+
+static std::vector<uint8_t> image(size_t n, uint32_t seed) {
+  std::vector<uint8_t> v(n);
+  for (size_t i = 0; i < n; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    v[i] = (uint8_t)(seed >> 16);
+  }
+  return v;
+}
+
+static void digestOf(const std::vector<uint8_t> &v, uint8_t d[32]) {
+  Sha256 h;
+  h.update(v.data(), v.size());
+  h.finish(d);
+}
+
+// Feeds `img` in chunks of 1, 7, 300, 4096+5 ... bytes, like TCP segments
+static bool stream(Writer &w, const std::vector<uint8_t> &img) {
+  static const size_t splits[] = { 1, 7, 300, 4101, 1460, 64 };
+  size_t off = 0;
+  for (int i = 0; off < img.size(); ++i) {
+    size_t n = splits[i % 6];
+    if (n > img.size() - off) n = img.size() - off;
+    if (!w.write(&img[off], n)) return false;
+    off += n;
+  }
+  return true;
+}
+
+void test_sha256_vectors() {
+  char hex[65];
+  uint8_t d[32];
+  Sha256 h;
+  h.finish(d);
+  sha256ToHex(d, hex);
+  TEST_ASSERT_EQUAL_STRING("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hex);
+  h.reset();
+  const char *msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  for (size_t i = 0; msg[i]; ++i) h.update((const uint8_t *)msg + i, 1);
+  h.finish(d);
+  sha256ToHex(d, hex);
+  TEST_ASSERT_EQUAL_STRING("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hex);
+  uint8_t back[32];
+  TEST_ASSERT_TRUE(sha256FromHex(hex, back));
+  TEST_ASSERT_EQUAL_MEMORY(d, back, 32);
+  TEST_ASSERT_FALSE(sha256FromHex("248d", back));
+  TEST_ASSERT_FALSE(sha256FromHex("z48d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", back));
+}
+
+void test_stream_to_partition() {
+  SimPartition part(64 * SECTOR);
+  std::vector<uint8_t> img = image(10 * SECTOR + 1234, 1);
+  uint8_t d[32];
+  digestOf(img, d);
+  Writer w(part);
+  TEST_ASSERT_TRUE(w.begin(img.size(), d));
+  {
+    // page and sector writes only: no allocation per chunk
+    AllocGuard g;
+    TEST_ASSERT_TRUE(stream(w, img));
+    TEST_ASSERT_TRUE(w.finish());
+    TEST_ASSERT_NO_ALLOC(g);
+  }
+  TEST_ASSERT_EQUAL_MEMORY(img.data(), part.mem.data(), img.size());
+  // the padding of the last page stays erased, the rest of the partition untouched
+  TEST_ASSERT_EQUAL(0xFF, part.mem[img.size()]);
+  TEST_ASSERT_EQUAL(0x5A, part.mem[11 * SECTOR]);
+  TEST_ASSERT_EQUAL(11, part.erases);
+  TEST_ASSERT_EQUAL(256, part.maxWrite);
+  TEST_ASSERT_EQUAL((img.size() + 255) / 256, part.writes);
+  // readback in steps of 4 KB
+  int steps = 0;
+  while (!w.verifyStep(SECTOR)) {
+    TEST_ASSERT_EQUAL(FLASH_OK, w.error());
+    steps++;
+  }
+  TEST_ASSERT_EQUAL(10, steps);
+  TEST_ASSERT_TRUE(w.bytesVerified() == img.size());
+  // bounded RAM: one page, the hash and a few counters
+  TEST_ASSERT_TRUE(sizeof(Writer) < 512);
+}
+
+void test_size_errors() {
+  SimPartition part(4 * SECTOR);
+  std::vector<uint8_t> img = image(5 * SECTOR, 2);
+  uint8_t d[32];
+  digestOf(img, d);
+  Writer w(part);
+  TEST_ASSERT_FALSE(w.begin(img.size(), d));           // larger than the partition
+  TEST_ASSERT_EQUAL(FLASH_ERR_SIZE, w.error());
+  TEST_ASSERT_FALSE(w.write(img.data(), 1));
+  TEST_ASSERT_FALSE(w.begin(0, d));
+  // more bytes than announced
+  TEST_ASSERT_TRUE(w.begin(1000, d));
+  TEST_ASSERT_FALSE(w.write(img.data(), 1001));
+  TEST_ASSERT_EQUAL(FLASH_ERR_SIZE, w.error());
+  // fewer
+  TEST_ASSERT_TRUE(w.begin(1000, d));
+  TEST_ASSERT_TRUE(w.write(img.data(), 999));
+  TEST_ASSERT_FALSE(w.finish());
+  TEST_ASSERT_EQUAL(FLASH_ERR_SIZE, w.error());
+}
+
+void test_digest_mismatch() {
+  SimPartition part(16 * SECTOR);
+  std::vector<uint8_t> img = image(3 * SECTOR, 3);
+  uint8_t d[32];
+  digestOf(img, d);
+  img[5000] ^= 0x10;                                     // corrupted in transit
+  Writer w(part);
+  TEST_ASSERT_TRUE(w.begin(img.size(), d));
+  TEST_ASSERT_TRUE(stream(w, img));
+  TEST_ASSERT_FALSE(w.finish());
+  TEST_ASSERT_EQUAL(FLASH_ERR_DIGEST, w.error());
+  TEST_ASSERT_FALSE(w.verifyStep(1 << 20));
+  TEST_ASSERT_EQUAL_STRING("sha256 mismatch", flashWriteErrorName(w.error()));
+}
+
+void test_flash_failures() {
+  SimPartition part(16 * SECTOR);
+  std::vector<uint8_t> img = image(3 * SECTOR, 4);
+  uint8_t d[32];
+  digestOf(img, d);
+  // a page that cannot be programmed stops the stream there
+  part.failWriteAt = SECTOR + 300;
+  Writer w(part);
+  TEST_ASSERT_TRUE(w.begin(img.size(), d));
+  TEST_ASSERT_FALSE(stream(w, img));
+  TEST_ASSERT_EQUAL(FLASH_ERR_WRITE, w.error());
+  TEST_ASSERT_TRUE(w.bytesReceived() < 2 * SECTOR);
+  // a cell that does not hold its value passes the stream hash, not the readback
+  SimPartition bad(16 * SECTOR);
+  bad.stuckAt = 2 * SECTOR + 17;
+  img[2 * SECTOR + 17] &= 0xFE;
+  digestOf(img, d);
+  Writer w2(bad);
+  TEST_ASSERT_TRUE(w2.begin(img.size(), d));
+  TEST_ASSERT_TRUE(stream(w2, img));
+  TEST_ASSERT_TRUE(w2.finish());
+  while (!w2.verifyStep(SECTOR) && w2.error() == FLASH_OK) {}
+  TEST_ASSERT_EQUAL(FLASH_ERR_READBACK, w2.error());
+}
+
+void test_swap_and_roll_back() {
+  const uint32_t N = 8;
+  SimPartition live(N * SECTOR), staging(12 * SECTOR);
+  std::vector<uint8_t> oldImg = image(N * SECTOR, 5), newImg = image(N * SECTOR, 6);
+  live.mem.assign(oldImg.begin(), oldImg.end());
+  uint8_t d[32];
+  digestOf(newImg, d);
+  Writer w(staging);
+  TEST_ASSERT_TRUE(w.begin(newImg.size(), d));
+  TEST_ASSERT_TRUE(stream(w, newImg));
+  TEST_ASSERT_TRUE(w.finish());
+  const uint32_t scratch = staging.size() - SECTOR;
+  for (uint32_t s = 0; s < N; ++s) {
+    for (uint8_t k = 0; k < FLASH_SWAP_STEPS; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, s * SECTOR, scratch, k)));
+  }
+  TEST_ASSERT_EQUAL_MEMORY(newImg.data(), live.mem.data(), newImg.size());
+  TEST_ASSERT_EQUAL_MEMORY(oldImg.data(), staging.mem.data(), oldImg.size());
+  // health check failed: swap back
+  for (uint32_t s = 0; s < N; ++s) {
+    for (uint8_t k = 0; k < FLASH_SWAP_STEPS; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, s * SECTOR, scratch, k)));
+  }
+  TEST_ASSERT_EQUAL_MEMORY(oldImg.data(), live.mem.data(), oldImg.size());
+  TEST_ASSERT_EQUAL_MEMORY(newImg.data(), staging.mem.data(), newImg.size());
+}
+
+// A power cut halfway through each step of sector 3, then what the next boot
+// does (src/ota.cpp): the step runs again, the sector is finished, and the
+// sectors swapped so far are swapped back
+void test_swap_resumes_after_power_cut() {
+  const uint32_t N = 6, CUT = 3;
+  std::vector<uint8_t> oldImg = image(N * SECTOR, 7), newImg = image(N * SECTOR, 8);
+  for (uint8_t cutStep = 0; cutStep < FLASH_SWAP_STEPS; ++cutStep) {
+    SimPartition live(N * SECTOR), staging(8 * SECTOR);
+    live.mem.assign(oldImg.begin(), oldImg.end());
+    memcpy(staging.mem.data(), newImg.data(), newImg.size());
+    const uint32_t scratch = staging.size() - SECTOR;
+    for (uint32_t s = 0; s < CUT; ++s) {
+      for (uint8_t k = 0; k < FLASH_SWAP_STEPS; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, s * SECTOR, scratch, k)));
+    }
+    for (uint8_t k = 0; k < cutStep; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, CUT * SECTOR, scratch, k)));
+    // erased and half written when the power went
+    SimPartition &torn = cutStep == 1 ? live : staging;
+    uint32_t at = cutStep == 0 ? scratch : CUT * SECTOR;
+    torn.erase(at, SECTOR);
+    memset(&torn.mem[at], 0x00, SECTOR / 2);
+    for (uint8_t k = cutStep; k < FLASH_SWAP_STEPS; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, CUT * SECTOR, scratch, k)));
+    for (uint32_t s = 0; s <= CUT; ++s) {
+      for (uint8_t k = 0; k < FLASH_SWAP_STEPS; ++k) TEST_ASSERT_TRUE((flashSwapStep<SECTOR, 256>(live, staging, s * SECTOR, scratch, k)));
+    }
+    TEST_ASSERT_EQUAL_MEMORY(oldImg.data(), live.mem.data(), oldImg.size());
+    TEST_ASSERT_EQUAL_MEMORY(newImg.data(), staging.mem.data(), newImg.size());
+  }
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sha256_vectors);
+  RUN_TEST(test_stream_to_partition);
+  RUN_TEST(test_size_errors);
+  RUN_TEST(test_digest_mismatch);
+  RUN_TEST(test_flash_failures);
+  RUN_TEST(test_swap_and_roll_back);
+  RUN_TEST(test_swap_resumes_after_power_cut);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
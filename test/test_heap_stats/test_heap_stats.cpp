@@ -0,0 +1,78 @@
+// Host tests for per-module allocation accounting (pio test -e native)
+#include <unity.h>
+#include <string.h>
+#include "heap_stats.h"
+
+// What the malloc hook does on the device
+static void fakeMalloc(size_t n) { heapCountAlloc(heapCurrentTag(), n, true); }
+static void fakeFree() { heapCountFree(heapCurrentTag()); }
+
+void test_scopes_attribute_to_module() {
+  heapCountersReset();
+  fakeMalloc(10);
+  {
+    HeapScope web(LOGM_WEB);
+    fakeMalloc(100);
+    {
+      HeapScope mqtt(LOGM_MQTT);
+      fakeMalloc(30);
+      fakeFree();
+    }
+    // back to the outer scope
+    fakeMalloc(50);
+  }
+  fakeFree();
+  TEST_ASSERT_EQUAL(2, heapCounters(LOGM_WEB).allocs);
+  TEST_ASSERT_EQUAL(150, heapCounters(LOGM_WEB).bytes);
+  TEST_ASSERT_EQUAL(1, heapCounters(LOGM_MQTT).allocs);
+  TEST_ASSERT_EQUAL(1, heapCounters(LOGM_MQTT).frees);
+  TEST_ASSERT_EQUAL(1, heapCounters(HEAP_TAG_OTHER).allocs);
+  TEST_ASSERT_EQUAL(1, heapCounters(HEAP_TAG_OTHER).frees);
+  TEST_ASSERT_EQUAL_STRING("other", heapTagName(HEAP_TAG_OTHER));
+  TEST_ASSERT_EQUAL_STRING("web", heapTagName(LOGM_WEB));
+  // out-of-range tags are not lost
+  heapCountAlloc(200, 8, false);
+  TEST_ASSERT_EQUAL(2, heapCounters(HEAP_TAG_OTHER).allocs);
+  TEST_ASSERT_EQUAL(1, heapCounters(HEAP_TAG_OTHER).failed);
+}
+
+void test_request_delta() {
+  heapCountersReset();
+  HeapSnapshot before = HeapSnapshot::take(LOGM_WEB);
+  HeapSnapshot allBefore = HeapSnapshot::take();
+  {
+    HeapScope web(LOGM_WEB);
+    for (int i = 0; i < 5; ++i) fakeMalloc(64);
+    for (int i = 0; i < 4; ++i) fakeFree();
+  }
+  // another task allocating meanwhile is not charged to the request
+  fakeMalloc(1000);
+  HeapSnapshot d = HeapSnapshot::take(LOGM_WEB).since(before);
+  TEST_ASSERT_EQUAL(5, d.allocs);
+  TEST_ASSERT_EQUAL(4, d.frees);
+  TEST_ASSERT_EQUAL(320, d.bytes);
+  HeapSnapshot all = HeapSnapshot::take().since(allBefore);
+  TEST_ASSERT_EQUAL(6, all.allocs);
+  TEST_ASSERT_EQUAL(1320, all.bytes);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_scopes_attribute_to_module);
+  RUN_TEST(test_request_delta);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
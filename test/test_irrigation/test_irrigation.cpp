@@ -0,0 +1,183 @@
+// Host simulation of the irrigation job scheduler (run with `pio test -e native`)
+#include <unity.h>
+#include "irrigation_engine.h"
+
+typedef IrrigationEngine<6, 8> Engine;
+
+// Simulated relay bank: records on/off edges
+struct Valves {
+  bool on[7];
+  int maxOnAtOnce;
+  int edges;
+  Valves() : maxOnAtOnce(0), edges(0) { for (int i = 0; i < 7; ++i) on[i] = false; }
+  int countOn() const { int n = 0; for (int i = 1; i < 7; ++i) n += on[i]; return n; }
+};
+
+struct Actuator {
+  Valves *v;
+  void operator()(uint8_t ch, bool state) {
+    TEST_ASSERT_TRUE(v->on[ch] != state); // every call must be a real edge
+    v->on[ch] = state;
+    v->edges++;
+    if (v->countOn() > v->maxOnAtOnce) v->maxOnAtOnce = v->countOn();
+  }
+};
+
+static void setupZones(Engine &e, uint8_t concurrent) {
+  Engine::Zone z[3] = { {3, 60}, {4, 120}, {5, 30} };
+  TEST_ASSERT_TRUE(e.setZones(z, 3));
+  e.setMaxConcurrent(concurrent);
+}
+
+// Advance simulated time in 10 ms loop steps
+static void run(Engine &e, Actuator &a, uint32_t &now, uint32_t untilMs) {
+  while ((int32_t)(untilMs - now) > 0) { now += 10; e.tick(now, a); }
+}
+
+void test_sequencing_respects_pump_capacity() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 1);
+  uint32_t now = 0;
+  TEST_ASSERT_EQUAL(3, e.enqueueAll());
+  e.tick(now, a);
+  TEST_ASSERT_TRUE(v.on[3]);
+  TEST_ASSERT_FALSE(v.on[4]);
+  run(e, a, now, 60000);
+  TEST_ASSERT_FALSE(v.on[3]);
+  TEST_ASSERT_TRUE(v.on[4]);
+  run(e, a, now, 180000);
+  TEST_ASSERT_TRUE(v.on[5]);
+  run(e, a, now, 210000);
+  TEST_ASSERT_TRUE(e.idle());
+  TEST_ASSERT_EQUAL(1, v.maxOnAtOnce);
+  TEST_ASSERT_EQUAL(6, v.edges);
+}
+
+void test_two_valves_in_parallel() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 2);
+  uint32_t now = 0;
+  e.enqueueAll();
+  e.tick(now, a);
+  TEST_ASSERT_TRUE(v.on[3] && v.on[4]);
+  // zone 3 ends at 60 s, zone 5 (30 s) takes its slot
+  run(e, a, now, 60000);
+  TEST_ASSERT_TRUE(v.on[5]);
+  TEST_ASSERT_EQUAL(30, e.remainingSec(2, now));
+  run(e, a, now, 120000);
+  TEST_ASSERT_TRUE(e.idle());
+  TEST_ASSERT_EQUAL(2, v.maxOnAtOnce);
+}
+
+void test_overlapping_job_is_queued_not_cut_short() {
+  // Old behaviour: a second trigger's pending-off switched relay 3 off while
+  // the other run was still active. Now the second run waits its turn.
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 1);
+  uint32_t now = 0;
+  e.enqueue(0, 60);
+  e.tick(now, a);
+  run(e, a, now, 30000);
+  e.enqueue(0, 60);
+  run(e, a, now, 60000);
+  // first run finished and the queued one restarted the valve immediately
+  TEST_ASSERT_TRUE(v.on[3]);
+  run(e, a, now, 119990);
+  TEST_ASSERT_TRUE(v.on[3]);
+  run(e, a, now, 120000);
+  TEST_ASSERT_FALSE(v.on[3]);
+}
+
+void test_busy_zone_does_not_block_other_zones() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 2);
+  uint32_t now = 0;
+  e.enqueue(0); e.enqueue(0); e.enqueue(2);
+  e.tick(now, a);
+  // second job for zone 0 must wait, zone 2 may use the free slot
+  TEST_ASSERT_TRUE(v.on[3] && v.on[5]);
+  TEST_ASSERT_EQUAL(1, e.queuedCount());
+}
+
+void test_queue_is_bounded() {
+  Engine e;
+  setupZones(e, 1);
+  for (int i = 0; i < 8; ++i) TEST_ASSERT_TRUE(e.enqueue(1));
+  TEST_ASSERT_FALSE(e.enqueue(1));
+  TEST_ASSERT_EQUAL(1, e.droppedCount());
+  TEST_ASSERT_FALSE(e.enqueue(5)); // unknown zone
+}
+
+void test_millis_wraparound() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 1);
+  uint32_t now = 0xFFFFFFFFUL - 20000UL;
+  e.enqueue(0);
+  e.tick(now, a);
+  TEST_ASSERT_EQUAL(60000, e.msUntilNextStop(now));
+  run(e, a, now, now + 59990);
+  TEST_ASSERT_TRUE(v.on[3]);
+  run(e, a, now, now + 20);
+  TEST_ASSERT_FALSE(v.on[3]);
+}
+
+void test_cancel_all_closes_valves() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 3);
+  e.enqueueAll(); e.enqueueAll();
+  e.tick(0, a);
+  TEST_ASSERT_EQUAL(3, v.countOn());
+  TEST_ASSERT_FALSE(e.setZones(0, 0)); // not while running
+  e.cancelAll(a);
+  TEST_ASSERT_EQUAL(0, v.countOn());
+  TEST_ASSERT_TRUE(e.idle());
+}
+
+// A new default run time while watering: the running and queued jobs keep theirs
+void test_duration_change_keeps_running_jobs() {
+  Engine e; Valves v; Actuator a = { &v };
+  setupZones(e, 1);
+  uint32_t now = 0;
+  e.enqueue(0);
+  e.enqueue(0);
+  e.tick(now, a);
+  TEST_ASSERT_TRUE(v.on[3]);
+  TEST_ASSERT_TRUE(e.setZoneDuration(0, 10));
+  TEST_ASSERT_FALSE(e.setZoneDuration(3, 10));
+  run(e, a, now, 59990);
+  TEST_ASSERT_TRUE(v.on[3]);          // still the 60 s it started with
+  run(e, a, now, 60000 + 59990);
+  TEST_ASSERT_TRUE(v.on[3]);          // the queued one kept 60 s too
+  run(e, a, now, 120010);
+  TEST_ASSERT_TRUE(e.idle());
+  e.enqueue(0);
+  e.tick(now, a);
+  run(e, a, now, now + 10000);
+  TEST_ASSERT_FALSE(v.on[3]);         // new jobs use the new default
+}
+
+static int runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sequencing_respects_pump_capacity);
+  RUN_TEST(test_two_valves_in_parallel);
+  RUN_TEST(test_overlapping_job_is_queued_not_cut_short);
+  RUN_TEST(test_busy_zone_does_not_block_other_zones);
+  RUN_TEST(test_queue_is_bounded);
+  RUN_TEST(test_millis_wraparound);
+  RUN_TEST(test_cancel_all_closes_valves);
+  RUN_TEST(test_duration_change_keeps_running_jobs);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  return runAllTests();
+}
+#endif
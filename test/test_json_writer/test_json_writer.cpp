@@ -0,0 +1,203 @@
+// Host tests for streaming JSON output and chunked transfer (pio test -e native).
+// Allocations are counted so the test can show that serializing a document
+// costs no heap, whatever its size.
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "json_writer.h"
+#include "chunked_sink.h"
+#include "../common/alloc_guard.h"
+
+struct ByteSink {
+  std::string out;
+  size_t write(const uint8_t *p, size_t n) {
+    out.append((const char *)p, n);
+    return n;
+  }
+};
+
+// Stands in for the socket: counts, never allocates
+struct CountingSocket {
+  size_t bytes;
+  uint32_t sum;
+  CountingSocket() : bytes(0), sum(0) {}
+  size_t write(const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; ++i) sum = sum * 31 + p[i];
+    bytes += n;
+    return n;
+  }
+};
+
+template <size_t Buf>
+static std::string toJson(StructProducer produce) {
+  ByteSink sink;
+  JsonWriter<ByteSink, Buf> w(sink);
+  produce(w);
+  w.flush();
+  return sink.out;
+}
+
+static void mixedDoc(StructWriter &w) {
+  w.beginMap();
+  w.key("in");
+  w.beginMap();
+  w.floatField("temp", 21.5f);
+  w.floatField("hum", NAN);
+  w.endMap();
+  w.key("times");
+  w.beginArray();
+  w.intValue(360);
+  w.intValue(-7);
+  w.beginArray();
+  w.endArray();
+  w.beginMap();
+  w.endMap();
+  w.endArray();
+  w.strField("rules", "tin<5 -> ch1\n\"x\"\\");
+  w.boolField("on", true);
+  w.floatField("ppfd", 200.0f);
+  w.intField("big", -9223372036854775807LL - 1);
+  w.endMap();
+}
+
+void test_document_shapes() {
+  const char *expected =
+      "{\"in\":{\"temp\":21.5,\"hum\":null},\"times\":[360,-7,[],{}],"
+      "\"rules\":\"tin<5 -> ch1\\n\\\"x\\\"\\\\\",\"on\":true,\"ppfd\":200,"
+      "\"big\":-9223372036854775808}";
+  TEST_ASSERT_EQUAL_STRING(expected, toJson<256>(mixedDoc).c_str());
+  // same bytes however small the buffer
+  TEST_ASSERT_EQUAL_STRING(expected, toJson<32>(mixedDoc).c_str());
+}
+
+static void floatsDoc(StructWriter &w) {
+  w.beginArray();
+  w.floatValue(0.0f);
+  w.floatValue(-0.25f);
+  w.floatValue(1000.0f);
+  w.floatValue(1e30f);
+  w.floatValue(-1e30f);
+  w.endArray();
+}
+
+void test_float_formatting() {
+  // too long for %.3f: %g, exponent intact
+  TEST_ASSERT_EQUAL_STRING("[0,-0.25,1000,1e+30,-1e+30]", toJson<64>(floatsDoc).c_str());
+}
+
+static void scheduleDoc(StructWriter &w) {
+  w.beginArray();
+  for (int i = 0; i < 400; ++i) {
+    w.beginMap();
+    w.intField("ch", 1 + i % 6);
+    w.intField("hour", i % 24);
+    w.intField("minute", i % 60);
+    w.boolField("on", i & 1);
+    w.boolField("enabled", true);
+    w.intField("days", 127);
+    w.endMap();
+  }
+  w.endArray();
+}
+
+// Dechunk `body`; false if the framing is wrong
+static bool dechunk(const std::string &body, std::string &out, int *chunks) {
+  size_t pos = 0;
+  *chunks = 0;
+  for (;;) {
+    size_t eol = body.find("\r\n", pos);
+    if (eol == std::string::npos) return false;
+    size_t n = strtoul(body.substr(pos, eol - pos).c_str(), nullptr, 16);
+    pos = eol + 2;
+    if (!n) return body.compare(pos, std::string::npos, "\r\n") == 0;
+    if (body.compare(pos + n, 2, "\r\n") != 0) return false;
+    out.append(body, pos, n);
+    pos += n + 2;
+    (*chunks)++;
+  }
+}
+
+void test_chunked_framing() {
+  ByteSink sock;
+  ChunkedSink<ByteSink> chunks(sock);
+  JsonWriter<ChunkedSink<ByteSink>, 64> w(chunks);
+  scheduleDoc(w);
+  w.flush();
+  TEST_ASSERT_TRUE(chunks.finish());
+  std::string body;
+  int n;
+  TEST_ASSERT_TRUE(dechunk(sock.out, body, &n));
+  TEST_ASSERT_EQUAL_STRING(toJson<256>(scheduleDoc).c_str(), body.c_str());
+  TEST_ASSERT_EQUAL((int)chunks.chunkCount(), n);
+  TEST_ASSERT_TRUE(n >= (int)(body.size() / 64));
+}
+
+// Old way: whole document in a string, then copied into the response
+static std::string scheduleByConcat() {
+  std::string s = "[";
+  char item[96];
+  for (int i = 0; i < 400; ++i) {
+    snprintf(item, sizeof(item), "%s{\"ch\":%d,\"hour\":%d,\"minute\":%d,\"on\":%s,\"enabled\":true,\"days\":127}",
+             i ? "," : "", 1 + i % 6, i % 24, i % 60, (i & 1) ? "true" : "false");
+    s += item;
+  }
+  s += "]";
+  return s;
+}
+
+void test_peak_heap_bounded_by_buffer() {
+  CountingSocket sock;
+  AllocGuard streamed;
+  {
+    ChunkedSink<CountingSocket> chunks(sock);
+    JsonWriter<ChunkedSink<CountingSocket>, 256> w(chunks);
+    scheduleDoc(w);
+    w.flush();
+    chunks.finish();
+  }
+  TEST_ASSERT_NO_ALLOC(streamed);
+  size_t streamedPeak = streamed.peakBytes();
+  TEST_ASSERT_EQUAL(0, (int)streamedPeak);
+
+  AllocGuard concat;
+  size_t payload;
+  {
+    std::string doc = scheduleByConcat();
+    std::string response = doc;   // sendResponse() printing a String copy
+    payload = doc.size();
+  }
+  TEST_ASSERT_TRUE(concat.peakBytes() >= payload);
+  TEST_ASSERT_EQUAL(0, (int)concat.retainedBytes());
+  TEST_ASSERT_EQUAL((int)toJson<256>(scheduleDoc).size(), (int)payload);
+
+  char msg[160];
+  snprintf(msg, sizeof(msg), "%u byte document: streamed peak heap %u B (%u allocs, 256 B stack buffer), "
+           "string build peak %u B", (unsigned)payload, (unsigned)streamedPeak, 0u,
+           (unsigned)concat.peakBytes());
+  TEST_MESSAGE(msg);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_document_shapes);
+  RUN_TEST(test_float_formatting);
+  RUN_TEST(test_chunked_framing);
+  RUN_TEST(test_peak_heap_bounded_by_buffer);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,122 @@
+// Host tests and check-in cost for the loop liveness monitor (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include "liveness_monitor.h"
+#include "loop_profiler.h"
+#include "watchdog_deadlines.h"
+#include "../common/alloc_guard.h"
+
+typedef LivenessMonitor<4> Monitor;
+
+void test_progress_is_not_a_stall() {
+  Monitor m;
+  m.setDeadline(1, 1000);
+  m.setIdleDeadline(500);
+  LivenessStall st;
+  // a loop checking in every 10 ms never trips
+  for (uint32_t t = 0; t < 20000; t += 10) {
+    m.enter(1);
+    m.leave();
+    TEST_ASSERT_FALSE(m.check(t, st));
+  }
+  TEST_ASSERT_EQUAL(4000, m.checkIns());
+}
+
+void test_stall_in_subsystem_names_it() {
+  Monitor m;
+  m.setDeadline(2, 1000);
+  m.setIdleDeadline(5000);
+  LivenessStall st;
+  TEST_ASSERT_FALSE(m.check(0, st));
+  m.enter(2);            // ...and never returns
+  for (uint32_t t = 100; t <= 1100; t += 100) TEST_ASSERT_FALSE(m.check(t, st));
+  TEST_ASSERT_EQUAL(2, st.slot);
+  TEST_ASSERT_TRUE(m.check(1200, st));
+  TEST_ASSERT_EQUAL(2, st.slot);
+  TEST_ASSERT_EQUAL(1100, st.stalledMs);
+  // it returns after all: the stall clears on the next poll
+  m.leave();
+  TEST_ASSERT_FALSE(m.check(1300, st));
+  TEST_ASSERT_EQUAL(Monitor::IDLE, st.slot);
+}
+
+void test_idle_and_unsupervised() {
+  Monitor m;
+  m.setIdleDeadline(500);
+  LivenessStall st;
+  m.check(0, st);
+  m.enter(3);
+  m.leave();
+  // stuck between subsystems
+  TEST_ASSERT_FALSE(m.check(400, st));
+  TEST_ASSERT_TRUE(m.check(1000, st));
+  TEST_ASSERT_EQUAL(Monitor::IDLE, st.slot);
+  // slot 0 has no deadline: never reported
+  m.enter(0);
+  TEST_ASSERT_FALSE(m.check(1000, st));
+  TEST_ASSERT_FALSE(m.check(60000, st));
+  TEST_ASSERT_EQUAL(0, st.slot);
+  TEST_ASSERT_EQUAL(59000, st.stalledMs);
+}
+
+void test_checkin_cost() {
+  Monitor m;
+  const int N = 1000000;
+  AllocGuard g;
+  uint32_t t0 = profTicks();
+  for (int i = 0; i < N; ++i) {
+    LivenessScope<Monitor> s(m, (uint8_t)(i & 3));
+  }
+  uint32_t elapsed = profTicks() - t0;
+  TEST_ASSERT_NO_ALLOC(g);
+  TEST_ASSERT_EQUAL(2 * N, m.checkIns());
+  double ns = (double)elapsed / N * 1000.0 / profTicksPerUs();
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%.2f ns per supervised call (enter + leave)", ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(ns < 100);
+}
+
+// The firmware's deadlines: a broker connect that runs into every timeout
+// must not trip MQTT's, the others keep the base one
+void test_mqtt_deadline_covers_a_connect() {
+  const uint32_t base = 8000;
+  LivenessMonitor<LOGM_COUNT> m;
+  watchdogSetDeadlines(m, base);
+  TEST_ASSERT_TRUE(m.deadlineOf(LOGM_MQTT) > MQTT_TCP_CONNECT_MS + MQTT_TLS_HANDSHAKE_S * 1000UL + base / 2);
+  TEST_ASSERT_TRUE(m.deadlineOf(LOGM_MQTT) > MQTT_SOCKET_TIMEOUT_S * 1000UL + base / 2);
+  for (uint8_t i = 0; i < LOGM_COUNT; ++i) {
+    if (i != LOGM_MQTT) TEST_ASSERT_EQUAL_UINT32(base, m.deadlineOf(i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(base, m.deadlineOf(LivenessMonitor<LOGM_COUNT>::IDLE));
+  // in MQTT for the whole of a failed connect: no stall
+  LivenessStall st;
+  m.enter(LOGM_MQTT);
+  TEST_ASSERT_FALSE(m.check(0, st));
+  TEST_ASSERT_FALSE(m.check(MQTT_BLOCK_MAX_MS + 100, st));
+  TEST_ASSERT_TRUE(m.check(m.deadlineOf(LOGM_MQTT) + 200, st));
+  TEST_ASSERT_EQUAL(LOGM_MQTT, st.slot);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_progress_is_not_a_stall);
+  RUN_TEST(test_stall_in_subsystem_names_it);
+  RUN_TEST(test_idle_and_unsupervised);
+  RUN_TEST(test_checkin_cost);
+  RUN_TEST(test_mqtt_deadline_covers_a_connect);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,196 @@
+// Host tests for the POSIX TZ rules and the local day map (pio test -e
+// native): parsing, offsets against the C library, and both DST transitions
+// run minute by minute the way the scheduler does: an event in the skipped
+// hour fires once, an event in the repeated hour does not fire twice.
+#include <unity.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "local_time.h"
+
+static const char *CET = "CET-1CEST,M3.5.0,M10.5.0/3";
+// 2024-03-31 and 2024-10-27, the last Sundays of March and October
+static const int32_t SPRING = 19813;
+static const int32_t AUTUMN = 20023;
+
+void test_parse() {
+  TzRule r;
+  TEST_ASSERT_TRUE(tzParse("UTC0", r));
+  TEST_ASSERT_FALSE(r.hasDst);
+  TEST_ASSERT_EQUAL(0, r.stdOffset);
+  TEST_ASSERT_TRUE(tzParse("<-03>3", r));
+  TEST_ASSERT_EQUAL(-3 * 3600, r.stdOffset);
+  TEST_ASSERT_TRUE(tzParse("<+0530>-5:30", r));
+  TEST_ASSERT_EQUAL(5 * 3600 + 1800, r.stdOffset);
+  TEST_ASSERT_TRUE(tzParse(CET, r));
+  TEST_ASSERT_TRUE(r.hasDst);
+  TEST_ASSERT_EQUAL(3600, r.stdOffset);
+  TEST_ASSERT_EQUAL(7200, r.dstOffset);
+  TEST_ASSERT_EQUAL('M', r.start.kind);
+  TEST_ASSERT_EQUAL(3, r.start.month);
+  TEST_ASSERT_EQUAL(5, r.start.week);
+  TEST_ASSERT_EQUAL(2 * 3600, r.start.timeSec);
+  TEST_ASSERT_EQUAL(3 * 3600, r.end.timeSec);
+  TEST_ASSERT_TRUE(tzParse("EST5EDT", r));              // US rule implied
+  TEST_ASSERT_EQUAL(2, r.start.week);
+  TEST_ASSERT_TRUE(tzParse("<-01>1<+00>,M3.5.0/0,M10.5.0/1", r));
+  TEST_ASSERT_FALSE(tzParse("", r));
+  TEST_ASSERT_FALSE(tzParse("CE-1", r));                // name too short
+  TEST_ASSERT_FALSE(tzParse("CET", r));                 // no offset
+  TEST_ASSERT_FALSE(tzParse("CET-1CEST,M13.5.0,M10.5.0", r));
+  TEST_ASSERT_FALSE(tzParse("CET-1CEST,M3.5.0", r));
+  TEST_ASSERT_FALSE(tzParse("CET-1 ", r));
+}
+
+// Offsets and local dates hour by hour over two years, against localtime_r
+void checkAgainstLibc(const char *tz) {
+  TzRule r;
+  TEST_ASSERT_TRUE(tzParse(tz, r));
+  setenv("TZ", tz, 1);
+  tzset();
+  for (int64_t t = 1704067200LL - 86400; t < 1704067200LL + 2 * 366 * 86400LL; t += 1800) {
+    time_t tt = (time_t)t;
+    struct tm lt;
+    localtime_r(&tt, &lt);
+    int32_t off = tzOffsetAt(r, t);
+    TEST_ASSERT_EQUAL((int32_t)lt.tm_gmtoff, off);
+    int32_t day = tzLocalDayOf(r, t);
+    TEST_ASSERT_EQUAL(tzDaysFromCivil(lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday), day);
+    TEST_ASSERT_EQUAL(lt.tm_wday, tzWeekday(day));
+  }
+}
+
+void test_offsets_match_libc() {
+  checkAgainstLibc("UTC0");
+  checkAgainstLibc(CET);
+  checkAgainstLibc("EST5EDT,M3.2.0,M11.1.0");
+  checkAgainstLibc("AEST-10AEDT,M10.1.0,M4.1.0/3");   // DST across the new year
+  checkAgainstLibc("<-03>3");
+  checkAgainstLibc("IST-2IDT,M3.4.4/26,M10.5.0");     // change past 24:00
+}
+
+void test_day_without_change() {
+  TzRule r;
+  tzParse(CET, r);
+  LocalDay d = tzLocalDay(r, SPRING - 1);               // Saturday
+  TEST_ASSERT_EQUAL(6, d.wday);
+  TEST_ASSERT_TRUE(d.changeUtc == LocalDay::NO_CHANGE);
+  // 06:00 CET is 05:00 UTC
+  TEST_ASSERT_TRUE(d.toUtc(6 * 60) == (int64_t)(SPRING - 1) * 86400 + 5 * 3600);
+  d = tzLocalDay(r, SPRING + 1);
+  TEST_ASSERT_TRUE(d.toUtc(6 * 60) == (int64_t)(SPRING + 1) * 86400 + 4 * 3600);
+}
+
+void test_spring_forward_map() {
+  TzRule r;
+  tzParse(CET, r);
+  LocalDay d = tzLocalDay(r, SPRING);
+  int64_t mid = (int64_t)SPRING * 86400;
+  TEST_ASSERT_EQUAL(0, d.wday);
+  TEST_ASSERT_TRUE(d.changeUtc == mid + 3600);          // 02:00 CET = 01:00 UTC
+  TEST_ASSERT_TRUE(d.toUtc(60 + 59) == mid + 59 * 60);  // 01:59 CET
+  // 02:00..02:59 do not exist: all at the change, which is 03:00 CEST
+  TEST_ASSERT_TRUE(d.toUtc(2 * 60) == mid + 3600);
+  TEST_ASSERT_TRUE(d.toUtc(2 * 60 + 30) == mid + 3600);
+  TEST_ASSERT_TRUE(d.toUtc(2 * 60 + 59) == mid + 3600);
+  TEST_ASSERT_TRUE(d.toUtc(3 * 60) == mid + 3600);
+  TEST_ASSERT_TRUE(d.toUtc(3 * 60 + 1) == mid + 3600 + 60);
+  TEST_ASSERT_TRUE(d.toUtc(6 * 60) == mid + 4 * 3600);
+}
+
+void test_fall_back_map() {
+  TzRule r;
+  tzParse(CET, r);
+  LocalDay d = tzLocalDay(r, AUTUMN);
+  int64_t mid = (int64_t)AUTUMN * 86400;
+  TEST_ASSERT_TRUE(d.changeUtc == mid + 3600);          // 03:00 CEST = 01:00 UTC
+  // 02:00..02:59 happen twice: the first (CEST) one
+  TEST_ASSERT_TRUE(d.toUtc(2 * 60) == mid);
+  TEST_ASSERT_TRUE(d.toUtc(2 * 60 + 30) == mid + 1800);
+  TEST_ASSERT_TRUE(d.toUtc(3 * 60) == mid + 2 * 3600);
+  TEST_ASSERT_TRUE(d.toUtc(6 * 60) == mid + 5 * 3600);
+}
+
+// The scheduler's loop over a local day: plan once, then fire every planned
+// UTC minute the clock passes, with a watermark
+static std::vector<int64_t> runDay(const TzRule &r, int32_t day, const std::vector<uint16_t> &times) {
+  LocalDay d = tzLocalDay(r, day);
+  std::vector<int64_t> plan;
+  for (size_t i = 0; i < times.size(); ++i) plan.push_back(d.toUtc(times[i]) / 60);
+  std::vector<int64_t> fired;
+  int64_t last = ((int64_t)day * 86400 - 4 * 3600) / 60;
+  int64_t end = last + 32 * 60;
+  for (int64_t now = last + 1; now < end; ++now) {
+    for (size_t i = 0; i < plan.size(); ++i)
+      if (plan[i] > last && plan[i] <= now) fired.push_back(times[i]);
+    last = now;
+  }
+  return fired;
+}
+
+void test_skipped_hour_fires_once() {
+  TzRule r;
+  tzParse(CET, r);
+  uint16_t t[] = { 1 * 60 + 59, 2 * 60, 2 * 60 + 30, 3 * 60, 3 * 60 + 30 };
+  std::vector<uint16_t> times(t, t + 5);
+  std::vector<int64_t> fired = runDay(r, SPRING, times);
+  TEST_ASSERT_EQUAL(5, (int)fired.size());
+  for (size_t i = 0; i < times.size(); ++i) TEST_ASSERT_EQUAL(times[i], fired[i]);
+}
+
+void test_repeated_hour_fires_once() {
+  TzRule r;
+  tzParse(CET, r);
+  uint16_t t[] = { 1 * 60 + 59, 2 * 60, 2 * 60 + 30, 2 * 60 + 59, 3 * 60, 6 * 60 };
+  std::vector<uint16_t> times(t, t + 6);
+  std::vector<int64_t> fired = runDay(r, AUTUMN, times);
+  TEST_ASSERT_EQUAL(6, (int)fired.size());
+  for (size_t i = 0; i < times.size(); ++i) TEST_ASSERT_EQUAL(times[i], fired[i]);
+}
+
+void test_every_minute_of_a_year_once() {
+  // every local minute of every day maps to one UTC instant inside the day,
+  // in order, for a zone on each hemisphere
+  const char *zones[] = { CET, "AEST-10AEDT,M10.1.0,M4.1.0/3" };
+  for (int z = 0; z < 2; ++z) {
+    TzRule r;
+    tzParse(zones[z], r);
+    int32_t first = tzDaysFromCivil(2024, 1, 1);
+    for (int32_t day = first; day < first + 366; ++day) {
+      LocalDay d = tzLocalDay(r, day);
+      int64_t prev = INT64_MIN;
+      for (uint16_t m = 0; m < 1440; ++m) {
+        int64_t u = d.toUtc(m);
+        TEST_ASSERT_TRUE(u >= prev);
+        TEST_ASSERT_EQUAL(day, tzLocalDayOf(r, u));
+        prev = u;
+      }
+    }
+  }
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse);
+  RUN_TEST(test_offsets_match_libc);
+  RUN_TEST(test_day_without_change);
+  RUN_TEST(test_spring_forward_map);
+  RUN_TEST(test_fall_back_map);
+  RUN_TEST(test_skipped_hour_fires_once);
+  RUN_TEST(test_repeated_hour_fires_once);
+  RUN_TEST(test_every_minute_of_a_year_once);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
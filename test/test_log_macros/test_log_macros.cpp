@@ -0,0 +1,117 @@
+// Host tests and benchmark for the leveled log macros (pio test -e native)
+#include <unity.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+// debug calls are compiled out in this test
+#define LOG_COMPILE_LEVEL LOG_INFO
+#include "log_macros.h"
+#include "../common/alloc_guard.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t benchNow() { return ESP.getCycleCount(); }
+static const char *BENCH_UNIT = "cycles";
+#else
+#include <chrono>
+static uint32_t benchNow() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static const char *BENCH_UNIT = "ns";
+#endif
+
+static char lastLine[128];
+static int emitted = 0;
+static int evaluated = 0;
+
+void logEmit(LogLevel level, LogModule module, const char *fmt, ...) {
+  int n = snprintf(lastLine, sizeof(lastLine), "%c %s: ", "-EWID"[level], logModuleName(module));
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(lastLine + n, sizeof(lastLine) - n, fmt, ap);
+  va_end(ap);
+  emitted++;
+}
+
+static int sideEffect() { return ++evaluated; }
+
+void test_emitted_call_is_formatted() {
+  emitted = 0;
+  logSetModuleLevel(LOGM_MQTT, LOG_INFO);
+  LOG_I(LOGM_MQTT, "broker %s:%d", "10.0.0.2", 1883);
+  TEST_ASSERT_EQUAL(1, emitted);
+  TEST_ASSERT_EQUAL_STRING("I mqtt: broker 10.0.0.2:1883", lastLine);
+  LOG_E(LOGM_SENSOR, "indoor DHT missing");
+  TEST_ASSERT_EQUAL_STRING("E sensor: indoor DHT missing", lastLine);
+}
+
+void test_suppressed_arguments_not_evaluated() {
+  emitted = 0;
+  evaluated = 0;
+  // runtime: module at warn drops info
+  logSetModuleLevel(LOGM_WEB, LOG_WARN);
+  AllocGuard g;
+  LOG_I(LOGM_WEB, "value %d", sideEffect());
+  TEST_ASSERT_EQUAL(0, evaluated);
+  LOG_W(LOGM_WEB, "value %d", sideEffect());
+  TEST_ASSERT_EQUAL(1, evaluated);
+  // formatting goes to a stack buffer
+  TEST_ASSERT_NO_ALLOC(g);
+  // compile time: debug is stripped even with the module at debug
+  logSetModuleLevel(LOGM_WEB, LOG_DEBUG);
+  LOG_D(LOGM_WEB, "value %d", sideEffect());
+  TEST_ASSERT_EQUAL(1, evaluated);
+  TEST_ASSERT_EQUAL(1, emitted);
+  // other modules keep their own level
+  TEST_ASSERT_EQUAL(LOG_INFO, logModuleLevel(LOGM_MAIN));
+  LogModule m;
+  TEST_ASSERT_TRUE(logModuleParse("thermostat", m));
+  TEST_ASSERT_EQUAL(LOGM_THERMOSTAT, m);
+  TEST_ASSERT_FALSE(logModuleParse("nope", m));
+}
+
+void test_benchmark_suppressed_vs_emitted() {
+  const int N = 200000;
+  volatile int sink = 0;
+  logSetModuleLevel(LOGM_MQTT, LOG_WARN);
+  uint32_t t0 = benchNow();
+  for (int i = 0; i < N; ++i) LOG_I(LOGM_MQTT, "sample %d %d", i, sink);
+  uint32_t suppressed = benchNow() - t0;
+  t0 = benchNow();
+  for (int i = 0; i < N; ++i) LOG_D(LOGM_MQTT, "sample %d %d", i, sink);
+  uint32_t stripped = benchNow() - t0;
+  logSetModuleLevel(LOGM_MQTT, LOG_INFO);
+  emitted = 0;
+  t0 = benchNow();
+  for (int i = 0; i < N / 10; ++i) LOG_I(LOGM_MQTT, "sample %d %d", i, sink);
+  uint32_t formatted = benchNow() - t0;
+  TEST_ASSERT_EQUAL(N / 10, emitted);
+  char msg[160];
+  snprintf(msg, sizeof(msg), "%s/call: runtime-suppressed %.2f, compiled-out %.2f, emitted (format only) %.1f",
+           BENCH_UNIT, (double)suppressed / N, (double)stripped / N, (double)formatted / (N / 10));
+  TEST_MESSAGE(msg);
+  // a suppressed call must be at least 10x cheaper than formatting
+  TEST_ASSERT_TRUE((double)suppressed / N * 10 < (double)formatted / (N / 10));
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_emitted_call_is_formatted);
+  RUN_TEST(test_suppressed_arguments_not_evaluated);
+  RUN_TEST(test_benchmark_suppressed_vs_emitted);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
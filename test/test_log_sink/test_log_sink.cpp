@@ -0,0 +1,118 @@
+// Host tests for log routing and flash staging (pio test -e native)
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "log_sink.h"
+#include "../common/alloc_guard.h"
+
+static std::string serialOut, flashOut;
+
+static void serialSink(LogLevel, const char *text, size_t len, bool eol) {
+  serialOut.append(text, len);
+  if (eol) serialOut += "\n";
+}
+
+static void flashSink(LogLevel, const char *text, size_t len, bool eol) {
+  flashOut += "[";
+  flashOut.append(text, len);
+  flashOut += eol ? "]\n" : "]";
+}
+
+struct StringWriter {
+  std::string out;
+  size_t write(const uint8_t *p, size_t n) {
+    out.append((const char *)p, n);
+    return n;
+  }
+};
+
+static void logStr(LogRouter<4, 16> &r, LogLevel l, const char *s, bool eol = true) {
+  r.write(l, s, strlen(s), eol);
+}
+
+void test_per_sink_levels() {
+  serialOut.clear();
+  flashOut.clear();
+  LogRouter<4, 16> r;
+  TEST_ASSERT_TRUE(r.add("serial", serialSink, LOG_DEBUG, false));
+  TEST_ASSERT_TRUE(r.add("flash", flashSink, LOG_WARN, true));
+  logStr(r, LOG_DEBUG, "dbg");
+  logStr(r, LOG_ERROR, "err");
+  TEST_ASSERT_EQUAL_STRING("dbg\nerr\n", serialOut.c_str());
+  TEST_ASSERT_EQUAL_STRING("[err]\n", flashOut.c_str());
+  TEST_ASSERT_EQUAL(1, r.sink(1).filtered);
+  TEST_ASSERT_TRUE(r.setLevel("serial", LOG_NONE));
+  TEST_ASSERT_FALSE(r.setLevel("sd", LOG_INFO));
+  TEST_ASSERT_FALSE(r.enabled(LOG_INFO));
+  TEST_ASSERT_TRUE(r.enabled(LOG_ERROR));
+  LogLevel l;
+  TEST_ASSERT_TRUE(logLevelParse("debug", l));
+  TEST_ASSERT_EQUAL(LOG_DEBUG, l);
+  TEST_ASSERT_FALSE(logLevelParse("verbose", l));
+}
+
+void test_fragments_join_into_lines() {
+  serialOut.clear();
+  flashOut.clear();
+  LogRouter<4, 16> r;
+  r.add("serial", serialSink, LOG_INFO, false);
+  r.add("flash", flashSink, LOG_INFO, true);
+  logStr(r, LOG_INFO, "Connecting", false);
+  logStr(r, LOG_INFO, ".", false);
+  logStr(r, LOG_INFO, ".", false);
+  logStr(r, LOG_INFO, " ok");
+  // serial shows progress immediately, line sinks get one joined line
+  TEST_ASSERT_EQUAL_STRING("Connecting.. ok\n", serialOut.c_str());
+  TEST_ASSERT_EQUAL_STRING("[Connecting.. ok]\n", flashOut.c_str());
+  // bounded: fragments past LineLen are cut, not grown
+  for (int i = 0; i < 10; ++i) logStr(r, LOG_INFO, "abcd", false);
+  flashOut.clear();
+  logStr(r, LOG_INFO, "end");
+  TEST_ASSERT_EQUAL(16 + 3, (int)flashOut.size());
+  TEST_ASSERT_TRUE(r.truncatedFragments() > 0);
+}
+
+void test_flush_buffer_batches_writes() {
+  LogFlushBuffer<64> b(30000);
+  StringWriter w;
+  TEST_ASSERT_FALSE(b.due(0));
+  TEST_ASSERT_TRUE(b.append("line one\n", 9, 1000, false));
+  TEST_ASSERT_FALSE(b.due(2000));
+  // old enough
+  TEST_ASSERT_TRUE(b.due(31000));
+  TEST_ASSERT_TRUE(b.flush(w));
+  TEST_ASSERT_EQUAL_STRING("line one\n", w.out.c_str());
+  // an error flushes right away
+  b.append("E: boom\n", 8, 40000, true);
+  TEST_ASSERT_TRUE(b.due(40000));
+  b.flush(w);
+  // nearly full; staging a line never allocates
+  AllocGuard g;
+  for (int i = 0; i < 6; ++i) b.append("0123456789", 10, 50000, false);
+  TEST_ASSERT_NO_ALLOC(g);
+  TEST_ASSERT_TRUE(b.due(50000));
+  TEST_ASSERT_FALSE(b.append("0123456789", 10, 50000, false));
+  TEST_ASSERT_EQUAL(1, b.droppedLines());
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_per_sink_levels);
+  RUN_TEST(test_fragments_join_into_lines);
+  RUN_TEST(test_flush_buffer_batches_writes);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,104 @@
+// Host tests and overhead benchmark for the loop profiler (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include "loop_profiler.h"
+#include "../common/alloc_guard.h"
+
+void test_bucket_edges() {
+  for (uint8_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+    uint32_t up = LatencyHistogram::bucketUpper(i);
+    TEST_ASSERT_EQUAL(i, LatencyHistogram::bucketOf(up));
+    if (i + 1 < LatencyHistogram::BUCKETS) TEST_ASSERT_EQUAL(i + 1, LatencyHistogram::bucketOf(up + 1));
+  }
+  TEST_ASSERT_EQUAL(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(UINT32_MAX));
+  // bucket width stays within 25% of its lower edge
+  TEST_ASSERT_EQUAL(LatencyHistogram::bucketOf(1000), LatencyHistogram::bucketOf(1023));
+  TEST_ASSERT_TRUE(LatencyHistogram::bucketOf(1024) != LatencyHistogram::bucketOf(1023));
+}
+
+void test_percentiles() {
+  LatencyHistogram h;
+  TEST_ASSERT_EQUAL(0, h.percentile(50));
+  for (uint32_t v = 1; v <= 10000; ++v) h.record(v);
+  h.record(2000000);   // one outlier
+  TEST_ASSERT_EQUAL(10001, h.count());
+  TEST_ASSERT_EQUAL(1, h.min());
+  TEST_ASSERT_EQUAL(2000000, h.max());
+  uint32_t p50 = h.percentile(50), p99 = h.percentile(99);
+  TEST_ASSERT_TRUE(p50 >= 5000 && p50 <= 5000 * 5 / 4);
+  TEST_ASSERT_TRUE(p99 >= 9900 && p99 <= 9900 * 5 / 4);
+  TEST_ASSERT_EQUAL(2000000, h.percentile(100));
+  h.reset();
+  TEST_ASSERT_EQUAL(0, h.count());
+  TEST_ASSERT_EQUAL(0, h.min());
+}
+
+void test_loop_period_and_sections() {
+  LoopProfiler<3> p;
+  uint32_t t = 1000;
+  for (int i = 0; i < 100; ++i) {
+    p.loopStart(t);
+    p.record(0, 200);
+    p.record(1, i == 50 ? 9000 : 300);
+    p.loopEnd(t + 600);
+    // every 10th loop starts late
+    t += i % 10 == 9 ? 15000 : 10000;
+  }
+  TEST_ASSERT_EQUAL(99, p.period().count());
+  TEST_ASSERT_EQUAL(100, p.busy().count());
+  TEST_ASSERT_EQUAL(10000, p.period().min());
+  TEST_ASSERT_EQUAL(15000, p.period().max());
+  TEST_ASSERT_EQUAL(9000, p.section(1).max());
+  // bucket upper edge: within 25% above the real value
+  TEST_ASSERT_TRUE(p.section(1).percentile(50) >= 300 && p.section(1).percentile(50) <= 375);
+  TEST_ASSERT_EQUAL(0, p.section(2).count());
+  // out of range sections are ignored
+  p.record(7, 1);
+  p.reset();
+  p.loopStart(0);
+  TEST_ASSERT_EQUAL(0, p.period().count());
+}
+
+void test_overhead_under_one_percent() {
+  LoopProfiler<10> p;
+  const int N = 100000;
+  volatile uint32_t sink = 0;
+  AllocGuard g;
+  uint32_t t0 = profTicks();
+  for (int i = 0; i < N; ++i) {
+    ProfScope<LoopProfiler<10> > s(p, (uint8_t)(i % 10));
+    sink += i;
+  }
+  uint32_t elapsed = profTicks() - t0;
+  TEST_ASSERT_NO_ALLOC(g);
+  TEST_ASSERT_EQUAL(N / 10, p.section(3).count());
+  double perScopeUs = (double)elapsed / N / profTicksPerUs();
+  // 10 scoped sections per loop against the 10 ms loop period
+  double pct = perScopeUs * 10 / 10000.0 * 100;
+  char msg[120];
+  snprintf(msg, sizeof(msg), "%.3f us per scoped section, %.4f%% of a 10 ms loop with 10 sections", perScopeUs, pct);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(pct < 1.0);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bucket_edges);
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_loop_period_and_sections);
+  RUN_TEST(test_overhead_under_one_percent);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
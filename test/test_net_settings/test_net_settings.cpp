@@ -0,0 +1,119 @@
+// Host tests for the site network settings behind `net_set` (pio test -e
+// native): parsing, validation and what a change needs re-applied.
+#include <unity.h>
+#include "net_settings.h"
+
+static NetSettings base() {
+  NetSettings s;
+  memset(&s, 0, sizeof(s));
+  netCopy(s.ssid[0], sizeof(s.ssid[0]), "casa");
+  netCopy(s.pass[0], sizeof(s.pass[0]), "secreto123");
+  s.staticIp = true;
+  netParseIPv4("192.168.1.50", s.ip);
+  netParseIPv4("192.168.1.1", s.gateway);
+  netParseIPv4("255.255.255.0", s.subnet);
+  netParseIPv4("8.8.8.8", s.dns);
+  netCopy(s.mqttServer, sizeof(s.mqttServer), "broker.local");
+  s.mqttPort = 8883;
+  netCopy(s.apPass, sizeof(s.apPass), "invernadero");
+  return s;
+}
+
+void test_parse_ipv4() {
+  uint8_t ip[4] = { 1, 2, 3, 4 };
+  TEST_ASSERT_TRUE(netParseIPv4("10.0.255.7", ip));
+  TEST_ASSERT_EQUAL(10, ip[0]);
+  TEST_ASSERT_EQUAL(255, ip[2]);
+  TEST_ASSERT_EQUAL(7, ip[3]);
+  static const char *bad[] = { "", "10.0.0", "10.0.0.1.", "10.0.0.256", "10..0.1", "a.b.c.d",
+                               "10.0.0.1 ", " 10.0.0.1", "1000.0.0.1", "10.0.0.-1" };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    TEST_ASSERT_FALSE(netParseIPv4(bad[i], ip));
+    TEST_ASSERT_EQUAL(10, ip[0]);   // untouched
+  }
+  uint8_t m[4];
+  netParseIPv4("255.255.255.0", m);
+  TEST_ASSERT_TRUE(netValidMask(m));
+  netParseIPv4("255.255.0.255", m);
+  TEST_ASSERT_FALSE(netValidMask(m));
+  netParseIPv4("0.0.0.0", m);
+  TEST_ASSERT_FALSE(netValidMask(m));
+  netParseIPv4("255.255.255.255", m);
+  TEST_ASSERT_TRUE(netValidMask(m));
+}
+
+void test_set_fields() {
+  NetSettings s = base();
+  TEST_ASSERT_NULL(netSettingsSet(s, NET_SSID2, "invernadero-norte"));
+  TEST_ASSERT_EQUAL_STRING("invernadero-norte", s.ssid[1]);
+  TEST_ASSERT_NULL(netSettingsSet(s, NET_PASS3, ""));              // open network
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_PASS, "corta"));
+  TEST_ASSERT_EQUAL_STRING("secreto123", s.pass[0]);
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_SSID, "123456789012345678901234567890123"));
+  TEST_ASSERT_NULL(netSettingsSet(s, NET_IP, "dhcp"));
+  TEST_ASSERT_FALSE(s.staticIp);
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_IP, "192.168.1"));
+  TEST_ASSERT_FALSE(s.staticIp);
+  TEST_ASSERT_NULL(netSettingsSet(s, NET_IP, "10.1.2.3"));
+  TEST_ASSERT_TRUE(s.staticIp);
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_SUBNET, "255.0.255.0"));
+  TEST_ASSERT_NULL(netSettingsSet(s, NET_MQTT_PORT, "1883"));
+  TEST_ASSERT_EQUAL(1883, s.mqttPort);
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_MQTT_PORT, "70000"));
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_MQTT_PORT, "18x"));
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_MQTT_PORT, ""));
+  TEST_ASSERT_EQUAL(1883, s.mqttPort);
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_MQTT_SERVER, ""));
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_AP_PASS, "1234567"));
+  TEST_ASSERT_NOT_NULL(netSettingsSet(s, NET_FIELD_COUNT, "x"));
+}
+
+void test_diff() {
+  NetSettings a = base();
+  NetSettings b = a;
+  TEST_ASSERT_EQUAL(0, netSettingsDiff(a, b));
+  // a shorter value leaves old bytes behind the terminator: still equal
+  netSettingsSet(b, NET_SSID, "casa-larga");
+  netSettingsSet(b, NET_SSID, "casa");
+  TEST_ASSERT_EQUAL(0, netSettingsDiff(a, b));
+  netSettingsSet(b, NET_DNS, "1.1.1.1");
+  TEST_ASSERT_EQUAL(NET_APPLY_WIFI, netSettingsDiff(a, b));
+  b = a;
+  netSettingsSet(b, NET_MQTT_USER, "gh");
+  TEST_ASSERT_EQUAL(NET_APPLY_MQTT, netSettingsDiff(a, b));
+  netSettingsSet(b, NET_AP_PASS, "otraclave");
+  TEST_ASSERT_EQUAL(NET_APPLY_MQTT | NET_APPLY_AP, netSettingsDiff(a, b));
+  b = a;
+  netSettingsSet(b, NET_IP, "dhcp");
+  TEST_ASSERT_EQUAL(NET_APPLY_WIFI, netSettingsDiff(a, b));
+}
+
+void test_field_names_match_enum() {
+  // NET_FIELD_NAMES is the command's choice list: one name per field, in order
+  size_t names = 1;
+  for (const char *p = NET_FIELD_NAMES; *p; ++p) names += *p == '|';
+  TEST_ASSERT_EQUAL(NET_FIELD_COUNT, names);
+  TEST_ASSERT_EQUAL(0, strncmp(NET_FIELD_NAMES + strlen(NET_FIELD_NAMES) - 7, "ap_pass", 7));
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_ipv4);
+  RUN_TEST(test_set_fields);
+  RUN_TEST(test_diff);
+  RUN_TEST(test_field_names_match_enum);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,391 @@
+// Host tests for compressed and delta OTA images (pio test -e native):
+// header checks, a pack made by tools/ota_pack.py, LZ and delta round trips
+// in odd splits into the flash writer, and malformed or mismatched packs.
+#include <unity.h>
+#include <vector>
+#include <string.h>
+#include "ota_pack.h"
+#include "flash_writer.h"
+#include "../common/alloc_guard.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct VecBase {
+  Bytes d;
+  bool read(uint32_t off, uint8_t *p, size_t n) {
+    if (off + n > d.size()) return false;
+    memcpy(p, &d[off], n);
+    return true;
+  }
+};
+
+// Output with a fixed capacity, so appending never allocates
+struct VecOut {
+  Bytes d;
+  size_t limit;
+  VecOut() : limit(SIZE_MAX) { d.reserve(1 << 16); }
+  bool write(const uint8_t *p, size_t n) {
+    if (d.size() + n > limit) return false;
+    d.insert(d.end(), p, p + n);
+    return true;
+  }
+};
+
+// Erase-before-write flash for the end-to-end test
+struct MemFlash {
+  Bytes mem;
+  explicit MemFlash(uint32_t size) : mem(size, 0) {}
+  uint32_t size() const { return (uint32_t)mem.size(); }
+  bool erase(uint32_t off, uint32_t len) { memset(&mem[off], 0xFF, len); return true; }
+  bool write(uint32_t off, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; ++i) mem[off + i] &= p[i];
+    return true;
+  }
+  bool read(uint32_t off, uint8_t *p, size_t n) { memcpy(p, &mem[off], n); return true; }
+};
+
+typedef OtaUnpacker<VecBase, VecOut> Unpacker;
+
+// tools/ota_pack.py delta, -w 8 -l 4, of toolNew() against toolOld()
+static const uint8_t TOOL_PACK[] = {
+  0x4f, 0x54, 0x41, 0x50, 0x01, 0x03, 0x08, 0x04, 0x6c, 0x02, 0x00, 0x00, 0x58, 0x02, 0x00, 0x00,
+  0x16, 0x6e, 0xa3, 0x67, 0xb4, 0xd3, 0x1f, 0x52, 0x7c, 0x4a, 0xba, 0x6f, 0x7a, 0x8b, 0xfb, 0x83,
+  0xe0, 0x0a, 0xfb, 0x51, 0xd3, 0xf1, 0x91, 0xb2, 0xf4, 0x8d, 0x8e, 0xad, 0xc0, 0x63, 0x2c, 0x1e,
+  0x80, 0x40, 0x60, 0x50, 0x1d, 0x5c, 0x0a, 0x2b, 0x02, 0x80, 0x00, 0x3c, 0x01, 0xe0, 0x0f, 0x00,
+  0x6c, 0x04, 0x21, 0xe0, 0x0f, 0x00, 0x15, 0x4b, 0x0d, 0xc2, 0xfa, 0xca, 0x42, 0x9e, 0x00, 0x61,
+  0xff, 0x80, 0x3c, 0x01, 0xe0, 0x0f, 0x1f, 0xf8, 0x03, 0xc0, 0x1e, 0x00, 0xf1, 0xff, 0x80, 0x3c,
+  0x01, 0x75, 0x5a, 0xa5, 0x5e, 0xad, 0x51, 0xa8, 0x54, 0xea, 0x55, 0xda, 0xe5, 0x7e, 0xbd, 0x59,
+  0xac, 0x56, 0xeb, 0x54, 0x5a, 0x25, 0x1e, 0x8d, 0xa3, 0xd5, 0xc0, 0x84, 0xde, 0x00, 0xf0, 0x07,
+  0x80, 0x3d, 0x07, 0xe0, 0x0f, 0x00, 0x78, 0x03, 0xc7, 0xfe, 0x00, 0xf0, 0x07, 0x80, 0x3c, 0x7f,
+  0xe0, 0x0f, 0x00, 0x78, 0x03, 0xc7, 0xfe, 0x00, 0xf0, 0x06, 0x00,
+};
+
+static Bytes toolOld() {
+  Bytes v(600);
+  for (size_t i = 0; i < v.size(); ++i) v[i] = (uint8_t)(i * i + i / 16);
+  return v;
+}
+
+// "hello" over 100..104, 20 bytes inserted at 300, every 64th byte + 1
+static Bytes toolNew() {
+  Bytes v = toolOld();
+  memcpy(&v[100], "hello", 5);
+  Bytes ins(20);
+  for (size_t i = 0; i < ins.size(); ++i) ins[i] = (uint8_t)(i ^ 0x55);
+  v.insert(v.begin() + 300, ins.begin(), ins.end());
+  for (size_t k = 0; k < v.size(); k += 64) v[k]++;
+  return v;
+}
+
+static uint32_t next(uint32_t &seed) {
+  seed = seed * 1103515245u + 12345u;
+  return seed >> 8;
+}
+
+// Firmware-like: most 32-byte blocks repeat one 300 bytes back with a change
+static Bytes image(size_t n, uint32_t seed) {
+  Bytes v(n);
+  for (size_t b = 0; b < n; b += 32) {
+    size_t end = b + 32 < n ? b + 32 : n;
+    bool repeat = b >= 300 && next(seed) % 4;
+    for (size_t i = b; i < end; ++i) v[i] = repeat ? v[i - 300] : (uint8_t)next(seed);
+    if (repeat) v[b + next(seed) % (end - b)] = (uint8_t)next(seed);
+  }
+  return v;
+}
+
+static Bytes header(uint8_t flags, uint8_t w, uint8_t l, uint32_t size, uint32_t baseSize) {
+  Bytes h(OTA_PACK_HEADER_SIZE, 0);
+  memcpy(&h[0], "OTAP", 4);
+  h[4] = OTA_PACK_VERSION;
+  h[5] = flags;
+  h[6] = w;
+  h[7] = l;
+  for (int i = 0; i < 4; ++i) {
+    h[8 + i] = (uint8_t)(size >> (8 * i));
+    h[12 + i] = (uint8_t)(baseSize >> (8 * i));
+  }
+  return h;
+}
+
+// Reference LZ encoder: greedy, longest match in the window
+struct Bits {
+  Bytes out;
+  uint32_t acc = 0;
+  int n = 0;
+  void put(uint32_t v, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+      acc = acc << 1 | (v >> i & 1);
+      if (++n == 8) {
+        out.push_back((uint8_t)acc);
+        acc = 0;
+        n = 0;
+      }
+    }
+  }
+  Bytes finish() {
+    if (n) out.push_back((uint8_t)(acc << (8 - n)));
+    return out;
+  }
+};
+
+static Bytes lz(const Bytes &in, int w, int l) {
+  Bits b;
+  size_t window = (size_t)1 << w, maxLen = (size_t)1 << l;
+  for (size_t i = 0; i < in.size();) {
+    size_t best = 0, dist = 0;
+    for (size_t d = 1; d <= window && d <= i; ++d) {
+      size_t k = 0;
+      while (k < maxLen && i + k < in.size() && in[i + k - d] == in[i + k]) k++;
+      if (k > best) {
+        best = k;
+        dist = d;
+      }
+    }
+    if (best >= 3) {
+      b.put(0, 1);
+      b.put((uint32_t)dist - 1, w);
+      b.put((uint32_t)best - 1, l);
+      i += best;
+    } else {
+      b.put(1, 1);
+      b.put(in[i++], 8);
+    }
+  }
+  return b.finish();
+}
+
+static void varint(Bytes &out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t)v);
+}
+
+// One delta operation producing newImg[n, n + diffLen + extraLen) from base at o
+static void op(Bytes &out, const Bytes &base, const Bytes &newImg, size_t n, size_t o,
+               uint32_t diffLen, uint32_t extraLen, int32_t seek) {
+  varint(out, diffLen);
+  varint(out, extraLen);
+  varint(out, seek >= 0 ? (uint32_t)seek << 1 : ((uint32_t)-seek << 1) - 1);
+  for (uint32_t i = 0; i < diffLen; ++i) out.push_back((uint8_t)(newImg[n + i] - base[o + i]));
+  out.insert(out.end(), newImg.begin() + n + diffLen, newImg.begin() + n + diffLen + extraLen);
+}
+
+// Feeds the body in splits of 1, 2, 5 ... bytes; false on the first refusal
+template <typename U>
+static bool feed(U &u, const uint8_t *p, size_t n) {
+  static const size_t splits[] = { 1, 2, 5, 64, 333, 7, 1460 };
+  for (size_t off = 0, i = 0; off < n; ++i) {
+    size_t k = splits[i % 7] < n - off ? splits[i % 7] : n - off;
+    if (!u.write(p + off, k)) return false;
+    off += k;
+  }
+  return true;
+}
+
+void test_header() {
+  OtaPackHeader h;
+  TEST_ASSERT_NULL(otaPackParseHeader(TOOL_PACK, 12, h));
+  TEST_ASSERT_EQUAL(OTA_PACK_LZ | OTA_PACK_DELTA, h.flags);
+  TEST_ASSERT_EQUAL(8, h.windowBits);
+  TEST_ASSERT_EQUAL(4, h.lookaheadBits);
+  TEST_ASSERT_EQUAL(620, h.imageSize);
+  TEST_ASSERT_EQUAL(600, h.baseSize);
+  Bytes old = toolOld();
+  uint8_t d[32];
+  Sha256 sha;
+  sha.update(old.data(), old.size());
+  sha.finish(d);
+  TEST_ASSERT_EQUAL_MEMORY(d, h.baseDigest, 32);
+
+  TEST_ASSERT_TRUE(otaPackIsPack(TOOL_PACK, 4));
+  TEST_ASSERT_FALSE(otaPackIsPack((const uint8_t *)"\xe9\x05\x02\x2f", 4));   // a plain firmware.bin
+  Bytes bad(TOOL_PACK, TOOL_PACK + OTA_PACK_HEADER_SIZE);
+  bad[4] = 2;
+  TEST_ASSERT_EQUAL_STRING("unknown pack version", otaPackParseHeader(bad.data(), 12, h));
+  TEST_ASSERT_NOT_NULL(otaPackParseHeader(header(4, 8, 4, 100, 0).data(), 12, h));
+  TEST_ASSERT_EQUAL_STRING("LZ window too large", otaPackParseHeader(header(OTA_PACK_LZ, 13, 4, 100, 0).data(), 12, h));
+  TEST_ASSERT_EQUAL_STRING("bad LZ lookahead", otaPackParseHeader(header(OTA_PACK_LZ, 8, 8, 100, 0).data(), 12, h));
+  TEST_ASSERT_NOT_NULL(otaPackParseHeader(header(OTA_PACK_DELTA, 0, 0, 100, 0).data(), 12, h));
+  TEST_ASSERT_NOT_NULL(otaPackParseHeader(header(OTA_PACK_LZ, 8, 4, 100, 50).data(), 12, h));
+  TEST_ASSERT_NOT_NULL(otaPackParseHeader(header(OTA_PACK_LZ, 8, 4, 0, 0).data(), 12, h));
+  // no LZ: window fields ignored
+  TEST_ASSERT_NULL(otaPackParseHeader(header(OTA_PACK_DELTA, 0, 0, 100, 50).data(), 12, h));
+}
+
+// The host tool and the board agree on the format
+void test_tool_pack() {
+  OtaPackHeader h;
+  TEST_ASSERT_NULL(otaPackParseHeader(TOOL_PACK, 12, h));
+  Bytes want = toolNew();
+  for (size_t split = 1; split <= sizeof(TOOL_PACK); split += 13) {
+    VecBase base;
+    base.d = toolOld();
+    VecOut out;
+    Unpacker u(base, out);
+    u.begin(h);
+    for (size_t off = OTA_PACK_HEADER_SIZE; off < sizeof(TOOL_PACK); off += split) {
+      size_t k = split < sizeof(TOOL_PACK) - off ? split : sizeof(TOOL_PACK) - off;
+      TEST_ASSERT_TRUE(u.write(TOOL_PACK + off, k));
+    }
+    TEST_ASSERT_TRUE(u.finish());
+    TEST_ASSERT_EQUAL(want.size(), out.d.size());
+    TEST_ASSERT_EQUAL_MEMORY(want.data(), out.d.data(), want.size());
+  }
+}
+
+// Compressed image -> unpacker -> flash writer, as src/ota.cpp chains them
+void test_lz_into_flash() {
+  static const int params[][2] = { { 8, 4 }, { 12, 6 }, { 4, 3 }, { 10, 9 } };
+  Bytes img = image(20000, 1);
+  uint8_t d[32];
+  Sha256 sha;
+  sha.update(img.data(), img.size());
+  sha.finish(d);
+  for (int i = 0; i < 4; ++i) {
+    Bytes body = lz(img, params[i][0], params[i][1]);
+    // the repeats are 300 bytes back: beyond a small window
+    if (params[i][0] >= 10) TEST_ASSERT_TRUE(body.size() < img.size() * 3 / 4);
+    OtaPackHeader h;
+    TEST_ASSERT_NULL(otaPackParseHeader(header(OTA_PACK_LZ, params[i][0], params[i][1], img.size(), 0).data(), 12, h));
+    MemFlash flash(64 * 1024);
+    FlashStreamWriter<MemFlash> writer(flash);
+    VecBase none;
+    OtaUnpacker<VecBase, FlashStreamWriter<MemFlash> > u(none, writer);
+    u.begin(h);
+    TEST_ASSERT_TRUE(writer.begin(h.imageSize, d));
+    {
+      AllocGuard g;
+      TEST_ASSERT_TRUE(feed(u, body.data(), body.size()));
+      TEST_ASSERT_TRUE(u.finish());
+      TEST_ASSERT_TRUE(writer.finish());
+      TEST_ASSERT_NO_ALLOC(g);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(img.data(), flash.mem.data(), img.size());
+  }
+  // bounded RAM: the window, a base buffer and a few counters
+  TEST_ASSERT_TRUE(sizeof(Unpacker) < 4096 + 512);
+}
+
+void test_delta() {
+  VecBase base;
+  base.d = image(30000, 2);
+  // new = base[0, 5000) with small changes + 100 new bytes + base[8000, 30000)
+  // + base[1000, 3000) again
+  Bytes img(base.d.begin(), base.d.begin() + 5000);
+  for (size_t k = 0; k < img.size(); k += 50) img[k] += 4;   // moved addresses
+  Bytes fresh = image(100, 3);
+  img.insert(img.end(), fresh.begin(), fresh.end());
+  img.insert(img.end(), base.d.begin() + 8000, base.d.end());
+  img.insert(img.end(), base.d.begin() + 1000, base.d.begin() + 3000);
+  Bytes ops;
+  op(ops, base.d, img, 0, 0, 5000, 100, 3000);            // to 8000
+  op(ops, base.d, img, 5100, 8000, 22000, 0, -29000);     // back to 1000
+  op(ops, base.d, img, 27100, 1000, 2000, 0, 0);
+  op(ops, base.d, img, 29100, 3000, 0, 0, 0);              // empty
+  for (int withLz = 0; withLz < 2; ++withLz) {
+    Bytes body = withLz ? lz(ops, 8, 4) : ops;
+    OtaPackHeader h;
+    uint8_t flags = OTA_PACK_DELTA | (withLz ? OTA_PACK_LZ : 0);
+    TEST_ASSERT_NULL(otaPackParseHeader(header(flags, 8, 4, img.size(), base.d.size()).data(), 12, h));
+    VecOut out;
+    Unpacker u(base, out);
+    u.begin(h);
+    TEST_ASSERT_TRUE(feed(u, body.data(), body.size()));
+    TEST_ASSERT_TRUE(u.finish());
+    TEST_ASSERT_EQUAL(img.size(), out.d.size());
+    TEST_ASSERT_EQUAL_MEMORY(img.data(), out.d.data(), img.size());
+  }
+  // compressed, the delta is a fraction of the image
+  TEST_ASSERT_TRUE(lz(ops, 12, 6).size() < img.size() / 8);
+}
+
+void test_errors() {
+  VecBase base;
+  base.d = image(1000, 4);
+  Bytes img(base.d.begin(), base.d.begin() + 500);
+  OtaPackHeader h;
+  TEST_ASSERT_NULL(otaPackParseHeader(header(OTA_PACK_DELTA, 0, 0, 500, 1000).data(), 12, h));
+  VecOut out;
+  Unpacker u(base, out);
+
+  // diff past the end of the base
+  Bytes ops;
+  varint(ops, 1200);
+  varint(ops, 0);
+  varint(ops, 0);
+  u.begin(h);
+  TEST_ASSERT_FALSE(feed(u, ops.data(), ops.size()));
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_BASE, u.error());
+  TEST_ASSERT_FALSE(u.write(img.data(), 1));               // stays failed
+
+  // seek before the start
+  ops.clear();
+  op(ops, base.d, img, 0, 0, 10, 0, -11);
+  u.begin(h);
+  TEST_ASSERT_FALSE(feed(u, ops.data(), ops.size()));
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_BASE, u.error());
+
+  // cut short: in the middle of an operation, or complete but too few bytes
+  ops.clear();
+  op(ops, base.d, img, 0, 0, 500, 0, 0);
+  u.begin(h);
+  TEST_ASSERT_TRUE(feed(u, ops.data(), ops.size() - 1));
+  TEST_ASSERT_FALSE(u.finish());
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_FORMAT, u.error());
+  ops.clear();
+  op(ops, base.d, img, 0, 0, 400, 0, 0);
+  u.begin(h);
+  TEST_ASSERT_TRUE(feed(u, ops.data(), ops.size()));
+  TEST_ASSERT_FALSE(u.finish());
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_SIZE, u.error());
+
+  // more bytes than announced
+  Bytes longer(base.d.begin(), base.d.begin() + 501);
+  ops.clear();
+  op(ops, base.d, longer, 0, 0, 501, 0, 0);
+  u.begin(h);
+  TEST_ASSERT_FALSE(feed(u, ops.data(), ops.size()));
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_SIZE, u.error());
+
+  // a varint longer than 32 bits
+  const uint8_t runaway[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+  u.begin(h);
+  TEST_ASSERT_FALSE(u.write(runaway, sizeof(runaway)));
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_FORMAT, u.error());
+
+  // the output refuses (flash error)
+  ops.clear();
+  op(ops, base.d, img, 0, 0, 500, 0, 0);
+  out.d.clear();
+  out.limit = 100;
+  u.begin(h);
+  TEST_ASSERT_FALSE(feed(u, ops.data(), ops.size()));
+  TEST_ASSERT_EQUAL(OTA_PACK_ERR_OUTPUT, u.error());
+  TEST_ASSERT_EQUAL_STRING("output", otaPackErrorName(u.error()));
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_header);
+  RUN_TEST(test_tool_pack);
+  RUN_TEST(test_lz_into_flash);
+  RUN_TEST(test_delta);
+  RUN_TEST(test_errors);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,118 @@
+// Host tests for the MQTT offline publish queue (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "publish_queue.h"
+
+typedef PublishQueue<4, 16, 32> Queue;
+
+// In-memory stand-in for the SPIFFS spill file
+struct MemFile {
+  uint8_t buf[512];
+  size_t len;
+  size_t pos;
+  MemFile() : len(0), pos(0) {}
+  size_t write(const uint8_t *p, size_t n) {
+    if (len + n > sizeof(buf)) n = sizeof(buf) - len;
+    memcpy(buf + len, p, n);
+    len += n;
+    return n;
+  }
+  size_t read(uint8_t *p, size_t n) {
+    if (pos + n > len) n = len - pos;
+    memcpy(p, buf + pos, n);
+    pos += n;
+    return n;
+  }
+};
+
+static bool pushStr(Queue &q, const char *topic, const char *payload, bool retain = false) {
+  return q.push(topic, payload, strlen(payload), retain);
+}
+
+void test_fifo_order_and_wrap() {
+  Queue q;
+  char p[8];
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      snprintf(p, sizeof(p), "m%d", round * 4 + i);
+      TEST_ASSERT_TRUE(pushStr(q, "relay", p));
+    }
+    TEST_ASSERT_TRUE(q.full());
+    TEST_ASSERT_FALSE(pushStr(q, "relay", "overflow"));
+    for (int i = 0; i < 4; ++i) {
+      snprintf(p, sizeof(p), "m%d", round * 4 + i);
+      TEST_ASSERT_EQUAL_STRING(p, q.front().payload);
+      q.pop();
+    }
+    TEST_ASSERT_TRUE(q.empty());
+  }
+}
+
+void test_rejects_oversized() {
+  Queue q;
+  TEST_ASSERT_FALSE(pushStr(q, "a_topic_that_is_too_long", "x"));
+  TEST_ASSERT_FALSE(pushStr(q, "t", "0123456789012345678901234567890123"));
+  TEST_ASSERT_TRUE(pushStr(q, "t", "01234567890123456789012345678901"));
+  TEST_ASSERT_EQUAL(1, q.size());
+}
+
+void test_spill_and_replay_roundtrip() {
+  Queue q;
+  MemFile f;
+  pushStr(q, "relay", "{\"ch\":1,\"on\":1}");
+  pushStr(q, "status", "{}", true);
+  // spill everything, then the queue keeps accepting newer messages
+  size_t bytes = 0;
+  for (size_t i = 0; i < q.size(); ++i) {
+    TEST_ASSERT_TRUE(q.at(i).write(f));
+    bytes += q.at(i).recordSize();
+  }
+  TEST_ASSERT_EQUAL(bytes, f.len);
+  q.clear();
+  pushStr(q, "relay", "newer");
+
+  Queue::Msg m;
+  TEST_ASSERT_TRUE(m.read(f));
+  TEST_ASSERT_EQUAL_STRING("relay", m.topic);
+  TEST_ASSERT_EQUAL_STRING("{\"ch\":1,\"on\":1}", m.payload);
+  TEST_ASSERT_FALSE(m.retain);
+  TEST_ASSERT_TRUE(m.read(f));
+  TEST_ASSERT_EQUAL_STRING("status", m.topic);
+  TEST_ASSERT_TRUE(m.retain);
+  TEST_ASSERT_FALSE(m.read(f)); // end of file
+  TEST_ASSERT_EQUAL_STRING("newer", q.front().payload);
+}
+
+void test_truncated_record_is_rejected() {
+  Queue q;
+  MemFile f;
+  pushStr(q, "relay", "payload");
+  q.front().write(f);
+  f.len -= 3; // power lost mid-append
+  Queue::Msg m;
+  TEST_ASSERT_FALSE(m.read(f));
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order_and_wrap);
+  RUN_TEST(test_rejects_oversized);
+  RUN_TEST(test_spill_and_replay_roundtrip);
+  RUN_TEST(test_truncated_record_is_rejected);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
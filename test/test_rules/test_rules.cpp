@@ -0,0 +1,189 @@
+// Host replay of sensor traces through the rule engine (run with `pio test -e native`)
+#include <unity.h>
+#include "rule_engine.h"
+
+typedef RuleSet<8, 16> Rules;
+
+struct Recorder {
+  int edges;
+  bool state[8];
+  void operator()(uint8_t ch, bool on) {
+    state[ch] = on;
+    edges++;
+  }
+};
+
+// evaluate() takes the callback by value; forward to the shared recorder
+struct Act {
+  Recorder *r;
+  void operator()(uint8_t ch, bool on) { (*r)(ch, on); }
+};
+
+static Recorder makeRecorder() {
+  Recorder r;
+  r.edges = 0;
+  for (int i = 0; i < 8; ++i) r.state[i] = false;
+  return r;
+}
+
+// Trace in the thermostat log format (/therm_log.csv):
+// epoch,tin,hin,tout,hout,heater -- one sample per minute
+static const char *TRACE =
+  "1760000000,22.0,70.0,20.0,60.0,0\n"
+  "1760000060,22.5,78.0,24.0,60.0,0\n"
+  "1760000120,23.0,82.0,25.5,61.0,0\n"   // both conditions true -> vent on
+  "1760000180,23.0,81.0,25.2,61.0,0\n"
+  "1760000240,23.0,79.8,24.8,61.0,0\n"   // within hysteresis -> stays on
+  "1760000300,23.0,79.0,24.0,61.0,0\n"   // below thr - hyst, but min-on not elapsed
+  "1760000360,23.0,79.0,24.0,61.0,0\n"
+  "1760000420,23.0,79.0,24.0,61.0,0\n"
+  "1760000480,23.0,79.0,24.0,61.0,0\n"
+  "1760000540,23.0,79.0,24.0,61.0,0\n"
+  "1760000600,23.0,79.0,24.0,61.0,0\n"
+  "1760000660,23.0,79.0,24.0,61.0,0\n"
+  "1760000720,23.0,79.0,24.0,61.0,0\n"   // 10 min after on -> off
+  "1760000780,nan,90.0,30.0,61.0,0\n";   // missing indoor temp doesn't matter here
+
+// Replay the CSV trace, evaluating once per sample
+static void replay(Rules &rules, Recorder &rec, uint32_t &now, const char *trace, int *onSamples) {
+  const char *p = trace;
+  int sample = 0;
+  while (*p) {
+    float in[RULE_VAR_COUNT];
+    unsigned long epoch = strtoul(p, (char **)&p, 10);
+    float *order[4] = { &in[RULE_VAR_TIN], &in[RULE_VAR_HIN], &in[RULE_VAR_TOUT], &in[RULE_VAR_HOUT] };
+    for (int i = 0; i < 4; ++i) { ++p; *order[i] = strtof(p, (char **)&p); }
+    while (*p && *p != '\n') ++p;
+    if (*p) ++p;
+    in[RULE_VAR_MINUTE] = (float)((epoch / 60) % 1440);
+    now = (uint32_t)(epoch - 1760000000UL) * 1000UL;
+    Act act = { &rec };
+    rules.evaluate(in, now, act);
+    if (onSamples) onSamples[sample] = rec.state[4];
+    sample++;
+  }
+}
+
+void test_compile_errors_keep_previous_rules() {
+  Rules r;
+  char err[48];
+  TEST_ASSERT_TRUE(r.compile("tout>25 & hin>80 -> ch4 10m h0.5", err, sizeof(err)));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(600, r.rule(0).minOnSec);
+  TEST_ASSERT_FALSE(r.compile("tout>25 -> ch4; bogus>1 -> ch2", err, sizeof(err)));
+  TEST_ASSERT_EQUAL_STRING("rule 2: unknown variable", err);
+  TEST_ASSERT_FALSE(r.compile("tout>25 -> ch9", err, sizeof(err)));
+  TEST_ASSERT_FALSE(r.compile("tout 25 -> ch4", err, sizeof(err)));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(2, r.rule(0).condCount);
+}
+
+void test_capacity_is_bounded() {
+  RuleSet<2, 3> r;
+  char err[48];
+  TEST_ASSERT_FALSE(r.compile("tin>1 -> ch1; tin>2 -> ch2; tin>3 -> ch3", err, sizeof(err)));
+  TEST_ASSERT_FALSE(r.compile("tin>1 & tin>2 -> ch1; tin>2 & hin>1 -> ch2", err, sizeof(err)));
+  TEST_ASSERT_TRUE(r.compile("tin>1 & tin>2 -> ch1; hin>1 -> ch2", err, sizeof(err)));
+}
+
+void test_trace_replay_vent_with_hysteresis_and_min_on() {
+  Rules rules;
+  char err[48];
+  TEST_ASSERT_TRUE(rules.compile("tout>25 & hin>80 -> ch4 10m h0.5", err, sizeof(err)));
+  uint32_t now = 0;
+  Recorder rec = makeRecorder();
+  int on[16];
+  replay(rules, rec, now, TRACE, on);
+  int expected[14] = { 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1 };
+  for (int i = 0; i < 14; ++i) TEST_ASSERT_EQUAL_MESSAGE(expected[i], on[i], "sample");
+  TEST_ASSERT_EQUAL(3, rec.edges);
+}
+
+void test_rules_sharing_a_channel_are_ored() {
+  Rules rules;
+  char err[48];
+  TEST_ASSERT_TRUE(rules.compile("tin>30 -> ch5\nhin>90 -> ch5", err, sizeof(err)));
+  uint32_t now = 0;
+  Recorder rec = makeRecorder();
+  Act act = { &rec };
+  float in[RULE_VAR_COUNT] = { 31, 50, 20, 50, 600 };
+  rules.evaluate(in, now, act);
+  TEST_ASSERT_TRUE(rec.state[5]);
+  in[RULE_VAR_HIN] = 95; in[RULE_VAR_TIN] = 20;
+  rules.evaluate(in, now += 1000, act);
+  TEST_ASSERT_TRUE(rec.state[5]);
+  TEST_ASSERT_EQUAL(1, rec.edges);
+  in[RULE_VAR_HIN] = 50;
+  rules.evaluate(in, now += 1000, act);
+  TEST_ASSERT_FALSE(rec.state[5]);
+}
+
+void test_time_window_and_recompile_releases_channel() {
+  Rules rules;
+  char err[48];
+  TEST_ASSERT_TRUE(rules.compile("min>=360 & min<1200 -> ch2", err, sizeof(err)));
+  uint32_t now = 0;
+  Recorder rec = makeRecorder();
+  Act act = { &rec };
+  float in[RULE_VAR_COUNT] = { NAN, NAN, NAN, NAN, 400 };
+  rules.evaluate(in, now, act);
+  TEST_ASSERT_TRUE(rec.state[2]);
+  // channel no longer driven by any rule -> switched off once
+  TEST_ASSERT_TRUE(rules.compile("tin>40 -> ch1", err, sizeof(err)));
+  rules.evaluate(in, now += 1000, act);
+  TEST_ASSERT_FALSE(rec.state[2]);
+  TEST_ASSERT_EQUAL(2, rec.edges);
+}
+
+void test_recompile_keeps_active_rules_and_min_on() {
+  Rules rules;
+  char err[48];
+  TEST_ASSERT_TRUE(rules.compile("tout>25 -> ch4 10m", err, sizeof(err)));
+  uint32_t now = 0;
+  Recorder rec = makeRecorder();
+  Act act = { &rec };
+  float in[RULE_VAR_COUNT] = { 20, 50, 30, 50, 600 };
+  rules.evaluate(in, now, act);
+  TEST_ASSERT_TRUE(rec.state[4]);
+  // same rule, another one added: still inside its minimum on-time
+  TEST_ASSERT_TRUE(rules.compile("tin>40 -> ch1; tout>25 -> ch4 10m", err, sizeof(err)));
+  in[RULE_VAR_TOUT] = 20;
+  rules.evaluate(in, now = 60000, act);
+  TEST_ASSERT_TRUE(rec.state[4]);
+  // rule edited: the old minimum on-time still holds the channel
+  TEST_ASSERT_TRUE(rules.compile("tout>28 -> ch4 1m", err, sizeof(err)));
+  rules.evaluate(in, now = 120000, act);
+  TEST_ASSERT_TRUE(rec.state[4]);
+  // rule removed: likewise, then off once the 10 minutes are up
+  TEST_ASSERT_TRUE(rules.compile("tin>40 -> ch1", err, sizeof(err)));
+  rules.evaluate(in, now = 599000, act);
+  TEST_ASSERT_TRUE(rec.state[4]);
+  TEST_ASSERT_EQUAL(1, rec.edges);
+  rules.evaluate(in, now = 600000, act);
+  TEST_ASSERT_FALSE(rec.state[4]);
+  TEST_ASSERT_EQUAL(2, rec.edges);
+}
+
+static int runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_compile_errors_keep_previous_rules);
+  RUN_TEST(test_capacity_is_bounded);
+  RUN_TEST(test_trace_replay_vent_with_hysteresis_and_min_on);
+  RUN_TEST(test_rules_sharing_a_channel_are_ored);
+  RUN_TEST(test_time_window_and_recompile_releases_channel);
+  RUN_TEST(test_recompile_keeps_active_rules_and_min_on);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  return runAllTests();
+}
+#endif
@@ -0,0 +1,161 @@
+// Host tests for delta-only MQTT telemetry (pio test -e native). The traffic
+// test replays a synthetic day of 2 s samples and compares broker traffic
+// against the previous scheme (a text status every 2 s).
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "telemetry_filter.h"
+
+typedef TelemetryFilter<4, 16> Filter;
+
+static const uint32_t HEARTBEAT_MS = 15UL * 60UL * 1000UL;
+
+void test_first_sample_and_deadband() {
+  Filter f;
+  int g = f.addGroup("sensor", HEARTBEAT_MS);
+  int t = f.addMetric(g, "inTemp", 0.2f, 1);
+  f.set(t, 21.0f);
+  TEST_ASSERT_TRUE(f.due(g, 0));
+  f.markSent(g, 0);
+  f.set(t, 21.1f);
+  TEST_ASSERT_FALSE(f.due(g, 2000));
+  f.set(t, 20.85f);
+  TEST_ASSERT_FALSE(f.due(g, 4000));
+  f.set(t, 21.3f);
+  TEST_ASSERT_TRUE(f.due(g, 6000));
+  f.markSent(g, 6000);
+  // drift is measured from the last sent value, not the last sample
+  f.set(t, 21.45f);
+  TEST_ASSERT_FALSE(f.due(g, 8000));
+  f.set(t, 21.55f);
+  TEST_ASSERT_TRUE(f.due(g, 10000));
+}
+
+void test_heartbeat_and_invalidate() {
+  Filter f;
+  int g = f.addGroup("relays", HEARTBEAT_MS);
+  int r = f.addMetric(g, "ch1", 0, 0);
+  f.set(r, 0);
+  f.markSent(g, 1000);
+  TEST_ASSERT_FALSE(f.due(g, 1000 + HEARTBEAT_MS - 1));
+  TEST_ASSERT_TRUE(f.due(g, 1000 + HEARTBEAT_MS));
+  f.markSent(g, 5000);
+  f.invalidate();
+  TEST_ASSERT_TRUE(f.due(g, 5001));
+  f.markSent(g, 5001);
+  // deadband 0: every change is sent
+  f.set(r, 1);
+  TEST_ASSERT_TRUE(f.due(g, 5002));
+}
+
+void test_missing_reading_transitions() {
+  Filter f;
+  int g = f.addGroup("sensor", HEARTBEAT_MS);
+  int t = f.addMetric(g, "outTemp", 0.2f, 1);
+  f.markSent(g, 0);  // sent as null
+  TEST_ASSERT_FALSE(f.due(g, 100));
+  f.set(t, 10.0f);
+  TEST_ASSERT_TRUE(f.due(g, 200));
+  f.markSent(g, 200);
+  f.set(t, NAN);
+  TEST_ASSERT_TRUE(f.due(g, 300));
+}
+
+void test_group_format() {
+  Filter f;
+  int s = f.addGroup("sensor", HEARTBEAT_MS);
+  int th = f.addGroup("thermostat", HEARTBEAT_MS);
+  int a = f.addMetric(s, "inTemp", 0.2f, 1);
+  f.addMetric(th, "setpoint", 0.05f, 1);
+  int b = f.addMetric(s, "inHum", 1.0f, 0);
+  f.set(a, 21.26f);
+  f.set(b, 64.6f);
+  char buf[64];
+  size_t n = f.format(s, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("{\"inTemp\":21.3,\"inHum\":65}", buf);
+  TEST_ASSERT_EQUAL(strlen(buf), n);
+  n = f.format(th, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_STRING("{\"setpoint\":null}", buf);
+  TEST_ASSERT_EQUAL(0, f.format(s, buf, 10));
+}
+
+// Deterministic noise in [-1, 1]
+static uint32_t rngState = 12345;
+static float noise() {
+  rngState = rngState * 1103515245UL + 12345UL;
+  return ((rngState >> 16) & 0x7FFF) / 16383.5f - 1.0f;
+}
+
+void test_traffic_reduction_over_a_day() {
+  Filter f;
+  int gs = f.addGroup("sensor", HEARTBEAT_MS);
+  int gr = f.addGroup("relays", HEARTBEAT_MS);
+  int tin = f.addMetric(gs, "inTemp", 0.2f, 1);
+  int hin = f.addMetric(gs, "inHum", 1.0f, 0);
+  int tout = f.addMetric(gs, "outTemp", 0.2f, 1);
+  int hout = f.addMetric(gs, "outHum", 1.0f, 0);
+  int ch[6];
+  char keys[6][4];
+  for (int i = 0; i < 6; ++i) {
+    snprintf(keys[i], sizeof(keys[i]), "ch%d", i + 1);
+    ch[i] = f.addMetric(gr, keys[i], 0, 0);
+  }
+  const char *topicBase = "greenhouse/A0B1C2D3E4F5/";
+  unsigned long newMsgs = 0, newBytes = 0, oldMsgs = 0, oldBytes = 0;
+  char buf[160];
+  for (uint32_t t = 0; t < 86400UL * 1000UL; t += 2000) {
+    float day = (float)t / 86400000.0f * 6.2831853f;
+    // DHT22: 0.1 C / 0.1 % resolution plus reading jitter
+    f.set(tin, roundf((22.0f + 4.0f * sinf(day) + 0.1f * noise()) * 10.0f) / 10.0f);
+    f.set(hin, roundf((70.0f - 10.0f * sinf(day) + 0.5f * noise()) * 10.0f) / 10.0f);
+    f.set(tout, roundf((15.0f + 8.0f * sinf(day) + 0.1f * noise()) * 10.0f) / 10.0f);
+    f.set(hout, roundf((60.0f - 20.0f * sinf(day) + 0.5f * noise()) * 10.0f) / 10.0f);
+    // lights 16 h, irrigation 4x per day, heater cycling every ~20 minutes
+    uint32_t sec = t / 1000;
+    f.set(ch[1], sec < 16UL * 3600UL ? 1 : 0);
+    f.set(ch[2], (sec % 21600UL) < 120 ? 1 : 0);
+    f.set(ch[0], (sec % 1200UL) < 300 ? 1 : 0);
+    for (size_t g = 0; g < f.groups(); ++g) {
+      if (!f.due((int)g, t)) continue;
+      size_t n = f.format((int)g, buf, sizeof(buf));
+      TEST_ASSERT_TRUE(n > 0);
+      newMsgs++;
+      newBytes += strlen(topicBase) + strlen(f.groupName((int)g)) + n;
+      f.markSent((int)g, t);
+    }
+    // previous firmware: "Hora: YYYY-MM-DD HH:MM:SS" to <base>/status every 2 s
+    oldMsgs++;
+    oldBytes += strlen(topicBase) + strlen("status") + strlen("Hora: 2026-03-02 12:00:00");
+  }
+  char msg[128];
+  snprintf(msg, sizeof(msg), "per day: old %lu msgs / %lu B, delta %lu msgs / %lu B",
+           oldMsgs, oldBytes, newMsgs, newBytes);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_TRUE(newMsgs * 10 <= oldMsgs);
+  TEST_ASSERT_TRUE(newBytes * 10 <= oldBytes);
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_sample_and_deadband);
+  RUN_TEST(test_heartbeat_and_invalidate);
+  RUN_TEST(test_missing_reading_transitions);
+  RUN_TEST(test_group_format);
+  RUN_TEST(test_traffic_reduction_over_a_day);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
@@ -0,0 +1,146 @@
+// Host tests and benchmark for the fixed-capacity history ring (pio test -e native)
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "time_series_ring.h"
+
+// In-memory file for save()/load()
+struct MemFile {
+  uint8_t buf[1024];
+  size_t len;
+  size_t pos;
+  MemFile() : len(0), pos(0) {}
+  size_t write(const uint8_t *p, size_t n) {
+    if (len + n > sizeof(buf)) n = sizeof(buf) - len;
+    memcpy(buf + len, p, n);
+    len += n;
+    return n;
+  }
+  size_t read(uint8_t *p, size_t n) {
+    if (pos + n > len) n = len - pos;
+    memcpy(p, buf + pos, n);
+    pos += n;
+    return n;
+  }
+};
+
+static const uint32_t MAGIC = 0x4C484931; // "LHI1"
+
+void test_day_seconds_packing() {
+  DaySeconds d = DaySeconds::make(2026, 364, 86400);
+  TEST_ASSERT_EQUAL(4, sizeof(DaySeconds));
+  TEST_ASSERT_EQUAL(2026, d.year());
+  TEST_ASSERT_EQUAL(364, d.yday());
+  TEST_ASSERT_EQUAL(86400, d.seconds());
+  // leap year last day and the following New Year's day
+  DaySeconds a = DaySeconds::make(2028, 365, 1);
+  DaySeconds b = DaySeconds::make(2029, 0, 2);
+  TEST_ASSERT_EQUAL(2028, a.year());
+  TEST_ASSERT_EQUAL(365, a.yday());
+  TEST_ASSERT_EQUAL(2029, b.year());
+  TEST_ASSERT_EQUAL(0, b.yday());
+  TEST_ASSERT_EQUAL(a.daysSince2000() + 1, b.daysSince2000());
+}
+
+void test_push_wraps_and_keeps_newest() {
+  TimeSeriesRing<DaySeconds, 4> r;
+  TEST_ASSERT_TRUE(r.empty());
+  for (int i = 0; i < 6; ++i) r.push(DaySeconds::make(2026, i, i * 10));
+  TEST_ASSERT_EQUAL(4, r.size());
+  TEST_ASSERT_EQUAL(2, r.at(0).yday());
+  TEST_ASSERT_EQUAL(5, r.newest().yday());
+  TEST_ASSERT_EQUAL(50, r.newest().seconds());
+}
+
+void test_save_load_roundtrip_after_wrap() {
+  TimeSeriesRing<DaySeconds, 5> r;
+  for (int i = 0; i < 7; ++i) r.push(DaySeconds::make(2026, 100 + i, 3600 * i));
+  MemFile f;
+  TEST_ASSERT_TRUE(r.save(f, MAGIC));
+  TEST_ASSERT_EQUAL(8 + 5 * 4, f.len);
+  TimeSeriesRing<DaySeconds, 5> back;
+  TEST_ASSERT_TRUE(back.load(f, MAGIC));
+  TEST_ASSERT_EQUAL(5, back.size());
+  for (size_t i = 0; i < 5; ++i) TEST_ASSERT_EQUAL(r.at(i).packed, back.at(i).packed);
+}
+
+void test_load_rejects_foreign_file_and_keeps_newest_when_shrinking() {
+  TimeSeriesRing<DaySeconds, 5> r;
+  for (int i = 0; i < 5; ++i) r.push(DaySeconds::make(2026, i, i));
+  MemFile f;
+  r.save(f, MAGIC);
+  TimeSeriesRing<DaySeconds, 5> other;
+  TEST_ASSERT_FALSE(other.load(f, MAGIC + 1));
+  TEST_ASSERT_TRUE(other.empty());
+  f.pos = 0;
+  TimeSeriesRing<DaySeconds, 3> small;
+  TEST_ASSERT_TRUE(small.load(f, MAGIC));
+  TEST_ASSERT_EQUAL(3, small.size());
+  TEST_ASSERT_EQUAL(2, small.at(0).yday());
+}
+
+#ifndef ARDUINO
+#include <chrono>
+#include <stdio.h>
+
+// Old automation.cpp approach: three parallel vectors trimmed with erase(begin())
+static void pushVectors(std::vector<unsigned long> &acc, std::vector<int> &year, std::vector<int> &yday,
+                        int y, int d, unsigned long s) {
+  year.push_back(y);
+  yday.push_back(d);
+  acc.push_back(s);
+  while (acc.size() > 120) {
+    acc.erase(acc.begin());
+    year.erase(year.begin());
+    yday.erase(yday.begin());
+  }
+}
+
+void test_bench_ring_vs_vectors() {
+  const int PUSHES = 200000;
+  // build records up front so only the push itself is measured
+  static DaySeconds days[365];
+  for (int d = 0; d < 365; ++d) days[d] = DaySeconds::make(2026, d, (uint32_t)d * 100);
+  std::vector<unsigned long> acc; std::vector<int> year, yday;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < PUSHES; ++i) pushVectors(acc, year, yday, 2026, i % 365, (unsigned long)(i % 365) * 100);
+  auto t1 = std::chrono::steady_clock::now();
+  TimeSeriesRing<DaySeconds, 120> ring;
+  for (int i = 0; i < PUSHES; ++i) ring.push(days[i % 365]);
+  auto t2 = std::chrono::steady_clock::now();
+  double vecNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / PUSHES;
+  double ringNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / PUSHES;
+  size_t vecBytes = acc.capacity() * sizeof(unsigned long) + (year.capacity() + yday.capacity()) * sizeof(int);
+  char msg[160];
+  snprintf(msg, sizeof(msg), "push: vectors %.1f ns/op, ring %.1f ns/op; storage: vectors %u B heap, ring %u B static",
+           vecNs, ringNs, (unsigned)vecBytes, (unsigned)sizeof(ring));
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL(acc.size(), ring.size());
+  TEST_ASSERT_EQUAL(acc.back(), ring.newest().seconds());
+}
+#endif
+
+static int runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_day_seconds_packing);
+  RUN_TEST(test_push_wraps_and_keeps_newest);
+  RUN_TEST(test_save_load_roundtrip_after_wrap);
+  RUN_TEST(test_load_rejects_foreign_file_and_keeps_newest_when_shrinking);
+#ifndef ARDUINO
+  RUN_TEST(test_bench_ring_vs_vectors);
+#endif
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  return runAllTests();
+}
+#endif
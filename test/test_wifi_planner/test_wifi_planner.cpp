@@ -0,0 +1,200 @@
+// Host tests for the Wi-Fi connection policy (pio test -e native): RSSI
+// ranking, per-attempt timeouts, backoff, reconnects and the fallback AP.
+#include <unity.h>
+#include "wifi_planner.h"
+#include "../common/alloc_guard.h"
+
+typedef WifiPlanner<3> Planner;
+
+static const WifiPlannerConfig CFG = {
+  15000,    // connectTimeoutMs
+  10000,    // scanTimeoutMs
+  2000,     // backoffMinMs
+  60000,    // backoffMaxMs
+  120000,   // fallbackAfterMs
+};
+
+static Planner makePlanner(const WifiPlannerConfig &cfg = CFG) {
+  Planner p(cfg);
+  p.addAp("casa");
+  p.addAp("invernadero");
+  p.addAp("oculta");
+  return p;
+}
+
+void test_candidates_by_rssi_then_hidden() {
+  Planner p = makePlanner();
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(0));   // not started
+  p.begin(0);
+  TEST_ASSERT_EQUAL(WIFI_ACT_SCAN, p.tick(0));
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(100)); // scan running
+  TEST_ASSERT_EQUAL(1, p.scanResult("invernadero", -75));
+  TEST_ASSERT_EQUAL(Planner::NONE, p.scanResult("vecino", -30));
+  TEST_ASSERT_EQUAL(0, p.scanResult("casa", -60));
+  TEST_ASSERT_EQUAL(1, p.scanResult("invernadero", -52));   // stronger BSS, same SSID
+  TEST_ASSERT_EQUAL(Planner::NONE, p.scanResult("invernadero", -80));
+  p.scanDone(2500);
+  TEST_ASSERT_EQUAL(-52, p.rssiInScan(1));
+  TEST_ASSERT_FALSE(p.seenInScan(2));
+
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(2500));
+  TEST_ASSERT_EQUAL(1, p.target());
+  p.linkDown(3000);                                    // refused
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(3000));
+  TEST_ASSERT_EQUAL(0, p.target());
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(17999));
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(18000));    // timed out
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(18000));
+  TEST_ASSERT_EQUAL(2, p.target());                    // hidden SSID last
+  p.linkUp(19000);
+  TEST_ASSERT_EQUAL(WIFI_CONNECTED, p.state());
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(20000));
+  TEST_ASSERT_EQUAL(1, p.stats().scans);
+  TEST_ASSERT_EQUAL(3, p.stats().attempts);
+  TEST_ASSERT_EQUAL(2, p.stats().failures);
+  TEST_ASSERT_EQUAL(1, p.stats().connects);
+}
+
+// Every candidate refuses, from the scan to the backoff
+static void failRound(Planner &p, uint32_t now) {
+  TEST_ASSERT_EQUAL(WIFI_ACT_SCAN, p.tick(now));
+  p.scanDone(now);
+  for (int i = 0; i < 3; ++i) {
+    TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(now));
+    p.linkDown(now);
+  }
+  TEST_ASSERT_EQUAL(WIFI_BACKOFF, p.state());
+}
+
+void test_backoff_grows_with_jitter_and_resets() {
+  WifiPlannerConfig cfg = CFG;
+  cfg.fallbackAfterMs = 0;   // no AP in the way of 8 rounds
+  Planner p = makePlanner(cfg);
+  p.seed(12345);
+  p.begin(0);
+  uint32_t now = 0;
+  uint32_t base = CFG.backoffMinMs;
+  for (int round = 0; round < 8; ++round) {
+    failRound(p, now);
+    uint32_t wait = p.retryInMs(now);
+    TEST_ASSERT_TRUE(wait >= base - base / 4 && wait <= base + base / 4);
+    TEST_ASSERT_EQUAL(WIFI_ACT_NONE, p.tick(now + wait - 1));
+    now += wait;
+    base = base * 2 > CFG.backoffMaxMs ? CFG.backoffMaxMs : base * 2;
+  }
+  TEST_ASSERT_EQUAL(CFG.backoffMaxMs, base);
+  // a link resets the backoff
+  TEST_ASSERT_EQUAL(WIFI_ACT_SCAN, p.tick(now));
+  p.scanDone(now);
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(now));
+  p.linkUp(now);
+  p.linkDown(now + 1000);
+  failRound(p, now + 1000);
+  TEST_ASSERT_TRUE(p.retryInMs(now + 1000) <= CFG.backoffMinMs + CFG.backoffMinMs / 4);
+}
+
+void test_dropped_link_rescans_at_once() {
+  Planner p = makePlanner();
+  p.begin(0);
+  TEST_ASSERT_EQUAL(WIFI_ACT_SCAN, p.tick(0));
+  p.scanResult("casa", -60);
+  p.scanDone(0);
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(0));
+  p.linkUp(1000);
+  TEST_ASSERT_EQUAL(60000, p.linkUpMs(61000));
+  p.linkDown(61000);
+  TEST_ASSERT_EQUAL(0, p.linkUpMs(61000));
+  TEST_ASSERT_EQUAL(WIFI_ACT_SCAN, p.tick(61000));
+  TEST_ASSERT_FALSE(p.seenInScan(0));          // last scan's sightings are gone
+  p.scanResult("casa", -58);
+  p.scanDone(62000);
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(62000));
+  p.linkUp(63000);
+  TEST_ASSERT_EQUAL(2, p.stats().connects);
+  TEST_ASSERT_EQUAL(1, p.stats().disconnects);
+  TEST_ASSERT_TRUE(p.connectedMs(73000) == 70000);
+}
+
+void test_fallback_ap() {
+  Planner p = makePlanner();
+  p.begin(0);
+  AllocGuard g;
+  uint32_t now = 0;
+  bool started = false;
+  // nothing answers for 3 minutes; the AP opens once, at 120 s
+  for (; now < 180000; now += 10) {
+    WifiAction a = p.tick(now);
+    if (a == WIFI_ACT_SCAN) p.scanDone(now);
+    if (a == WIFI_ACT_CONNECT) p.linkDown(now);
+    if (a == WIFI_ACT_START_AP) {
+      TEST_ASSERT_FALSE(started);
+      TEST_ASSERT_EQUAL(CFG.fallbackAfterMs, now);
+      started = true;
+    }
+  }
+  TEST_ASSERT_NO_ALLOC(g);
+  TEST_ASSERT_TRUE(started);
+  TEST_ASSERT_TRUE(p.apActive());
+  // the link comes back: the AP closes
+  while (p.tick(now) != WIFI_ACT_SCAN) now += 10;
+  p.scanDone(now);
+  TEST_ASSERT_EQUAL(WIFI_ACT_CONNECT, p.tick(now));
+  p.linkUp(now);
+  TEST_ASSERT_EQUAL(WIFI_ACT_STOP_AP, p.tick(now));
+  TEST_ASSERT_FALSE(p.apActive());
+
+  // no networks configured: only the AP
+  WifiPlannerConfig cfg = CFG;
+  Planner none(cfg);
+  none.begin(0);
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, none.tick(0));
+  TEST_ASSERT_EQUAL(WIFI_ACT_START_AP, none.tick(120000));
+  TEST_ASSERT_EQUAL(WIFI_ACT_NONE, none.tick(500000));
+
+  // fallback disabled
+  cfg.fallbackAfterMs = 0;
+  Planner noAp(cfg);
+  noAp.addAp("casa");
+  noAp.begin(0);
+  for (now = 0; now < 600000; now += 1000) {
+    WifiAction a = noAp.tick(now);
+    TEST_ASSERT_TRUE(a != WIFI_ACT_START_AP);
+    if (a == WIFI_ACT_SCAN) noAp.scanDone(now);
+  }
+}
+
+void test_add_ap_limits() {
+  Planner p(CFG);
+  TEST_ASSERT_EQUAL(Planner::NONE, p.addAp(""));
+  TEST_ASSERT_EQUAL(Planner::NONE, p.addAp("123456789012345678901234567890123"));   // 33 chars
+  TEST_ASSERT_EQUAL(0, p.addAp("12345678901234567890123456789012"));
+  TEST_ASSERT_EQUAL(1, p.addAp("b"));
+  TEST_ASSERT_EQUAL(2, p.addAp("c"));
+  TEST_ASSERT_EQUAL(Planner::NONE, p.addAp("d"));
+  TEST_ASSERT_EQUAL_STRING("b", p.ssid(1));
+  p.clearAps();
+  TEST_ASSERT_EQUAL(0, p.aps());
+}
+
+void runAllTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_candidates_by_rssi_then_hidden);
+  RUN_TEST(test_backoff_grows_with_jitter_and_resets);
+  RUN_TEST(test_dropped_link_rescans_at_once);
+  RUN_TEST(test_fallback_ap);
+  RUN_TEST(test_add_ap_limits);
+  UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);
+  runAllTests();
+}
+void loop() {}
+#else
+int main() {
+  runAllTests();
+  return 0;
+}
+#endif
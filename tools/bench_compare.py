@@ -0,0 +1,82 @@
+import argparse, json, sys
+
+# Compare two runs of the host benchmarks (bench/bench_main.cpp) and flag
+# regressions. Each input is the JSON-lines output of
+# `pio run -e native_bench -t exec`; build output lines are ignored.
+#
+# Usage:
+#   pio run -e native_bench -t exec | tee new.jsonl
+#   python bench_compare.py base.jsonl new.jsonl
+#   python bench_compare.py base.jsonl new.jsonl --time-pct 25 --alloc-pct 0
+#
+# Exit status is 1 when a benchmark got slower than --time-pct, allocates
+# more (count or bytes) than --alloc-pct or is missing from the new run, so it
+# can gate CI. Allocation figures are deterministic; time varies between hosts
+# and runs, hence the looser default.
+
+METRICS = [('ns_per_op', 'ns/op'), ('allocs_per_op', 'allocs/op'), ('bytes_per_op', 'bytes/op')]
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith('{'):
+                continue
+            try:
+                r = json.loads(line)
+            except ValueError:
+                continue
+            if 'bench' in r:
+                results[r['bench']] = r
+    return results
+
+
+def change_pct(old, new):
+    if old == 0:
+        return 0.0 if new == 0 else float('inf')
+    return (new - old) * 100.0 / old
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Compare two host benchmark runs')
+    ap.add_argument('base', help='JSON lines of the reference run')
+    ap.add_argument('new', help='JSON lines of the run to check')
+    ap.add_argument('--time-pct', type=float, default=20.0,
+                    help='allowed ns/op increase in percent (default 20)')
+    ap.add_argument('--alloc-pct', type=float, default=0.0,
+                    help='allowed allocs/op and bytes/op increase in percent (default 0)')
+    args = ap.parse_args()
+
+    base, new = load(args.base), load(args.new)
+    if not base or not new:
+        sys.exit('no benchmark results in %s' % (args.base if not base else args.new))
+
+    regressions = 0
+    print('%-26s %-10s %12s %12s %9s' % ('bench', 'metric', 'base', 'new', 'change'))
+    for name in sorted(set(base) | set(new)):
+        if name not in new:
+            # a benchmark that crashed or was dropped must not pass silently
+            regressions += 1
+            print('%-26s missing from new  REGRESSION' % name)
+            continue
+        if name not in base:
+            print('%-26s only in new' % name)
+            continue
+        for key, label in METRICS:
+            old_v, new_v = base[name].get(key, 0), new[name].get(key, 0)
+            pct = change_pct(old_v, new_v)
+            limit = args.time_pct if key == 'ns_per_op' else args.alloc_pct
+            # allocation counts are exact; ignore float noise below 0.01 per op
+            worse = pct > limit and (key == 'ns_per_op' or new_v - old_v >= 0.01)
+            regressions += worse
+            print('%-26s %-10s %12.2f %12.2f %8.1f%%%s' % (name, label, old_v, new_v, pct,
+                                                         '  REGRESSION' if worse else ''))
+    if regressions:
+        print('%d regression(s)' % regressions)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,65 @@
+import argparse, subprocess, sys, time
+
+# Measure MQTT traffic produced by the board on a local broker, per topic.
+# Uses mosquitto_sub (mosquitto-clients package), no Python MQTT library needed.
+#
+# Usage:
+#   python mqtt_traffic.py --host 192.168.1.10 --duration 3600
+#   python mqtt_traffic.py --host localhost --topic 'greenhouse/A0B1C2D3E4F5/#'
+#
+# Retained messages delivered on subscribe are skipped (only live traffic is counted).
+
+
+def summary(stats, elapsed):
+    total_msgs = sum(s[0] for s in stats.values())
+    total_bytes = sum(s[1] for s in stats.values())
+    hours = max(elapsed, 1e-9) / 3600.0
+    print(f'--- {elapsed:.0f} s ---')
+    for topic in sorted(stats):
+        msgs, nbytes = stats[topic]
+        print(f'{topic:50s} {msgs:7d} msgs {nbytes:9d} B  {msgs / hours:8.1f} msgs/h')
+    print(f'{"total":50s} {total_msgs:7d} msgs {total_bytes:9d} B  {total_msgs / hours:8.1f} msgs/h '
+          f'{total_bytes / hours:10.0f} B/h')
+    sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Count MQTT messages/bytes per topic')
+    parser.add_argument('--host', default='localhost')
+    parser.add_argument('--port', type=int, default=1883)
+    parser.add_argument('--topic', default='greenhouse/#')
+    parser.add_argument('--duration', type=float, default=0, help='seconds to run (0 = until Ctrl-C)')
+    parser.add_argument('--every', type=float, default=60, help='print a summary every N seconds')
+    args = parser.parse_args()
+
+    # -R: do not print stale (retained) messages; %l is the payload length
+    cmd = ['mosquitto_sub', '-h', args.host, '-p', str(args.port), '-t', args.topic,
+           '-R', '-F', '%t %l']
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True)
+    stats = {}
+    start = last = time.time()
+    try:
+        for line in proc.stdout:
+            parts = line.rsplit(' ', 1)
+            if len(parts) != 2:
+                continue
+            topic, length = parts[0], int(parts[1])
+            s = stats.setdefault(topic, [0, 0])
+            s[0] += 1
+            # bytes on the wire are dominated by topic + payload
+            s[1] += len(topic) + length
+            now = time.time()
+            if now - last >= args.every:
+                last = now
+                summary(stats, now - start)
+            if args.duration and now - start >= args.duration:
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        proc.terminate()
+    summary(stats, time.time() - start)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,294 @@
+import argparse, hashlib, struct, sys
+
+# Make compressed and delta OTA images ("packs") for POST /ota, unpacked on
+# the board as they stream in (include/ota_pack.h, src/ota.cpp).
+#
+# Usage:
+#   python ota_pack.py lz .pio/build/esp32s3usbotg/firmware.bin -o fw.otap
+#   python ota_pack.py delta running.bin .pio/build/esp32s3usbotg/firmware.bin -o fw.otap
+#   python ota_pack.py lz .pio/build/esp32s3usbotg/spiffs.bin -o fs.otap
+#
+# A delta applies to one exact image: `running.bin` must be the firmware.bin
+# the board runs now (keep the firmware.bin of each release). The board checks
+# the base hash before it writes anything. Prints the sizes, the compression
+# ratio, and the curl command with the sha256 of the unpacked image, which is
+# what /ota checks. Every pack is unpacked again here and compared before it
+# is written.
+
+MAGIC = b'OTAP'
+VERSION = 1
+FLAG_LZ, FLAG_DELTA = 1, 2
+HEADER = struct.Struct('<4sBBBBII32s')
+MIN_MATCH = 3          # a backref of 1+W+L bits beats two 9-bit literals from here
+MAX_CHAIN = 24         # candidates tried per position
+SEED = 8               # delta: bytes that must match to align with the base
+SEED_STRIDE = 4        # delta: base positions indexed
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def put(self, value, count):
+        self.acc = self.acc << count | value
+        self.bits += count
+        while self.bits >= 8:
+            self.bits -= 8
+            self.out.append(self.acc >> self.bits & 0xFF)
+        self.acc &= (1 << self.bits) - 1
+
+    def finish(self):
+        if self.bits:
+            self.out.append(self.acc << (8 - self.bits) & 0xFF)
+        return bytes(self.out)
+
+
+def lz_compress(data, wbits, lbits):
+    """heatshrink bit format, greedy matching over hash chains of 3 bytes"""
+    window, max_len = 1 << wbits, 1 << lbits
+    w = BitWriter()
+    chains = {}
+    n = len(data)
+    i = 0
+
+    def insert(pos):
+        chains.setdefault(data[pos:pos + MIN_MATCH], []).append(pos)
+
+    while i < n:
+        best_len, best_pos = 0, 0
+        limit = min(max_len, n - i)
+        if limit >= MIN_MATCH:
+            cands = chains.get(data[i:i + MIN_MATCH], ())
+            tried = 0
+            for c in reversed(cands):
+                if i - c > window or tried == MAX_CHAIN:
+                    break
+                tried += 1
+                # longest common prefix up to `limit`, by halving
+                lo, hi = MIN_MATCH, limit
+                if data[c:c + hi] != data[i:i + hi]:
+                    while lo < hi:
+                        mid = (lo + hi + 1) // 2
+                        if data[c:c + mid] == data[i:i + mid]:
+                            lo = mid
+                        else:
+                            hi = mid - 1
+                if hi > best_len:
+                    best_len, best_pos = hi, c
+                    if hi == limit:
+                        break
+        if best_len >= MIN_MATCH:
+            w.put(0, 1)
+            w.put(i - best_pos - 1, wbits)
+            w.put(best_len - 1, lbits)
+            for p in range(i, i + best_len):
+                insert(p)
+            i += best_len
+        else:
+            w.put(1, 1)
+            w.put(data[i], 8)
+            insert(i)
+            i += 1
+    return w.finish()
+
+
+def lz_decompress(body, wbits, lbits):
+    out = bytearray()
+    acc = bits = 0
+    field, index = 'tag', 0
+    need = {'tag': 1, 'lit': 8, 'idx': wbits, 'cnt': lbits}
+    for b in body:
+        acc = acc << 8 | b
+        bits += 8
+        while bits >= need[field]:
+            bits -= need[field]
+            v = acc >> bits & ((1 << need[field]) - 1)
+            acc &= (1 << bits) - 1
+            if field == 'tag':
+                field = 'lit' if v else 'idx'
+            elif field == 'lit':
+                out.append(v)
+                field = 'tag'
+            elif field == 'idx':
+                index, field = v + 1, 'cnt'
+            else:
+                for _ in range(v + 1):
+                    out.append(out[-index] if index <= len(out) else 0)
+                field = 'tag'
+    return bytes(out)
+
+
+def varint(v, out):
+    while v >= 0x80:
+        out.append(v & 0x7F | 0x80)
+        v >>= 7
+    out.append(v)
+
+
+def zigzag(v):
+    return v << 1 if v >= 0 else (-v << 1) - 1
+
+
+def extend(old, new, o, n):
+    """bsdiff's forward extension: the length that maximises matches*2 - length"""
+    score, best, length, i = 0, 0, 0, 0
+    while n + i < len(new) and o + i < len(old):
+        # whole runs of equal bytes at once
+        if new[n + i:n + i + 64] == old[o + i:o + i + 64] and n + i + 64 <= len(new) and o + i + 64 <= len(old):
+            score += 64
+            i += 64
+        else:
+            score += new[n + i] == old[o + i]
+            i += 1
+        if score * 2 - i > best:
+            best, length = score * 2 - i, i
+        elif i - length > 256:
+            break
+    return length
+
+
+def delta_encode(old, new):
+    """bsdiff-style operations, see include/ota_pack.h"""
+    index = {}
+    for p in range(0, len(old) - SEED + 1, SEED_STRIDE):
+        index.setdefault(old[p:p + SEED], p)
+    regions = []            # (new start, old start, length), in order
+    done = 0                # new bytes covered by a region or left as extra
+    shift = 0               # old - new of the last region: tried first
+    n = 0
+    while n + SEED <= len(new):
+        key = new[n:n + SEED]
+        o = n + shift
+        if not (0 <= o <= len(old) - SEED and old[o:o + SEED] == key):
+            o = index.get(key)
+            if o is None:
+                n += 1
+                continue
+        while n > done and o > 0 and new[n - 1] == old[o - 1]:
+            n -= 1
+            o -= 1
+        length = extend(old, new, o, n)
+        regions.append((n, o, length))
+        shift = o - n
+        n = done = n + length
+    out = bytearray()
+    pos_old = 0
+    pos_new = 0
+    # a leading op with no diff for the extra bytes before the first region
+    regions.insert(0, (0, 0, 0))
+    regions.append((len(new), 0, 0))
+    for k in range(len(regions) - 1):
+        n0, o0, length = regions[k]
+        n1, o1, _ = regions[k + 1]
+        assert n0 == pos_new and o0 == pos_old
+        diff = bytes((new[n0 + i] - old[o0 + i]) & 0xFF for i in range(length))
+        extra = new[n0 + length:n1]
+        seek = (o1 if k + 1 < len(regions) - 1 else o0 + length) - (o0 + length)
+        varint(length, out)
+        varint(len(extra), out)
+        varint(zigzag(seek), out)
+        out += diff
+        out += extra
+        pos_new = n1
+        pos_old = o0 + length + seek
+    return bytes(out)
+
+
+def delta_apply(old, ops):
+    out = bytearray()
+    pos, i = 0, 0
+
+    def read_varint():
+        nonlocal i
+        v = shift = 0
+        while True:
+            b = ops[i]
+            i += 1
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    while i < len(ops):
+        diff_len, extra_len, seek = read_varint(), read_varint(), read_varint()
+        seek = (seek >> 1) ^ -(seek & 1)
+        out += bytes((old[pos + k] + ops[i + k]) & 0xFF for k in range(diff_len))
+        i += diff_len
+        out += ops[i:i + extra_len]
+        i += extra_len
+        pos += diff_len + seek
+    return bytes(out)
+
+
+def pack(new, old, wbits, lbits, use_lz):
+    flags = (FLAG_LZ if use_lz else 0) | (FLAG_DELTA if old is not None else 0)
+    body = delta_encode(old, new) if old is not None else new
+    if use_lz:
+        body = lz_compress(body, wbits, lbits)
+    base_digest = hashlib.sha256(old).digest() if old is not None else bytes(32)
+    header = HEADER.pack(MAGIC, VERSION, flags, wbits if use_lz else 0, lbits if use_lz else 0,
+                         len(new), len(old) if old is not None else 0, base_digest)
+    return header + body
+
+
+def unpack(data, old):
+    magic, version, flags, wbits, lbits, _, _, _ = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        return None
+    body = data[HEADER.size:]
+    if flags & FLAG_LZ:
+        body = lz_decompress(body, wbits, lbits)
+    if flags & FLAG_DELTA:
+        return delta_apply(old, body)
+    return body
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Make compressed or delta OTA images')
+    sub = ap.add_subparsers(dest='mode')
+    lz = sub.add_parser('lz', help='compress an image')
+    lz.add_argument('image', help='firmware.bin or spiffs.bin')
+    dl = sub.add_parser('delta', help='delta against the image the board runs')
+    dl.add_argument('base', help='firmware.bin the board runs now')
+    dl.add_argument('image', help='new firmware.bin')
+    dl.add_argument('--no-lz', action='store_true', help='leave the delta uncompressed')
+    for p in (lz, dl):
+        p.add_argument('-o', '--output', required=True, help='pack to write')
+        p.add_argument('-w', '--window', type=int, default=12,
+                       help='LZ window bits, 2^W bytes of RAM on the board (4..12, default 12)')
+        p.add_argument('-l', '--lookahead', type=int, default=6,
+                       help='LZ lookahead bits, longest match 2^L (3..W-1, default 6)')
+        p.add_argument('--url', default='http://<ip>', help='board address for the printed command')
+    args = ap.parse_args()
+    if not args.mode:
+        ap.error('lz or delta')
+    if not 4 <= args.window <= 12 or not 3 <= args.lookahead < args.window:
+        ap.error('window 4..12 bits, lookahead 3..window-1')
+
+    with open(args.image, 'rb') as f:
+        new = f.read()
+    old = None
+    if args.mode == 'delta':
+        with open(args.base, 'rb') as f:
+            old = f.read()
+    data = pack(new, old, args.window, args.lookahead, not getattr(args, 'no_lz', False))
+    if unpack(data, old) != new:
+        sys.exit('internal error: the pack does not unpack to %s' % args.image)
+    with open(args.output, 'wb') as f:
+        f.write(data)
+
+    ratio = len(data) * 100.0 / len(new)
+    print('%s: %d bytes' % (args.image, len(new)))
+    if old is not None:
+        print('base %s: %d bytes, sha256 %s' % (args.base, len(old), hashlib.sha256(old).hexdigest()))
+    print('%s: %d bytes, %.1f%% of the image (%.1fx smaller)' % (args.output, len(data), ratio,
+                                                             len(new) / float(len(data))))
+    kind = 'fs' if 'spiffs' in args.image else 'app'
+    print('curl --data-binary @%s "%s/ota?type=%s&sha256=%s&token=<OTA_TOKEN>"' % (
+        args.output, args.url, kind, hashlib.sha256(new).hexdigest()))
+
+
+if __name__ == '__main__':
+    main()
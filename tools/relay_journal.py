@@ -0,0 +1,149 @@
+import argparse, struct, sys, datetime, urllib.request
+
+# Replay the relay actuation journal written by src/relay_journal.cpp and
+# reconstruct per-channel on/off timelines.
+#
+# Usage:
+#   python relay_journal.py --url http://192.168.1.50/journal
+#   python relay_journal.py relay_journal.old relay_journal.bin --channel 1
+#   python relay_journal.py journal.bin --at "2026-03-02 03:00"
+
+RECORD = struct.Struct('<IIBBBB')  # epoch, ms, ch, on, source, reason
+
+SOURCES = ['unknown', 'boot', 'relays', 'scheduler', 'thermostat', 'automation',
+           'http', 'serial', 'mqtt', 'rules']
+REASONS = ['none', 'manual', 'schedule', 'setpoint', 'ext_limit', 'overtemp',
+           'max_runtime', 'lights_min', 'daily_light', 'irrigation', 'rule']
+
+
+def name(table, idx):
+    return table[idx] if idx < len(table) else str(idx)
+
+
+def parse(data):
+    events = []
+    usable = len(data) - len(data) % RECORD.size
+    for off in range(0, usable, RECORD.size):
+        epoch, ms, ch, on, src, reason = RECORD.unpack_from(data, off)
+        events.append({'epoch': epoch, 'ms': ms, 'ch': ch, 'on': bool(on),
+                       'src': name(SOURCES, src), 'reason': name(REASONS, reason)})
+    return events
+
+
+def assign_times(events):
+    """Fill in wall-clock time for events recorded before NTP sync.
+
+    Within one boot (between boot markers) millis() is continuous, so any
+    event carrying an epoch anchors the others of the same boot.
+    """
+    boots = []
+    for e in events:
+        if e['src'] == 'boot' or not boots:
+            boots.append([])
+        boots[-1].append(e)
+    for boot in boots:
+        anchor = next((e for e in boot if e['epoch']), None)
+        for e in boot:
+            if e['epoch']:
+                e['time'] = float(e['epoch'])
+            elif anchor:
+                e['time'] = anchor['epoch'] + (e['ms'] - anchor['ms']) / 1000.0
+            else:
+                e['time'] = None
+    return events
+
+
+def fmt_time(e):
+    if e['time'] is None:
+        return f"+{e['ms'] / 1000.0:.3f}s"
+    return datetime.datetime.fromtimestamp(e['time']).strftime('%Y-%m-%d %H:%M:%S')
+
+
+def timelines(events):
+    """Per-channel list of (on_event, off_event or None) intervals."""
+    out = {}
+    open_on = {}
+    for e in events:
+        if e['src'] == 'boot':
+            # relays are driven off at boot
+            for ch, on in list(open_on.items()):
+                out.setdefault(ch, []).append((on, e))
+            open_on.clear()
+            continue
+        ch = e['ch']
+        if e['on']:
+            open_on.setdefault(ch, e)
+        elif ch in open_on:
+            out.setdefault(ch, []).append((open_on.pop(ch), e))
+    for ch, on in open_on.items():
+        out.setdefault(ch, []).append((on, None))
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay relay actuation journal')
+    parser.add_argument('files', nargs='*', help='journal files, oldest first')
+    parser.add_argument('--url', help='download journal from device (http://<ip>/journal)')
+    parser.add_argument('--channel', type=int, help='only show this channel')
+    parser.add_argument('--at', help='show who held each relay on at "YYYY-MM-DD HH:MM[:SS]"')
+    parser.add_argument('--events', action='store_true', help='print raw event list')
+    args = parser.parse_args()
+
+    data = b''
+    if args.url:
+        data += urllib.request.urlopen(args.url, timeout=10).read()
+    for path in args.files:
+        with open(path, 'rb') as f:
+            data += f.read()
+    if not data:
+        parser.error('no journal data (give files or --url)')
+
+    events = assign_times(parse(data))
+    if args.events:
+        for e in events:
+            if args.channel and e['ch'] != args.channel:
+                continue
+            if e['src'] == 'boot':
+                print(f"{fmt_time(e)}  --- boot ---")
+            else:
+                print(f"{fmt_time(e)}  ch{e['ch']} {'ON ' if e['on'] else 'OFF'} "
+                      f"by {e['src']} ({e['reason']})")
+
+    tl = timelines(events)
+    if args.at:
+        at = None
+        for fmt in ('%Y-%m-%d %H:%M:%S', '%Y-%m-%d %H:%M'):
+            try:
+                at = datetime.datetime.strptime(args.at, fmt).timestamp()
+            except ValueError:
+                pass
+        if at is None:
+            parser.error('--at must be "YYYY-MM-DD HH:MM[:SS]"')
+        for ch in sorted(tl):
+            if args.channel and ch != args.channel:
+                continue
+            for on, off in tl[ch]:
+                if on['time'] is None or on['time'] > at:
+                    continue
+                if off is None or (off['time'] is not None and off['time'] > at):
+                    print(f"ch{ch} was ON at {args.at}: turned on {fmt_time(on)} "
+                          f"by {on['src']} ({on['reason']})")
+        return
+
+    for ch in sorted(tl):
+        if args.channel and ch != args.channel:
+            continue
+        print(f'Channel {ch}:')
+        for on, off in tl[ch]:
+            line = f"  ON  {fmt_time(on)} by {on['src']} ({on['reason']})"
+            if off is None:
+                line += '  -> still on'
+            else:
+                line += f"  -> OFF {fmt_time(off)} by {off['src']} ({off['reason']})"
+                if on['time'] is not None and off['time'] is not None:
+                    line += f"  [{off['time'] - on['time']:.0f}s]"
+            print(line)
+
+
+if __name__ == '__main__':
+    sys.exit(main())